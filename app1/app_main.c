@@ -35,6 +35,7 @@
 #include "cmd.h"
 #include "console.h"
 #include "dio.h"
+#include "evt.h"
 #include "gps_gtu7.h"
 #include "log.h"
 #include "mem.h"
@@ -64,6 +65,7 @@ enum main_u16_pms {
 ////////////////////////////////////////////////////////////////////////////////
 
 static int32_t cmd_main_status();
+static void gps_cycle_cb(const struct evt* evt, uint32_t user_data);
 
 ////////////////////////////////////////////////////////////////////////////////
 // Private (static) variables
@@ -104,18 +106,22 @@ static struct cmd_client_info cmd_info = {
 enum dout_index {
     DIN_BUTTON_1,
     DIN_GPS_PPS,
+    DIN_SWUART_RX,
 
     DIN_NUM
 };
 
 static struct dio_in_info d_inputs[DIN_NUM] = {
     {
-        // Button 1
+        // Button 1. Debounced, so no edge interrupt: contact bounce would
+        // flood the edge queue. Use EVT_TOPIC_DIO_BUTTON or dio_get_stable().
         .name = "Button_1",
         .port = DIO_PORT_C,
         .pin = DIO_PIN_13,
         .pull = DIO_PULL_NO,
         .invert = 1,
+        .debounce = DIO_DEBOUNCE_INTEG,
+        .debounce_samples = 4,
     },
     {
         // GPS PPS, connected to PB2 (CN10, pin 22).
@@ -123,11 +129,23 @@ static struct dio_in_info d_inputs[DIN_NUM] = {
         .port = DIO_PORT_A,
         .pin = DIO_PIN_8,
         .pull = DIO_PULL_NO,
+        .edge = DIO_EDGE_RISING,
+        .capture_tmr = DIO_TMR_1,
+        .capture_chan = 1,
+        .capture_af = DIO_AF_1,
+    },
+    {
+        // Software UART RX, PC11 (CN7, pin 2).
+        .name = "SWUART_RX",
+        .port = DIO_PORT_C,
+        .pin = DIO_PIN_11,
+        .pull = DIO_PULL_UP,
     }
 };
 
 enum din_index {
     DOUT_LED_2,
+    DOUT_SWUART_TX,
 
     DOUT_NUM
 };
@@ -142,6 +160,19 @@ static struct dio_out_info d_outputs[DOUT_NUM] = {
         .init_value = 0,
         .speed = DIO_SPEED_FREQ_LOW,
         .output_type = DIO_OUTPUT_PUSHPULL,
+        .pwm_tmr = DIO_TMR_2,
+        .pwm_chan = 1,
+        .pwm_af = DIO_AF_1,
+    },
+    {
+        // Software UART TX, PC10 (CN7, pin 1).
+        .name = "SWUART_TX",
+        .port = DIO_PORT_C,
+        .pin = DIO_PIN_10,
+        .pull = DIO_PULL_NO,
+        .init_value = 1,
+        .speed = DIO_SPEED_FREQ_LOW,
+        .output_type = DIO_OUTPUT_PUSHPULL,
     }
 };
 
@@ -150,6 +181,7 @@ static struct dio_cfg dio_cfg = {
     .inputs = d_inputs,
     .num_outputs = ARRAY_SIZE(d_outputs),
     .outputs = d_outputs,
+    .debounce_ms = 5,
 };
 
 static struct stat_dur stat_loop_dur;
@@ -166,6 +198,7 @@ void app_main(void)
 {
     int32_t result;;
     struct console_cfg console_cfg;
+    struct evt_cfg evt_cfg;
     struct gps_cfg gps_cfg;
     struct ttys_cfg ttys_cfg;
     struct blinky_cfg blinky_cfg = {
@@ -174,6 +207,7 @@ void app_main(void)
         .code_period_ms = 1000,
         .sep_num_blinks = 5,
         .sep_period_ms = 200,
+        .hw_enable = true,
     };
 
     //
@@ -207,6 +241,37 @@ void app_main(void)
         }
     }
 
+    // UART1 is used by the gps NMEA load generator ("gps gen").
+    result = ttys_get_def_cfg(TTYS_INSTANCE_UART1, &ttys_cfg);
+    if (result < 0) {
+        log_error("ttys_get_def_cfg error %d\n", result);
+        INC_SAT_U16(cnts_u16[CNT_INIT_ERR]);
+    } else {
+        ttys_cfg.create_stream = false;
+        ttys_cfg.send_cr_after_nl = false;
+        result = ttys_init(TTYS_INSTANCE_UART1, &ttys_cfg);
+        if (result < 0) {
+            log_error("ttys_init UART1 error %d\n", result);
+            INC_SAT_U16(cnts_u16[CNT_INIT_ERR]);
+        }
+    }
+
+    // Software UART on dio pins, as the USARTs are all used.
+    result = ttys_get_def_cfg(TTYS_INSTANCE_SWUART, &ttys_cfg);
+    if (result < 0) {
+        log_error("ttys_get_def_cfg error %d\n", result);
+        INC_SAT_U16(cnts_u16[CNT_INIT_ERR]);
+    } else {
+        ttys_cfg.swuart_tx_dout_idx = DOUT_SWUART_TX;
+        ttys_cfg.swuart_rx_din_idx = DIN_SWUART_RX;
+        ttys_cfg.swuart_baud = 9600;
+        result = ttys_init(TTYS_INSTANCE_SWUART, &ttys_cfg);
+        if (result < 0) {
+            log_error("ttys_init SWUART error %d\n", result);
+            INC_SAT_U16(cnts_u16[CNT_INIT_ERR]);
+        }
+    }
+
     result = cmd_init(NULL);
     if (result < 0) {
         log_error("cmd_init error %d\n", result);
@@ -225,6 +290,18 @@ void app_main(void)
         }
     }
 
+    result = evt_get_def_cfg(&evt_cfg);
+    if (result < 0) {
+        log_error("evt_get_def_cfg error %d\n", result);
+        INC_SAT_U16(cnts_u16[CNT_INIT_ERR]);
+    } else {
+        result = evt_init(&evt_cfg);
+        if (result < 0) {
+            log_error("evt_init error %d\n", result);
+            INC_SAT_U16(cnts_u16[CNT_INIT_ERR]);
+        }
+    }
+
     result = tmr_init(NULL);
     if (result < 0) {
         log_error("tmr_init error %d\n", result);
@@ -237,19 +314,20 @@ void app_main(void)
         INC_SAT_U16(cnts_u16[CNT_INIT_ERR]);
     }
 
-    result = gps_get_def_cfg(&gps_cfg);
+    result = gps_get_def_cfg(GPS_INSTANCE_1, &gps_cfg);
     if (result < 0) {
         log_error("gps_get_def_cfg error %d\n", result);
         INC_SAT_U16(cnts_u16[CNT_INIT_ERR]);
     } else {
-        result = gps_init(&gps_cfg);
+        gps_cfg.pps_din_idx = DIN_GPS_PPS;
+        result = gps_init(GPS_INSTANCE_1, &gps_cfg);
         if (result < 0) {
             log_error("gps_init error %d\n", result);
             INC_SAT_U16(cnts_u16[CNT_INIT_ERR]);
         }
     }
     
-    result = blinky_init(&blinky_cfg);
+    result = blinky_init(BLINKY_INSTANCE_1, &blinky_cfg);
     if (result < 0) {
         log_error("blinky_init error %d\n", result);
         INC_SAT_U16(cnts_u16[CNT_INIT_ERR]);
@@ -273,6 +351,24 @@ void app_main(void)
         INC_SAT_U16(cnts_u16[CNT_START_ERR]);
     }
 
+    result = ttys_start(TTYS_INSTANCE_UART1);
+    if (result < 0) {
+        log_error("ttys_start UART1 error %d\n", result);
+        INC_SAT_U16(cnts_u16[CNT_START_ERR]);
+    }
+
+    result = ttys_start(TTYS_INSTANCE_SWUART);
+    if (result < 0) {
+        log_error("ttys_start SWUART error %d\n", result);
+        INC_SAT_U16(cnts_u16[CNT_START_ERR]);
+    }
+
+    result = evt_start();
+    if (result < 0) {
+        log_error("evt_start error %d\n", result);
+        INC_SAT_U16(cnts_u16[CNT_START_ERR]);
+    }
+
     result = tmr_start();
     if (result < 0) {
         log_error("tmr_start error %d\n", result);
@@ -285,19 +381,25 @@ void app_main(void)
         INC_SAT_U16(cnts_u16[CNT_START_ERR]);
     }
 
-    result = gps_start();
+    result = gps_start(GPS_INSTANCE_1);
     if (result < 0) {
         log_error("gps_start error %d\n", result);
         INC_SAT_U16(cnts_u16[CNT_START_ERR]);
     }
 
+    result = evt_subscribe(EVT_TOPIC_GPS_CYCLE, gps_cycle_cb, 0);
+    if (result < 0) {
+        log_error("evt_subscribe error %d\n", result);
+        INC_SAT_U16(cnts_u16[CNT_START_ERR]);
+    }
+
     result = mem_start();
     if (result < 0) {
         log_error("mem_start error %d\n", result);
         INC_SAT_U16(cnts_u16[CNT_START_ERR]);
     }
 
-    result = blinky_start();
+    result = blinky_start(BLINKY_INSTANCE_1);
     if (result < 0) {
         log_error("blinky_start error %d\n", result);
         INC_SAT_U16(cnts_u16[CNT_START_ERR]);
@@ -329,10 +431,22 @@ void app_main(void)
         if (result < 0)
             INC_SAT_U16(cnts_u16[CNT_RUN_ERR]);
 
+        result = dio_run();
+        if (result < 0)
+            INC_SAT_U16(cnts_u16[CNT_RUN_ERR]);
+
         result = tmr_run();
         if (result < 0)
             INC_SAT_U16(cnts_u16[CNT_RUN_ERR]);
 
+        result = evt_run();
+        if (result < 0)
+            INC_SAT_U16(cnts_u16[CNT_RUN_ERR]);
+
+        result = mem_run();
+        if (result < 0)
+            INC_SAT_U16(cnts_u16[CNT_RUN_ERR]);
+
     }
 }
 
@@ -379,3 +493,19 @@ static int32_t cmd_main_status(int32_t argc, const char** argv)
     }
     return 0;
 }
+
+/*
+ * @brief Event callback for EVT_TOPIC_GPS_CYCLE.
+ *
+ * @param[in] evt The event.
+ * @param[in] user_data Not used.
+ *
+ * GPS instance 1 has the PPS input, so the UTC time of its navigation epochs
+ * labels the most recent PPS edge in the tmr timebase.
+ */
+static void gps_cycle_cb(const struct evt* evt, uint32_t user_data)
+{
+    if (evt->data.gps_cycle.instance_id == GPS_INSTANCE_1 &&
+        evt->data.gps_cycle.utc_sec != 0)
+        tmr_pps_set_utc(evt->data.gps_cycle.utc_sec);
+}
@@ -0,0 +1,239 @@
+/*
+ * @brief Host test of the dop utility.
+ *
+ * dop_calc() (fixed-point) is compared with dop_calc_ref() (double
+ * precision):
+ * - A known geometry (one satellite at the zenith, three on the horizon
+ *   120 degrees apart), where inv(G'G) has a closed form, checks both.
+ * - Random geometries (4 to DOP_MAX_SATS satellites, whole degrees) check
+ *   the fixed-point results are within DOP_MAX_ERR_X100 of the reference,
+ *   for a reference GDOP up to DOP_MAX_GDOP_X100. Poorer geometries are not
+ *   checked, but the maximum error is reported per GDOP range. The
+ *   fixed-point calculation may reject a geometry the reference accepts, but
+ *   not the other way around.
+ *
+ * Usage: dop_test [trials [seed]]
+ *
+ * The exit status is 0 if all checks pass.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2021 Eugene R Schroeder
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "dop.h"
+#include "module.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Common macros
+////////////////////////////////////////////////////////////////////////////////
+
+// Tolerances, the same as the "gps dop test" command.
+#define DOP_MAX_GDOP_X100 2000
+#define DOP_MAX_ERR_X100 5
+
+// Tolerance for the closed form check (rounding of the x100 values).
+#define DOP_KNOWN_ERR_X100 1
+
+#define DOP_NUM_VALS 5
+#define DOP_NUM_RANGES 6
+
+#define DEF_TRIALS 1000000
+
+////////////////////////////////////////////////////////////////////////////////
+// Private (static) variables
+////////////////////////////////////////////////////////////////////////////////
+
+static const char* dop_names[DOP_NUM_VALS] = {
+    "GDOP", "PDOP", "HDOP", "VDOP", "TDOP",
+};
+
+// Upper limits of the reference GDOP ranges for the error report.
+static const uint32_t range_max_x100[DOP_NUM_RANGES] = {
+    200, 500, 1000, 2000, 5000, UINT32_MAX,
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Private (static) functions
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * @brief Check both calculations with a geometry that has a closed form
+ *        result.
+ *
+ * @return Number of failures.
+ *
+ * With unit vectors (0,0,1) and (cos(a),sin(a),0) for a = 0, 120, 240, G'G
+ * is diag(1.5, 1.5) for east/north, and [[1, 1], [1, 4]] for up/clock. So
+ * q00 = q11 = 2/3, q22 = 4/3, q33 = 1/3.
+ */
+static int check_known(void)
+{
+    static const struct dop_sat sats[] = {
+        { .azimuth = 0, .elevation = 90 },
+        { .azimuth = 0, .elevation = 0 },
+        { .azimuth = 120, .elevation = 0 },
+        { .azimuth = 240, .elevation = 0 },
+    };
+    const double expect[DOP_NUM_VALS] = {
+        sqrt(3.0), sqrt(8.0 / 3), sqrt(4.0 / 3), sqrt(4.0 / 3), sqrt(1.0 / 3),
+    };
+    struct dop_result results[2];
+    const uint16_t* vals;
+    int fails = 0;
+    int impl;
+    int idx;
+
+    if (dop_calc(sats, ARRAY_SIZE(sats), &results[0]) != 0 ||
+        dop_calc_ref(sats, ARRAY_SIZE(sats), &results[1]) != 0) {
+        printf("FAIL: known geometry rejected\n");
+        return 1;
+    }
+    for (impl = 0; impl < 2; impl++) {
+        vals = &results[impl].gdop_x100;
+        for (idx = 0; idx < DOP_NUM_VALS; idx++) {
+            if (fabs(vals[idx] - expect[idx] * 100) > DOP_KNOWN_ERR_X100) {
+                printf("FAIL: known geometry %s %s %u, expected %.2f\n",
+                       impl == 0 ? "fixed" : "ref", dop_names[idx],
+                       vals[idx], expect[idx]);
+                fails++;
+            }
+        }
+    }
+    return fails;
+}
+
+/*
+ * @brief Compare the calculations on random geometries.
+ *
+ * @param[in] trials Number of geometries.
+ * @param[in] seed Random number seed.
+ *
+ * @return Number of failures.
+ */
+static int check_random(uint32_t trials, uint32_t seed)
+{
+    struct dop_sat sats[DOP_MAX_SATS];
+    struct dop_result result;
+    struct dop_result ref;
+    const uint16_t* vals;
+    const uint16_t* ref_vals;
+    uint32_t max_err[DOP_NUM_RANGES][DOP_NUM_VALS] = {{0}};
+    uint32_t range_cnt[DOP_NUM_RANGES] = {0};
+    uint32_t rejected = 0;
+    uint32_t trial;
+    uint32_t num_sats;
+    uint32_t range;
+    uint32_t err;
+    int fails = 0;
+    int rc;
+    int ref_rc;
+    int idx;
+
+    srand(seed);
+    for (trial = 0; trial < trials; trial++) {
+        num_sats = 4 + rand() % (DOP_MAX_SATS - 3);
+        for (idx = 0; idx < (int)num_sats; idx++) {
+            sats[idx].azimuth = rand() % 360;
+            sats[idx].elevation = rand() % 91;
+        }
+        rc = dop_calc(sats, num_sats, &result);
+        ref_rc = dop_calc_ref(sats, num_sats, &ref);
+        if (ref_rc != 0) {
+            if (rc == 0) {
+                if (fails < 5)
+                    printf("FAIL: sats=%lu accepted, rejected by ref\n",
+                           (unsigned long)num_sats);
+                fails++;
+            }
+            continue;
+        }
+        if (rc != 0) {
+            // Only allowed for poor geometry.
+            if (ref.gdop_x100 <= DOP_MAX_GDOP_X100) {
+                if (fails < 5)
+                    printf("FAIL: sats=%lu rejected, ref GDOP %u\n",
+                           (unsigned long)num_sats, ref.gdop_x100);
+                fails++;
+            }
+            rejected++;
+            continue;
+        }
+
+        for (range = 0; ref.gdop_x100 > range_max_x100[range]; range++)
+            ;
+        range_cnt[range]++;
+        vals = &result.gdop_x100;
+        ref_vals = &ref.gdop_x100;
+        for (idx = 0; idx < DOP_NUM_VALS; idx++) {
+            err = abs(vals[idx] - ref_vals[idx]);
+            if (err > max_err[range][idx])
+                max_err[range][idx] = err;
+            if (ref.gdop_x100 <= DOP_MAX_GDOP_X100 &&
+                err > DOP_MAX_ERR_X100) {
+                if (fails < 5)
+                    printf("FAIL: sats=%lu %s %u, ref %u\n",
+                           (unsigned long)num_sats, dop_names[idx],
+                           vals[idx], ref_vals[idx]);
+                fails++;
+            }
+        }
+    }
+
+    printf("Trials=%lu seed=%lu rejected (poor geometry)=%lu\n",
+           (unsigned long)trials, (unsigned long)seed,
+           (unsigned long)rejected);
+    printf("Ref GDOP range   Count    Max error (GDOP PDOP HDOP VDOP TDOP)\n");
+    for (range = 0; range < DOP_NUM_RANGES; range++) {
+        uint32_t lo = range == 0 ? 0 : range_max_x100[range - 1];
+        if (range_max_x100[range] == UINT32_MAX)
+            printf("  %5.2f+        ", lo / 100.0);
+        else
+            printf("  %5.2f-%-6.2f  ", lo / 100.0,
+                   range_max_x100[range] / 100.0);
+        printf("%8lu   ", (unsigned long)range_cnt[range]);
+        for (idx = 0; idx < DOP_NUM_VALS; idx++)
+            printf(" %4.2f", max_err[range][idx] / 100.0);
+        printf("\n");
+    }
+    printf("Tolerance: %.2f up to GDOP %.2f\n", DOP_MAX_ERR_X100 / 100.0,
+           DOP_MAX_GDOP_X100 / 100.0);
+    return fails;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Main
+////////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char** argv)
+{
+    uint32_t trials = argc > 1 ? strtoul(argv[1], NULL, 0) : DEF_TRIALS;
+    uint32_t seed = argc > 2 ? strtoul(argv[2], NULL, 0) : 1;
+    int fails = 0;
+
+    fails += check_known();
+    fails += check_random(trials, seed);
+    printf("%s\n", fails == 0 ? "PASS" : "FAIL");
+    return fails == 0 ? 0 : 1;
+}
@@ -0,0 +1,566 @@
+/*
+ * @brief Host replay harness for the gps_gtu7 module parser.
+ *
+ * Recorded receiver captures (NMEA, any length) are fed through the real
+ * gps_run()/process_byte()/process_msg() path, with stubs for the ttys and
+ * tmr modules:
+ * - The ttys stub reads the capture files, passes each character through the
+ *   receive filter (if the instance registered one), and returns the result
+ *   from ttys_getc(). gps_run() is called after each line.
+ * - The tmr stub keeps a simulated time. It advances by one character time at
+ *   the capture baud rate for each character, and jumps to the next second
+ *   when the RMC/GGA time of day changes, so the cleanup timer and health
+ *   measurements see realistic timing. Expired timer callbacks are called
+ *   before each gps_run().
+ *
+ * Checks:
+ * - Each line is classified independently (good, bad checksum, truncated),
+ *   using the NMEA rules, and compared to the module counters. This is only
+ *   done with the receive filter off, since the filter drops lines first.
+ * - With the receive filter on, each line it passed (marked by an arrival tag)
+ *   must get one latency sample, with no arrival times lost.
+ * - The final satellite table, UTC time and position are printed as
+ *   "sat <prn> <elevation> <azimuth> <snr>", "utc <yyyy-mm-dd> <hh:mm:ss>" and
+ *   "pos <lat> <lon>" (1e-7 degrees) lines. With -x, they are compared to an
+ *   expect file in the same format ('#' starts a comment line).
+ *
+ * The host time spent in gps_run() is measured per line, and reported with
+ * the replay speed relative to real time at the capture baud rate.
+ *
+ * Usage: gps_replay [-b baud] [-f] [-x expect-file] capture-file...
+ *
+ * The exit status is 0 if all checks pass.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2021 Eugene R Schroeder
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// The module under test is included, to give access to its static state.
+#include "../modules/gps_gtu7/gps_gtu7.c"
+
+////////////////////////////////////////////////////////////////////////////////
+// Common macros
+////////////////////////////////////////////////////////////////////////////////
+
+#define REPLAY_INSTANCE GPS_INSTANCE_1
+#define REPLAY_RX_BFR_SIZE 1024
+#define REPLAY_MAX_EXPECT_LINES 64
+#define REPLAY_LINE_SIZE 128
+#define REPLAY_CYCLES_PER_US 84
+
+////////////////////////////////////////////////////////////////////////////////
+// Type definitions
+////////////////////////////////////////////////////////////////////////////////
+
+struct replay_tmr {
+    tmr_cb_func cb_func;
+    uint32_t cb_user_data;
+    uint32_t period_ms;
+    uint32_t start_ms;
+};
+
+// Line counts, from the harness's own classification.
+struct replay_cnts {
+    uint32_t lines;
+    uint32_t good;      // Good, with a known message type.
+    uint32_t other;     // Good, with an unknown message type.
+    uint32_t cksum_err;
+    uint32_t truncated;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Private (static) variables
+////////////////////////////////////////////////////////////////////////////////
+
+// Simulated time.
+static uint64_t sim_us;
+
+static struct replay_tmr tmrs[TMR_NUM_INST];
+static uint32_t num_tmrs;
+
+// Receive filter registered by the module, and characters it passed.
+static ttys_rx_filter_cb rx_filter;
+static uint32_t rx_filter_user_data;
+static char rx_bfr[REPLAY_RX_BFR_SIZE];
+static uint32_t rx_put_idx;
+static uint32_t rx_get_idx;
+static uint32_t rx_arrival_tags;
+
+////////////////////////////////////////////////////////////////////////////////
+// Stubs for modules not included in the host build
+////////////////////////////////////////////////////////////////////////////////
+
+uint32_t tmr_get_ms(void)
+{
+    return (uint32_t)(sim_us / 1000);
+}
+
+uint32_t tmr_get_cycles(void)
+{
+    return (uint32_t)(sim_us * REPLAY_CYCLES_PER_US);
+}
+
+int32_t tmr_inst_get_cb(uint32_t ms, tmr_cb_func cb_func,
+                        uint32_t cb_user_data)
+{
+    struct replay_tmr* tmr;
+
+    if (num_tmrs >= TMR_NUM_INST)
+        return MOD_ERR_RESOURCE;
+    tmr = &tmrs[num_tmrs];
+    tmr->cb_func = cb_func;
+    tmr->cb_user_data = cb_user_data;
+    tmr->period_ms = ms;
+    tmr->start_ms = tmr_get_ms();
+    return num_tmrs++;
+}
+
+void tmr_pps_edge(uint32_t edge_cycles)
+{
+}
+
+int32_t dio_set_edge_isr_cb(uint32_t din_idx, dio_edge_cb cb,
+                            uint32_t user_data)
+{
+    return 0;
+}
+
+int32_t ttys_getc(enum ttys_instance_id instance_id, char* c)
+{
+    if (rx_get_idx == rx_put_idx)
+        return 0;
+    *c = rx_bfr[rx_get_idx++];
+    return 1;
+}
+
+int32_t ttys_putc(enum ttys_instance_id instance_id, char c)
+{
+    return 0;
+}
+
+int32_t ttys_set_baud(enum ttys_instance_id instance_id, uint32_t baud)
+{
+    return 0;
+}
+
+uint32_t ttys_get_baud(enum ttys_instance_id instance_id)
+{
+    return GPS_RCVR_DEF_BAUD;
+}
+
+bool ttys_is_tx_idle(enum ttys_instance_id instance_id)
+{
+    return true;
+}
+
+uint32_t ttys_get_tx_free(enum ttys_instance_id instance_id)
+{
+    return REPLAY_RX_BFR_SIZE;
+}
+
+int32_t ttys_set_rx_filter(enum ttys_instance_id instance_id,
+                           ttys_rx_filter_cb cb, uint32_t user_data)
+{
+    rx_filter = cb;
+    rx_filter_user_data = user_data;
+    return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Private (static) functions
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * @brief Call the callbacks of expired timers.
+ */
+static void run_tmrs(void)
+{
+    uint32_t now_ms = tmr_get_ms();
+    struct replay_tmr* tmr;
+
+    for (tmr = tmrs; tmr < &tmrs[num_tmrs]; tmr++) {
+        while (tmr->period_ms != 0 &&
+               now_ms - tmr->start_ms >= tmr->period_ms) {
+            tmr->start_ms += tmr->period_ms;
+            if (tmr->cb_func(tmr - tmrs, tmr->cb_user_data) != TMR_CB_RESTART)
+                tmr->period_ms = 0;
+        }
+    }
+}
+
+/*
+ * @brief Receive a character, as the ttys interrupt handler would.
+ *
+ * @param[in] c The character.
+ */
+static void rx_char(char c)
+{
+    char out[TTYS_RX_FILTER_MAX_OUT];
+    uint32_t num;
+    uint32_t idx;
+
+    if (rx_filter == NULL) {
+        out[0] = c;
+        num = 1;
+    } else {
+        num = rx_filter(c, out, rx_filter_user_data);
+    }
+    for (idx = 0; idx < num && rx_put_idx < REPLAY_RX_BFR_SIZE; idx++) {
+        if (((uint8_t)out[idx] & ~ARRIVAL_TAG_MASK) == ARRIVAL_TAG_BASE)
+            rx_arrival_tags++;
+        rx_bfr[rx_put_idx++] = out[idx];
+    }
+}
+
+/*
+ * @brief Get the time of day from an RMC or GGA sentence.
+ *
+ * @param[in] line The sentence.
+ *
+ * @return Seconds since midnight, or -1 if not an RMC/GGA sentence with a
+ *         time.
+ */
+static int32_t line_tod_sec(const char* line)
+{
+    const char* p;
+
+    if (line[0] != '$' || strlen(line) < 14 ||
+        (strncmp(line + 3, "RMC,", 4) != 0 &&
+         strncmp(line + 3, "GGA,", 4) != 0))
+        return -1;
+    p = line + 7;
+    if (!isdigit((unsigned char)p[0]) || !isdigit((unsigned char)p[5]))
+        return -1;
+    return two_digits(p) * 3600 + two_digits(p + 2) * 60 + two_digits(p + 4);
+}
+
+/*
+ * @brief Classify a line the way the module should: truncated if too long
+ *        for the input buffer or missing the checksum, else checksum error or
+ *        good. Only the message type lookup uses module code.
+ *
+ * @param[in] line The line, without the line terminator.
+ * @param[in,out] cnts Counts to update.
+ */
+static void classify_line(const char* line, struct replay_cnts* cnts)
+{
+    uint32_t printable = 0;
+    uint8_t sum = 0;
+    unsigned int cksum;
+    const char* p;
+
+    for (p = line; *p != '\0'; p++)
+        if (isprint((unsigned char)*p))
+            printable++;
+    if (printable == 0)
+        return;
+    cnts->lines++;
+    if (printable > GPS_IN_BFR_SIZE - 1) {
+        cnts->truncated++;
+        return;
+    }
+    for (p = line + 1; *p != '\0' && *p != '*'; p++)
+        sum ^= (uint8_t)*p;
+    if (line[0] != '$' || *p != '*' || strlen(p) < 3) {
+        cnts->truncated++;
+        return;
+    }
+    if (sscanf(p + 1, "%2x", &cksum) != 1 || cksum != sum) {
+        cnts->cksum_err++;
+        return;
+    }
+    if (nmea_prefix_to_msg_id(line) >= 0)
+        cnts->good++;
+    else
+        cnts->other++;
+}
+
+/*
+ * @brief Get a host monotonic time.
+ *
+ * @return Time in ns.
+ */
+static uint64_t host_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+ * @brief Compare a counter to its expected value.
+ *
+ * @param[in] name Counter name.
+ * @param[in] value Module counter value (saturating at UINT16_MAX).
+ * @param[in] expected Expected count.
+ *
+ * @return Number of failures (0 or 1).
+ */
+static int check_cnt(const char* name, uint32_t value, uint32_t expected)
+{
+    if (expected > UINT16_MAX)
+        expected = UINT16_MAX;
+    if (value == expected)
+        return 0;
+    printf("FAIL: %s %lu, expected %lu\n", name, (unsigned long)value,
+           (unsigned long)expected);
+    return 1;
+}
+
+/*
+ * @brief Print the parser output, and compare it to an expect file.
+ *
+ * @param[in] st The gps instance state.
+ * @param[in] expect_path Expect file, or NULL for none.
+ *
+ * @return Number of failures.
+ */
+static int check_output(struct gps_state* st, const char* expect_path)
+{
+    static char got[REPLAY_MAX_EXPECT_LINES][REPLAY_LINE_SIZE];
+    static char exp[REPLAY_MAX_EXPECT_LINES][REPLAY_LINE_SIZE];
+    uint32_t num_got = 0;
+    uint32_t num_exp = 0;
+    uint32_t idx;
+    int fails = 0;
+    FILE* f;
+
+    if (st->utc.valid)
+        snprintf(got[num_got++], REPLAY_LINE_SIZE,
+                 "utc %04u-%02u-%02u %02u:%02u:%02u", st->utc.year,
+                 st->utc.month, st->utc.day, st->utc.hour, st->utc.min,
+                 st->utc.sec);
+    if (st->fix.valid)
+        snprintf(got[num_got++], REPLAY_LINE_SIZE, "pos %ld %ld",
+                 (long)st->fix.lat, (long)st->fix.lon);
+    for (idx = 0; idx < MAX_SATS && num_got < REPLAY_MAX_EXPECT_LINES;
+         idx++) {
+        struct sat_data* sat = &st->sat_data[idx];
+        if (sat->present)
+            snprintf(got[num_got++], REPLAY_LINE_SIZE, "sat %lu %u %u %u",
+                     (unsigned long)idx + 1, sat->elevation, sat->azimuth,
+                     sat->snr);
+    }
+    for (idx = 0; idx < num_got; idx++)
+        printf("%s\n", got[idx]);
+    if (expect_path == NULL)
+        return 0;
+
+    f = fopen(expect_path, "r");
+    if (f == NULL) {
+        perror(expect_path);
+        return 1;
+    }
+    while (num_exp < REPLAY_MAX_EXPECT_LINES &&
+           fgets(exp[num_exp], REPLAY_LINE_SIZE, f) != NULL) {
+        exp[num_exp][strcspn(exp[num_exp], "\r\n")] = '\0';
+        if (exp[num_exp][0] != '#' && exp[num_exp][0] != '\0')
+            num_exp++;
+    }
+    fclose(f);
+
+    for (idx = 0; idx < num_got || idx < num_exp; idx++) {
+        const char* g = idx < num_got ? got[idx] : "(none)";
+        const char* e = idx < num_exp ? exp[idx] : "(none)";
+        if (strcmp(g, e) != 0) {
+            printf("FAIL: got \"%s\", expected \"%s\"\n", g, e);
+            fails++;
+        }
+    }
+    return fails;
+}
+
+/*
+ * @brief Replay a capture file.
+ *
+ * @param[in] path Capture file path.
+ * @param[in] baud Capture baud rate.
+ * @param[in,out] cnts Line counts to update.
+ *
+ * @return 0 for success, else -1 if the file can't be read.
+ */
+static int replay_file(const char* path, uint32_t baud,
+                       struct replay_cnts* cnts)
+{
+    static int32_t last_tod = -1;
+    static uint64_t epoch_us;
+    static uint64_t run_ns_total;
+    static uint64_t run_ns_min = UINT64_MAX;
+    static uint64_t run_ns_max;
+    static uint64_t bytes_total;
+    static uint32_t runs;
+    uint64_t char_us_x1000 = 10000000000ULL / baud;
+    uint64_t start_sim_us = sim_us;
+    uint64_t sim_us_x1000 = 0;
+    uint64_t bytes = 0;
+    char* line = NULL;
+    size_t line_size = 0;
+    ssize_t len;
+    ssize_t idx;
+    FILE* f;
+
+    f = fopen(path, "r");
+    if (f == NULL) {
+        perror(path);
+        return -1;
+    }
+    while ((len = getline(&line, &line_size, f)) > 0) {
+        int32_t tod = line_tod_sec(line);
+        uint64_t t0;
+        uint64_t ns;
+
+        // Start of a new epoch (one second, at most).
+        if (tod >= 0 && tod != last_tod) {
+            if (last_tod >= 0) {
+                epoch_us += 1000000;
+                if (sim_us < epoch_us)
+                    sim_us = epoch_us;
+            }
+            epoch_us = sim_us;
+            last_tod = tod;
+        }
+        for (idx = 0; idx < len; idx++) {
+            sim_us_x1000 += char_us_x1000;
+            sim_us += sim_us_x1000 / 1000;
+            sim_us_x1000 %= 1000;
+            rx_char(line[idx]);
+        }
+        bytes += len;
+
+        line[strcspn(line, "\r\n")] = '\0';
+        classify_line(line, cnts);
+
+        run_tmrs();
+        t0 = host_ns();
+        gps_run();
+        ns = host_ns() - t0;
+        rx_put_idx = 0;
+        rx_get_idx = 0;
+
+        runs++;
+        run_ns_total += ns;
+        if (ns < run_ns_min)
+            run_ns_min = ns;
+        if (ns > run_ns_max)
+            run_ns_max = ns;
+    }
+    free(line);
+    fclose(f);
+
+    bytes_total += bytes;
+    printf("%s: %llu bytes, %llu s simulated\n", path,
+           (unsigned long long)bytes,
+           (unsigned long long)((sim_us - start_sim_us) / 1000000));
+    if (runs > 0 && run_ns_total > 0)
+        printf("gps_run per line: min %llu avg %llu max %llu ns, "
+               "%.0f bytes/s (%.0fx real time at %lu baud)\n",
+               (unsigned long long)run_ns_min,
+               (unsigned long long)(run_ns_total / runs),
+               (unsigned long long)run_ns_max,
+               bytes_total * 1e9 / run_ns_total,
+               bytes_total * 1e9 / run_ns_total / (baud / 10.0),
+               (unsigned long)baud);
+    return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Main
+////////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char** argv)
+{
+    struct replay_cnts cnts = {0};
+    struct gps_state* st = &gps_states[REPLAY_INSTANCE];
+    struct gps_cfg cfg;
+    const char* expect_path = NULL;
+    uint32_t baud = GPS_RCVR_DEF_BAUD;
+    bool filter = false;
+    int fails = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "b:fx:")) != -1) {
+        switch (opt) {
+            case 'b':
+                baud = strtoul(optarg, NULL, 0);
+                break;
+            case 'f':
+                filter = true;
+                break;
+            case 'x':
+                expect_path = optarg;
+                break;
+            default:
+                optind = argc;
+                baud = 0;
+                break;
+        }
+    }
+    if (optind >= argc || baud == 0) {
+        fprintf(stderr, "Usage: %s [-b baud] [-f] [-x expect-file] "
+                "capture-file...\n", argv[0]);
+        return 2;
+    }
+
+    gps_get_def_cfg(REPLAY_INSTANCE, &cfg);
+    cfg.pps_enable = false;
+    cfg.rcvr_cfg_enable = false;
+    cfg.nmea_filter_enable = filter;
+    cfg.nmea_filter_msgs = GPS_NMEA_ALL;
+    if (gps_init(REPLAY_INSTANCE, &cfg) != 0 ||
+        gps_start(REPLAY_INSTANCE) != 0) {
+        fprintf(stderr, "gps init/start failed\n");
+        return 1;
+    }
+
+    for (; optind < argc; optind++)
+        if (replay_file(argv[optind], baud, &cnts) != 0)
+            return 1;
+
+    printf("lines %lu: good %lu, other %lu, checksum err %lu, "
+           "truncated %lu\n", (unsigned long)cnts.lines,
+           (unsigned long)cnts.good, (unsigned long)cnts.other,
+           (unsigned long)cnts.cksum_err, (unsigned long)cnts.truncated);
+    if (!filter) {
+        uint32_t good = 0;
+        uint32_t idx;
+        for (idx = 0; idx < NMEA_NUM_MSG_IDS; idx++)
+            good += st->health.msg_cnts[idx];
+        fails += check_cnt("good", good, cnts.good);
+        fails += check_cnt("checksum err", st->health.nmea_cksum_errs,
+                           cnts.cksum_err);
+        fails += check_cnt("truncated", st->health.nmea_truncs,
+                           cnts.truncated);
+    } else {
+        fails += check_cnt("latency samples", st->health.latency_us.samples,
+                           rx_arrival_tags);
+        fails += check_cnt("arrival time lost", cnts_u16[CNT_ARRIVAL_LOST], 0);
+    }
+    fails += check_output(st, expect_path);
+    printf("%s\n", fails == 0 ? "PASS" : "FAIL");
+    return fails == 0 ? 0 : 1;
+}
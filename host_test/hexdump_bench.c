@@ -0,0 +1,251 @@
+/*
+ * @brief Host test and benchmark of the mem module hex dump formatter.
+ *
+ * mem_hexdump() is compared with the printf() loop that "mem r" used before
+ * it:
+ * - For each data unit size, and for full and partial lines, the output
+ *   without the ASCII sidebar must be identical.
+ * - One line with the ASCII sidebar is checked against the expected text.
+ * - Both dump BENCH_BYTES bytes (with 1 byte units) to /dev/null, best of
+ *   BENCH_REPS runs, and the speedup is reported. stdout is unbuffered, as on
+ *   the target, where each write goes to the ttys transmit buffer. The check
+ *   only requires mem_hexdump() to be faster; the speedup depends on the host.
+ *
+ * The test must be linked at a low address (-no-pie), so buffer addresses fit
+ * in the 32-bit address field.
+ *
+ * Usage: hexdump_bench [reps]
+ *
+ * The exit status is 0 if all checks pass.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2021 Eugene R Schroeder
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// The module under test is included, to give access to its static state.
+#include "../modules/mem/mem.c"
+
+////////////////////////////////////////////////////////////////////////////////
+// Common macros
+////////////////////////////////////////////////////////////////////////////////
+
+#define BENCH_BYTES 16384
+#define BENCH_REPS 5
+
+////////////////////////////////////////////////////////////////////////////////
+// Private (static) variables
+////////////////////////////////////////////////////////////////////////////////
+
+static uint8_t bfr[BENCH_BYTES] __attribute__((aligned(4)));
+
+////////////////////////////////////////////////////////////////////////////////
+// Stubs for modules not included in the host build
+////////////////////////////////////////////////////////////////////////////////
+
+uint32_t tmr_get_ms(void)
+{
+    return 0;
+}
+
+uint32_t tmr_get_cycles(void)
+{
+    return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Private (static) functions
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * @brief The "mem r" display loop before mem_hexdump().
+ *
+ * @param[in] addr Start address, aligned to unit_size.
+ * @param[in] count Number of data units to display.
+ * @param[in] unit_size Data unit size (1, 2, or 4).
+ */
+static void old_dump(const void* addr, uint32_t count, uint32_t unit_size)
+{
+    const uint8_t* p8 = addr;
+    uint32_t items_per_line = HEXDUMP_BYTES_PER_LINE / unit_size;
+    uint32_t line_item_ctr = 0;
+
+    while (count-- > 0) {
+        if (line_item_ctr == 0)
+            printf("%08x:", (unsigned)(uintptr_t)p8);
+        switch (unit_size) {
+            case 1:
+                printf(" %02x", *p8);
+                break;
+            case 2:
+                printf(" %04x", *(const uint16_t*)p8);
+                break;
+            case 4:
+                printf(" %08x", *(const uint32_t*)p8);
+                break;
+        }
+        p8 += unit_size;
+        if (++line_item_ctr == items_per_line) {
+            printf("\n");
+            line_item_ctr = 0;
+        }
+    }
+    if (line_item_ctr != 0)
+        printf("\n");
+}
+
+/*
+ * @brief Capture the output of a dump.
+ *
+ * @param[in] old Use old_dump() rather than mem_hexdump().
+ * @param[in] count Number of data units to display, from the buffer start.
+ * @param[in] unit_size Data unit size (1, 2, or 4).
+ * @param[in] ascii Display the ASCII sidebar (mem_hexdump() only).
+ *
+ * @return The output, to be freed by the caller.
+ */
+static char* capture(bool old, uint32_t count, uint32_t unit_size, bool ascii)
+{
+    FILE* saved_stdout = stdout;
+    char* out = NULL;
+    size_t out_len;
+
+    stdout = open_memstream(&out, &out_len);
+    if (old)
+        old_dump(bfr, count, unit_size);
+    else
+        mem_hexdump(bfr, count, unit_size, ascii);
+    fclose(stdout);
+    stdout = saved_stdout;
+    return out;
+}
+
+/*
+ * @brief Check the output format.
+ *
+ * @return Number of failures.
+ */
+static int check_format(void)
+{
+    static const uint32_t counts[] = { 1, 3, 4, 15, 16, 17, 100 };
+    char expect[HEXDUMP_LINE_SIZE + 1];
+    uint32_t unit_size;
+    uint32_t idx;
+    char* old_out;
+    char* new_out;
+    int fails = 0;
+
+    for (unit_size = 1; unit_size <= 4; unit_size *= 2) {
+        for (idx = 0; idx < ARRAY_SIZE(counts); idx++) {
+            old_out = capture(true, counts[idx], unit_size, false);
+            new_out = capture(false, counts[idx], unit_size, false);
+            if (strcmp(old_out, new_out) != 0) {
+                printf("FAIL: unit size %u count %u:\n%s-- expected:\n%s",
+                       unit_size, counts[idx], new_out, old_out);
+                fails++;
+            }
+            free(old_out);
+            free(new_out);
+        }
+    }
+
+    // 5 of 16 bytes, so the sidebar is padded.
+    snprintf(expect, sizeof(expect), "%08x: 48 69 21 0a ff%*s  Hi!..\n",
+             (unsigned)(uintptr_t)bfr, 11 * 3, "");
+    new_out = capture(false, 5, 1, true);
+    if (strcmp(new_out, expect) != 0) {
+        printf("FAIL: ASCII sidebar:\n%s-- expected:\n%s", new_out, expect);
+        fails++;
+    }
+    free(new_out);
+    return fails;
+}
+
+/*
+ * @brief Time a dump of the buffer to /dev/null.
+ *
+ * @param[in] old Use old_dump() rather than mem_hexdump().
+ * @param[in] reps Number of runs.
+ *
+ * @return Fastest run time, in seconds.
+ */
+static double time_dump(bool old, uint32_t reps)
+{
+    FILE* saved_stdout = stdout;
+    double best = 0;
+    double secs;
+    struct timespec start;
+    struct timespec end;
+    uint32_t rep;
+
+    stdout = fopen("/dev/null", "w");
+    setvbuf(stdout, NULL, _IONBF, 0);
+    for (rep = 0; rep < reps; rep++) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (old)
+            old_dump(bfr, BENCH_BYTES, 1);
+        else
+            mem_hexdump(bfr, BENCH_BYTES, 1, false);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        secs = (end.tv_sec - start.tv_sec) +
+            (end.tv_nsec - start.tv_nsec) / 1e9;
+        if (rep == 0 || secs < best)
+            best = secs;
+    }
+    fclose(stdout);
+    stdout = saved_stdout;
+    return best;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Main
+////////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char** argv)
+{
+    uint32_t reps = argc > 1 ? strtoul(argv[1], NULL, 0) : BENCH_REPS;
+    double new_secs;
+    double old_secs;
+    uint32_t idx;
+    int fails = 0;
+
+    for (idx = 0; idx < BENCH_BYTES; idx++)
+        bfr[idx] = idx * 7 + 3;
+    memcpy(bfr, "Hi!\n\xff", 5);
+
+    fails += check_format();
+
+    new_secs = time_dump(false, reps);
+    old_secs = time_dump(true, reps);
+    printf("Dump of %u bytes: mem_hexdump() %.6f s, printf() loop %.6f s, "
+           "%.1fx faster\n", BENCH_BYTES, new_secs, old_secs,
+           old_secs / new_secs);
+    if (new_secs >= old_secs) {
+        printf("FAIL: mem_hexdump() not faster\n");
+        fails++;
+    }
+    printf("%s\n", fails == 0 ? "PASS" : "FAIL");
+    return fails == 0 ? 0 : 1;
+}
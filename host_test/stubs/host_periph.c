@@ -0,0 +1,49 @@
+/*
+ * @brief Host build peripheral instances. See stm32f4xx.h.
+ */
+
+#include "stm32f4xx.h"
+
+uint32_t SystemCoreClock = 84000000;
+
+GPIO_TypeDef host_GPIOA;
+GPIO_TypeDef host_GPIOB;
+GPIO_TypeDef host_GPIOC;
+GPIO_TypeDef host_GPIOD;
+GPIO_TypeDef host_GPIOE;
+GPIO_TypeDef host_GPIOF;
+GPIO_TypeDef host_GPIOG;
+GPIO_TypeDef host_GPIOH;
+USART_TypeDef host_USART1;
+USART_TypeDef host_USART2;
+USART_TypeDef host_USART6;
+TIM_TypeDef host_TIM1;
+TIM_TypeDef host_TIM2;
+TIM_TypeDef host_TIM3;
+TIM_TypeDef host_TIM4;
+TIM_TypeDef host_TIM5;
+TIM_TypeDef host_TIM9;
+TIM_TypeDef host_TIM10;
+TIM_TypeDef host_TIM11;
+DMA_TypeDef host_DMA1;
+DMA_TypeDef host_DMA2;
+DMA_Stream_TypeDef host_DMA1_Stream0;
+DMA_Stream_TypeDef host_DMA1_Stream1;
+DMA_Stream_TypeDef host_DMA1_Stream2;
+DMA_Stream_TypeDef host_DMA1_Stream3;
+DMA_Stream_TypeDef host_DMA1_Stream4;
+DMA_Stream_TypeDef host_DMA1_Stream5;
+DMA_Stream_TypeDef host_DMA1_Stream6;
+DMA_Stream_TypeDef host_DMA1_Stream7;
+DMA_Stream_TypeDef host_DMA2_Stream0;
+DMA_Stream_TypeDef host_DMA2_Stream1;
+DMA_Stream_TypeDef host_DMA2_Stream2;
+DMA_Stream_TypeDef host_DMA2_Stream3;
+DMA_Stream_TypeDef host_DMA2_Stream4;
+DMA_Stream_TypeDef host_DMA2_Stream5;
+DMA_Stream_TypeDef host_DMA2_Stream6;
+DMA_Stream_TypeDef host_DMA2_Stream7;
+EXTI_TypeDef host_EXTI;
+SysTick_Type host_SysTick;
+DWT_Type host_DWT;
+CoreDebug_Type host_CoreDebug;
@@ -0,0 +1,172 @@
+#ifndef _STM32F4XX_H_
+#define _STM32F4XX_H_
+
+/*
+ * @brief Host build replacement for the STM32F4 device header.
+ *
+ * Peripherals are ordinary variables (defined in host_periph.c), so code
+ * under test can access their registers, and tests can inspect and change
+ * them. Core functions (NVIC, interrupt masking) do nothing.
+ */
+
+#include <stdint.h>
+
+#define __IO volatile
+
+typedef enum {
+    SysTick_IRQn = -1,
+    EXTI0_IRQn = 6, EXTI1_IRQn, EXTI2_IRQn, EXTI3_IRQn, EXTI4_IRQn,
+    DMA1_Stream0_IRQn = 11, DMA1_Stream1_IRQn, DMA1_Stream2_IRQn,
+    DMA1_Stream3_IRQn, DMA1_Stream4_IRQn, DMA1_Stream5_IRQn,
+    DMA1_Stream6_IRQn,
+    EXTI9_5_IRQn = 23, TIM1_BRK_TIM9_IRQn, TIM1_UP_TIM10_IRQn,
+    TIM1_TRG_COM_TIM11_IRQn, TIM1_CC_IRQn, TIM2_IRQn, TIM3_IRQn, TIM4_IRQn,
+    USART1_IRQn = 37, USART2_IRQn,
+    EXTI15_10_IRQn = 40,
+    DMA1_Stream7_IRQn = 47,
+    TIM5_IRQn = 50,
+    DMA2_Stream0_IRQn = 56, DMA2_Stream1_IRQn, DMA2_Stream2_IRQn,
+    DMA2_Stream3_IRQn, DMA2_Stream4_IRQn,
+    DMA2_Stream5_IRQn = 68, DMA2_Stream6_IRQn, DMA2_Stream7_IRQn,
+    USART6_IRQn = 71,
+} IRQn_Type;
+
+typedef struct {
+    __IO uint32_t MODER, OTYPER, OSPEEDR, PUPDR, IDR, ODR, BSRR, LCKR, AFR[2];
+} GPIO_TypeDef;
+typedef struct {
+    __IO uint32_t SR, DR, BRR, CR1, CR2, CR3, GTPR;
+} USART_TypeDef;
+typedef struct {
+    __IO uint32_t CR1, CR2, SMCR, DIER, SR, EGR, CCMR1, CCMR2, CCER, CNT, PSC,
+        ARR, RCR, CCR1, CCR2, CCR3, CCR4, BDTR, DCR, DMAR, OR;
+} TIM_TypeDef;
+typedef struct {
+    __IO uint32_t CR, NDTR, PAR, M0AR, M1AR, FCR;
+} DMA_Stream_TypeDef;
+typedef struct {
+    __IO uint32_t LISR, HISR, LIFCR, HIFCR;
+} DMA_TypeDef;
+typedef struct {
+    __IO uint32_t IMR, EMR, RTSR, FTSR, SWIER, PR;
+} EXTI_TypeDef;
+typedef struct {
+    __IO uint32_t CTRL, LOAD, VAL, CALIB;
+} SysTick_Type;
+typedef struct {
+    __IO uint32_t CTRL, CYCCNT;
+} DWT_Type;
+typedef struct {
+    __IO uint32_t DHCSR, DCRSR, DCRDR, DEMCR;
+} CoreDebug_Type;
+
+#define CoreDebug_DEMCR_TRCENA_Msk (1UL << 24)
+#define DWT_CTRL_CYCCNTENA_Msk (1UL)
+#define SysTick_LOAD_RELOAD_Msk (0xFFFFFFUL)
+#define SysTick_CTRL_COUNTFLAG_Msk (1UL << 16)
+#define WRITE_REG(REG, VAL) ((REG) = (VAL))
+#define READ_REG(REG) ((REG))
+#define TIM_SR_UIF (1U<<0)
+#define TIM_SR_CC1IF (1U<<1)
+#define TIM_SR_CC1OF (1U<<9)
+#define TIM_DIER_UIE (1U<<0)
+#define TIM_DIER_CC1IE (1U<<1)
+
+extern GPIO_TypeDef host_GPIOA;
+#define GPIOA (&host_GPIOA)
+extern GPIO_TypeDef host_GPIOB;
+#define GPIOB (&host_GPIOB)
+extern GPIO_TypeDef host_GPIOC;
+#define GPIOC (&host_GPIOC)
+extern GPIO_TypeDef host_GPIOD;
+#define GPIOD (&host_GPIOD)
+extern GPIO_TypeDef host_GPIOE;
+#define GPIOE (&host_GPIOE)
+extern GPIO_TypeDef host_GPIOF;
+#define GPIOF (&host_GPIOF)
+extern GPIO_TypeDef host_GPIOG;
+#define GPIOG (&host_GPIOG)
+extern GPIO_TypeDef host_GPIOH;
+#define GPIOH (&host_GPIOH)
+extern USART_TypeDef host_USART1;
+#define USART1 (&host_USART1)
+extern USART_TypeDef host_USART2;
+#define USART2 (&host_USART2)
+extern USART_TypeDef host_USART6;
+#define USART6 (&host_USART6)
+extern TIM_TypeDef host_TIM1;
+#define TIM1 (&host_TIM1)
+extern TIM_TypeDef host_TIM2;
+#define TIM2 (&host_TIM2)
+extern TIM_TypeDef host_TIM3;
+#define TIM3 (&host_TIM3)
+extern TIM_TypeDef host_TIM4;
+#define TIM4 (&host_TIM4)
+extern TIM_TypeDef host_TIM5;
+#define TIM5 (&host_TIM5)
+extern TIM_TypeDef host_TIM9;
+#define TIM9 (&host_TIM9)
+extern TIM_TypeDef host_TIM10;
+#define TIM10 (&host_TIM10)
+extern TIM_TypeDef host_TIM11;
+#define TIM11 (&host_TIM11)
+extern DMA_TypeDef host_DMA1;
+#define DMA1 (&host_DMA1)
+extern DMA_TypeDef host_DMA2;
+#define DMA2 (&host_DMA2)
+extern DMA_Stream_TypeDef host_DMA1_Stream0;
+#define DMA1_Stream0 (&host_DMA1_Stream0)
+extern DMA_Stream_TypeDef host_DMA1_Stream1;
+#define DMA1_Stream1 (&host_DMA1_Stream1)
+extern DMA_Stream_TypeDef host_DMA1_Stream2;
+#define DMA1_Stream2 (&host_DMA1_Stream2)
+extern DMA_Stream_TypeDef host_DMA1_Stream3;
+#define DMA1_Stream3 (&host_DMA1_Stream3)
+extern DMA_Stream_TypeDef host_DMA1_Stream4;
+#define DMA1_Stream4 (&host_DMA1_Stream4)
+extern DMA_Stream_TypeDef host_DMA1_Stream5;
+#define DMA1_Stream5 (&host_DMA1_Stream5)
+extern DMA_Stream_TypeDef host_DMA1_Stream6;
+#define DMA1_Stream6 (&host_DMA1_Stream6)
+extern DMA_Stream_TypeDef host_DMA1_Stream7;
+#define DMA1_Stream7 (&host_DMA1_Stream7)
+extern DMA_Stream_TypeDef host_DMA2_Stream0;
+#define DMA2_Stream0 (&host_DMA2_Stream0)
+extern DMA_Stream_TypeDef host_DMA2_Stream1;
+#define DMA2_Stream1 (&host_DMA2_Stream1)
+extern DMA_Stream_TypeDef host_DMA2_Stream2;
+#define DMA2_Stream2 (&host_DMA2_Stream2)
+extern DMA_Stream_TypeDef host_DMA2_Stream3;
+#define DMA2_Stream3 (&host_DMA2_Stream3)
+extern DMA_Stream_TypeDef host_DMA2_Stream4;
+#define DMA2_Stream4 (&host_DMA2_Stream4)
+extern DMA_Stream_TypeDef host_DMA2_Stream5;
+#define DMA2_Stream5 (&host_DMA2_Stream5)
+extern DMA_Stream_TypeDef host_DMA2_Stream6;
+#define DMA2_Stream6 (&host_DMA2_Stream6)
+extern DMA_Stream_TypeDef host_DMA2_Stream7;
+#define DMA2_Stream7 (&host_DMA2_Stream7)
+extern EXTI_TypeDef host_EXTI;
+#define EXTI (&host_EXTI)
+extern SysTick_Type host_SysTick;
+#define SysTick (&host_SysTick)
+extern DWT_Type host_DWT;
+#define DWT (&host_DWT)
+extern CoreDebug_Type host_CoreDebug;
+#define CoreDebug (&host_CoreDebug)
+
+extern uint32_t SystemCoreClock;
+
+static inline void NVIC_EnableIRQ(IRQn_Type irq) { }
+static inline void NVIC_DisableIRQ(IRQn_Type irq) { }
+static inline void NVIC_ClearPendingIRQ(IRQn_Type irq) { }
+static inline void NVIC_SetPriority(IRQn_Type irq, uint32_t pri) { }
+static inline uint32_t NVIC_GetPriorityGrouping(void) { return 0; }
+static inline uint32_t NVIC_EncodePriority(uint32_t grp, uint32_t pre,
+                                           uint32_t sub) { return 0; }
+static inline void __disable_irq(void) { }
+static inline void __enable_irq(void) { }
+static inline uint32_t __get_PRIMASK(void) { return 0; }
+static inline void __set_PRIMASK(uint32_t primask) { }
+
+#endif // _STM32F4XX_H_
@@ -0,0 +1,2 @@
+// Host build: see stm32f4xx_ll_host.h.
+#include "stm32f4xx_ll_host.h"
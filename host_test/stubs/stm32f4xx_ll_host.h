@@ -0,0 +1,371 @@
+#ifndef _STM32F4XX_LL_HOST_H_
+#define _STM32F4XX_LL_HOST_H_
+
+/*
+ * @brief Host build replacement for the STM32 LL driver headers.
+ *
+ * Only what the modules under test use is provided. Functions do nothing, and
+ * those that return a value return 0. Tests that need a peripheral to do
+ * something access its registers directly (see stm32f4xx.h).
+ */
+
+#include "stm32f4xx.h"
+
+#define LL_GPIO_PIN_0 0x1U
+#define LL_GPIO_PIN_1 0x2U
+#define LL_GPIO_PIN_2 0x4U
+#define LL_GPIO_PIN_3 0x8U
+#define LL_GPIO_PIN_4 0x10U
+#define LL_GPIO_PIN_5 0x20U
+#define LL_GPIO_PIN_6 0x40U
+#define LL_GPIO_PIN_7 0x80U
+#define LL_GPIO_PIN_8 0x100U
+#define LL_GPIO_PIN_9 0x200U
+#define LL_GPIO_PIN_10 0x400U
+#define LL_GPIO_PIN_11 0x800U
+#define LL_GPIO_PIN_12 0x1000U
+#define LL_GPIO_PIN_13 0x2000U
+#define LL_GPIO_PIN_14 0x4000U
+#define LL_GPIO_PIN_15 0x8000U
+#define LL_GPIO_MODE_INPUT 0
+#define LL_GPIO_MODE_OUTPUT 1
+#define LL_GPIO_MODE_ALTERNATE 2
+#define LL_GPIO_OUTPUT_PUSHPULL 0
+#define LL_GPIO_OUTPUT_OPENDRAIN 1
+#define LL_GPIO_PULL_NO 0
+#define LL_GPIO_PULL_UP 1
+#define LL_GPIO_PULL_DOWN 2
+#define LL_GPIO_SPEED_FREQ_LOW 0
+#define LL_GPIO_SPEED_FREQ_MEDIUM 1
+#define LL_GPIO_SPEED_FREQ_HIGH 2
+#define LL_GPIO_SPEED_FREQ_VERY_HIGH 3
+#define LL_GPIO_AF_0 0
+#define LL_GPIO_AF_1 1
+#define LL_GPIO_AF_2 2
+#define LL_GPIO_AF_3 3
+static inline uint32_t LL_GPIO_IsInputPinSet(GPIO_TypeDef* p0, uint32_t p1)
+{ return 0; }
+static inline uint32_t LL_GPIO_IsOutputPinSet(GPIO_TypeDef* p0, uint32_t p1)
+{ return 0; }
+static inline void LL_GPIO_SetOutputPin(GPIO_TypeDef* p0, uint32_t p1) { }
+static inline void LL_GPIO_ResetOutputPin(GPIO_TypeDef* p0, uint32_t p1) { }
+static inline void LL_GPIO_TogglePin(GPIO_TypeDef* p0, uint32_t p1) { }
+static inline uint32_t LL_GPIO_ReadInputPort(GPIO_TypeDef* p0) { return 0; }
+static inline uint32_t LL_GPIO_ReadOutputPort(GPIO_TypeDef* p0) { return 0; }
+static inline void LL_GPIO_WriteOutputPort(GPIO_TypeDef* p0, uint32_t p1) { }
+static inline void LL_GPIO_SetPinMode(GPIO_TypeDef* p0, uint32_t p1,
+                                      uint32_t p2)
+{ }
+static inline void LL_GPIO_SetPinOutputType(GPIO_TypeDef* p0, uint32_t p1,
+                                            uint32_t p2)
+{ }
+static inline void LL_GPIO_SetPinPull(GPIO_TypeDef* p0, uint32_t p1,
+                                      uint32_t p2)
+{ }
+static inline void LL_GPIO_SetPinSpeed(GPIO_TypeDef* p0, uint32_t p1,
+                                       uint32_t p2)
+{ }
+static inline void LL_GPIO_SetAFPin_0_7(GPIO_TypeDef* p0, uint32_t p1,
+                                        uint32_t p2)
+{ }
+static inline void LL_GPIO_SetAFPin_8_15(GPIO_TypeDef* p0, uint32_t p1,
+                                         uint32_t p2)
+{ }
+static inline void LL_SYSTICK_EnableIT(void) { }
+#define LL_USART_SR_PE 0x1U
+#define LL_USART_SR_FE 0x2U
+#define LL_USART_SR_NE 0x4U
+#define LL_USART_SR_ORE 0x8U
+#define LL_USART_SR_TC 0x40U
+#define LL_USART_SR_TXE 0x80U
+#define LL_USART_SR_RXNE 0x20U
+#define LL_USART_OVERSAMPLING_16 0
+static inline void LL_USART_EnableIT_RXNE(USART_TypeDef* p0) { }
+static inline void LL_USART_EnableIT_TXE(USART_TypeDef* p0) { }
+static inline void LL_USART_DisableIT_TXE(USART_TypeDef* p0) { }
+static inline void LL_USART_SetBaudRate(USART_TypeDef* p0, uint32_t p1,
+                                        uint32_t p2, uint32_t p3)
+{ }
+static inline uint32_t LL_USART_GetBaudRate(USART_TypeDef* p0, uint32_t p1,
+                                            uint32_t p2)
+{ return 0; }
+static inline uint32_t LL_USART_IsActiveFlag_TC(USART_TypeDef* p0) { return 0; }
+static inline void LL_USART_Disable(USART_TypeDef* p0) { }
+static inline void LL_USART_Enable(USART_TypeDef* p0) { }
+typedef struct {
+    uint32_t SYSCLK_Frequency;
+    uint32_t HCLK_Frequency;
+    uint32_t PCLK1_Frequency;
+    uint32_t PCLK2_Frequency;
+} LL_RCC_ClocksTypeDef;
+static inline void LL_RCC_GetSystemClocksFreq(LL_RCC_ClocksTypeDef* p0)
+{
+    p0->SYSCLK_Frequency = SystemCoreClock;
+    p0->HCLK_Frequency = SystemCoreClock;
+    p0->PCLK1_Frequency = SystemCoreClock / 2;
+    p0->PCLK2_Frequency = SystemCoreClock;
+}
+#define LL_EXTI_LINE_0 (1U<<0)
+#define LL_EXTI_LINE_8 (1U<<8)
+#define LL_EXTI_LINE_13 (1U<<13)
+static inline void LL_EXTI_EnableIT_0_31(uint32_t p0) { }
+static inline void LL_EXTI_DisableIT_0_31(uint32_t p0) { }
+static inline void LL_EXTI_EnableRisingTrig_0_31(uint32_t p0) { }
+static inline void LL_EXTI_EnableFallingTrig_0_31(uint32_t p0) { }
+static inline void LL_EXTI_DisableRisingTrig_0_31(uint32_t p0) { }
+static inline void LL_EXTI_DisableFallingTrig_0_31(uint32_t p0) { }
+static inline uint32_t LL_EXTI_IsActiveFlag_0_31(uint32_t p0) { return 0; }
+static inline void LL_EXTI_ClearFlag_0_31(uint32_t p0) { }
+static inline uint32_t LL_EXTI_ReadFlag_0_31(uint32_t p0) { return 0; }
+#define LL_SYSCFG_EXTI_PORTA 0
+#define LL_SYSCFG_EXTI_PORTB 1
+#define LL_SYSCFG_EXTI_PORTC 2
+static inline void LL_SYSCFG_SetEXTISource(uint32_t p0, uint32_t p1) { }
+#define LL_APB1_GRP1_PERIPH_TIM2 1
+#define LL_APB1_GRP1_PERIPH_TIM3 2
+#define LL_APB1_GRP1_PERIPH_TIM4 4
+#define LL_APB1_GRP1_PERIPH_TIM5 8
+#define LL_APB2_GRP1_PERIPH_SYSCFG 0x4000
+#define LL_APB2_GRP1_PERIPH_TIM1 1
+#define LL_APB2_GRP1_PERIPH_USART1 0x10
+#define LL_AHB1_GRP1_PERIPH_DMA1 0x200000
+#define LL_AHB1_GRP1_PERIPH_DMA2 0x400000
+static inline void LL_APB1_GRP1_EnableClock(uint32_t p0) { }
+static inline void LL_APB2_GRP1_EnableClock(uint32_t p0) { }
+static inline void LL_AHB1_GRP1_EnableClock(uint32_t p0) { }
+#define LL_SYSCFG_EXTI_LINE0 (0x000FU << 16 | 0)
+#define LL_EXTI_LINE_1 (1U<<1)
+#define LL_SYSCFG_EXTI_LINE1 (0x000FU << 16 | 1)
+#define LL_EXTI_LINE_2 (1U<<2)
+#define LL_SYSCFG_EXTI_LINE2 (0x000FU << 16 | 2)
+#define LL_EXTI_LINE_3 (1U<<3)
+#define LL_SYSCFG_EXTI_LINE3 (0x000FU << 16 | 3)
+#define LL_EXTI_LINE_4 (1U<<4)
+#define LL_SYSCFG_EXTI_LINE4 (0x000FU << 16 | 4)
+#define LL_EXTI_LINE_5 (1U<<5)
+#define LL_SYSCFG_EXTI_LINE5 (0x000FU << 16 | 5)
+#define LL_EXTI_LINE_6 (1U<<6)
+#define LL_SYSCFG_EXTI_LINE6 (0x000FU << 16 | 6)
+#define LL_EXTI_LINE_7 (1U<<7)
+#define LL_SYSCFG_EXTI_LINE7 (0x000FU << 16 | 7)
+#define LL_EXTI_LINE_9 (1U<<9)
+#define LL_SYSCFG_EXTI_LINE9 (0x000FU << 16 | 9)
+#define LL_EXTI_LINE_10 (1U<<10)
+#define LL_SYSCFG_EXTI_LINE10 (0x000FU << 16 | 10)
+#define LL_EXTI_LINE_11 (1U<<11)
+#define LL_SYSCFG_EXTI_LINE11 (0x000FU << 16 | 11)
+#define LL_EXTI_LINE_12 (1U<<12)
+#define LL_SYSCFG_EXTI_LINE12 (0x000FU << 16 | 12)
+#define LL_SYSCFG_EXTI_LINE13 (0x000FU << 16 | 13)
+#define LL_EXTI_LINE_14 (1U<<14)
+#define LL_SYSCFG_EXTI_LINE14 (0x000FU << 16 | 14)
+#define LL_EXTI_LINE_15 (1U<<15)
+#define LL_SYSCFG_EXTI_LINE15 (0x000FU << 16 | 15)
+#define LL_SYSCFG_EXTI_PORTD 3
+#define LL_SYSCFG_EXTI_PORTE 4
+#define LL_SYSCFG_EXTI_PORTH 7
+#define LL_SYSCFG_EXTI_LINE8 (0x000FU << 16 | 8)
+#define LL_TIM_CHANNEL_CH1 0x1U
+#define LL_TIM_CHANNEL_CH2 0x10U
+#define LL_TIM_CHANNEL_CH3 0x100U
+#define LL_TIM_CHANNEL_CH4 0x1000U
+#define LL_TIM_ACTIVEINPUT_DIRECTTI 1
+#define LL_TIM_IC_POLARITY_RISING 0
+#define LL_TIM_IC_POLARITY_FALLING 2
+#define LL_TIM_IC_POLARITY_BOTHEDGE 10
+#define LL_TIM_ICPSC_DIV1 0
+#define LL_TIM_ICPSC_DIV2 1
+#define LL_TIM_ICPSC_DIV4 2
+#define LL_TIM_ICPSC_DIV8 3
+#define LL_TIM_IC_FILTER_FDIV1 0
+static inline void LL_TIM_SetPrescaler(TIM_TypeDef* p0, uint32_t p1) { }
+static inline void LL_TIM_SetAutoReload(TIM_TypeDef* p0, uint32_t p1) { }
+static inline void LL_TIM_EnableCounter(TIM_TypeDef* p0) { }
+static inline void LL_TIM_DisableCounter(TIM_TypeDef* p0) { }
+static inline uint32_t LL_TIM_GetCounter(TIM_TypeDef* p0) { return 0; }
+static inline void LL_TIM_GenerateEvent_UPDATE(TIM_TypeDef* p0) { }
+static inline uint32_t LL_TIM_IsActiveFlag_UPDATE(TIM_TypeDef* p0)
+{ return 0; }
+static inline void LL_TIM_ClearFlag_UPDATE(TIM_TypeDef* p0) { }
+static inline void LL_TIM_IC_SetActiveInput(TIM_TypeDef* p0, uint32_t p1,
+                                            uint32_t p2)
+{ }
+static inline void LL_TIM_IC_SetPolarity(TIM_TypeDef* p0, uint32_t p1,
+                                         uint32_t p2)
+{ }
+static inline void LL_TIM_IC_SetPrescaler(TIM_TypeDef* p0, uint32_t p1,
+                                          uint32_t p2)
+{ }
+static inline void LL_TIM_IC_SetFilter(TIM_TypeDef* p0, uint32_t p1,
+                                       uint32_t p2)
+{ }
+static inline void LL_TIM_CC_EnableChannel(TIM_TypeDef* p0, uint32_t p1) { }
+static inline void LL_TIM_CC_DisableChannel(TIM_TypeDef* p0, uint32_t p1) { }
+#define LL_TIM_OCMODE_PWM1 0x60
+#define LL_TIM_OCPOLARITY_HIGH 0
+#define LL_TIM_OCPOLARITY_LOW 2
+static inline void LL_TIM_OC_SetMode(TIM_TypeDef* p0, uint32_t p1, uint32_t p2)
+{ }
+static inline void LL_TIM_OC_SetPolarity(TIM_TypeDef* p0, uint32_t p1,
+                                         uint32_t p2)
+{ }
+static inline void LL_TIM_OC_EnablePreload(TIM_TypeDef* p0, uint32_t p1) { }
+static inline void LL_TIM_EnableARRPreload(TIM_TypeDef* p0) { }
+static inline void LL_TIM_EnableAllOutputs(TIM_TypeDef* p0) { }
+#define LL_APB2_GRP1_PERIPH_TIM9 0x10000
+#define LL_APB2_GRP1_PERIPH_TIM10 0x20000
+#define LL_APB2_GRP1_PERIPH_TIM11 0x40000
+static inline uint32_t LL_TIM_IsEnabledCounter(TIM_TypeDef* p0) { return 0; }
+#define LL_DMA_STREAM_0 0
+#define LL_DMA_STREAM_1 1
+#define LL_DMA_STREAM_2 2
+#define LL_DMA_STREAM_3 3
+#define LL_DMA_STREAM_4 4
+#define LL_DMA_STREAM_5 5
+#define LL_DMA_STREAM_6 6
+#define LL_DMA_STREAM_7 7
+#define LL_DMA_CHANNEL_0 0
+#define LL_DMA_CHANNEL_3 0x06000000U
+#define LL_DMA_CHANNEL_6 0x0C000000U
+#define LL_DMA_DIRECTION_PERIPH_TO_MEMORY 0
+#define LL_DMA_DIRECTION_MEMORY_TO_PERIPH 0x40
+#define LL_DMA_DIRECTION_MEMORY_TO_MEMORY 0x80
+#define LL_DMA_MODE_NORMAL 0
+#define LL_DMA_MODE_CIRCULAR 0x100
+#define LL_DMA_PERIPH_NOINCREMENT 0
+#define LL_DMA_PERIPH_INCREMENT 0x200
+#define LL_DMA_MEMORY_NOINCREMENT 0
+#define LL_DMA_MEMORY_INCREMENT 0x400
+#define LL_DMA_PDATAALIGN_BYTE 0
+#define LL_DMA_PDATAALIGN_HALFWORD 0x800
+#define LL_DMA_PDATAALIGN_WORD 0x1000
+#define LL_DMA_MDATAALIGN_BYTE 0
+#define LL_DMA_MDATAALIGN_HALFWORD 0x2000
+#define LL_DMA_MDATAALIGN_WORD 0x4000
+#define LL_DMA_PRIORITY_LOW 0
+#define LL_DMA_PRIORITY_HIGH 0x20000
+#define LL_DMA_PRIORITY_VERYHIGH 0x30000
+#define LL_DMA_FIFOTHRESHOLD_FULL 3
+#define LL_DMA_MBURST_INC4 0x00800000U
+static inline void LL_DMA_SetChannelSelection(DMA_TypeDef* p0, uint32_t p1,
+                                              uint32_t p2)
+{ }
+static inline void LL_DMA_SetDataTransferDirection(DMA_TypeDef* p0,
+                                                   uint32_t p1, uint32_t p2)
+{ }
+static inline void LL_DMA_SetMode(DMA_TypeDef* p0, uint32_t p1, uint32_t p2) { }
+static inline void LL_DMA_SetPeriphIncMode(DMA_TypeDef* p0, uint32_t p1,
+                                           uint32_t p2)
+{ }
+static inline void LL_DMA_SetMemoryIncMode(DMA_TypeDef* p0, uint32_t p1,
+                                           uint32_t p2)
+{ }
+static inline void LL_DMA_SetPeriphSize(DMA_TypeDef* p0, uint32_t p1,
+                                        uint32_t p2)
+{ }
+static inline void LL_DMA_SetMemorySize(DMA_TypeDef* p0, uint32_t p1,
+                                        uint32_t p2)
+{ }
+static inline void LL_DMA_SetStreamPriorityLevel(DMA_TypeDef* p0, uint32_t p1,
+                                                 uint32_t p2)
+{ }
+static inline void LL_DMA_SetPeriphAddress(DMA_TypeDef* p0, uint32_t p1,
+                                           uint32_t p2)
+{ }
+static inline void LL_DMA_SetMemoryAddress(DMA_TypeDef* p0, uint32_t p1,
+                                           uint32_t p2)
+{ }
+static inline void LL_DMA_SetM2MSrcAddress(DMA_TypeDef* p0, uint32_t p1,
+                                           uint32_t p2)
+{ }
+static inline void LL_DMA_SetM2MDstAddress(DMA_TypeDef* p0, uint32_t p1,
+                                           uint32_t p2)
+{ }
+static inline void LL_DMA_SetDataLength(DMA_TypeDef* p0, uint32_t p1,
+                                        uint32_t p2)
+{ }
+static inline uint32_t LL_DMA_GetDataLength(DMA_TypeDef* p0, uint32_t p1)
+{ return 0; }
+static inline void LL_DMA_EnableStream(DMA_TypeDef* p0, uint32_t p1) { }
+static inline void LL_DMA_DisableStream(DMA_TypeDef* p0, uint32_t p1) { }
+static inline uint32_t LL_DMA_IsEnabledStream(DMA_TypeDef* p0, uint32_t p1)
+{ return 0; }
+static inline void LL_DMA_EnableIT_TC(DMA_TypeDef* p0, uint32_t p1) { }
+static inline void LL_DMA_DisableIT_TC(DMA_TypeDef* p0, uint32_t p1) { }
+static inline void LL_DMA_EnableIT_HT(DMA_TypeDef* p0, uint32_t p1) { }
+static inline void LL_DMA_EnableIT_TE(DMA_TypeDef* p0, uint32_t p1) { }
+static inline void LL_DMA_EnableFifoMode(DMA_TypeDef* p0, uint32_t p1) { }
+static inline void LL_DMA_DisableFifoMode(DMA_TypeDef* p0, uint32_t p1) { }
+static inline void LL_DMA_SetFIFOThreshold(DMA_TypeDef* p0, uint32_t p1,
+                                           uint32_t p2)
+{ }
+static inline void LL_DMA_SetMemoryBurstxfer(DMA_TypeDef* p0, uint32_t p1,
+                                             uint32_t p2)
+{ }
+static inline void LL_DMA_EnableDoubleBufferMode(DMA_TypeDef* p0, uint32_t p1)
+{ }
+static inline void LL_DMA_DisableDoubleBufferMode(DMA_TypeDef* p0, uint32_t p1)
+{ }
+static inline void LL_DMA_SetMemory1Address(DMA_TypeDef* p0, uint32_t p1,
+                                            uint32_t p2)
+{ }
+static inline uint32_t LL_DMA_GetCurrentTargetMem(DMA_TypeDef* p0, uint32_t p1)
+{ return 0; }
+#define LL_DMA_CURRENTTARGETMEM0 0
+#define LL_DMA_CURRENTTARGETMEM1 0x80000
+static inline uint32_t LL_DMA_IsActiveFlag_TC0(DMA_TypeDef* p0) { return 0; }
+static inline uint32_t LL_DMA_IsActiveFlag_TC1(DMA_TypeDef* p0) { return 0; }
+static inline uint32_t LL_DMA_IsActiveFlag_TC5(DMA_TypeDef* p0) { return 0; }
+static inline uint32_t LL_DMA_IsActiveFlag_TE5(DMA_TypeDef* p0) { return 0; }
+static inline uint32_t LL_DMA_IsActiveFlag_TC3(DMA_TypeDef* p0) { return 0; }
+static inline uint32_t LL_DMA_IsActiveFlag_HT1(DMA_TypeDef* p0) { return 0; }
+static inline uint32_t LL_DMA_IsActiveFlag_TE0(DMA_TypeDef* p0) { return 0; }
+static inline uint32_t LL_DMA_IsActiveFlag_TE1(DMA_TypeDef* p0) { return 0; }
+static inline void LL_DMA_ClearFlag_TC0(DMA_TypeDef* p0) { }
+static inline void LL_DMA_ClearFlag_TC1(DMA_TypeDef* p0) { }
+static inline void LL_DMA_ClearFlag_TC5(DMA_TypeDef* p0) { }
+static inline void LL_DMA_ClearFlag_TE5(DMA_TypeDef* p0) { }
+static inline void LL_DMA_ClearFlag_HT1(DMA_TypeDef* p0) { }
+static inline void LL_DMA_ClearFlag_TE0(DMA_TypeDef* p0) { }
+static inline void LL_DMA_ClearFlag_TE1(DMA_TypeDef* p0) { }
+static inline void LL_DMA_ClearFlag_HT5(DMA_TypeDef* p0) { }
+static inline void LL_DMA_ClearFlag_DME5(DMA_TypeDef* p0) { }
+static inline void LL_DMA_ClearFlag_FE5(DMA_TypeDef* p0) { }
+static inline void LL_DMA_ClearFlag_HT0(DMA_TypeDef* p0) { }
+static inline void LL_DMA_ClearFlag_DME0(DMA_TypeDef* p0) { }
+static inline void LL_DMA_ClearFlag_FE0(DMA_TypeDef* p0) { }
+static inline void LL_DMA_ClearFlag_DME1(DMA_TypeDef* p0) { }
+static inline void LL_DMA_ClearFlag_FE1(DMA_TypeDef* p0) { }
+static inline void LL_TIM_EnableDMAReq_UPDATE(TIM_TypeDef* p0) { }
+static inline void LL_TIM_DisableDMAReq_UPDATE(TIM_TypeDef* p0) { }
+static inline void LL_TIM_EnableDMAReq_CC1(TIM_TypeDef* p0) { }
+static inline void LL_TIM_DisableDMAReq_CC1(TIM_TypeDef* p0) { }
+#define LL_TIM_OCMODE_FROZEN 0
+static inline void LL_TIM_EnableDMAReq_CC2(TIM_TypeDef* p0) { }
+static inline void LL_TIM_DisableDMAReq_CC2(TIM_TypeDef* p0) { }
+static inline uint32_t LL_DMA_IsActiveFlag_TC2(DMA_TypeDef* p0) { return 0; }
+static inline uint32_t LL_DMA_IsActiveFlag_HT2(DMA_TypeDef* p0) { return 0; }
+static inline uint32_t LL_DMA_IsActiveFlag_TE2(DMA_TypeDef* p0) { return 0; }
+static inline void LL_DMA_ClearFlag_TC2(DMA_TypeDef* p0) { }
+static inline void LL_DMA_ClearFlag_HT2(DMA_TypeDef* p0) { }
+static inline void LL_DMA_ClearFlag_TE2(DMA_TypeDef* p0) { }
+static inline void LL_DMA_ClearFlag_DME2(DMA_TypeDef* p0) { }
+static inline void LL_DMA_ClearFlag_FE2(DMA_TypeDef* p0) { }
+#define LL_TIM_CLOCKSOURCE_INTERNAL 0
+#define LL_TIM_CLOCKSOURCE_EXT_MODE1 7
+#define LL_TIM_TS_TI1FP1 0x50
+#define LL_TIM_TS_TI2FP2 0x60
+static inline void LL_TIM_SetClockSource(TIM_TypeDef* p0, uint32_t p1) { }
+static inline void LL_TIM_SetTriggerInput(TIM_TypeDef* p0, uint32_t p1) { }
+static inline void LL_TIM_EnableIT_UPDATE(TIM_TypeDef* p0) { }
+static inline void LL_TIM_DisableIT_UPDATE(TIM_TypeDef* p0) { }
+#define LL_DMA_CHANNEL_2 0x04000000U
+#define LL_DMA_CHANNEL_5 0x0A000000U
+#define LL_TIM_OCMODE_TOGGLE 0x30
+#define LL_TIM_OCMODE_FORCED_INACTIVE 0x40
+static inline void LL_TIM_SetCounter(TIM_TypeDef* p0, uint32_t p1) { }
+static inline void LL_TIM_DisableARRPreload(TIM_TypeDef* p0) { }
+static inline void LL_TIM_OC_DisablePreload(TIM_TypeDef* p0, uint32_t p1) { }
+static inline void LL_DMA_DisableIT_TE(DMA_TypeDef* p0, uint32_t p1) { }
+
+#endif // _STM32F4XX_LL_HOST_H_
@@ -0,0 +1,303 @@
+/*
+ * @brief Host simulation of the ttys software UART.
+ *
+ * The real TIM3 interrupt handler is called once per tick (SWUART_OVERSAMPLE
+ * ticks per bit), with the TX and RX pins simulated by a host GPIO port:
+ * - Loopback: TX is connected to RX, and all 256 character values are sent
+ *   and must be received in order, without framing errors.
+ * - Baud rate error: the RX pin is driven by a simulated sender whose baud
+ *   rate differs from the receiver's by -SIM_MAX_ERR_PCT to +SIM_MAX_ERR_PCT,
+ *   in SIM_ERR_STEP_PERMILLE steps. Each trial sends a random character at a
+ *   random phase relative to the ticks. All trials must be received correctly
+ *   for errors from SIM_PASS_MIN_PERMILLE to SIM_PASS_MAX_PERMILLE; outside
+ *   that range the results are only reported.
+ *
+ * A positive error means the sender is fast (its bits are shorter).
+ *
+ * Usage: swuart_sim [trials [seed]]
+ *
+ * The exit status is 0 if all checks pass.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2021 Eugene R Schroeder
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+// The module under test is included, to give access to its static state.
+#include "../modules/ttys/ttys.c"
+
+////////////////////////////////////////////////////////////////////////////////
+// Common macros
+////////////////////////////////////////////////////////////////////////////////
+
+#define SIM_PIN_IDX 0 // dio input and output index of the pins.
+#define SIM_PIN_MASK 1
+
+// Baud rate error sweep, and the range that must pass.
+#define SIM_MAX_ERR_PCT 6
+#define SIM_ERR_STEP_PERMILLE 5
+#define SIM_PASS_MIN_PERMILLE -50
+#define SIM_PASS_MAX_PERMILLE 25
+
+// Idle ticks before and after each character in the sweep.
+#define SIM_IDLE_TICKS (2 * SWUART_OVERSAMPLE)
+
+#define SIM_CYCLES_PER_TICK 100
+
+#define DEF_TRIALS 2000
+
+////////////////////////////////////////////////////////////////////////////////
+// Private (static) variables
+////////////////////////////////////////////////////////////////////////////////
+
+// Fast path pin data, normally set up by dio_init().
+struct dio_fast_in _dio_fast_ins[DIO_MAX_MASK_BITS];
+struct dio_fast_out _dio_fast_outs[DIO_MAX_MASK_BITS];
+
+static GPIO_TypeDef sim_port;
+static uint32_t sim_cycles;
+static dio_tmr* reserved_tmr;
+
+////////////////////////////////////////////////////////////////////////////////
+// Stubs for modules not included in the host build
+////////////////////////////////////////////////////////////////////////////////
+
+uint32_t tmr_get_ms(void)
+{
+    return sim_cycles / (SystemCoreClock / 1000);
+}
+
+uint32_t tmr_get_cycles(void)
+{
+    return sim_cycles++;
+}
+
+int32_t dio_get_num_in(void)
+{
+    return 1;
+}
+
+int32_t dio_get_num_out(void)
+{
+    return 1;
+}
+
+int32_t dio_set(uint32_t dout_idx, uint32_t value)
+{
+    dio_set_fast(dout_idx, value);
+    return 0;
+}
+
+int32_t dio_reserve_tmr(dio_tmr* tmr)
+{
+    reserved_tmr = tmr;
+    return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Private (static) functions
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * @brief Run one timer tick.
+ *
+ * @param[in] loopback Connect TX to RX.
+ *
+ * The interrupt handler is called, then the BSRR write (if any) is applied
+ * to the output.
+ */
+static void sim_tick(bool loopback)
+{
+    uint32_t bsrr;
+
+    SWUART_TMR->SR |= TIM_SR_UIF;
+    TIM3_IRQHandler();
+    sim_cycles += SIM_CYCLES_PER_TICK;
+    bsrr = sim_port.BSRR;
+    sim_port.BSRR = 0;
+    sim_port.ODR = (sim_port.ODR & ~(bsrr >> 16)) | (bsrr & 0xffff);
+    if (loopback)
+        sim_port.IDR = sim_port.ODR;
+}
+
+/*
+ * @brief Send all character values with TX connected to RX.
+ *
+ * @return Number of failures.
+ */
+static int check_loopback(void)
+{
+    struct ttys_state* st = &ttys_states[TTYS_INSTANCE_SWUART];
+    uint32_t tx_val = 0;
+    uint32_t rx_val = 0;
+    uint32_t tick;
+    int fails = 0;
+    char c;
+
+    st->cfg.swuart_tx_dout_idx = SIM_PIN_IDX;
+    for (tick = 0; rx_val < 256 && tick < 300 * SWUART_FRAME_BITS *
+                                          SWUART_OVERSAMPLE; tick++) {
+        while (tx_val < 256 && ttys_get_tx_free(TTYS_INSTANCE_SWUART) > 0)
+            ttys_putc(TTYS_INSTANCE_SWUART, (char)tx_val++);
+        sim_tick(true);
+        while (ttys_getc(TTYS_INSTANCE_SWUART, &c) == 1) {
+            if ((uint8_t)c != rx_val && fails++ < 5)
+                printf("FAIL: loopback got 0x%02x, expected 0x%02x\n",
+                       (uint8_t)c, (unsigned)rx_val);
+            rx_val++;
+        }
+    }
+    if (rx_val != 256) {
+        printf("FAIL: loopback received %u of 256\n", (unsigned)rx_val);
+        fails++;
+    }
+    if (cnts_u16[CNT_RX_UART_FE] != 0) {
+        printf("FAIL: loopback framing errors %u\n", cnts_u16[CNT_RX_UART_FE]);
+        fails++;
+    }
+    printf("Loopback: %u characters, %lu ticks, %lu cycles per tick (host)\n",
+           (unsigned)rx_val, (unsigned long)swuart.ticks,
+           (unsigned long)(swuart.isr_cycles / swuart.ticks));
+    st->cfg.swuart_tx_dout_idx = -1;
+    return fails;
+}
+
+/*
+ * @brief Receive one character from a sender with a baud rate error.
+ *
+ * @param[in] c The character.
+ * @param[in] bit_ticks Sender bit length, in ticks.
+ * @param[in] phase Sender start time after the first idle tick, in ticks.
+ *
+ * @return true if the character was received correctly.
+ */
+static bool rx_char(uint8_t c, double bit_ticks, double phase)
+{
+    uint32_t frame = ((uint32_t)c | 0x100) << 1; // Start, data, stop.
+    uint32_t num_ticks;
+    uint32_t num_rx = 0;
+    uint32_t tick;
+    int32_t bit;
+    bool ok = false;
+    char rx_c;
+
+    num_ticks = SIM_IDLE_TICKS * 2 + (uint32_t)(phase + SWUART_FRAME_BITS *
+                                                bit_ticks) + 1;
+    for (tick = 0; tick < num_ticks; tick++) {
+        bit = (int32_t)(((double)tick - SIM_IDLE_TICKS - phase) / bit_ticks +
+                        1) - 1;
+        if (bit < 0 || bit >= SWUART_FRAME_BITS)
+            sim_port.IDR = SIM_PIN_MASK;
+        else
+            sim_port.IDR = (frame >> bit) & 1 ? SIM_PIN_MASK : 0;
+        sim_tick(false);
+    }
+    while (ttys_getc(TTYS_INSTANCE_SWUART, &rx_c) == 1) {
+        num_rx++;
+        ok = (uint8_t)rx_c == c;
+    }
+    return num_rx == 1 && ok && swuart.rx_bits == 0;
+}
+
+/*
+ * @brief Sweep the sender baud rate error.
+ *
+ * @param[in] trials Number of characters per error value.
+ * @param[in] seed Random number seed.
+ *
+ * @return Number of failures.
+ */
+static int check_baud_err(uint32_t trials, uint32_t seed)
+{
+    int32_t err;
+    uint32_t trial;
+    uint32_t ok;
+    uint16_t fe;
+    int fails = 0;
+
+    srand(seed);
+    printf("Trials=%lu seed=%lu\n", (unsigned long)trials,
+           (unsigned long)seed);
+    printf("Baud error   Received   Framing errors\n");
+    for (err = -SIM_MAX_ERR_PCT * 10; err <= SIM_MAX_ERR_PCT * 10;
+         err += SIM_ERR_STEP_PERMILLE) {
+        fe = cnts_u16[CNT_RX_UART_FE];
+        ok = 0;
+        for (trial = 0; trial < trials; trial++) {
+            if (rx_char(rand() & 0xff, SWUART_OVERSAMPLE / (1 + err / 1000.0),
+                        (rand() % 1000) * SWUART_OVERSAMPLE / 1000.0))
+                ok++;
+        }
+        printf("  %+5.1f%%   %8lu   %8u%s\n", err / 10.0, (unsigned long)ok,
+               cnts_u16[CNT_RX_UART_FE] - fe,
+               err >= SIM_PASS_MIN_PERMILLE && err <= SIM_PASS_MAX_PERMILLE ?
+               "" : "  (not checked)");
+        if (err >= SIM_PASS_MIN_PERMILLE && err <= SIM_PASS_MAX_PERMILLE &&
+            ok != trials) {
+            printf("FAIL: %+.1f%% received %lu of %lu\n", err / 10.0,
+                   (unsigned long)ok, (unsigned long)trials);
+            fails++;
+        }
+    }
+    printf("Tolerance: %+.1f%% to %+.1f%%\n", SIM_PASS_MIN_PERMILLE / 10.0,
+           SIM_PASS_MAX_PERMILLE / 10.0);
+    return fails;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Main
+////////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char** argv)
+{
+    uint32_t trials = argc > 1 ? strtoul(argv[1], NULL, 0) : DEF_TRIALS;
+    uint32_t seed = argc > 2 ? strtoul(argv[2], NULL, 0) : 1;
+    struct ttys_cfg ttys_cfg;
+    int fails = 0;
+
+    _dio_fast_outs[SIM_PIN_IDX].bsrr = &sim_port.BSRR;
+    _dio_fast_outs[SIM_PIN_IDX].bsrr_val[0] = SIM_PIN_MASK << 16;
+    _dio_fast_outs[SIM_PIN_IDX].bsrr_val[1] = SIM_PIN_MASK;
+    _dio_fast_ins[SIM_PIN_IDX].idr = &sim_port.IDR;
+    _dio_fast_ins[SIM_PIN_IDX].shift = 0;
+    sim_port.IDR = SIM_PIN_MASK;
+
+    ttys_get_def_cfg(TTYS_INSTANCE_SWUART, &ttys_cfg);
+    ttys_cfg.create_stream = false;
+    ttys_cfg.swuart_tx_dout_idx = SIM_PIN_IDX;
+    ttys_cfg.swuart_rx_din_idx = SIM_PIN_IDX;
+    if (ttys_init(TTYS_INSTANCE_SWUART, &ttys_cfg) != 0 ||
+        ttys_start(TTYS_INSTANCE_SWUART) != 0) {
+        printf("FAIL: software UART start\n");
+        return 1;
+    }
+    if (reserved_tmr != TIM3) {
+        printf("FAIL: TIM3 not reserved\n");
+        fails++;
+    }
+
+    fails += check_loopback();
+    fails += check_baud_err(trials, seed);
+    printf("%s\n", fails == 0 ? "PASS" : "FAIL");
+    return fails == 0 ? 0 : 1;
+}
@@ -6,7 +6,24 @@
  * rate. Normally the separator rate is much faster than the blink rate. This
  * process then repeats.
  *
+ * There are two backends. By default a tmr callback runs a state machine at
+ * each LED change, so the timing depends on how promptly tmr_run() is called.
+ * If hw_enable is set, and the LED output has a PWM timer that supports it,
+ * the whole pattern is computed up front as a table of LED on/off durations,
+ * which dio plays with a timer and DMA (dio_toggle_seq_start()). Blinking then
+ * costs no CPU, and stays exact even if the super loop stalls. Only one
+ * output can play a toggle sequence at a time, so other instances fall back
+ * to the tmr backend.
+ *
+ * There can be several instances, each blinking its own LED with its own
+ * pattern. They all share a single tmr timer, so adding LEDs does not use up
+ * the timer pool. Each instance scheduled on the tmr backend has the time of
+ * its next LED change, and these are kept in a list sorted by time. The timer
+ * is always set to expire at the first entry, and the callback handles all
+ * entries that are due and re-inserts them at their next change time.
+ *
  * The following console commands are provided:
+ * > blinky inst [instance-id]
  * > blinky status
  * > blinky blinks num-blinks period-ms
  * > blinky sep num-blinks period-ms
@@ -57,6 +74,9 @@
 #define PRE_BLINK_DELAY_MS 2000
 #define POST_BLINK_DELAY_MS 2000
 
+#define HW_TICK_HZ 10000
+#define HW_TICKS_PER_MS (HW_TICK_HZ / 1000)
+
 ////////////////////////////////////////////////////////////////////////////////
 // Type definitions
 ////////////////////////////////////////////////////////////////////////////////
@@ -75,26 +95,50 @@ struct blinky_state
 {
     struct blinky_cfg cfg;
     enum states state;
-    bool valid_dio;
+    bool started;
+    bool hw_active; // Pattern is played by dio.
     uint32_t blink_counter;
-    int32_t tmr_id;
+    uint32_t due_ms; // Time of next LED change, when on the schedule.
 };
 ////////////////////////////////////////////////////////////////////////////////
 // Private (static) function declarations
 ////////////////////////////////////////////////////////////////////////////////
 
+static int32_t cmd_blinky_inst(int32_t argc, const char** argv);
 static int32_t cmd_blinky_status(int32_t argc, const char** argv);
 static int32_t cmd_blinky_blinks(int32_t argc, const char** argv);
-static void start();
+static void start(enum blinky_instance_id instance_id);
+static bool hw_start(struct blinky_state* st);
+static void hw_add(uint32_t* ticks, uint32_t* num_ticks, bool led_on,
+                   uint32_t ms);
+static void sched_insert(enum blinky_instance_id instance_id);
+static void sched_remove(enum blinky_instance_id instance_id);
+static void sched_tmr_update(uint32_t now_ms);
+static uint32_t step(struct blinky_state* st);
 static enum tmr_cb_action tmr_cb(int32_t tmr_id, uint32_t user_data);
 
 ////////////////////////////////////////////////////////////////////////////////
 // Private (static) variables
 ////////////////////////////////////////////////////////////////////////////////
 
-struct blinky_state state;
+static struct blinky_state blinky_states[BLINKY_NUM_INSTANCES];
+
+// Shared by all instances.
+static int32_t sched_tmr_id = -1;
+
+// Instances on the tmr backend, sorted by due_ms (earliest first).
+static enum blinky_instance_id sched[BLINKY_NUM_INSTANCES];
+static uint32_t sched_len;
+
+// Instance the console commands apply to.
+static enum blinky_instance_id cmd_instance_id;
 
 static struct cmd_cmd_info cmds[] = {
+    {
+        .name = "inst",
+        .func = cmd_blinky_inst,
+        .help = "Select instance for other commands, usage: blinky inst [<id>]",
+    },
     {
         .name = "status",
         .func = cmd_blinky_status,
@@ -132,13 +176,15 @@ static struct cmd_client_info cmd_info = {
 /*
  * @brief Get default blinky configuration.
  *
+ * @param[in] instance_id Identifies the blinky instance.
  * @param[out] cfg The blinky configuration with defaults filled in.
  *
  * @return 0 for success, else a "MOD_ERR" value. See code for details.
  */
-int32_t blinky_get_def_cfg(struct blinky_cfg* cfg)
+int32_t blinky_get_def_cfg(enum blinky_instance_id instance_id,
+                           struct blinky_cfg* cfg)
 {
-    if (cfg == NULL)
+    if (instance_id >= BLINKY_NUM_INSTANCES || cfg == NULL)
         return MOD_ERR_ARG;
 
     memset(cfg, 0, sizeof(*cfg));
@@ -153,117 +199,150 @@ int32_t blinky_get_def_cfg(struct blinky_cfg* cfg)
 /*
  * @brief Initialize blinky module instance.
  *
- * @param[in] cfg The blinky configuration. (FUTURE)
+ * @param[in] instance_id Identifies the blinky instance.
+ * @param[in] cfg The blinky configuration.
  *
  * @return 0 for success, else a "MOD_ERR" value. See code for details.
  *
- * This function initializes the blinky singleton module. Generally, it should
+ * This function initializes a blinky module instance. Generally, it should
  * not access other modules as they might not have been initialized yet. An
  * exception is the log module.
  */
-int32_t blinky_init(struct blinky_cfg* cfg)
+int32_t blinky_init(enum blinky_instance_id instance_id,
+                    struct blinky_cfg* cfg)
 {
     log_debug("In blinky_init()\n");
 
-    memset(&state, 0, sizeof(state));
-    state.tmr_id = -1;
+    if (instance_id >= BLINKY_NUM_INSTANCES || cfg == NULL)
+        return MOD_ERR_ARG;
 
-    state.cfg = *cfg;
+    memset(&blinky_states[instance_id], 0, sizeof(struct blinky_state));
+    blinky_states[instance_id].cfg = *cfg;
     return 0;
 }
 
 /*
  * @brief Start blinky module instance.
  *
+ * @param[in] instance_id Identifies the blinky instance.
+ *
  * @return 0 for success, else a "MOD_ERR" value. See code for details.
  *
- * This function starts the blinky singleton module, to enter normal operation.
+ * This function starts a blinky module instance, to enter normal operation.
+ * The console commands and the shared timer are set up when the first
+ * instance is started.
  */
-int32_t blinky_start(void)
+int32_t blinky_start(enum blinky_instance_id instance_id)
 {
+    struct blinky_state* st;
     int32_t result;
 
     log_debug("In blinky_start()\n");
+    if (instance_id >= BLINKY_NUM_INSTANCES)
+        return MOD_ERR_BAD_INSTANCE;
+    st = &blinky_states[instance_id];
+    if (st->started)
+        return MOD_ERR_STATE;
+
     result = dio_get_num_out();
     if (result < 0) {
         log_error("blinky_start: dio error %d\n", result);
         return MOD_ERR_RESOURCE;
     }
-    else if (state.cfg.dout_idx >= result) {
+    else if (st->cfg.dout_idx >= result) {
         log_error("blinky_start: bad dout_idx %u (>=%d)\n",
-                  state.cfg.dout_idx, result);
+                  st->cfg.dout_idx, result);
         return MOD_ERR_ARG;
     }
-    state.valid_dio = true;
-    result = cmd_register(&cmd_info);
-    if (result < 0) {
-        log_error("blinky_start: cmd error %d\n", result);
-        return MOD_ERR_RESOURCE;
+    if (sched_tmr_id < 0) {
+        result = cmd_register(&cmd_info);
+        if (result < 0) {
+            log_error("blinky_start: cmd error %d\n", result);
+            return MOD_ERR_RESOURCE;
+        }
+        sched_tmr_id = tmr_inst_get_cb(0, tmr_cb, 0);
+        if (sched_tmr_id < 0) {
+            log_error("blinky_start: tmr error %d\n", sched_tmr_id);
+            return MOD_ERR_RESOURCE;
+        }
+        cmd_instance_id = instance_id;
     }
-    state.tmr_id = tmr_inst_get_cb(0, tmr_cb, 0);
-    if (state.tmr_id < 0) {
-        log_error("blinky_start: tmr error %d\n", state.tmr_id);
-        return MOD_ERR_RESOURCE;
-    }
-    start();
+    st->started = true;
+    start(instance_id);
     return 0;
 }
 
 /*
  * @brief Set number of code blinks.
  *
+ * @param[in] instance_id Identifies the blinky instance.
  * @param[in] num_blinks The number of blinks (set to 0 for no blinks).
  *
  * @return 0 for success, else a "MOD_ERR" value. See code for details.
  */
-int32_t blinky_set_code_blinks(uint32_t num_blinks)
+int32_t blinky_set_code_blinks(enum blinky_instance_id instance_id,
+                               uint32_t num_blinks)
 {
-    state.cfg.code_num_blinks = num_blinks;
-    start();
+    if (instance_id >= BLINKY_NUM_INSTANCES)
+        return MOD_ERR_BAD_INSTANCE;
+    blinky_states[instance_id].cfg.code_num_blinks = num_blinks;
+    start(instance_id);
     return 0;
 }
 
 /*
  * @brief Set number of separator blinks.
  *
+ * @param[in] instance_id Identifies the blinky instance.
  * @param[in] num_blinks The number of separator blinks (set to 0 for no
  *                       separator blinks).
  *
  * @return 0 for success, else a "MOD_ERR" value. See code for details.
  */
-int32_t blinky_set_sep_blinks(uint32_t num_blinks)
+int32_t blinky_set_sep_blinks(enum blinky_instance_id instance_id,
+                              uint32_t num_blinks)
 {
-    state.cfg.sep_num_blinks = num_blinks;
-    start();
+    if (instance_id >= BLINKY_NUM_INSTANCES)
+        return MOD_ERR_BAD_INSTANCE;
+    blinky_states[instance_id].cfg.sep_num_blinks = num_blinks;
+    start(instance_id);
     return 0;
 }
 
 /*
  * @brief Set code blink period.
  *
+ * @param[in] instance_id Identifies the blinky instance.
  * @param[in] period_ms Period in ms (if set to 0, there will be no code blinks).
  *
  * @return 0 for success, else a "MOD_ERR" value. See code for details.
  */
-int32_t blinky_set_code_period(uint32_t period_ms)
+int32_t blinky_set_code_period(enum blinky_instance_id instance_id,
+                               uint32_t period_ms)
 {
-    state.cfg.code_period_ms = period_ms;
-    start();
+    if (instance_id >= BLINKY_NUM_INSTANCES)
+        return MOD_ERR_BAD_INSTANCE;
+    blinky_states[instance_id].cfg.code_period_ms = period_ms;
+    start(instance_id);
     return 0;
 }
 
 /*
  * @brief Set separator blink period.
  *
+ * @param[in] instance_id Identifies the blinky instance.
  * @param[in] period_ms Period in ms (if set to 0, there will be no separator
  *                      blinks).
  *
  * @return 0 for success, else a "MOD_ERR" value. See code for details.
  */
-int32_t blinky_set_sep_period(uint32_t period_ms)
+int32_t blinky_set_sep_period(enum blinky_instance_id instance_id,
+                              uint32_t period_ms)
 {
-    state.cfg.sep_period_ms = period_ms;
-    start();
+    if (instance_id >= BLINKY_NUM_INSTANCES)
+        return MOD_ERR_BAD_INSTANCE;
+    blinky_states[instance_id].cfg.sep_period_ms = period_ms;
+    start(instance_id);
     return 0;
 }
 
@@ -271,6 +350,44 @@ int32_t blinky_set_sep_period(uint32_t period_ms)
 // Private (static) functions
 ////////////////////////////////////////////////////////////////////////////////
 
+/*
+ * @brief Console command function for "blinky inst".
+ *
+ * @param[in] argc Number of arguments, including "blinky"
+ * @param[in] argv Argument values, including "blinky"
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * Command usage: blinky inst [<id>]
+ */
+static int32_t cmd_blinky_inst(int32_t argc, const char** argv)
+{
+    struct cmd_arg_val arg_vals[1];
+    enum blinky_instance_id idx;
+    struct blinky_state* st;
+
+    if (cmd_parse_args(argc-2, argv+2, "[u]", arg_vals) < 0)
+        return MOD_ERR_BAD_CMD;
+
+    if (argc == 2) {
+        for (idx = 0; idx < BLINKY_NUM_INSTANCES; idx++) {
+            st = &blinky_states[idx];
+            printf("%c%d: %s dout=%lu backend=%s\n",
+                   idx == cmd_instance_id ? '*' : ' ', idx,
+                   st->started ? "started" : "not started",
+                   st->cfg.dout_idx, st->hw_active ? "hw" : "tmr");
+        }
+        return 0;
+    }
+    if (arg_vals[0].val.u >= BLINKY_NUM_INSTANCES ||
+        !blinky_states[arg_vals[0].val.u].started) {
+        printf("Instance %lu not started\n", arg_vals[0].val.u);
+        return MOD_ERR_BAD_INSTANCE;
+    }
+    cmd_instance_id = arg_vals[0].val.u;
+    return 0;
+}
+
 /*
  * @brief Console command function for "blinky status".
  *
@@ -283,11 +400,22 @@ int32_t blinky_set_sep_period(uint32_t period_ms)
  */
 static int32_t cmd_blinky_status(int32_t argc, const char** argv)
 {
-    printf("state=%d blink_counter=%lu tmr_id=%ld\n",
-           state.state, state.blink_counter, state.tmr_id);
+    struct blinky_state* st = &blinky_states[cmd_instance_id];
+    uint32_t now_ms = tmr_get_ms();
+    uint32_t idx;
+
+    printf("Instance %d:\n", cmd_instance_id);
+    printf("state=%d blink_counter=%lu tmr_id=%ld backend=%s\n",
+           st->state, st->blink_counter, sched_tmr_id,
+           st->hw_active ? "hw" : "tmr");
     printf("code-num-blinks=%lu code-period-ms=%lu sep-num-blinks=%lu sep-perioid-ms=%lu\n",
-           state.cfg.code_num_blinks, state.cfg.code_period_ms,
-           state.cfg.sep_num_blinks, state.cfg.sep_period_ms);
+           st->cfg.code_num_blinks, st->cfg.code_period_ms,
+           st->cfg.sep_num_blinks, st->cfg.sep_period_ms);
+    printf("schedule:");
+    for (idx = 0; idx < sched_len; idx++)
+        printf(" %d@%ldms", sched[idx],
+               (int32_t)(blinky_states[sched[idx]].due_ms - now_ms));
+    printf("\n");
     return 0;
 }
 
@@ -313,32 +441,187 @@ static int32_t cmd_blinky_blinks(int32_t argc, const char** argv)
         return MOD_ERR_BAD_CMD;
 
     if (strcasecmp(argv[1], "blinks") == 0) {
-        blinky_set_code_blinks(arg_vals[0].val.u);
+        blinky_set_code_blinks(cmd_instance_id, arg_vals[0].val.u);
         if (num_args >= 2)
-            blinky_set_code_period(arg_vals[1].val.u);
+            blinky_set_code_period(cmd_instance_id, arg_vals[1].val.u);
     } else {
-        blinky_set_sep_blinks(arg_vals[0].val.u);
+        blinky_set_sep_blinks(cmd_instance_id, arg_vals[0].val.u);
         if (num_args >= 2)
-            blinky_set_sep_period(arg_vals[1].val.u);
+            blinky_set_sep_period(cmd_instance_id, arg_vals[1].val.u);
     }
-    start();
     return 0;
 }
 
 /*
- * @brief Start or restart blinky.
+ * @brief Start or restart a blinky instance.
  *
- * This is called during the initial module start, and after any change of
+ * @param[in] instance_id Identifies the blinky instance.
+ *
+ * This is called during the initial instance start, and after any change of
  * parameters.
  */
-void start(void)
+static void start(enum blinky_instance_id instance_id)
 {
-    if (!state.valid_dio || state.tmr_id < 0)
+    struct blinky_state* st = &blinky_states[instance_id];
+    uint32_t now_ms;
+
+    if (!st->started || sched_tmr_id < 0)
         return;
 
-    dio_set(state.cfg.dout_idx, false);
-    state.state = STATE_PRE_BLINK_DELAY;
-    tmr_inst_start(state.tmr_id, PRE_BLINK_DELAY_MS);
+    sched_remove(instance_id);
+    dio_set(st->cfg.dout_idx, false);
+    if (st->hw_active) {
+        dio_toggle_seq_stop(st->cfg.dout_idx);
+        st->hw_active = false;
+    }
+    now_ms = tmr_get_ms();
+    if (st->cfg.hw_enable && hw_start(st)) {
+        st->hw_active = true;
+        st->state = STATE_OFF;
+    } else {
+        st->state = STATE_PRE_BLINK_DELAY;
+        st->due_ms = now_ms + PRE_BLINK_DELAY_MS;
+        sched_insert(instance_id);
+    }
+    sched_tmr_update(now_ms);
+}
+
+/*
+ * @brief Start the blink pattern using a dio toggle sequence.
+ *
+ * @param[in] st The instance state.
+ *
+ * @return true if the sequence was started, or the LED just stays off.
+ *
+ * The table follows the same sequence as the tmr state machine. Consecutive
+ * off periods are merged, including the last with the first, so the table
+ * alternates between off and on, starting with off.
+ */
+static bool hw_start(struct blinky_state* st)
+{
+    uint32_t ticks[DIO_TOGGLE_SEQ_MAX + 1];
+    uint32_t num_ticks = 0;
+    uint32_t idx;
+    uint32_t half_ms;
+    int32_t result;
+
+    if (2 * ((st->cfg.code_num_blinks + st->cfg.sep_num_blinks)) >
+        DIO_TOGGLE_SEQ_MAX) {
+        log_info("blinky: too many blinks for hw\n");
+        return false;
+    }
+
+    hw_add(ticks, &num_ticks, false, PRE_BLINK_DELAY_MS);
+    if (st->cfg.code_period_ms > 0) {
+        half_ms = (st->cfg.code_period_ms + 1) / 2;
+        for (idx = 0; idx < st->cfg.code_num_blinks; idx++) {
+            hw_add(ticks, &num_ticks, true, half_ms);
+            if (idx + 1 < st->cfg.code_num_blinks)
+                hw_add(ticks, &num_ticks, false, half_ms);
+        }
+    }
+    hw_add(ticks, &num_ticks, false, POST_BLINK_DELAY_MS);
+    if (st->cfg.sep_period_ms > 0) {
+        half_ms = (st->cfg.sep_period_ms + 1) / 2;
+        for (idx = 0; idx < st->cfg.sep_num_blinks; idx++) {
+            hw_add(ticks, &num_ticks, true, half_ms);
+            if (idx + 1 < st->cfg.sep_num_blinks)
+                hw_add(ticks, &num_ticks, false, half_ms);
+        }
+    }
+
+    // A single entry means the LED is always off. An odd count means the
+    // table ends with an off period, so wrap it into the first.
+    if (num_ticks == 1)
+        return true;
+    if (num_ticks & 1)
+        ticks[0] += ticks[--num_ticks];
+
+    result = dio_toggle_seq_start(st->cfg.dout_idx, ticks, num_ticks,
+                                  HW_TICK_HZ);
+    if (result < 0) {
+        log_info("blinky: hw error %ld, using tmr\n", result);
+        return false;
+    }
+    return true;
+}
+
+/*
+ * @brief Add an LED on/off period to the hardware pattern table.
+ *
+ * @param[in,out] ticks The table of durations.
+ * @param[in,out] num_ticks The number of durations in the table.
+ * @param[in] led_on LED state for the period.
+ * @param[in] ms Duration of the period.
+ *
+ * Even table indexes are off periods and odd ones are on periods, so a period
+ * with the same LED state as the last one is merged with it.
+ */
+static void hw_add(uint32_t* ticks, uint32_t* num_ticks, bool led_on,
+                   uint32_t ms)
+{
+    if (*num_ticks > 0 && ((*num_ticks - 1) & 1) == led_on)
+        ticks[*num_ticks - 1] += ms * HW_TICKS_PER_MS;
+    else
+        ticks[(*num_ticks)++] = ms * HW_TICKS_PER_MS;
+}
+
+/*
+ * @brief Insert an instance into the schedule, keeping it sorted.
+ *
+ * @param[in] instance_id Identifies the blinky instance.
+ *
+ * The instance must not already be on the schedule. Instances with the same
+ * due time keep the order they were inserted in.
+ */
+static void sched_insert(enum blinky_instance_id instance_id)
+{
+    uint32_t due_ms = blinky_states[instance_id].due_ms;
+    uint32_t idx;
+
+    for (idx = sched_len; idx > 0; idx--) {
+        if ((int32_t)(blinky_states[sched[idx-1]].due_ms - due_ms) <= 0)
+            break;
+        sched[idx] = sched[idx-1];
+    }
+    sched[idx] = instance_id;
+    sched_len++;
+}
+
+/*
+ * @brief Remove an instance from the schedule, if it is on it.
+ *
+ * @param[in] instance_id Identifies the blinky instance.
+ */
+static void sched_remove(enum blinky_instance_id instance_id)
+{
+    uint32_t idx;
+
+    for (idx = 0; idx < sched_len; idx++) {
+        if (sched[idx] == instance_id) {
+            sched_len--;
+            memmove(&sched[idx], &sched[idx+1],
+                    (sched_len - idx) * sizeof(sched[0]));
+            return;
+        }
+    }
+}
+
+/*
+ * @brief Set the shared timer to expire at the first scheduled change.
+ *
+ * @param[in] now_ms The current time.
+ */
+static void sched_tmr_update(uint32_t now_ms)
+{
+    int32_t delta_ms;
+
+    if (sched_len == 0) {
+        tmr_inst_start(sched_tmr_id, 0);
+        return;
+    }
+    delta_ms = blinky_states[sched[0]].due_ms - now_ms;
+    tmr_inst_start(sched_tmr_id, delta_ms > 0 ? delta_ms : 1);
 }
 
 /*
@@ -348,23 +631,61 @@ void start(void)
  * @param[in] user_data User callback data.
  *
  * @return TMR_CB_NONE
+ *
+ * Each instance that is due is stepped, and put back on the schedule at its
+ * next change. The next change time is based on the due time rather than the
+ * current time, so a late callback does not stretch the pattern. If the
+ * instance has fallen more than a step behind, it is resynchronized to the
+ * current time rather than trying to catch up.
+ */
+static enum tmr_cb_action tmr_cb(int32_t tmr_id, uint32_t user_data)
+{
+    enum blinky_instance_id instance_id;
+    struct blinky_state* st;
+    uint32_t now_ms = tmr_get_ms();
+    uint32_t next_ms;
+
+    while (sched_len > 0) {
+        instance_id = sched[0];
+        st = &blinky_states[instance_id];
+        if ((int32_t)(st->due_ms - now_ms) > 0)
+            break;
+        sched_remove(instance_id);
+        next_ms = step(st);
+        if (next_ms == 0)
+            continue;
+        st->due_ms += next_ms;
+        if ((int32_t)(st->due_ms - now_ms) <= 0)
+            st->due_ms = now_ms + next_ms;
+        sched_insert(instance_id);
+    }
+    sched_tmr_update(now_ms);
+    return TMR_CB_NONE;
+}
+
+/*
+ * @brief Run one step of an instance's state machine.
+ *
+ * @param[in] st The instance state.
+ *
+ * @return Time until the next step in ms, or 0 to stop.
  */
-enum tmr_cb_action tmr_cb(int32_t tmr_id, uint32_t user_data)
+static uint32_t step(struct blinky_state* st)
 {
     enum states next_state;
     bool led_on;
     uint32_t next_timer_value;
 
-    switch (state.state) {
+    switch (st->state) {
         case STATE_OFF:
-            log_error("blinky unexpected tmr_cb in off state\n");
-            return TMR_CB_NONE;
+            log_error("blinky unexpected step in off state\n");
+            return 0;
 
         case STATE_SEPARATOR_ON:
-            if (++state.blink_counter < state.cfg.sep_num_blinks) {
+            if (++st->blink_counter < st->cfg.sep_num_blinks) {
                 next_state = STATE_SEPARATOR_OFF;
                 led_on = false;
-                next_timer_value = (state.cfg.sep_period_ms+1)/2;
+                next_timer_value = (st->cfg.sep_period_ms+1)/2;
             } else {
                 next_state = STATE_PRE_BLINK_DELAY;
                 led_on = false;
@@ -375,15 +696,15 @@ enum tmr_cb_action tmr_cb(int32_t tmr_id, uint32_t user_data)
         case STATE_SEPARATOR_OFF:
             next_state = STATE_SEPARATOR_ON;
             led_on = true;
-            next_timer_value = (state.cfg.sep_period_ms+1)/2;
+            next_timer_value = (st->cfg.sep_period_ms+1)/2;
             break;
 
         case STATE_PRE_BLINK_DELAY:
-            if (state.cfg.code_period_ms > 0 && state.cfg.code_num_blinks > 0) {
+            if (st->cfg.code_period_ms > 0 && st->cfg.code_num_blinks > 0) {
                 next_state = STATE_BLINK_ON;
                 led_on = true;
-                next_timer_value = (state.cfg.code_period_ms+1)/2;
-                state.blink_counter = 0;
+                next_timer_value = (st->cfg.code_period_ms+1)/2;
+                st->blink_counter = 0;
             } else {
                 next_state = STATE_POST_BLINK_DELAY;
                 led_on = false;
@@ -392,10 +713,10 @@ enum tmr_cb_action tmr_cb(int32_t tmr_id, uint32_t user_data)
             break;
 
         case STATE_BLINK_ON:
-            if (++state.blink_counter < state.cfg.code_num_blinks) {
+            if (++st->blink_counter < st->cfg.code_num_blinks) {
                 next_state = STATE_BLINK_OFF;
                 led_on = false;
-                next_timer_value = (state.cfg.code_period_ms+1)/2;
+                next_timer_value = (st->cfg.code_period_ms+1)/2;
             } else {
                 next_state = STATE_POST_BLINK_DELAY;
                 led_on = false;
@@ -406,15 +727,15 @@ enum tmr_cb_action tmr_cb(int32_t tmr_id, uint32_t user_data)
         case STATE_BLINK_OFF:
             next_state = STATE_BLINK_ON;
             led_on = true;
-            next_timer_value = (state.cfg.code_period_ms+1)/2;
+            next_timer_value = (st->cfg.code_period_ms+1)/2;
             break;
 
         case STATE_POST_BLINK_DELAY:
-            if (state.cfg.sep_period_ms > 0 && state.cfg.sep_num_blinks > 0) {
+            if (st->cfg.sep_period_ms > 0 && st->cfg.sep_num_blinks > 0) {
                 next_state = STATE_SEPARATOR_ON;
                 led_on = true;
-                next_timer_value = (state.cfg.sep_period_ms+1)/2;
-                state.blink_counter = 0;
+                next_timer_value = (st->cfg.sep_period_ms+1)/2;
+                st->blink_counter = 0;
             } else {
                 next_state = STATE_PRE_BLINK_DELAY;
                 led_on = false;
@@ -423,14 +744,13 @@ enum tmr_cb_action tmr_cb(int32_t tmr_id, uint32_t user_data)
             break;
 
         default:
-            log_error("blinky unexpected state %d\n", state.state);
-            next_state = STATE_OFF;
-            return TMR_CB_NONE;
+            log_error("blinky unexpected state %d\n", st->state);
+            st->state = STATE_OFF;
+            return 0;
     }
 
-    state.state = next_state;
-    dio_set(state.cfg.dout_idx, led_on);
-    tmr_inst_start(state.tmr_id, next_timer_value);
-    return TMR_CB_NONE;
+    st->state = next_state;
+    dio_set(st->cfg.dout_idx, led_on);
+    return next_timer_value;
 }
 
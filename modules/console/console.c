@@ -2,7 +2,8 @@
  * @brief Implementation of console module.
  *
  * This module supports a CLI console on a ttys. Upon receiving a command it
- * passes the command string to the cmd module for execution.
+ * passes the command string to the cmd module for execution. It also
+ * publishes an EVT_TOPIC_TTYS_LINE event for each non-empty command line.
  *
  * This module provides simple line discipline functions:
  * - Echoing received characters.
@@ -43,6 +44,7 @@
 
 #include "cmd.h"
 #include "console.h"
+#include "evt.h"
 #include "log.h"
 #include "module.h"
 #include "ttys.h"
@@ -137,6 +139,7 @@ int32_t console_init(struct console_cfg* cfg)
 int32_t console_run(void)
 {
     char c;
+    struct evt evt;
     if (!state.first_run_done) {
         state.first_run_done = true;
         printf("%s", PROMPT);
@@ -148,6 +151,12 @@ int32_t console_run(void)
         if (c == '\n' || c == '\r') {
             state.cmd_bfr[state.num_cmd_bfr_chars] = '\0';
             printf("\n");
+            if (state.num_cmd_bfr_chars > 0) {
+                evt.topic = EVT_TOPIC_TTYS_LINE;
+                evt.data.ttys_line.instance_id = state.cfg.ttys_instance_id;
+                evt.data.ttys_line.len = state.num_cmd_bfr_chars;
+                evt_publish(&evt);
+            }
             cmd_execute(state.cmd_bfr);
             state.num_cmd_bfr_chars = 0;
             printf("%s", PROMPT);
@@ -7,10 +7,113 @@
  * During configuration, the user must specify the set of inputs and outputs and
  * their characteristics.
  *
+ * Besides single input/output access, groups of inputs/outputs can be accessed
+ * using masks of input/output indexes (bit N for index N). At init, the
+ * inputs/outputs are grouped by port, so each port is accessed once: input
+ * values are read from one IDR read per port, and outputs are changed with one
+ * BSRR write per port. The outputs on a port change at the same time, without
+ * glitches, and without a read-modify-write that could conflict with an
+ * interrupt handler.
+ *
+ * Inputs can optionally generate edge events, using EXTI interrupts. The
+ * interrupt handler captures the cycle counter, and puts an edge event in a
+ * queue. The queue is lock-free, with the interrupt handlers as the single
+ * producer (all EXTI interrupts have the same priority, so they don't preempt
+ * each other), and dio_run() or dio_get_edge() as the single consumer. An
+ * application should use one or the other, not both.
+ *
+ * dio_run() passes each edge event to the input's edge callback, if any, and
+ * publishes it on the evt bus (EVT_TOPIC_DIO_EDGE). For time-critical uses
+ * (e.g. a PPS input), a callback can also be called directly from the
+ * interrupt handler.
+ *
+ * An input on a timer channel pin can instead have its edges captured by the
+ * timer hardware, which removes the interrupt latency jitter. The timer runs
+ * at the core clock, so the captured count converts exactly to the cycle
+ * counter: the interrupt handler reads the timer counter and the cycle
+ * counter, and subtracts the ticks elapsed since the capture. This works as
+ * long as the interrupt is serviced within one timer period (780 us for a
+ * 16-bit timer).
+ *
+ * For time critical code, dio_get_fast() and dio_set_fast() are inline
+ * functions that use a table precomputed at init, with the register addresses
+ * and masks (inversion applied). They have no checks, and an output is set
+ * with a single BSRR store. The "dio bench" command compares the cycles per
+ * call of the checked and fast functions.
+ *
+ * Outputs on a timer channel pin can generate PWM, using the timer's output
+ * compare. Once set, the waveform runs without CPU involvement. The timer
+ * prescaler and period are chosen for the best duty resolution at the
+ * requested frequency. While PWM is active, dio_set() has no effect on the
+ * output. Outputs on channels of the same timer share its frequency. Another
+ * module can reserve a timer with dio_reserve_tmr() (e.g. the ttys software
+ * UART uses TIM3), after which it can't be used for PWM or toggle sequences.
+ *
+ * A waveform generator plays a buffer of BSRR words to a port, one word per
+ * sample, using DMA2 (stream 5, channel 6) triggered by the TIM1 update
+ * event. The buffer is played once or in a loop, without CPU involvement.
+ *
+ * A logic analyzer captures a port's IDR at a fixed rate, using DMA2 (stream
+ * 2, channel 6) triggered by TIM1 compare channel 2, into a small circular
+ * buffer. The DMA half/full transfer interrupts run-length encode each half
+ * into a larger buffer of runs (value and count), so long captures of slowly
+ * changing signals fit in RAM. The capture can start on an edge event of an
+ * input. The "dio la dump" command prints the capture in VCD format, which can
+ * be loaded into PulseView and other waveform viewers.
+ *
+ * A toggle sequence plays a repeating pattern of output levels on a PWM output
+ * pin, for example an LED blink pattern. The timer output compare toggles the
+ * pin at each update event, and DMA1 loads the next period into the auto
+ * reload register, so the pattern costs no CPU and its timing is exact.
+ *
+ * A frequency counter measures one input over a gate time, reporting the
+ * frequency, period and period jitter. For an input with edge events, it is a
+ * reciprocal counter: the gate opens and closes on 0 to 1 edges, and the
+ * edge time stamps give the gate length, so the resolution is that of the
+ * time stamps at any frequency (ideal for the GPS PPS). For an input on
+ * channel 1 or 2 of a capture timer, without edge events, the timer counts
+ * the edges in hardware (external clock mode), and the count is read every
+ * DIO_FREQ_POLL_MS. This suits high frequencies, with a resolution of one
+ * count per gate.
+ *
+ * On the STM32F401, only DMA2 can access the GPIO ports, and only TIM1
+ * requests are routed to it, so TIM1 is the sample clock for both the
+ * waveform generator and the logic analyzer. They can run at the same time,
+ * at the same rate (e.g. for a loopback test). TIM1 is also a capture timer,
+ * so capture on TIM1 is suspended while the sample clock runs, and TIM1 can't
+ * be used for PWM.
+ *
+ * Edges are counted per input, and the period and high time of the input are
+ * measured from the edge times. Queue overflows and capture overruns are
+ * counted as performance measurements.
+ *
+ * Inputs can optionally be debounced. A tmr callback samples the inputs
+ * periodically, with one IDR read per port, and runs the debounce filters for
+ * all the pins of a port in parallel, using bitwise operations:
+ * - The shift register filter keeps a history of port samples. Running AND/OR
+ *   values over the history give the pins that have been all 1s or all 0s for
+ *   each window size.
+ * - The integrator filter keeps its counters as "vertical" bit planes (plane N
+ *   holds bit N of the counter of each pin), so the counters are incremented,
+ *   decremented, and compared to their limits with a handful of bitwise
+ *   operations.
+ * So the cost of a sample depends on the number of ports, not the number of
+ * inputs. When the stable value of an input changes, an EVT_TOPIC_DIO_BUTTON
+ * event is published on the evt bus.
+ *
  * The following console commands are provided:
  * > dio status
  * > dio get
  * > dio set
+ * > dio getmask
+ * > dio setmask
+ * > dio toggle
+ * > dio edges
+ * > dio pwm
+ * > dio bench
+ * > dio wave
+ * > dio la
+ * > dio freq
  * See code for details.
  *
  * Currently, defintions from the STMicroelectronics Low Level (LL) device
@@ -41,24 +144,172 @@
  * SOFTWARE.
  */
 
+#include <ctype.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "stm32f4xx_ll_bus.h"
+#include "stm32f4xx_ll_exti.h"
+#include "stm32f4xx_ll_system.h"
+
 #include "cmd.h"
 #include "dio.h"
+#include "evt.h"
 #include "log.h"
 #include "module.h"
+#include "tmr.h"
 
 ////////////////////////////////////////////////////////////////////////////////
 // Common macros
 ////////////////////////////////////////////////////////////////////////////////
 
+#define DIO_MAX_PORTS 8
+
+#define DIO_NUM_EXTI_LINES 16
+#define DIO_NO_INPUT 0xff
+#define DIO_EDGE_QUEUE_LEN 16 // Must be a power of 2.
+
+#define DIO_PINS_PER_PORT 16
+#define DIO_TMR_NUM_CHANS 4
+
+#define DIO_BENCH_CALLS 1000
+
+// Sample clock timer, for the waveform generator and logic analyzer.
+#define DIO_SAMPLE_TMR DIO_TMR_1
+#define DIO_SAMPLE_USER_WAVE 0x1
+#define DIO_SAMPLE_USER_LA 0x2
+
+// Waveform generator hardware: TIM1 update triggers DMA2 stream 5 channel 6.
+#define DIO_WAVE_DMA DMA2
+#define DIO_WAVE_DMA_STREAM LL_DMA_STREAM_5
+#define DIO_WAVE_DMA_CHANNEL LL_DMA_CHANNEL_6
+#define DIO_WAVE_DMA_IRQ DMA2_Stream5_IRQn
+#define DIO_WAVE_MAX_SAMPLES 256 // For the console command buffer.
+
+// Logic analyzer hardware: TIM1 CC2 triggers DMA2 stream 2 channel 6.
+#define DIO_LA_DMA DMA2
+#define DIO_LA_DMA_STREAM LL_DMA_STREAM_2
+#define DIO_LA_DMA_CHANNEL LL_DMA_CHANNEL_6
+#define DIO_LA_DMA_IRQ DMA2_Stream2_IRQn
+#define DIO_LA_HALF_LEN 64    // Samples per DMA half buffer.
+#define DIO_LA_MAX_RUNS 2048  // Run length encoded buffer size.
+#define DIO_LA_MAX_RUN_CNT 0xffff
+#define DIO_FREQ_POLL_MS DIO_FREQ_MIN_GATE_MS // Hardware counter read period.
+#define DIO_DEBOUNCE_CNT_BITS 3 // Enough for DIO_DEBOUNCE_MAX_SAMPLES.
+
 ////////////////////////////////////////////////////////////////////////////////
 // Type definitions
 ////////////////////////////////////////////////////////////////////////////////
 
+// Edge event state for a pin number (EXTI line), used by both EXTI and
+// timer capture inputs.
+struct edge_line_info {
+    uint8_t din_idx;      // DIO_NO_INPUT if not used.
+    dio_edge_cb cb;       // Called from dio_run().
+    uint32_t cb_user_data;
+    dio_edge_cb isr_cb;   // Called from the interrupt handler.
+    uint32_t isr_cb_user_data;
+    uint32_t edges;
+    bool rise_valid;
+    uint32_t rise_cycles;
+    uint32_t period_cycles;
+    uint32_t high_cycles;
+};
+
+// Timers that can be used for PWM.
+struct pwm_tmr_info {
+    dio_tmr* tmr;
+    bool apb2;
+    uint32_t periph;
+    uint32_t cnt_max;
+    DMA_TypeDef* up_dma; // DMA for the update event, for toggle sequences.
+    uint32_t up_dma_stream;
+    uint32_t up_dma_channel;
+};
+
+// Waveform generator state.
+struct wave_state {
+    dio_port* port;
+    uint32_t num_samples;
+    uint32_t rate_hz;
+    bool circular;
+    volatile bool busy;
+    volatile uint32_t loops; // Times the buffer has been played.
+};
+
+// Logic analyzer state.
+enum la_state_id {
+    LA_IDLE,
+    LA_ARMED,   // Waiting for the trigger.
+    LA_RUNNING,
+    LA_DONE,
+};
+
+struct la_run {
+    uint16_t value;
+    uint16_t count;
+};
+
+struct la_state {
+    volatile enum la_state_id state;
+    dio_port* port;
+    uint32_t rate_hz;
+    uint32_t num_samples;
+    uint8_t trig_din_idx; // DIO_NO_INPUT for none.
+    uint8_t trig_value;
+    volatile uint32_t samples; // Samples encoded.
+    volatile uint32_t num_runs;
+    bool truncated; // Runs buffer full.
+    bool overrun;   // Encoding didn't keep up with DMA.
+};
+
+// Frequency counter state.
+struct freq_state {
+    uint8_t din_idx;  // DIO_NO_INPUT when stopped.
+    uint32_t gate_ms;
+    uint32_t gate_cycles;
+    const struct capture_tmr_info* hw_cti; // NULL for reciprocal counting.
+    int32_t tmr_id;
+    bool gate_open;   // Gate start time is valid.
+    uint32_t gate_start_cycles;
+    uint32_t last_cycles;
+    uint32_t last_cnt;
+    uint32_t edges;
+    bool overflow;    // Counts were lost in the open gate.
+    uint32_t min_period_cycles;
+    uint32_t max_period_cycles;
+    struct dio_freq_meas meas;
+};
+
+// Timers that can be used for edge capture.
+struct capture_tmr_info {
+    dio_tmr* tmr;
+    IRQn_Type irq_type;
+    bool apb2;
+    uint32_t periph;
+    uint32_t cnt_mask;
+};
+
+// Debounce state for a port. Bit N of each value is for pin N.
+struct debounce_port {
+    uint16_t shift_mask; // Pins using the shift register filter.
+    uint16_t integ_mask; // Pins using the integrator filter.
+    uint16_t stable;     // Stable pin values (before inversion).
+
+    // Shift register filter. win_mask[N] has the pins with window N+1.
+    uint16_t win_mask[DIO_DEBOUNCE_MAX_SAMPLES];
+    uint16_t hist[DIO_DEBOUNCE_MAX_SAMPLES]; // Index 0 is the newest.
+
+    // Integrator filter counters and limits, as bit planes.
+    uint16_t cnt[DIO_DEBOUNCE_CNT_BITS];
+    uint16_t limit[DIO_DEBOUNCE_CNT_BITS];
+
+    uint8_t din_idx[DIO_PINS_PER_PORT];
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 // Private (static) function declarations
 ////////////////////////////////////////////////////////////////////////////////
@@ -66,6 +317,43 @@
 static int32_t cmd_dio_status(int32_t argc, const char** argv);
 static int32_t cmd_dio_get(int32_t argc, const char** argv);
 static int32_t cmd_dio_set(int32_t argc, const char** argv);
+static int32_t cmd_dio_getmask(int32_t argc, const char** argv);
+static int32_t cmd_dio_setmask(int32_t argc, const char** argv);
+static int32_t cmd_dio_toggle(int32_t argc, const char** argv);
+static int32_t cmd_dio_edges(int32_t argc, const char** argv);
+static int32_t cmd_dio_pwm(int32_t argc, const char** argv);
+static int32_t cmd_dio_bench(int32_t argc, const char** argv);
+static int32_t cmd_dio_wave(int32_t argc, const char** argv);
+
+static int32_t get_port_idx(dio_port* port);
+static const struct pwm_tmr_info* get_pwm_tmr(uint32_t dout_idx);
+static void dma_clear_flags(DMA_TypeDef* dma, uint32_t stream);
+static void print_pwm(uint32_t dout_idx);
+static int32_t calc_tmr_period(uint32_t freq_hz, uint32_t cnt_max,
+                               uint32_t* psc, uint32_t* arr);
+static void wave_hw_stop(void);
+static int32_t sample_clk_start(uint32_t user, uint32_t rate_hz);
+static void sample_clk_stop(uint32_t user);
+static int32_t cmd_dio_la(int32_t argc, const char** argv);
+static void la_hw_stop(void);
+static void la_encode(const uint16_t* samples, uint32_t num_samples);
+static void la_dump(void);
+static void la_print_time(uint32_t sample);
+static dio_port* port_from_name(const char* name);
+static int32_t cmd_dio_freq(int32_t argc, const char** argv);
+static void freq_edge(uint32_t cycles);
+static void freq_gate_check(uint32_t cycles, uint32_t slack_cycles);
+static enum tmr_cb_action freq_tmr_cb(int32_t tmr_id, uint32_t user_data);
+static uint32_t cycles_to_ns(uint32_t cycles, uint32_t div);
+
+static int32_t edge_start(uint32_t din_idx);
+static int32_t capture_start(uint32_t din_idx);
+static void exti_isr(uint32_t line_mask);
+static void capture_isr(uint32_t tmr_idx);
+static void edge_put(struct edge_line_info* eli, uint32_t cycles);
+static int32_t debounce_add(uint32_t din_idx);
+static void debounce_start(void);
+static enum tmr_cb_action debounce_tmr_cb(int32_t tmr_id, uint32_t user_data);
 
 ////////////////////////////////////////////////////////////////////////////////
 // Private (static) variables
@@ -73,6 +361,103 @@ static int32_t cmd_dio_set(int32_t argc, const char** argv);
 
 static struct dio_cfg* cfg;
 
+// Ports used by the inputs/outputs, and the index of each input/output's port
+// in this table. Only the first DIO_MAX_MASK_BITS inputs/outputs can be
+// accessed by mask.
+static dio_port* ports[DIO_MAX_PORTS];
+static uint32_t num_ports;
+static uint8_t in_port_idx[DIO_MAX_MASK_BITS];
+static uint8_t out_port_idx[DIO_MAX_MASK_BITS];
+static uint32_t in_invert_mask;
+static uint32_t out_invert_mask;
+static uint32_t in_valid_mask;
+static uint32_t out_valid_mask;
+
+static struct edge_line_info edge_lines[DIO_NUM_EXTI_LINES];
+
+// Edge event queue. Free running indexes, the difference is the number of
+// queued events.
+static struct dio_edge edge_queue[DIO_EDGE_QUEUE_LEN];
+static volatile uint32_t edge_put_idx;
+static volatile uint32_t edge_get_idx;
+
+static const struct capture_tmr_info capture_tmrs[] = {
+    {DIO_TMR_1, TIM1_CC_IRQn, true, LL_APB2_GRP1_PERIPH_TIM1, 0xffff},
+    {DIO_TMR_4, TIM4_IRQn, false, LL_APB1_GRP1_PERIPH_TIM4, 0xffff},
+    {DIO_TMR_5, TIM5_IRQn, false, LL_APB1_GRP1_PERIPH_TIM5, 0xffffffff},
+};
+
+static const uint32_t capture_ll_chans[DIO_TMR_NUM_CHANS] = {
+    LL_TIM_CHANNEL_CH1, LL_TIM_CHANNEL_CH2, LL_TIM_CHANNEL_CH3,
+    LL_TIM_CHANNEL_CH4,
+};
+
+// TIM1's update DMA (DMA2) is used by the waveform generator, and TIM9-11 have
+// no DMA.
+static const struct pwm_tmr_info pwm_tmrs[] = {
+    {DIO_TMR_1, true, LL_APB2_GRP1_PERIPH_TIM1, 0xffff, NULL, 0, 0},
+    {DIO_TMR_2, false, LL_APB1_GRP1_PERIPH_TIM2, 0xffffffff,
+     DMA1, LL_DMA_STREAM_1, LL_DMA_CHANNEL_3},
+    {DIO_TMR_3, false, LL_APB1_GRP1_PERIPH_TIM3, 0xffff,
+     DMA1, LL_DMA_STREAM_2, LL_DMA_CHANNEL_5},
+    {DIO_TMR_4, false, LL_APB1_GRP1_PERIPH_TIM4, 0xffff,
+     DMA1, LL_DMA_STREAM_6, LL_DMA_CHANNEL_2},
+    {DIO_TMR_5, false, LL_APB1_GRP1_PERIPH_TIM5, 0xffffffff,
+     DMA1, LL_DMA_STREAM_0, LL_DMA_CHANNEL_6},
+    {DIO_TMR_9, true, LL_APB2_GRP1_PERIPH_TIM9, 0xffff, NULL, 0, 0},
+    {DIO_TMR_10, true, LL_APB2_GRP1_PERIPH_TIM10, 0xffff, NULL, 0, 0},
+    {DIO_TMR_11, true, LL_APB2_GRP1_PERIPH_TIM11, 0xffff, NULL, 0, 0},
+};
+
+// PWM state of the outputs, only for the first DIO_MAX_MASK_BITS outputs.
+// The period is in timer ticks, 0 if PWM is off.
+static uint32_t pwm_period_ticks[DIO_MAX_MASK_BITS];
+static uint16_t pwm_duty[DIO_MAX_MASK_BITS];
+static uint32_t pwm_tmr_reserved_mask; // Indexed by pwm_tmrs.
+
+// Toggle sequence state. Only one sequence can play at a time. The buffer
+// holds auto reload register values, rotated by one (see
+// dio_toggle_seq_start()).
+static uint8_t tseq_dout_idx;
+static const struct pwm_tmr_info* tseq_pti;
+static uint32_t tseq_bfr[DIO_TOGGLE_SEQ_MAX];
+
+// Input index for each timer channel, DIO_NO_INPUT if not used.
+static uint8_t capture_din_idx[ARRAY_SIZE(capture_tmrs)][DIO_TMR_NUM_CHANS];
+static uint32_t capture_tmr_mask; // Timers started.
+static volatile uint32_t capture_suspend_mask; // Timers in use by others.
+
+static struct wave_state wave;
+
+static uint32_t sample_clk_users;
+static uint32_t sample_clk_rate_hz;
+
+static struct la_state la;
+static uint16_t la_dma_bfr[DIO_LA_HALF_LEN * 2];
+static struct la_run la_runs[DIO_LA_MAX_RUNS];
+
+static struct freq_state freq;
+
+// Waveform buffer for the console command.
+static uint32_t wave_bfr[DIO_WAVE_MAX_SAMPLES];
+static uint32_t wave_bfr_len;
+static dio_port* wave_bfr_port;
+
+static struct debounce_port debounce_ports[DIO_MAX_PORTS];
+static uint32_t debounce_port_mask; // Ports with debounced inputs.
+static uint32_t debounce_max_cycles;
+static uint32_t debounce_changes;
+
+// SYSCFG EXTI line values, indexed by pin number.
+static const uint32_t syscfg_exti_lines[DIO_NUM_EXTI_LINES] = {
+    LL_SYSCFG_EXTI_LINE0, LL_SYSCFG_EXTI_LINE1, LL_SYSCFG_EXTI_LINE2,
+    LL_SYSCFG_EXTI_LINE3, LL_SYSCFG_EXTI_LINE4, LL_SYSCFG_EXTI_LINE5,
+    LL_SYSCFG_EXTI_LINE6, LL_SYSCFG_EXTI_LINE7, LL_SYSCFG_EXTI_LINE8,
+    LL_SYSCFG_EXTI_LINE9, LL_SYSCFG_EXTI_LINE10, LL_SYSCFG_EXTI_LINE11,
+    LL_SYSCFG_EXTI_LINE12, LL_SYSCFG_EXTI_LINE13, LL_SYSCFG_EXTI_LINE14,
+    LL_SYSCFG_EXTI_LINE15,
+};
+
 static struct cmd_cmd_info cmds[] = {
     {
         .name = "status",
@@ -89,21 +474,95 @@ static struct cmd_cmd_info cmds[] = {
         .func = cmd_dio_set,
         .help = "Set output value, usage: dio set <output-name> {0|1}",
     },
+    {
+        .name = "getmask",
+        .func = cmd_dio_getmask,
+        .help = "Get input values, usage: dio getmask <input-mask>",
+    },
+    {
+        .name = "setmask",
+        .func = cmd_dio_setmask,
+        .help = "Set output values, usage: dio setmask <output-mask> <values>",
+    },
+    {
+        .name = "toggle",
+        .func = cmd_dio_toggle,
+        .help = "Toggle outputs, usage: dio toggle <output-mask>",
+    },
+    {
+        .name = "edges",
+        .func = cmd_dio_edges,
+        .help = "Get edge measurements, usage: dio edges",
+    },
+    {
+        .name = "pwm",
+        .func = cmd_dio_pwm,
+        .help = "Set PWM, usage: dio pwm [<output-name> <freq-hz> <duty>] "
+                "(duty in 0.1%, freq 0 for off)",
+    },
+    {
+        .name = "bench",
+        .func = cmd_dio_bench,
+        .help = "Measure get/set cycles per call, usage: dio bench",
+    },
+    {
+        .name = "wave",
+        .func = cmd_dio_wave,
+        .help = "Waveform generator, usage: dio wave [clear | "
+                "add <output-mask> <values> [count] | start <rate-hz> [loop] | "
+                "stop]",
+    },
+    {
+        .name = "la",
+        .func = cmd_dio_la,
+        .help = "Logic analyzer, usage: dio la [start <port> <rate-hz> "
+                "<samples> [<input-name> {0|1}] | stop | dump]",
+    },
+    {
+        .name = "freq",
+        .func = cmd_dio_freq,
+        .help = "Frequency counter, usage: dio freq [start <input-name> "
+                "<gate-ms> | stop]",
+    },
 };
 
 static int32_t log_level = LOG_DEFAULT;
 
+enum dio_u16_pms {
+    CNT_EDGE_QUEUE_FULL,
+    CNT_CAPTURE_OVERRUN,
+    CNT_WAVE_DMA_ERR,
+    CNT_LA_DMA_ERR,
+
+    NUM_U16_PMS
+};
+
+static uint16_t cnts_u16[NUM_U16_PMS];
+
+static const char* cnts_u16_names[NUM_U16_PMS] = {
+    "edge queue full",
+    "capture overrun",
+    "wave dma error",
+    "la dma error",
+};
+
 static struct cmd_client_info cmd_info = {
     .name = "dio",
     .num_cmds = ARRAY_SIZE(cmds),
     .cmds = cmds,
     .log_level_ptr = &log_level,
+    .num_u16_pms = NUM_U16_PMS,
+    .u16_pms = cnts_u16,
+    .u16_pm_names = cnts_u16_names,
 };
 
 ////////////////////////////////////////////////////////////////////////////////
 // Public (global) variables and externs
 ////////////////////////////////////////////////////////////////////////////////
 
+struct dio_fast_in _dio_fast_ins[DIO_MAX_MASK_BITS];
+struct dio_fast_out _dio_fast_outs[DIO_MAX_MASK_BITS];
+
 ////////////////////////////////////////////////////////////////////////////////
 // Public (global) functions
 ////////////////////////////////////////////////////////////////////////////////
@@ -122,15 +581,65 @@ static struct cmd_client_info cmd_info = {
 int32_t dio_init(struct dio_cfg* _cfg)
 {
     uint32_t idx;
+    int32_t port_idx;
     const struct dio_in_info* dii;
     const struct dio_out_info* doi;
 
     cfg = _cfg;
 
+    for (idx = 0; idx < DIO_NUM_EXTI_LINES; idx++) {
+        memset(&edge_lines[idx], 0, sizeof(edge_lines[idx]));
+        edge_lines[idx].din_idx = DIO_NO_INPUT;
+    }
+    edge_put_idx = 0;
+    edge_get_idx = 0;
+    memset(capture_din_idx, DIO_NO_INPUT, sizeof(capture_din_idx));
+    capture_tmr_mask = 0;
+    capture_suspend_mask = 0;
+    memset(&wave, 0, sizeof(wave));
+    memset(&la, 0, sizeof(la));
+    sample_clk_users = 0;
+    memset(&freq, 0, sizeof(freq));
+    freq.din_idx = DIO_NO_INPUT;
+    wave_bfr_len = 0;
+
+    memset(debounce_ports, 0, sizeof(debounce_ports));
+    debounce_port_mask = 0;
+    debounce_max_cycles = 0;
+    debounce_changes = 0;
+
+    memset(pwm_period_ticks, 0, sizeof(pwm_period_ticks));
+    memset(pwm_duty, 0, sizeof(pwm_duty));
+    pwm_tmr_reserved_mask = 0;
+    tseq_dout_idx = DIO_NO_INPUT;
+    tseq_pti = NULL;
+
+    num_ports = 0;
+    in_invert_mask = 0;
+    out_invert_mask = 0;
+    in_valid_mask = 0;
+    out_valid_mask = 0;
     for (idx = 0; idx < cfg->num_inputs; idx++) {
         dii = &cfg->inputs[idx];
         LL_GPIO_SetPinPull(dii->port, dii->pin, dii->pull);
         LL_GPIO_SetPinMode(dii->port, dii->pin, LL_GPIO_MODE_INPUT);
+        if (idx < DIO_MAX_MASK_BITS) {
+            port_idx = get_port_idx(dii->port);
+            if (port_idx < 0)
+                return port_idx;
+            in_port_idx[idx] = port_idx;
+            in_valid_mask |= 1UL << idx;
+            _dio_fast_ins[idx].idr = &dii->port->IDR;
+            _dio_fast_ins[idx].shift = __builtin_ctz(dii->pin);
+            _dio_fast_ins[idx].invert = dii->invert ? 1 : 0;
+            if (dii->invert)
+                in_invert_mask |= 1UL << idx;
+        }
+        if (dii->debounce != DIO_DEBOUNCE_NONE && cfg->debounce_ms > 0) {
+            int32_t result = debounce_add(idx);
+            if (result < 0)
+                return result;
+        }
     }
     for (idx = 0; idx < cfg->num_outputs; idx++) {
         doi = &cfg->outputs[idx];
@@ -138,6 +647,18 @@ int32_t dio_init(struct dio_cfg* _cfg)
         LL_GPIO_SetPinOutputType(doi->port, doi->pin,  doi->output_type);
         LL_GPIO_SetPinPull(doi->port, doi->pin, doi->pull);
         LL_GPIO_SetPinMode(doi->port, doi->pin, LL_GPIO_MODE_OUTPUT);
+        if (idx < DIO_MAX_MASK_BITS) {
+            port_idx = get_port_idx(doi->port);
+            if (port_idx < 0)
+                return port_idx;
+            out_port_idx[idx] = port_idx;
+            out_valid_mask |= 1UL << idx;
+            _dio_fast_outs[idx].bsrr = &doi->port->BSRR;
+            _dio_fast_outs[idx].bsrr_val[doi->invert ? 1 : 0] = doi->pin << 16;
+            _dio_fast_outs[idx].bsrr_val[doi->invert ? 0 : 1] = doi->pin;
+            if (doi->invert)
+                out_invert_mask |= 1UL << idx;
+        }
     }
     return 0;
 }
@@ -148,16 +669,64 @@ int32_t dio_init(struct dio_cfg* _cfg)
  * @return 0 for success, else a "MOD_ERR" value. See code for details.
  *
  * This function starts the dio singleton module, to enter normal operation.
+ * This includes enabling edge interrupts and debouncing for inputs that use
+ * them.
  */
 int32_t dio_start(void)
 {
     int32_t result;
+    uint32_t idx;
 
     result = cmd_register(&cmd_info);
     if (result < 0) {
         log_error("dio_start: cmd error %d\n", result);
         return MOD_ERR_RESOURCE;
     }
+    for (idx = 0; idx < cfg->num_inputs; idx++) {
+        if (cfg->inputs[idx].edge != DIO_EDGE_NONE) {
+            result = edge_start(idx);
+            if (result < 0)
+                return result;
+        }
+    }
+    if (debounce_port_mask != 0) {
+        debounce_start();
+        result = tmr_inst_get_cb(cfg->debounce_ms, debounce_tmr_cb, 0);
+        if (result < 0) {
+            log_error("dio_start: tmr error %d\n", result);
+            return MOD_ERR_RESOURCE;
+        }
+    }
+    return 0;
+}
+
+/*
+ * @brief Run dio module instance.
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * @note This function should not block.
+ *
+ * This function delivers queued edge events to the edge callbacks and the evt
+ * bus. At most one queue's worth of events is delivered per call.
+ */
+int32_t dio_run(void)
+{
+    struct dio_edge edge;
+    struct edge_line_info* eli;
+    struct evt evt;
+    uint32_t ctr;
+
+    for (ctr = 0; ctr < DIO_EDGE_QUEUE_LEN && dio_get_edge(&edge); ctr++) {
+        eli = &edge_lines[__builtin_ctz(cfg->inputs[edge.din_idx].pin)];
+        if (eli->cb != NULL)
+            eli->cb(&edge, eli->cb_user_data);
+        evt.topic = EVT_TOPIC_DIO_EDGE;
+        evt.data.dio_edge.din_idx = edge.din_idx;
+        evt.data.dio_edge.value = edge.value;
+        evt.data.dio_edge.cycles = edge.cycles;
+        evt_publish(&evt);
+    }
     return 0;
 }
 
@@ -219,126 +788,2558 @@ int32_t dio_set(uint32_t dout_idx, uint32_t value)
 }
 
 /*
- * @brief Get number of discrete inputs.
+ * @brief Set PWM on a discrete output.
  *
- * @return Return number of inputs (non-negative) for success, else a "MOD_ERR"
- *         value. See code for details.
+ * @param[in] dout_idx Discrete output index per module configuration.
+ * @param[in] freq_hz PWM frequency, or 0 to turn PWM off.
+ * @param[in] duty Duty cycle, 0 to DIO_PWM_DUTY_MAX (0.1% units), for the
+ *                 output value 1 (inversion applied).
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * When PWM is turned off, the output returns to the value last set by
+ * dio_set(). Changes to a running PWM take effect at the end of the current
+ * period, so there are no glitches.
+ *
+ * The channels of a timer share its frequency. If another output on the same
+ * timer has PWM active at a different frequency, MOD_ERR_STATE is returned;
+ * turn it off first. If the timer is in use for something else, or reserved
+ * with dio_reserve_tmr(), MOD_ERR_RESOURCE is returned.
  */
-int32_t dio_get_num_in(void)
+int32_t dio_set_pwm(uint32_t dout_idx, uint32_t freq_hz, uint32_t duty)
 {
-    return cfg == NULL ? MOD_ERR_RESOURCE : cfg->num_inputs;
+    const struct dio_out_info* doi;
+    const struct pwm_tmr_info* pti;
+    uint32_t idx;
+    uint32_t chan;
+    uint32_t psc;
+    uint32_t arr;
+
+    if (cfg == NULL || dout_idx >= cfg->num_outputs ||
+        dout_idx >= DIO_MAX_MASK_BITS || duty > DIO_PWM_DUTY_MAX)
+        return MOD_ERR_ARG;
+    doi = &cfg->outputs[dout_idx];
+    pti = get_pwm_tmr(dout_idx);
+    if (pti == NULL)
+        return MOD_ERR_ARG;
+    chan = capture_ll_chans[doi->pwm_chan - 1];
+
+    // The timer can't also be used for capture, which needs it free running,
+    // or for the waveform generator.
+    for (idx = 0; idx < ARRAY_SIZE(capture_tmrs); idx++) {
+        if (capture_tmrs[idx].tmr == pti->tmr &&
+            (capture_tmr_mask & (1 << idx)) != 0)
+            return MOD_ERR_RESOURCE;
+    }
+    if (pti->tmr == DIO_SAMPLE_TMR && sample_clk_users != 0)
+        return MOD_ERR_RESOURCE;
+    if (freq.hw_cti != NULL && freq.hw_cti->tmr == pti->tmr)
+        return MOD_ERR_RESOURCE;
+    if (tseq_pti == pti)
+        return MOD_ERR_RESOURCE;
+    if ((pwm_tmr_reserved_mask & (1 << (pti - pwm_tmrs))) != 0)
+        return MOD_ERR_RESOURCE;
+
+    if (freq_hz == 0) {
+        LL_GPIO_SetPinMode(doi->port, doi->pin, LL_GPIO_MODE_OUTPUT);
+        LL_TIM_CC_DisableChannel(pti->tmr, chan);
+        pwm_period_ticks[dout_idx] = 0;
+        return 0;
+    }
+    if (calc_tmr_period(freq_hz, pti->cnt_max, &psc, &arr) < 0)
+        return MOD_ERR_ARG;
+    for (idx = 0; idx < cfg->num_outputs && idx < DIO_MAX_MASK_BITS; idx++) {
+        if (idx != dout_idx && pwm_period_ticks[idx] != 0 &&
+            get_pwm_tmr(idx) == pti &&
+            pwm_period_ticks[idx] != (psc + 1) * (arr + 1))
+            return MOD_ERR_STATE;
+    }
+
+    if (pti->apb2)
+        LL_APB2_GRP1_EnableClock(pti->periph);
+    else
+        LL_APB1_GRP1_EnableClock(pti->periph);
+    LL_TIM_SetPrescaler(pti->tmr, psc);
+    LL_TIM_SetAutoReload(pti->tmr, arr);
+    LL_TIM_EnableARRPreload(pti->tmr);
+    LL_TIM_OC_SetMode(pti->tmr, chan, LL_TIM_OCMODE_PWM1);
+    LL_TIM_OC_SetPolarity(pti->tmr, chan, doi->invert ?
+                          LL_TIM_OCPOLARITY_LOW : LL_TIM_OCPOLARITY_HIGH);
+    LL_TIM_OC_EnablePreload(pti->tmr, chan);
+    (&pti->tmr->CCR1)[doi->pwm_chan - 1] =
+        ((uint64_t)(arr + 1) * duty + DIO_PWM_DUTY_MAX / 2) / DIO_PWM_DUTY_MAX;
+    if (pti->tmr == DIO_TMR_1)
+        LL_TIM_EnableAllOutputs(pti->tmr);
+    if (!LL_TIM_IsEnabledCounter(pti->tmr)) {
+        // Load the preloaded registers before starting.
+        LL_TIM_GenerateEvent_UPDATE(pti->tmr);
+        LL_TIM_EnableCounter(pti->tmr);
+    }
+    LL_TIM_CC_EnableChannel(pti->tmr, chan);
+
+    if (pwm_period_ticks[dout_idx] == 0) {
+        if (doi->pin >= DIO_PIN_8)
+            LL_GPIO_SetAFPin_8_15(doi->port, doi->pin, doi->pwm_af);
+        else
+            LL_GPIO_SetAFPin_0_7(doi->port, doi->pin, doi->pwm_af);
+        LL_GPIO_SetPinMode(doi->port, doi->pin, LL_GPIO_MODE_ALTERNATE);
+    }
+    pwm_period_ticks[dout_idx] = (psc + 1) * (arr + 1);
+    pwm_duty[dout_idx] = duty;
+    return 0;
 }
 
 /*
- * @brief Get number of discrete output.
+ * @brief Start a toggle sequence on an output.
  *
- * @return Return number of outputs (non-negative) for success, else a "MOD_ERR"
- *         value. See code for details.
+ * @param[in] dout_idx Discrete output index per module configuration. The
+ *                     output must have a PWM timer, TIM2 to TIM5.
+ * @param[in] ticks Duration of each output level, in ticks. The output
+ *                  starts at 0 (inversion applied), and toggles after each
+ *                  duration. The sequence repeats until stopped.
+ * @param[in] num_ticks Number of durations, even, 2 to DIO_TOGGLE_SEQ_MAX.
+ * @param[in] tick_hz Tick rate, which must divide the core clock, giving a
+ *                    prescaler of at most 65536.
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * The timer must not have PWM outputs active, or be reserved with
+ * dio_reserve_tmr(). The durations are copied, and must each be at least 2
+ * ticks, and fit in the timer counter.
  */
-int32_t dio_get_num_out(void)
+int32_t dio_toggle_seq_start(uint32_t dout_idx, const uint32_t* ticks,
+                             uint32_t num_ticks, uint32_t tick_hz)
 {
-    return cfg == NULL ? MOD_ERR_RESOURCE : cfg->num_outputs;
-}
+    const struct dio_out_info* doi;
+    const struct pwm_tmr_info* pti;
+    uint32_t chan;
+    uint32_t idx;
+    uint32_t psc;
 
-////////////////////////////////////////////////////////////////////////////////
-// Private (static) functions
-////////////////////////////////////////////////////////////////////////////////
+    if (cfg == NULL || dout_idx >= cfg->num_outputs ||
+        dout_idx >= DIO_MAX_MASK_BITS || ticks == NULL || num_ticks < 2 ||
+        num_ticks > DIO_TOGGLE_SEQ_MAX || (num_ticks & 1) != 0 ||
+        tick_hz == 0 || SystemCoreClock % tick_hz != 0 ||
+        SystemCoreClock / tick_hz > 0x10000)
+        return MOD_ERR_ARG;
+    doi = &cfg->outputs[dout_idx];
+    pti = get_pwm_tmr(dout_idx);
+    if (pti == NULL || pti->up_dma == NULL)
+        return MOD_ERR_ARG;
+    if (tseq_pti != NULL)
+        return MOD_ERR_STATE;
+    if ((pwm_tmr_reserved_mask & (1 << (pti - pwm_tmrs))) != 0)
+        return MOD_ERR_RESOURCE;
+    for (idx = 0; idx < cfg->num_outputs && idx < DIO_MAX_MASK_BITS; idx++) {
+        if (cfg->outputs[idx].pwm_tmr == pti->tmr &&
+            pwm_period_ticks[idx] != 0)
+            return MOD_ERR_RESOURCE;
+    }
+    for (idx = 0; idx < ARRAY_SIZE(capture_tmrs); idx++) {
+        if (capture_tmrs[idx].tmr == pti->tmr &&
+            (capture_tmr_mask & (1 << idx)) != 0)
+            return MOD_ERR_RESOURCE;
+    }
+    if (freq.hw_cti != NULL && freq.hw_cti->tmr == pti->tmr)
+        return MOD_ERR_RESOURCE;
+
+    // The DMA writes the next period at each update event, during the first
+    // tick of the period it applies to, so the buffer is rotated by one: the
+    // first period is loaded directly.
+    for (idx = 0; idx < num_ticks; idx++) {
+        if (ticks[idx] < 2 || ticks[idx] - 1 > pti->cnt_max)
+            return MOD_ERR_ARG;
+        tseq_bfr[(idx + num_ticks - 1) % num_ticks] = ticks[idx] - 1;
+    }
+    psc = SystemCoreClock / tick_hz - 1;
+    chan = capture_ll_chans[doi->pwm_chan - 1];
+
+    LL_APB1_GRP1_EnableClock(pti->periph);
+    LL_AHB1_GRP1_EnableClock(LL_AHB1_GRP1_PERIPH_DMA1);
+    LL_TIM_DisableCounter(pti->tmr);
+    LL_TIM_DisableDMAReq_UPDATE(pti->tmr);
+    LL_DMA_DisableStream(pti->up_dma, pti->up_dma_stream);
+    while (LL_DMA_IsEnabledStream(pti->up_dma, pti->up_dma_stream))
+        ;
+    dma_clear_flags(pti->up_dma, pti->up_dma_stream);
+    LL_DMA_SetChannelSelection(pti->up_dma, pti->up_dma_stream,
+                               pti->up_dma_channel);
+    LL_DMA_SetDataTransferDirection(pti->up_dma, pti->up_dma_stream,
+                                    LL_DMA_DIRECTION_MEMORY_TO_PERIPH);
+    LL_DMA_SetMode(pti->up_dma, pti->up_dma_stream, LL_DMA_MODE_CIRCULAR);
+    LL_DMA_SetPeriphIncMode(pti->up_dma, pti->up_dma_stream,
+                            LL_DMA_PERIPH_NOINCREMENT);
+    LL_DMA_SetMemoryIncMode(pti->up_dma, pti->up_dma_stream,
+                            LL_DMA_MEMORY_INCREMENT);
+    LL_DMA_SetPeriphSize(pti->up_dma, pti->up_dma_stream,
+                         LL_DMA_PDATAALIGN_WORD);
+    LL_DMA_SetMemorySize(pti->up_dma, pti->up_dma_stream,
+                         LL_DMA_MDATAALIGN_WORD);
+    LL_DMA_SetPeriphAddress(pti->up_dma, pti->up_dma_stream,
+                            (uint32_t)&pti->tmr->ARR);
+    LL_DMA_SetMemoryAddress(pti->up_dma, pti->up_dma_stream,
+                            (uint32_t)tseq_bfr);
+    LL_DMA_SetDataLength(pti->up_dma, pti->up_dma_stream, num_ticks);
+    LL_DMA_EnableStream(pti->up_dma, pti->up_dma_stream);
+
+    // ARR is not preloaded, so the DMA write takes effect in the current
+    // period. The output is forced to 0, then toggles at each update (compare
+    // match at count 0). The counter starts at 1, so there is no match at the
+    // start.
+    LL_TIM_SetPrescaler(pti->tmr, psc);
+    LL_TIM_DisableARRPreload(pti->tmr);
+    LL_TIM_SetAutoReload(pti->tmr, tseq_bfr[num_ticks - 1]);
+    LL_TIM_GenerateEvent_UPDATE(pti->tmr);
+    pti->tmr->SR = 0;
+    LL_TIM_SetCounter(pti->tmr, 1);
+    LL_TIM_OC_DisablePreload(pti->tmr, chan);
+    (&pti->tmr->CCR1)[doi->pwm_chan - 1] = 0;
+    LL_TIM_OC_SetPolarity(pti->tmr, chan, doi->invert ?
+                          LL_TIM_OCPOLARITY_LOW : LL_TIM_OCPOLARITY_HIGH);
+    LL_TIM_OC_SetMode(pti->tmr, chan, LL_TIM_OCMODE_FORCED_INACTIVE);
+    LL_TIM_CC_EnableChannel(pti->tmr, chan);
+    LL_TIM_OC_SetMode(pti->tmr, chan, LL_TIM_OCMODE_TOGGLE);
+    if (doi->pin >= DIO_PIN_8)
+        LL_GPIO_SetAFPin_8_15(doi->port, doi->pin, doi->pwm_af);
+    else
+        LL_GPIO_SetAFPin_0_7(doi->port, doi->pin, doi->pwm_af);
+    LL_GPIO_SetPinMode(doi->port, doi->pin, LL_GPIO_MODE_ALTERNATE);
+
+    tseq_pti = pti;
+    tseq_dout_idx = dout_idx;
+    LL_TIM_EnableDMAReq_UPDATE(pti->tmr);
+    LL_TIM_EnableCounter(pti->tmr);
+    return 0;
+}
 
 /*
- * @brief Console command function for "dio status".
+ * @brief Stop a toggle sequence.
  *
- * @param[in] argc Number of arguments, including "dio".
- * @param[in] argv Argument values, including "dio".
+ * @param[in] dout_idx Discrete output index per module configuration.
  *
  * @return 0 for success, else a "MOD_ERR" value. See code for details.
  *
- * Command usage: dio status
+ * The output returns to the value last set by dio_set().
  */
-static int32_t cmd_dio_status(int32_t argc, const char** argv)
+int32_t dio_toggle_seq_stop(uint32_t dout_idx)
 {
-    uint32_t idx;
-    
-    printf("Inputs:\n");
-    for (idx = 0; idx < cfg->num_inputs; idx++)
-        printf("  %2lu: %s = %ld\n", idx, cfg->inputs[idx].name, dio_get(idx));
-    
-
-    printf("Outputs:\n");
-    for (idx = 0; idx < cfg->num_outputs; idx++)
-        printf("  %2lu: %s = %ld\n", idx, cfg->outputs[idx].name,
-               dio_get_out(idx));
+    const struct dio_out_info* doi;
 
+    if (cfg == NULL || dout_idx >= cfg->num_outputs)
+        return MOD_ERR_ARG;
+    if (tseq_pti == NULL || tseq_dout_idx != dout_idx)
+        return 0;
+    doi = &cfg->outputs[dout_idx];
+    LL_GPIO_SetPinMode(doi->port, doi->pin, LL_GPIO_MODE_OUTPUT);
+    LL_TIM_DisableCounter(tseq_pti->tmr);
+    LL_TIM_DisableDMAReq_UPDATE(tseq_pti->tmr);
+    LL_DMA_DisableStream(tseq_pti->up_dma, tseq_pti->up_dma_stream);
+    LL_TIM_CC_DisableChannel(tseq_pti->tmr,
+                             capture_ll_chans[doi->pwm_chan - 1]);
+    LL_TIM_EnableARRPreload(tseq_pti->tmr);
+    tseq_pti = NULL;
+    tseq_dout_idx = DIO_NO_INPUT;
     return 0;
 }
 
 /*
- * @brief Console command function for "dio get".
+ * @brief Reserve a PWM timer for use by another module.
  *
- * @param[in] argc Number of arguments, including "dio".
- * @param[in] argv Argument values, including "dio".
+ * @param[in] tmr The timer, one of DIO_TMR_1 to DIO_TMR_11.
  *
  * @return 0 for success, else a "MOD_ERR" value. See code for details.
  *
- * Command usage: dio get <input-name>
+ * The reservation lasts until the next dio_init(). Afterwards, dio_set_pwm()
+ * and dio_toggle_seq_start() return MOD_ERR_RESOURCE for outputs on the timer.
+ * The timer must not be in use by the dio module already.
  */
-static int32_t cmd_dio_get(int32_t argc, const char** argv)
+int32_t dio_reserve_tmr(dio_tmr* tmr)
 {
+    uint32_t tmr_idx;
     uint32_t idx;
-    struct cmd_arg_val arg_vals[1];
 
-    if (cmd_parse_args(argc-2, argv+2, "s", arg_vals) != 1)
-        return MOD_ERR_BAD_CMD;
-
-    for (idx = 0; idx < cfg->num_inputs; idx++)
-        if (strcasecmp(arg_vals[0].val.s, cfg->inputs[idx].name) == 0)
+    if (cfg == NULL)
+        return MOD_ERR_STATE;
+    for (tmr_idx = 0; tmr_idx < ARRAY_SIZE(pwm_tmrs); tmr_idx++) {
+        if (pwm_tmrs[tmr_idx].tmr == tmr)
             break;
-    if (idx < cfg->num_inputs) {
-        printf("%s = %ld\n", cfg->inputs[idx].name, dio_get(idx));
-        return 0;
     }
-
-    for (idx = 0; idx < cfg->num_outputs; idx++)
-        if (strcasecmp(arg_vals[0].val.s, cfg->outputs[idx].name) == 0)
-            break;
-    if (idx < cfg->num_outputs) {
-        printf("%s %ld\n", cfg->outputs[idx].name, dio_get_out(idx));
-        return 0;
+    if (tmr_idx >= ARRAY_SIZE(pwm_tmrs))
+        return MOD_ERR_ARG;
+    if (tseq_pti == &pwm_tmrs[tmr_idx])
+        return MOD_ERR_RESOURCE;
+    for (idx = 0; idx < cfg->num_outputs && idx < DIO_MAX_MASK_BITS; idx++) {
+        if (cfg->outputs[idx].pwm_tmr == tmr && pwm_period_ticks[idx] != 0)
+            return MOD_ERR_RESOURCE;
     }
-    printf("Invalid dio input/output name '%s'\n", arg_vals[0].val.s);
-    return MOD_ERR_ARG;
+    for (idx = 0; idx < ARRAY_SIZE(capture_tmrs); idx++) {
+        if (capture_tmrs[idx].tmr == tmr &&
+            (capture_tmr_mask & (1 << idx)) != 0)
+            return MOD_ERR_RESOURCE;
+    }
+    if ((tmr == DIO_SAMPLE_TMR && sample_clk_users != 0) ||
+        (freq.hw_cti != NULL && freq.hw_cti->tmr == tmr))
+        return MOD_ERR_RESOURCE;
+    pwm_tmr_reserved_mask |= 1 << tmr_idx;
+    return 0;
 }
 
 /*
- * @brief Console command function for "dio set".
+ * @brief Get the BSRR value to set a group of discrete outputs.
  *
- * @param[in] argc Number of arguments, including "dio".
- * @param[in] argv Argument values, including "dio".
+ * @param[in] dout_mask Mask of output indexes (bit N for index N). The
+ *                      outputs must all be on the same port.
+ * @param[in] values Output values, in the same bit positions. Bits not in
+ *                   dout_mask are ignored.
+ * @param[out] port The port of the outputs.
+ * @param[out] bsrr The BSRR value.
  *
  * @return 0 for success, else a "MOD_ERR" value. See code for details.
  *
- * Command usage: dio set <output-name> {0|1}
+ * This is used to build waveforms for dio_wave_start().
  */
-static int32_t cmd_dio_set(int32_t argc, const char** argv)
+int32_t dio_mask_to_bsrr(uint32_t dout_mask, uint32_t values, dio_port** port,
+                         uint32_t* bsrr)
 {
+    uint32_t bits;
     uint32_t idx;
-    struct cmd_arg_val arg_vals[2];
-    uint32_t value;
-
-    if (cmd_parse_args(argc-2, argv+2, "su", arg_vals) != 2)
-        return MOD_ERR_BAD_CMD;
+    uint32_t pin;
+    uint32_t port_idx;
 
-    for (idx = 0; idx < cfg->num_outputs; idx++)
-        if (strcasecmp(arg_vals[0].val.s, cfg->outputs[idx].name) == 0)
-            break;
-    if (idx >= cfg->num_outputs) {
-        printf("Invalid dio name '%s'\n", arg_vals[0].val.s);
+    if (cfg == NULL || port == NULL || bsrr == NULL || dout_mask == 0 ||
+        (dout_mask & ~out_valid_mask) != 0)
         return MOD_ERR_ARG;
+
+    port_idx = out_port_idx[__builtin_ctz(dout_mask)];
+    *bsrr = 0;
+    values ^= out_invert_mask;
+    for (bits = dout_mask; bits != 0; bits &= bits - 1) {
+        idx = __builtin_ctz(bits);
+        if (out_port_idx[idx] != port_idx)
+            return MOD_ERR_ARG;
+        pin = cfg->outputs[idx].pin;
+        *bsrr |= (values >> idx) & 1 ? pin : pin << 16;
     }
+    *port = ports[port_idx];
+    return 0;
+}
 
-    value = arg_vals[1].val.u;
-    if (value != 0 && value != 1) {
-        printf("Invalid value '%s'\n", argv[3]);
+/*
+ * @brief Start playing a waveform to a port.
+ *
+ * @param[in] port The port.
+ * @param[in] bsrr_words The waveform, one BSRR value per sample. It must stay
+ *                       valid until the waveform ends or is stopped.
+ * @param[in] num_samples Number of samples (1 to 65535).
+ * @param[in] rate_hz Sample rate.
+ * @param[in] circular True to play the waveform in a loop, until stopped.
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * The first sample is written at the next sample clock period. The pins must
+ * be configured as outputs. If the logic analyzer is running, the sample rate
+ * must be the same.
+ */
+int32_t dio_wave_start(dio_port* port, const uint32_t* bsrr_words,
+                       uint32_t num_samples, uint32_t rate_hz, bool circular)
+{
+    int32_t rc;
+
+    if (cfg == NULL || port == NULL || bsrr_words == NULL ||
+        num_samples == 0 || num_samples > 0xffff || rate_hz == 0)
         return MOD_ERR_ARG;
-    }
-    return dio_set(idx, value);
+    if (wave.busy)
+        return MOD_ERR_STATE;
+    rc = sample_clk_start(DIO_SAMPLE_USER_WAVE, rate_hz);
+    if (rc < 0)
+        return rc;
+
+    LL_AHB1_GRP1_EnableClock(LL_AHB1_GRP1_PERIPH_DMA2);
+    LL_DMA_DisableStream(DIO_WAVE_DMA, DIO_WAVE_DMA_STREAM);
+    while (LL_DMA_IsEnabledStream(DIO_WAVE_DMA, DIO_WAVE_DMA_STREAM))
+        ;
+    LL_DMA_ClearFlag_TC5(DIO_WAVE_DMA);
+    LL_DMA_ClearFlag_HT5(DIO_WAVE_DMA);
+    LL_DMA_ClearFlag_TE5(DIO_WAVE_DMA);
+    LL_DMA_ClearFlag_DME5(DIO_WAVE_DMA);
+    LL_DMA_ClearFlag_FE5(DIO_WAVE_DMA);
+    LL_DMA_SetChannelSelection(DIO_WAVE_DMA, DIO_WAVE_DMA_STREAM,
+                               DIO_WAVE_DMA_CHANNEL);
+    LL_DMA_SetDataTransferDirection(DIO_WAVE_DMA, DIO_WAVE_DMA_STREAM,
+                                    LL_DMA_DIRECTION_MEMORY_TO_PERIPH);
+    LL_DMA_SetMode(DIO_WAVE_DMA, DIO_WAVE_DMA_STREAM,
+                   circular ? LL_DMA_MODE_CIRCULAR : LL_DMA_MODE_NORMAL);
+    LL_DMA_SetPeriphIncMode(DIO_WAVE_DMA, DIO_WAVE_DMA_STREAM,
+                            LL_DMA_PERIPH_NOINCREMENT);
+    LL_DMA_SetMemoryIncMode(DIO_WAVE_DMA, DIO_WAVE_DMA_STREAM,
+                            LL_DMA_MEMORY_INCREMENT);
+    LL_DMA_SetPeriphSize(DIO_WAVE_DMA, DIO_WAVE_DMA_STREAM,
+                         LL_DMA_PDATAALIGN_WORD);
+    LL_DMA_SetMemorySize(DIO_WAVE_DMA, DIO_WAVE_DMA_STREAM,
+                         LL_DMA_MDATAALIGN_WORD);
+    LL_DMA_SetStreamPriorityLevel(DIO_WAVE_DMA, DIO_WAVE_DMA_STREAM,
+                                  LL_DMA_PRIORITY_VERYHIGH);
+    LL_DMA_SetPeriphAddress(DIO_WAVE_DMA, DIO_WAVE_DMA_STREAM,
+                            (uint32_t)&port->BSRR);
+    LL_DMA_SetMemoryAddress(DIO_WAVE_DMA, DIO_WAVE_DMA_STREAM,
+                            (uint32_t)bsrr_words);
+    LL_DMA_SetDataLength(DIO_WAVE_DMA, DIO_WAVE_DMA_STREAM, num_samples);
+    LL_DMA_EnableIT_TC(DIO_WAVE_DMA, DIO_WAVE_DMA_STREAM);
+    LL_DMA_EnableIT_TE(DIO_WAVE_DMA, DIO_WAVE_DMA_STREAM);
+    NVIC_SetPriority(DIO_WAVE_DMA_IRQ,
+                     NVIC_EncodePriority(NVIC_GetPriorityGrouping(), 0, 0));
+    NVIC_EnableIRQ(DIO_WAVE_DMA_IRQ);
+    LL_DMA_EnableStream(DIO_WAVE_DMA, DIO_WAVE_DMA_STREAM);
+
+    wave.port = port;
+    wave.num_samples = num_samples;
+    wave.rate_hz = rate_hz;
+    wave.circular = circular;
+    wave.loops = 0;
+    wave.busy = true;
+    LL_TIM_EnableDMAReq_UPDATE(DIO_SAMPLE_TMR);
+    return 0;
+}
+
+/*
+ * @brief Stop playing a waveform.
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * The outputs keep the values of the last sample played.
+ */
+int32_t dio_wave_stop(void)
+{
+    __disable_irq();
+    if (wave.busy)
+        wave_hw_stop();
+    __enable_irq();
+    return 0;
+}
+
+/*
+ * @brief Check if a waveform is playing.
+ *
+ * @return true if a waveform is playing.
+ */
+bool dio_wave_is_busy(void)
+{
+    return wave.busy;
+}
+
+/*
+ * @brief DMA interrupt handler for the waveform generator.
+ *
+ * This function overrides the default handler, which is a "weak" symbol.
+ */
+void DMA2_Stream5_IRQHandler(void)
+{
+    if (LL_DMA_IsActiveFlag_TE5(DIO_WAVE_DMA)) {
+        LL_DMA_ClearFlag_TE5(DIO_WAVE_DMA);
+        INC_SAT_U16(cnts_u16[CNT_WAVE_DMA_ERR]);
+        wave_hw_stop();
+    }
+    if (LL_DMA_IsActiveFlag_TC5(DIO_WAVE_DMA)) {
+        LL_DMA_ClearFlag_TC5(DIO_WAVE_DMA);
+        wave.loops++;
+        if (!wave.circular)
+            wave_hw_stop();
+    }
+}
+
+/*
+ * @brief Start a logic analyzer capture.
+ *
+ * @param[in] port The port to capture (all 16 pins).
+ * @param[in] rate_hz Sample rate.
+ * @param[in] num_samples Number of samples to capture.
+ * @param[in] trig_din_idx Input whose edge starts the capture, or -1 to start
+ *                         immediately. The input must have edge events, and
+ *                         must not be captured by the sample clock timer,
+ *                         which can't capture while it is the sample clock.
+ * @param[in] trig_value Input value after the trigger edge (0 or 1).
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * The capture ends after num_samples, when the runs buffer is full, or when
+ * stopped. If the waveform generator is running, the sample rate must be the
+ * same.
+ */
+int32_t dio_la_start(dio_port* port, uint32_t rate_hz, uint32_t num_samples,
+                     int32_t trig_din_idx, uint32_t trig_value)
+{
+    int32_t rc;
+
+    if (cfg == NULL || port == NULL || num_samples == 0 || rate_hz == 0 ||
+        trig_value > 1)
+        return MOD_ERR_ARG;
+    if (trig_din_idx >= 0 &&
+        ((uint32_t)trig_din_idx >= cfg->num_inputs ||
+         cfg->inputs[trig_din_idx].edge == DIO_EDGE_NONE ||
+         cfg->inputs[trig_din_idx].capture_tmr == DIO_SAMPLE_TMR))
+        return MOD_ERR_ARG;
+    if (la.state == LA_ARMED || la.state == LA_RUNNING)
+        return MOD_ERR_STATE;
+    rc = sample_clk_start(DIO_SAMPLE_USER_LA, rate_hz);
+    if (rc < 0)
+        return rc;
+
+    la.port = port;
+    la.rate_hz = rate_hz;
+    la.num_samples = num_samples;
+    la.trig_din_idx = trig_din_idx < 0 ? DIO_NO_INPUT : trig_din_idx;
+    la.trig_value = trig_value;
+    la.samples = 0;
+    la.num_runs = 0;
+    la.truncated = false;
+    la.overrun = false;
+
+    LL_AHB1_GRP1_EnableClock(LL_AHB1_GRP1_PERIPH_DMA2);
+    LL_DMA_DisableStream(DIO_LA_DMA, DIO_LA_DMA_STREAM);
+    while (LL_DMA_IsEnabledStream(DIO_LA_DMA, DIO_LA_DMA_STREAM))
+        ;
+    LL_DMA_ClearFlag_TC2(DIO_LA_DMA);
+    LL_DMA_ClearFlag_HT2(DIO_LA_DMA);
+    LL_DMA_ClearFlag_TE2(DIO_LA_DMA);
+    LL_DMA_ClearFlag_DME2(DIO_LA_DMA);
+    LL_DMA_ClearFlag_FE2(DIO_LA_DMA);
+    LL_DMA_SetChannelSelection(DIO_LA_DMA, DIO_LA_DMA_STREAM,
+                               DIO_LA_DMA_CHANNEL);
+    LL_DMA_SetDataTransferDirection(DIO_LA_DMA, DIO_LA_DMA_STREAM,
+                                    LL_DMA_DIRECTION_PERIPH_TO_MEMORY);
+    LL_DMA_SetMode(DIO_LA_DMA, DIO_LA_DMA_STREAM, LL_DMA_MODE_CIRCULAR);
+    LL_DMA_SetPeriphIncMode(DIO_LA_DMA, DIO_LA_DMA_STREAM,
+                            LL_DMA_PERIPH_NOINCREMENT);
+    LL_DMA_SetMemoryIncMode(DIO_LA_DMA, DIO_LA_DMA_STREAM,
+                            LL_DMA_MEMORY_INCREMENT);
+    LL_DMA_SetPeriphSize(DIO_LA_DMA, DIO_LA_DMA_STREAM,
+                         LL_DMA_PDATAALIGN_HALFWORD);
+    LL_DMA_SetMemorySize(DIO_LA_DMA, DIO_LA_DMA_STREAM,
+                         LL_DMA_MDATAALIGN_HALFWORD);
+    LL_DMA_SetStreamPriorityLevel(DIO_LA_DMA, DIO_LA_DMA_STREAM,
+                                  LL_DMA_PRIORITY_VERYHIGH);
+    LL_DMA_SetPeriphAddress(DIO_LA_DMA, DIO_LA_DMA_STREAM,
+                            (uint32_t)&port->IDR);
+    LL_DMA_SetMemoryAddress(DIO_LA_DMA, DIO_LA_DMA_STREAM,
+                            (uint32_t)la_dma_bfr);
+    LL_DMA_SetDataLength(DIO_LA_DMA, DIO_LA_DMA_STREAM,
+                         ARRAY_SIZE(la_dma_bfr));
+    LL_DMA_EnableIT_HT(DIO_LA_DMA, DIO_LA_DMA_STREAM);
+    LL_DMA_EnableIT_TC(DIO_LA_DMA, DIO_LA_DMA_STREAM);
+    LL_DMA_EnableIT_TE(DIO_LA_DMA, DIO_LA_DMA_STREAM);
+    NVIC_SetPriority(DIO_LA_DMA_IRQ,
+                     NVIC_EncodePriority(NVIC_GetPriorityGrouping(), 0, 0));
+    NVIC_EnableIRQ(DIO_LA_DMA_IRQ);
+    LL_DMA_EnableStream(DIO_LA_DMA, DIO_LA_DMA_STREAM);
+
+    // Compare channel 2 (frozen, no pin output) matches once per sample
+    // period. Its DMA request is enabled by the trigger.
+    LL_TIM_OC_SetMode(DIO_SAMPLE_TMR, LL_TIM_CHANNEL_CH2, LL_TIM_OCMODE_FROZEN);
+    DIO_SAMPLE_TMR->CCR2 = 0;
+
+    __disable_irq();
+    if (la.trig_din_idx == DIO_NO_INPUT) {
+        la.state = LA_RUNNING;
+        LL_TIM_EnableDMAReq_CC2(DIO_SAMPLE_TMR);
+    } else {
+        la.state = LA_ARMED;
+    }
+    __enable_irq();
+    return 0;
+}
+
+/*
+ * @brief Stop a logic analyzer capture.
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * The samples captured so far are kept.
+ */
+int32_t dio_la_stop(void)
+{
+    __disable_irq();
+    if (la.state == LA_ARMED || la.state == LA_RUNNING)
+        la_hw_stop();
+    __enable_irq();
+    return 0;
+}
+
+/*
+ * @brief DMA interrupt handler for the logic analyzer.
+ *
+ * This function overrides the default handler, which is a "weak" symbol.
+ *
+ * If both halves are complete on entry, the encoding fell behind the DMA, and
+ * the capture is stopped.
+ */
+void DMA2_Stream2_IRQHandler(void)
+{
+    bool ht = LL_DMA_IsActiveFlag_HT2(DIO_LA_DMA);
+    bool tc = LL_DMA_IsActiveFlag_TC2(DIO_LA_DMA);
+
+    if (LL_DMA_IsActiveFlag_TE2(DIO_LA_DMA)) {
+        LL_DMA_ClearFlag_TE2(DIO_LA_DMA);
+        INC_SAT_U16(cnts_u16[CNT_LA_DMA_ERR]);
+        la_hw_stop();
+        return;
+    }
+    if (ht && tc) {
+        LL_DMA_ClearFlag_HT2(DIO_LA_DMA);
+        LL_DMA_ClearFlag_TC2(DIO_LA_DMA);
+        la.overrun = true;
+        la_hw_stop();
+        return;
+    }
+    if (ht) {
+        LL_DMA_ClearFlag_HT2(DIO_LA_DMA);
+        la_encode(&la_dma_bfr[0], DIO_LA_HALF_LEN);
+    }
+    if (tc) {
+        LL_DMA_ClearFlag_TC2(DIO_LA_DMA);
+        la_encode(&la_dma_bfr[DIO_LA_HALF_LEN], DIO_LA_HALF_LEN);
+    }
+}
+
+/*
+ * @brief Get values of a group of discrete inputs.
+ *
+ * @param[in] din_mask Mask of input indexes (bit N for index N).
+ * @param[out] values Input values, in the same bit positions. Bits not in
+ *                    din_mask are 0.
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * Each port is read once, so the values are a snapshot per port.
+ */
+int32_t dio_get_mask(uint32_t din_mask, uint32_t* values)
+{
+    uint32_t idr[DIO_MAX_PORTS];
+    uint32_t port_idx;
+    uint32_t bits;
+    uint32_t idx;
+    uint32_t result = 0;
+
+    if (cfg == NULL || values == NULL || (din_mask & ~in_valid_mask) != 0)
+        return MOD_ERR_ARG;
+
+    for (port_idx = 0; port_idx < num_ports; port_idx++)
+        idr[port_idx] = LL_GPIO_ReadInputPort(ports[port_idx]);
+
+    // Loop over the set bits of the mask.
+    for (bits = din_mask; bits != 0; bits &= bits - 1) {
+        idx = __builtin_ctz(bits);
+        if (idr[in_port_idx[idx]] & cfg->inputs[idx].pin)
+            result |= 1UL << idx;
+    }
+    *values = result ^ (in_invert_mask & din_mask);
+    return 0;
+}
+
+/*
+ * @brief Set values of a group of discrete outputs.
+ *
+ * @param[in] dout_mask Mask of output indexes (bit N for index N).
+ * @param[in] values Output values, in the same bit positions. Bits not in
+ *                   dout_mask are ignored.
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * Each port is written once, using the BSRR register, so the outputs on a
+ * port change at the same time.
+ */
+int32_t dio_set_mask(uint32_t dout_mask, uint32_t values)
+{
+    uint32_t bsrr[DIO_MAX_PORTS] = {0};
+    uint32_t port_idx;
+    uint32_t bits;
+    uint32_t idx;
+    uint32_t pin;
+
+    if (cfg == NULL || (dout_mask & ~out_valid_mask) != 0)
+        return MOD_ERR_ARG;
+
+    // BSRR bits 0-15 set pins, and bits 16-31 reset pins.
+    values ^= out_invert_mask;
+    for (bits = dout_mask; bits != 0; bits &= bits - 1) {
+        idx = __builtin_ctz(bits);
+        pin = cfg->outputs[idx].pin;
+        bsrr[out_port_idx[idx]] |= (values >> idx) & 1 ? pin : pin << 16;
+    }
+    for (port_idx = 0; port_idx < num_ports; port_idx++) {
+        if (bsrr[port_idx] != 0)
+            WRITE_REG(ports[port_idx]->BSRR, bsrr[port_idx]);
+    }
+    return 0;
+}
+
+/*
+ * @brief Toggle a group of discrete outputs.
+ *
+ * @param[in] dout_mask Mask of output indexes (bit N for index N).
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * Each port is read once (ODR) and written once (BSRR), so the outputs on a
+ * port change at the same time. Other outputs on the port are not written,
+ * so they are not affected even if an interrupt handler changes them between
+ * the read and the write.
+ */
+int32_t dio_toggle(uint32_t dout_mask)
+{
+    uint32_t bsrr[DIO_MAX_PORTS] = {0};
+    uint32_t odr[DIO_MAX_PORTS];
+    uint32_t port_idx;
+    uint32_t bits;
+    uint32_t idx;
+    uint32_t pin;
+
+    if (cfg == NULL || (dout_mask & ~out_valid_mask) != 0)
+        return MOD_ERR_ARG;
+
+    for (port_idx = 0; port_idx < num_ports; port_idx++)
+        odr[port_idx] = LL_GPIO_ReadOutputPort(ports[port_idx]);
+    for (bits = dout_mask; bits != 0; bits &= bits - 1) {
+        idx = __builtin_ctz(bits);
+        pin = cfg->outputs[idx].pin;
+        port_idx = out_port_idx[idx];
+        bsrr[port_idx] |= odr[port_idx] & pin ? pin << 16 : pin;
+    }
+    for (port_idx = 0; port_idx < num_ports; port_idx++) {
+        if (bsrr[port_idx] != 0)
+            WRITE_REG(ports[port_idx]->BSRR, bsrr[port_idx]);
+    }
+    return 0;
+}
+
+/*
+ * @brief Get debounced value of a discrete input.
+ *
+ * @param[in] din_idx Discrete input index per module configuration.
+ *
+ * @return Input value (0 or 1), else a "MOD_ERR" value. See code for details.
+ *
+ * For an input that is not debounced, this is the same as dio_get().
+ */
+int32_t dio_get_stable(uint32_t din_idx)
+{
+    const struct dio_in_info* dii;
+    int32_t port_idx;
+
+    if (cfg == NULL || din_idx >= cfg->num_inputs)
+        return MOD_ERR_ARG;
+    dii = &cfg->inputs[din_idx];
+    if (dii->debounce == DIO_DEBOUNCE_NONE || cfg->debounce_ms == 0)
+        return dio_get(din_idx);
+    port_idx = get_port_idx(dii->port);
+    if (port_idx < 0)
+        return port_idx;
+    return ((debounce_ports[port_idx].stable & dii->pin) != 0) ^ dii->invert;
+}
+
+/*
+ * @brief Get the next edge event from the queue.
+ *
+ * @param[out] edge The edge event.
+ *
+ * @return true if an edge event was returned, false if the queue is empty.
+ *
+ * @note Don't use this function if dio_run() is called, as it also takes
+ *       events from the queue.
+ */
+bool dio_get_edge(struct dio_edge* edge)
+{
+    if (edge_get_idx == edge_put_idx)
+        return false;
+    *edge = edge_queue[edge_get_idx % DIO_EDGE_QUEUE_LEN];
+    edge_get_idx++;
+    return true;
+}
+
+/*
+ * @brief Set the edge callback for an input, called from dio_run().
+ *
+ * @param[in] din_idx Discrete input index per module configuration.
+ * @param[in] cb The callback function (NULL for none).
+ * @param[in] user_data User data passed to the callback.
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ */
+int32_t dio_set_edge_cb(uint32_t din_idx, dio_edge_cb cb, uint32_t user_data)
+{
+    struct edge_line_info* eli;
+
+    if (cfg == NULL || din_idx >= cfg->num_inputs ||
+        cfg->inputs[din_idx].edge == DIO_EDGE_NONE)
+        return MOD_ERR_ARG;
+    eli = &edge_lines[__builtin_ctz(cfg->inputs[din_idx].pin)];
+    eli->cb = cb;
+    eli->cb_user_data = user_data;
+    return 0;
+}
+
+/*
+ * @brief Set the edge callback for an input, called from the interrupt
+ *        handler.
+ *
+ * @param[in] din_idx Discrete input index per module configuration.
+ * @param[in] cb The callback function (NULL for none).
+ * @param[in] user_data User data passed to the callback.
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * The callback must be short, as it runs in the interrupt handler. The edge
+ * event is also queued as usual.
+ */
+int32_t dio_set_edge_isr_cb(uint32_t din_idx, dio_edge_cb cb,
+                            uint32_t user_data)
+{
+    struct edge_line_info* eli;
+
+    if (cfg == NULL || din_idx >= cfg->num_inputs ||
+        cfg->inputs[din_idx].edge == DIO_EDGE_NONE)
+        return MOD_ERR_ARG;
+    eli = &edge_lines[__builtin_ctz(cfg->inputs[din_idx].pin)];
+    __disable_irq();
+    eli->isr_cb = cb;
+    eli->isr_cb_user_data = user_data;
+    __enable_irq();
+    return 0;
+}
+
+/*
+ * @brief EXTI interrupt handlers.
+ *
+ * These functions override the default handlers, which are "weak" symbols.
+ */
+void EXTI0_IRQHandler(void)
+{
+    exti_isr(LL_EXTI_LINE_0);
+}
+
+void EXTI1_IRQHandler(void)
+{
+    exti_isr(LL_EXTI_LINE_1);
+}
+
+void EXTI2_IRQHandler(void)
+{
+    exti_isr(LL_EXTI_LINE_2);
+}
+
+void EXTI3_IRQHandler(void)
+{
+    exti_isr(LL_EXTI_LINE_3);
+}
+
+void EXTI4_IRQHandler(void)
+{
+    exti_isr(LL_EXTI_LINE_4);
+}
+
+void EXTI9_5_IRQHandler(void)
+{
+    exti_isr(LL_EXTI_LINE_5 | LL_EXTI_LINE_6 | LL_EXTI_LINE_7 |
+             LL_EXTI_LINE_8 | LL_EXTI_LINE_9);
+}
+
+void EXTI15_10_IRQHandler(void)
+{
+    exti_isr(LL_EXTI_LINE_10 | LL_EXTI_LINE_11 | LL_EXTI_LINE_12 |
+             LL_EXTI_LINE_13 | LL_EXTI_LINE_14 | LL_EXTI_LINE_15);
+}
+
+/*
+ * @brief Timer interrupt handlers, for edge capture.
+ *
+ * These functions override the default handlers, which are "weak" symbols.
+ */
+void TIM1_CC_IRQHandler(void)
+{
+    capture_isr(0);
+}
+
+void TIM4_IRQHandler(void)
+{
+    capture_isr(1);
+}
+
+void TIM5_IRQHandler(void)
+{
+    capture_isr(2);
+}
+
+/*
+ * @brief Get edge measurements for an input.
+ *
+ * @param[in] din_idx Discrete input index per module configuration.
+ * @param[out] meas The measurements.
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ */
+int32_t dio_get_edge_meas(uint32_t din_idx, struct dio_edge_meas* meas)
+{
+    struct edge_line_info* eli;
+
+    if (cfg == NULL || din_idx >= cfg->num_inputs || meas == NULL ||
+        cfg->inputs[din_idx].edge == DIO_EDGE_NONE)
+        return MOD_ERR_ARG;
+    eli = &edge_lines[__builtin_ctz(cfg->inputs[din_idx].pin)];
+
+    // Interrupts are disabled so the values are consistent.
+    __disable_irq();
+    meas->edges = eli->edges;
+    meas->period_cycles = eli->period_cycles;
+    meas->high_cycles = eli->high_cycles;
+    __enable_irq();
+    return 0;
+}
+
+/*
+ * @brief Start the frequency counter on an input.
+ *
+ * @param[in] din_idx Discrete input index per module configuration.
+ * @param[in] gate_ms Gate time, DIO_FREQ_MIN_GATE_MS to DIO_FREQ_MAX_GATE_MS.
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * The input must have edge events (reciprocal counting), or be on channel 1 or
+ * 2 of a capture timer that has no capture inputs (hardware counting). Only
+ * one input can be measured at a time. Measurements are made continuously,
+ * one per gate, until stopped.
+ */
+int32_t dio_freq_start(uint32_t din_idx, uint32_t gate_ms)
+{
+    const struct dio_in_info* dii;
+    const struct capture_tmr_info* cti = NULL;
+    uint32_t tmr_idx;
+    uint32_t idx;
+    int32_t tmr_id = -1;
+
+    if (cfg == NULL || din_idx >= cfg->num_inputs ||
+        gate_ms < DIO_FREQ_MIN_GATE_MS || gate_ms > DIO_FREQ_MAX_GATE_MS)
+        return MOD_ERR_ARG;
+    if (freq.din_idx != DIO_NO_INPUT)
+        return MOD_ERR_STATE;
+    dii = &cfg->inputs[din_idx];
+
+    if (dii->edge == DIO_EDGE_NONE) {
+        for (tmr_idx = 0; tmr_idx < ARRAY_SIZE(capture_tmrs); tmr_idx++) {
+            if (capture_tmrs[tmr_idx].tmr == dii->capture_tmr)
+                break;
+        }
+        if (tmr_idx >= ARRAY_SIZE(capture_tmrs) ||
+            (dii->capture_chan != 1 && dii->capture_chan != 2))
+            return MOD_ERR_ARG;
+        cti = &capture_tmrs[tmr_idx];
+        if ((capture_tmr_mask & (1 << tmr_idx)) != 0 ||
+            (cti->tmr == DIO_SAMPLE_TMR && sample_clk_users != 0))
+            return MOD_ERR_RESOURCE;
+        for (idx = 0; idx < cfg->num_outputs && idx < DIO_MAX_MASK_BITS;
+             idx++) {
+            if (cfg->outputs[idx].pwm_tmr == cti->tmr &&
+                pwm_period_ticks[idx] != 0)
+                return MOD_ERR_RESOURCE;
+        }
+        tmr_id = tmr_inst_get_cb(DIO_FREQ_POLL_MS, freq_tmr_cb, 0);
+        if (tmr_id < 0)
+            return MOD_ERR_RESOURCE;
+
+        if (cti->apb2)
+            LL_APB2_GRP1_EnableClock(cti->periph);
+        else
+            LL_APB1_GRP1_EnableClock(cti->periph);
+        if (dii->pin >= DIO_PIN_8)
+            LL_GPIO_SetAFPin_8_15(dii->port, dii->pin, dii->capture_af);
+        else
+            LL_GPIO_SetAFPin_0_7(dii->port, dii->pin, dii->capture_af);
+        LL_GPIO_SetPinMode(dii->port, dii->pin, LL_GPIO_MODE_ALTERNATE);
+
+        // The filtered input clocks the counter (external clock mode 1).
+        LL_TIM_DisableCounter(cti->tmr);
+        LL_TIM_SetPrescaler(cti->tmr, 0);
+        LL_TIM_SetAutoReload(cti->tmr, cti->cnt_mask);
+        LL_TIM_IC_SetActiveInput(cti->tmr,
+                                 capture_ll_chans[dii->capture_chan - 1],
+                                 LL_TIM_ACTIVEINPUT_DIRECTTI);
+        LL_TIM_IC_SetFilter(cti->tmr, capture_ll_chans[dii->capture_chan - 1],
+                            LL_TIM_IC_FILTER_FDIV1);
+        LL_TIM_IC_SetPolarity(cti->tmr, capture_ll_chans[dii->capture_chan - 1],
+                              LL_TIM_IC_POLARITY_RISING);
+        LL_TIM_SetTriggerInput(cti->tmr, dii->capture_chan == 1 ?
+                               LL_TIM_TS_TI1FP1 : LL_TIM_TS_TI2FP2);
+        LL_TIM_SetClockSource(cti->tmr, LL_TIM_CLOCKSOURCE_EXT_MODE1);
+        LL_TIM_GenerateEvent_UPDATE(cti->tmr);
+        LL_TIM_ClearFlag_UPDATE(cti->tmr);
+        LL_TIM_EnableCounter(cti->tmr);
+    }
+
+    __disable_irq();
+    memset(&freq, 0, sizeof(freq));
+    freq.gate_ms = gate_ms;
+    freq.gate_cycles = (uint64_t)SystemCoreClock * gate_ms / 1000;
+    freq.hw_cti = cti;
+    freq.tmr_id = tmr_id;
+    freq.din_idx = din_idx;
+    __enable_irq();
+    return 0;
+}
+
+/*
+ * @brief Stop the frequency counter.
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ */
+int32_t dio_freq_stop(void)
+{
+    const struct dio_in_info* dii;
+
+    if (freq.din_idx == DIO_NO_INPUT)
+        return 0;
+    dii = &cfg->inputs[freq.din_idx];
+    if (freq.hw_cti != NULL) {
+        tmr_inst_release(freq.tmr_id);
+        LL_TIM_DisableCounter(freq.hw_cti->tmr);
+        LL_TIM_SetClockSource(freq.hw_cti->tmr, LL_TIM_CLOCKSOURCE_INTERNAL);
+        LL_GPIO_SetPinMode(dii->port, dii->pin, LL_GPIO_MODE_INPUT);
+        freq.hw_cti = NULL;
+    }
+    freq.din_idx = DIO_NO_INPUT;
+    return 0;
+}
+
+/*
+ * @brief Get the frequency counter measurement.
+ *
+ * @param[out] meas The measurement for the last completed gate.
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ */
+int32_t dio_freq_get(struct dio_freq_meas* meas)
+{
+    if (meas == NULL)
+        return MOD_ERR_ARG;
+    if (freq.din_idx == DIO_NO_INPUT)
+        return MOD_ERR_STATE;
+
+    // Interrupts are disabled so the values are consistent.
+    __disable_irq();
+    *meas = freq.meas;
+    __enable_irq();
+    return 0;
+}
+
+/*
+ * @brief Get number of discrete inputs.
+ *
+ * @return Return number of inputs (non-negative) for success, else a "MOD_ERR"
+ *         value. See code for details.
+ */
+int32_t dio_get_num_in(void)
+{
+    return cfg == NULL ? MOD_ERR_RESOURCE : cfg->num_inputs;
+}
+
+/*
+ * @brief Get number of discrete output.
+ *
+ * @return Return number of outputs (non-negative) for success, else a "MOD_ERR"
+ *         value. See code for details.
+ */
+int32_t dio_get_num_out(void)
+{
+    return cfg == NULL ? MOD_ERR_RESOURCE : cfg->num_outputs;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Private (static) functions
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * @brief Console command function for "dio status".
+ *
+ * @param[in] argc Number of arguments, including "dio".
+ * @param[in] argv Argument values, including "dio".
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * Command usage: dio status
+ */
+static int32_t cmd_dio_status(int32_t argc, const char** argv)
+{
+    uint32_t idx;
+    
+    printf("Inputs:\n");
+    for (idx = 0; idx < cfg->num_inputs; idx++) {
+        printf("  %2lu: %s = %ld", idx, cfg->inputs[idx].name, dio_get(idx));
+        if (cfg->inputs[idx].edge != DIO_EDGE_NONE)
+            printf(" edges=%lu",
+                   edge_lines[__builtin_ctz(cfg->inputs[idx].pin)].edges);
+        if (cfg->inputs[idx].debounce != DIO_DEBOUNCE_NONE)
+            printf(" stable=%ld", dio_get_stable(idx));
+        printf("\n");
+    }
+    if (debounce_port_mask != 0)
+        printf("Debounce: period=%lu ms changes=%lu max_cycles=%lu\n",
+               cfg->debounce_ms, debounce_changes, debounce_max_cycles);
+
+    printf("Outputs:\n");
+    for (idx = 0; idx < cfg->num_outputs; idx++) {
+        printf("  %2lu: %s = %ld", idx, cfg->outputs[idx].name,
+               dio_get_out(idx));
+        print_pwm(idx);
+        printf("\n");
+    }
+
+    return 0;
+}
+
+/*
+ * @brief Console command function for "dio get".
+ *
+ * @param[in] argc Number of arguments, including "dio".
+ * @param[in] argv Argument values, including "dio".
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * Command usage: dio get <input-name>
+ */
+static int32_t cmd_dio_get(int32_t argc, const char** argv)
+{
+    uint32_t idx;
+    struct cmd_arg_val arg_vals[1];
+
+    if (cmd_parse_args(argc-2, argv+2, "s", arg_vals) != 1)
+        return MOD_ERR_BAD_CMD;
+
+    for (idx = 0; idx < cfg->num_inputs; idx++)
+        if (strcasecmp(arg_vals[0].val.s, cfg->inputs[idx].name) == 0)
+            break;
+    if (idx < cfg->num_inputs) {
+        printf("%s = %ld\n", cfg->inputs[idx].name, dio_get(idx));
+        return 0;
+    }
+
+    for (idx = 0; idx < cfg->num_outputs; idx++)
+        if (strcasecmp(arg_vals[0].val.s, cfg->outputs[idx].name) == 0)
+            break;
+    if (idx < cfg->num_outputs) {
+        printf("%s %ld\n", cfg->outputs[idx].name, dio_get_out(idx));
+        return 0;
+    }
+    printf("Invalid dio input/output name '%s'\n", arg_vals[0].val.s);
+    return MOD_ERR_ARG;
+}
+
+/*
+ * @brief Console command function for "dio set".
+ *
+ * @param[in] argc Number of arguments, including "dio".
+ * @param[in] argv Argument values, including "dio".
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * Command usage: dio set <output-name> {0|1}
+ */
+static int32_t cmd_dio_set(int32_t argc, const char** argv)
+{
+    uint32_t idx;
+    struct cmd_arg_val arg_vals[2];
+    uint32_t value;
+
+    if (cmd_parse_args(argc-2, argv+2, "su", arg_vals) != 2)
+        return MOD_ERR_BAD_CMD;
+
+    for (idx = 0; idx < cfg->num_outputs; idx++)
+        if (strcasecmp(arg_vals[0].val.s, cfg->outputs[idx].name) == 0)
+            break;
+    if (idx >= cfg->num_outputs) {
+        printf("Invalid dio name '%s'\n", arg_vals[0].val.s);
+        return MOD_ERR_ARG;
+    }
+
+    value = arg_vals[1].val.u;
+    if (value != 0 && value != 1) {
+        printf("Invalid value '%s'\n", argv[3]);
+        return MOD_ERR_ARG;
+    }
+    return dio_set(idx, value);
+}
+
+/*
+ * @brief Console command function for "dio getmask".
+ *
+ * @param[in] argc Number of arguments, including "dio".
+ * @param[in] argv Argument values, including "dio".
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * Command usage: dio getmask <input-mask>
+ */
+static int32_t cmd_dio_getmask(int32_t argc, const char** argv)
+{
+    struct cmd_arg_val arg_vals[1];
+    uint32_t values;
+    int32_t rc;
+
+    if (cmd_parse_args(argc-2, argv+2, "u", arg_vals) != 1)
+        return MOD_ERR_BAD_CMD;
+
+    rc = dio_get_mask(arg_vals[0].val.u, &values);
+    if (rc < 0) {
+        printf("Invalid input mask 0x%lx (valid 0x%lx)\n", arg_vals[0].val.u,
+               in_valid_mask);
+        return rc;
+    }
+    printf("0x%lx\n", values);
+    return 0;
+}
+
+/*
+ * @brief Console command function for "dio setmask".
+ *
+ * @param[in] argc Number of arguments, including "dio".
+ * @param[in] argv Argument values, including "dio".
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * Command usage: dio setmask <output-mask> <values>
+ */
+static int32_t cmd_dio_setmask(int32_t argc, const char** argv)
+{
+    struct cmd_arg_val arg_vals[2];
+    int32_t rc;
+
+    if (cmd_parse_args(argc-2, argv+2, "uu", arg_vals) != 2)
+        return MOD_ERR_BAD_CMD;
+
+    rc = dio_set_mask(arg_vals[0].val.u, arg_vals[1].val.u);
+    if (rc < 0)
+        printf("Invalid output mask 0x%lx (valid 0x%lx)\n", arg_vals[0].val.u,
+               out_valid_mask);
+    return rc;
+}
+
+/*
+ * @brief Console command function for "dio toggle".
+ *
+ * @param[in] argc Number of arguments, including "dio".
+ * @param[in] argv Argument values, including "dio".
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * Command usage: dio toggle <output-mask>
+ */
+static int32_t cmd_dio_toggle(int32_t argc, const char** argv)
+{
+    struct cmd_arg_val arg_vals[1];
+    int32_t rc;
+
+    if (cmd_parse_args(argc-2, argv+2, "u", arg_vals) != 1)
+        return MOD_ERR_BAD_CMD;
+
+    rc = dio_toggle(arg_vals[0].val.u);
+    if (rc < 0)
+        printf("Invalid output mask 0x%lx (valid 0x%lx)\n", arg_vals[0].val.u,
+               out_valid_mask);
+    return rc;
+}
+
+/*
+ * @brief Console command function for "dio edges".
+ *
+ * @param[in] argc Number of arguments, including "dio".
+ * @param[in] argv Argument values, including "dio".
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * Command usage: dio edges
+ */
+static int32_t cmd_dio_edges(int32_t argc, const char** argv)
+{
+    const struct dio_in_info* dii;
+    struct dio_edge_meas meas;
+    uint32_t idx;
+    uint32_t cycles_per_us = SystemCoreClock / 1000000;
+
+    printf("Input        Src      Edges Period-us   High-us Duty-%%\n"
+           "------------ ----- -------- --------- --------- ------\n");
+    for (idx = 0; idx < cfg->num_inputs; idx++) {
+        dii = &cfg->inputs[idx];
+        if (dio_get_edge_meas(idx, &meas) < 0)
+            continue;
+        printf("%-12s ", dii->name);
+        if (dii->capture_tmr != NULL)
+            printf("tmr%lu  ",
+                   dii->capture_tmr == DIO_TMR_1 ? 1UL :
+                   dii->capture_tmr == DIO_TMR_4 ? 4UL : 5UL);
+        else
+            printf("exti  ");
+        printf("%8lu %9lu %9lu ", meas.edges,
+               meas.period_cycles / cycles_per_us,
+               meas.high_cycles / cycles_per_us);
+        if (meas.period_cycles > 0 && meas.high_cycles <= meas.period_cycles)
+            printf("%4lu.%lu\n",
+                   (uint32_t)((uint64_t)meas.high_cycles * 1000 /
+                              meas.period_cycles) / 10,
+                   (uint32_t)((uint64_t)meas.high_cycles * 1000 /
+                              meas.period_cycles) % 10);
+        else
+            printf("     -\n");
+    }
+    return 0;
+}
+
+/*
+ * @brief Console command function for "dio bench".
+ *
+ * @param[in] argc Number of arguments, including "dio".
+ * @param[in] argv Argument values, including "dio".
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * Command usage: dio bench
+ *
+ * Input 0 and output 0 are used. The output is set to its current value, so
+ * it doesn't change. Each measurement includes the loop overhead, which is
+ * also measured so it can be compared.
+ */
+static int32_t cmd_dio_bench(int32_t argc, const char** argv)
+{
+    static const char* names[] = {
+        "loop only", "dio_get", "dio_get_fast", "dio_set", "dio_set_fast",
+    };
+    uint32_t cycles[ARRAY_SIZE(names)];
+    uint32_t start;
+    uint32_t idx;
+    uint32_t value;
+    volatile uint32_t sink = 0;
+
+    if (cfg->num_inputs == 0 || cfg->num_outputs == 0)
+        return MOD_ERR_STATE;
+    value = dio_get_out(0);
+
+    // Interrupts are disabled during the measurements (not the printing, as
+    // console output can wait for the UART interrupt).
+    __disable_irq();
+
+    start = tmr_get_cycles();
+    for (idx = 0; idx < DIO_BENCH_CALLS; idx++)
+        sink += idx;
+    cycles[0] = tmr_get_cycles() - start;
+
+    start = tmr_get_cycles();
+    for (idx = 0; idx < DIO_BENCH_CALLS; idx++)
+        sink += dio_get(0);
+    cycles[1] = tmr_get_cycles() - start;
+
+    start = tmr_get_cycles();
+    for (idx = 0; idx < DIO_BENCH_CALLS; idx++)
+        sink += dio_get_fast(0);
+    cycles[2] = tmr_get_cycles() - start;
+
+    start = tmr_get_cycles();
+    for (idx = 0; idx < DIO_BENCH_CALLS; idx++) {
+        dio_set(0, value);
+        sink += idx;
+    }
+    cycles[3] = tmr_get_cycles() - start;
+
+    start = tmr_get_cycles();
+    for (idx = 0; idx < DIO_BENCH_CALLS; idx++) {
+        dio_set_fast(0, value);
+        sink += idx;
+    }
+    cycles[4] = tmr_get_cycles() - start;
+
+    __enable_irq();
+
+    printf("Cycles per call (%d calls, including loop):\n", DIO_BENCH_CALLS);
+    for (idx = 0; idx < ARRAY_SIZE(names); idx++)
+        printf("  %-12s : %lu.%02lu\n", names[idx],
+               cycles[idx] / DIO_BENCH_CALLS,
+               (cycles[idx] % DIO_BENCH_CALLS) / (DIO_BENCH_CALLS / 100));
+    return 0;
+}
+
+/*
+ * @brief Console command function for "dio pwm".
+ *
+ * @param[in] argc Number of arguments, including "dio".
+ * @param[in] argv Argument values, including "dio".
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * Command usage: dio pwm [<output-name> <freq-hz> <duty>]
+ *
+ * Without arguments, the PWM state of the outputs is displayed.
+ */
+static int32_t cmd_dio_pwm(int32_t argc, const char** argv)
+{
+    uint32_t idx;
+    struct cmd_arg_val arg_vals[3];
+    int32_t rc;
+
+    if (argc == 2) {
+        for (idx = 0; idx < cfg->num_outputs; idx++) {
+            if (cfg->outputs[idx].pwm_tmr == NULL)
+                continue;
+            printf("%s:", cfg->outputs[idx].name);
+            print_pwm(idx);
+            printf("\n");
+        }
+        return 0;
+    }
+
+    if (cmd_parse_args(argc-2, argv+2, "suu", arg_vals) != 3)
+        return MOD_ERR_BAD_CMD;
+
+    for (idx = 0; idx < cfg->num_outputs; idx++)
+        if (strcasecmp(arg_vals[0].val.s, cfg->outputs[idx].name) == 0)
+            break;
+    if (idx >= cfg->num_outputs) {
+        printf("Invalid dio name '%s'\n", arg_vals[0].val.s);
+        return MOD_ERR_ARG;
+    }
+
+    rc = dio_set_pwm(idx, arg_vals[1].val.u, arg_vals[2].val.u);
+    if (rc < 0) {
+        printf("PWM error %ld\n", rc);
+        return rc;
+    }
+    printf("%s:", cfg->outputs[idx].name);
+    print_pwm(idx);
+    printf("\n");
+    return 0;
+}
+
+/*
+ * @brief Enable edge events for an input.
+ *
+ * @param[in] din_idx Discrete input index per module configuration.
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * Edges are detected using EXTI interrupts, or timer capture if configured.
+ */
+static int32_t edge_start(uint32_t din_idx)
+{
+    const struct dio_in_info* dii = &cfg->inputs[din_idx];
+    uint32_t line = __builtin_ctz(dii->pin);
+    uint32_t exti_port;
+    IRQn_Type irq_type;
+
+    if (edge_lines[line].din_idx != DIO_NO_INPUT) {
+        log_error("dio: EXTI line %lu already used by %s\n", line,
+                  cfg->inputs[edge_lines[line].din_idx].name);
+        return MOD_ERR_RESOURCE;
+    }
+    if (dii->capture_tmr != NULL)
+        return capture_start(din_idx);
+
+    if (dii->port == DIO_PORT_A)
+        exti_port = LL_SYSCFG_EXTI_PORTA;
+    else if (dii->port == DIO_PORT_B)
+        exti_port = LL_SYSCFG_EXTI_PORTB;
+    else if (dii->port == DIO_PORT_C)
+        exti_port = LL_SYSCFG_EXTI_PORTC;
+    else if (dii->port == DIO_PORT_D)
+        exti_port = LL_SYSCFG_EXTI_PORTD;
+    else if (dii->port == DIO_PORT_E)
+        exti_port = LL_SYSCFG_EXTI_PORTE;
+    else if (dii->port == DIO_PORT_H)
+        exti_port = LL_SYSCFG_EXTI_PORTH;
+    else
+        return MOD_ERR_ARG;
+
+    if (line <= 4)
+        irq_type = EXTI0_IRQn + line;
+    else if (line <= 9)
+        irq_type = EXTI9_5_IRQn;
+    else
+        irq_type = EXTI15_10_IRQn;
+
+    edge_lines[line].din_idx = din_idx;
+    LL_APB2_GRP1_EnableClock(LL_APB2_GRP1_PERIPH_SYSCFG);
+    LL_SYSCFG_SetEXTISource(exti_port, syscfg_exti_lines[line]);
+    if (dii->edge & DIO_EDGE_RISING)
+        LL_EXTI_EnableRisingTrig_0_31(dii->pin);
+    if (dii->edge & DIO_EDGE_FALLING)
+        LL_EXTI_EnableFallingTrig_0_31(dii->pin);
+    LL_EXTI_ClearFlag_0_31(dii->pin);
+    LL_EXTI_EnableIT_0_31(dii->pin);
+
+    // All EXTI interrupts must have the same priority, as the edge queue
+    // relies on them not preempting each other.
+    NVIC_SetPriority(irq_type,
+                     NVIC_EncodePriority(NVIC_GetPriorityGrouping(), 0, 0));
+    NVIC_EnableIRQ(irq_type);
+    return 0;
+}
+
+/*
+ * @brief Enable timer capture of edges for an input.
+ *
+ * @param[in] din_idx Discrete input index per module configuration.
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * The timer is started on first use, free running at the core clock. Several
+ * inputs can use the same timer, on different channels.
+ */
+static int32_t capture_start(uint32_t din_idx)
+{
+    const struct dio_in_info* dii = &cfg->inputs[din_idx];
+    const struct capture_tmr_info* cti;
+    uint32_t tmr_idx;
+    uint32_t chan;
+    uint32_t polarity;
+
+    for (tmr_idx = 0; tmr_idx < ARRAY_SIZE(capture_tmrs); tmr_idx++) {
+        if (capture_tmrs[tmr_idx].tmr == dii->capture_tmr)
+            break;
+    }
+    if (tmr_idx >= ARRAY_SIZE(capture_tmrs) || dii->capture_chan < 1 ||
+        dii->capture_chan > DIO_TMR_NUM_CHANS) {
+        log_error("dio: bad capture timer for %s\n", dii->name);
+        return MOD_ERR_ARG;
+    }
+    cti = &capture_tmrs[tmr_idx];
+    chan = dii->capture_chan - 1;
+    if (capture_din_idx[tmr_idx][chan] != DIO_NO_INPUT) {
+        log_error("dio: capture channel already used by %s\n",
+                  cfg->inputs[capture_din_idx[tmr_idx][chan]].name);
+        return MOD_ERR_RESOURCE;
+    }
+
+    if (dii->edge == DIO_EDGE_RISING)
+        polarity = LL_TIM_IC_POLARITY_RISING;
+    else if (dii->edge == DIO_EDGE_FALLING)
+        polarity = LL_TIM_IC_POLARITY_FALLING;
+    else
+        polarity = LL_TIM_IC_POLARITY_BOTHEDGE;
+
+    edge_lines[__builtin_ctz(dii->pin)].din_idx = din_idx;
+    capture_din_idx[tmr_idx][chan] = din_idx;
+
+    if (dii->pin >= DIO_PIN_8)
+        LL_GPIO_SetAFPin_8_15(dii->port, dii->pin, dii->capture_af);
+    else
+        LL_GPIO_SetAFPin_0_7(dii->port, dii->pin, dii->capture_af);
+    LL_GPIO_SetPinMode(dii->port, dii->pin, LL_GPIO_MODE_ALTERNATE);
+
+    if ((capture_tmr_mask & (1 << tmr_idx)) == 0) {
+        if (cti->apb2)
+            LL_APB2_GRP1_EnableClock(cti->periph);
+        else
+            LL_APB1_GRP1_EnableClock(cti->periph);
+        LL_TIM_SetPrescaler(cti->tmr, 0);
+        LL_TIM_SetAutoReload(cti->tmr, cti->cnt_mask);
+        LL_TIM_GenerateEvent_UPDATE(cti->tmr);
+        cti->tmr->SR = 0;
+        LL_TIM_EnableCounter(cti->tmr);
+
+        // Same priority as the EXTI interrupts, see edge_start().
+        NVIC_SetPriority(cti->irq_type,
+                         NVIC_EncodePriority(NVIC_GetPriorityGrouping(), 0, 0));
+        NVIC_EnableIRQ(cti->irq_type);
+        capture_tmr_mask |= 1 << tmr_idx;
+    }
+
+    LL_TIM_IC_SetActiveInput(cti->tmr, capture_ll_chans[chan],
+                             LL_TIM_ACTIVEINPUT_DIRECTTI);
+    LL_TIM_IC_SetPrescaler(cti->tmr, capture_ll_chans[chan],
+                           LL_TIM_ICPSC_DIV1);
+    LL_TIM_IC_SetFilter(cti->tmr, capture_ll_chans[chan],
+                        LL_TIM_IC_FILTER_FDIV1);
+    LL_TIM_IC_SetPolarity(cti->tmr, capture_ll_chans[chan], polarity);
+    cti->tmr->SR = ~((TIM_SR_CC1IF | TIM_SR_CC1OF) << chan);
+    cti->tmr->DIER |= TIM_DIER_CC1IE << chan;
+    LL_TIM_CC_EnableChannel(cti->tmr, capture_ll_chans[chan]);
+    return 0;
+}
+
+/*
+ * @brief Handle EXTI interrupts.
+ *
+ * @param[in] line_mask The EXTI lines handled by the interrupt.
+ */
+static void exti_isr(uint32_t line_mask)
+{
+    // Capture the cycle count first, to minimize jitter.
+    uint32_t cycles = tmr_get_cycles();
+    uint32_t pending;
+    struct edge_line_info* eli;
+
+    pending = LL_EXTI_ReadFlag_0_31(line_mask);
+    LL_EXTI_ClearFlag_0_31(pending);
+    for (; pending != 0; pending &= pending - 1) {
+        eli = &edge_lines[__builtin_ctz(pending)];
+        if (eli->din_idx != DIO_NO_INPUT)
+            edge_put(eli, cycles);
+    }
+}
+
+/*
+ * @brief Handle timer capture interrupts.
+ *
+ * @param[in] tmr_idx Index in capture_tmrs.
+ *
+ * The counter and cycle counter are read back to back, so the small fixed
+ * offset between them is the same for every edge.
+ */
+static void capture_isr(uint32_t tmr_idx)
+{
+    const struct capture_tmr_info* cti = &capture_tmrs[tmr_idx];
+    uint32_t cnt = LL_TIM_GetCounter(cti->tmr);
+    uint32_t cycles = tmr_get_cycles();
+    uint32_t sr = cti->tmr->SR;
+    uint32_t chan;
+    uint32_t ccr;
+    uint32_t din_idx;
+
+    if (capture_suspend_mask & (1 << tmr_idx)) {
+        // The timer is not free running, so the captures can't be converted.
+        cti->tmr->SR = ~sr;
+        return;
+    }
+    for (chan = 0; chan < DIO_TMR_NUM_CHANS; chan++) {
+        if ((sr & (TIM_SR_CC1IF << chan)) == 0)
+            continue;
+        ccr = (&cti->tmr->CCR1)[chan]; // Clears the CCxIF flag.
+        if (sr & (TIM_SR_CC1OF << chan)) {
+            cti->tmr->SR = ~(TIM_SR_CC1OF << chan);
+            INC_SAT_U16(cnts_u16[CNT_CAPTURE_OVERRUN]);
+        }
+        din_idx = capture_din_idx[tmr_idx][chan];
+        if (din_idx != DIO_NO_INPUT)
+            edge_put(&edge_lines[__builtin_ctz(cfg->inputs[din_idx].pin)],
+                     cycles - ((cnt - ccr) & cti->cnt_mask));
+    }
+}
+
+/*
+ * @brief Record an edge, from an interrupt handler.
+ *
+ * @param[in] eli The edge line info for the input.
+ * @param[in] cycles Cycle counter at the edge.
+ *
+ * For an input with edge events on only one edge, the value after the edge is
+ * known. Otherwise the pin is read, which gives the wrong value if the pulse
+ * has already ended.
+ */
+static void edge_put(struct edge_line_info* eli, uint32_t cycles)
+{
+    const struct dio_in_info* dii = &cfg->inputs[eli->din_idx];
+    struct dio_edge* edge;
+    struct dio_edge edge_val;
+
+    eli->edges++;
+    edge_val.din_idx = eli->din_idx;
+    edge_val.cycles = cycles;
+    if (dii->edge == DIO_EDGE_RISING)
+        edge_val.value = 1 ^ dii->invert;
+    else if (dii->edge == DIO_EDGE_FALLING)
+        edge_val.value = 0 ^ dii->invert;
+    else
+        edge_val.value = LL_GPIO_IsInputPinSet(dii->port, dii->pin) ^
+            dii->invert;
+
+    if (edge_val.value) {
+        if (eli->rise_valid)
+            eli->period_cycles = cycles - eli->rise_cycles;
+        eli->rise_cycles = cycles;
+        eli->rise_valid = true;
+    } else if (eli->rise_valid) {
+        eli->high_cycles = cycles - eli->rise_cycles;
+    }
+
+    if (eli->isr_cb != NULL)
+        eli->isr_cb(&edge_val, eli->isr_cb_user_data);
+
+    if (freq.din_idx == eli->din_idx && freq.hw_cti == NULL &&
+        edge_val.value)
+        freq_edge(cycles);
+
+    if (la.state == LA_ARMED && la.trig_din_idx == eli->din_idx &&
+        la.trig_value == edge_val.value) {
+        la.state = LA_RUNNING;
+        LL_TIM_EnableDMAReq_CC2(DIO_SAMPLE_TMR);
+    }
+
+    if (edge_put_idx - edge_get_idx >= DIO_EDGE_QUEUE_LEN) {
+        INC_SAT_U16(cnts_u16[CNT_EDGE_QUEUE_FULL]);
+    } else {
+        edge = &edge_queue[edge_put_idx % DIO_EDGE_QUEUE_LEN];
+        *edge = edge_val;
+        edge_put_idx++;
+    }
+}
+
+/*
+ * @brief Add an input to the debounce state.
+ *
+ * @param[in] din_idx Discrete input index per module configuration.
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ */
+static int32_t debounce_add(uint32_t din_idx)
+{
+    const struct dio_in_info* dii = &cfg->inputs[din_idx];
+    struct debounce_port* dp;
+    int32_t port_idx;
+    uint32_t pin_num = __builtin_ctz(dii->pin);
+    uint32_t plane;
+
+    if (dii->debounce_samples < 1 ||
+        dii->debounce_samples > DIO_DEBOUNCE_MAX_SAMPLES) {
+        log_error("dio: bad debounce samples for %s\n", dii->name);
+        return MOD_ERR_ARG;
+    }
+    port_idx = get_port_idx(dii->port);
+    if (port_idx < 0)
+        return port_idx;
+    dp = &debounce_ports[port_idx];
+    if ((dp->shift_mask | dp->integ_mask) & dii->pin) {
+        log_error("dio: %s already debounced\n", dii->name);
+        return MOD_ERR_RESOURCE;
+    }
+
+    if (dii->debounce == DIO_DEBOUNCE_SHIFT) {
+        dp->shift_mask |= dii->pin;
+        dp->win_mask[dii->debounce_samples - 1] |= dii->pin;
+    } else if (dii->debounce == DIO_DEBOUNCE_INTEG) {
+        dp->integ_mask |= dii->pin;
+        for (plane = 0; plane < DIO_DEBOUNCE_CNT_BITS; plane++) {
+            if (dii->debounce_samples & (1 << plane))
+                dp->limit[plane] |= dii->pin;
+        }
+    } else {
+        return MOD_ERR_ARG;
+    }
+    dp->din_idx[pin_num] = din_idx;
+    debounce_port_mask |= 1UL << port_idx;
+    return 0;
+}
+
+/*
+ * @brief Initialize the debounce filters to the current input values.
+ */
+static void debounce_start(void)
+{
+    struct debounce_port* dp;
+    uint32_t bits;
+    uint32_t idx;
+    uint16_t raw;
+
+    for (bits = debounce_port_mask; bits != 0; bits &= bits - 1) {
+        dp = &debounce_ports[__builtin_ctz(bits)];
+        raw = LL_GPIO_ReadInputPort(ports[__builtin_ctz(bits)]);
+        dp->stable = raw;
+        for (idx = 0; idx < DIO_DEBOUNCE_MAX_SAMPLES; idx++)
+            dp->hist[idx] = raw;
+        for (idx = 0; idx < DIO_DEBOUNCE_CNT_BITS; idx++)
+            dp->cnt[idx] = dp->limit[idx] & raw;
+    }
+}
+
+/*
+ * @brief Debounce timer callback, which samples and filters the inputs.
+ *
+ * @param[in] tmr_id Timer ID.
+ * @param[in] user_data User callback data.
+ *
+ * @return TMR_CB_RESTART, to sample periodically.
+ */
+static enum tmr_cb_action debounce_tmr_cb(int32_t tmr_id, uint32_t user_data)
+{
+    uint32_t start_cycles = tmr_get_cycles();
+    struct debounce_port* dp;
+    struct evt evt;
+    uint32_t bits;
+    uint32_t idx;
+    uint32_t pin_num;
+    uint16_t raw;
+    uint16_t old;
+    uint16_t all_1s;
+    uint16_t any_1s;
+    uint16_t rise;
+    uint16_t fall;
+    uint16_t at_limit;
+    uint16_t at_zero;
+    uint16_t carry;
+    uint16_t borrow;
+    uint16_t val;
+    uint16_t changed;
+
+    for (bits = debounce_port_mask; bits != 0; bits &= bits - 1) {
+        dp = &debounce_ports[__builtin_ctz(bits)];
+        raw = LL_GPIO_ReadInputPort(ports[__builtin_ctz(bits)]);
+        old = dp->stable;
+
+        // Shift register filter: a pin with window N rises if the newest N
+        // samples are all 1s, and falls if they are all 0s.
+        for (idx = DIO_DEBOUNCE_MAX_SAMPLES - 1; idx > 0; idx--)
+            dp->hist[idx] = dp->hist[idx - 1];
+        dp->hist[0] = raw;
+        all_1s = 0xffff;
+        any_1s = 0;
+        rise = 0;
+        fall = 0;
+        for (idx = 0; idx < DIO_DEBOUNCE_MAX_SAMPLES; idx++) {
+            all_1s &= dp->hist[idx];
+            any_1s |= dp->hist[idx];
+            rise |= all_1s & dp->win_mask[idx];
+            fall |= ~any_1s & dp->win_mask[idx];
+        }
+
+        // Integrator filter: count up for 1s (until the limit), and down for
+        // 0s (until zero), using ripple carry/borrow over the bit planes. The
+        // pins counting up and down are disjoint, so the two are independent.
+        at_limit = 0xffff;
+        at_zero = 0xffff;
+        for (idx = 0; idx < DIO_DEBOUNCE_CNT_BITS; idx++) {
+            at_limit &= ~(dp->cnt[idx] ^ dp->limit[idx]);
+            at_zero &= ~dp->cnt[idx];
+        }
+        carry = raw & ~at_limit & dp->integ_mask;
+        borrow = ~raw & ~at_zero & dp->integ_mask;
+        at_limit = 0xffff;
+        at_zero = 0xffff;
+        for (idx = 0; idx < DIO_DEBOUNCE_CNT_BITS; idx++) {
+            val = dp->cnt[idx] ^ carry ^ borrow;
+            carry &= dp->cnt[idx];
+            borrow &= ~dp->cnt[idx];
+            dp->cnt[idx] = val;
+            at_limit &= ~(val ^ dp->limit[idx]);
+            at_zero &= ~val;
+        }
+        rise |= at_limit & dp->integ_mask;
+        fall |= at_zero & dp->integ_mask;
+
+        dp->stable = (old | rise) & ~fall;
+        changed = dp->stable ^ old;
+        for (; changed != 0; changed &= changed - 1) {
+            pin_num = __builtin_ctz(changed);
+            idx = dp->din_idx[pin_num];
+            debounce_changes++;
+            evt.topic = EVT_TOPIC_DIO_BUTTON;
+            evt.data.dio_edge.din_idx = idx;
+            evt.data.dio_edge.value = ((dp->stable >> pin_num) & 1) ^
+                cfg->inputs[idx].invert;
+            evt.data.dio_edge.cycles = start_cycles;
+            evt_publish(&evt);
+        }
+    }
+    start_cycles = tmr_get_cycles() - start_cycles;
+    if (start_cycles > debounce_max_cycles)
+        debounce_max_cycles = start_cycles;
+    return TMR_CB_RESTART;
+}
+
+/*
+ * @brief Console command function for "dio wave".
+ *
+ * @param[in] argc Number of arguments, including "dio".
+ * @param[in] argv Argument values, including "dio".
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * Command usage: dio wave [clear | add <output-mask> <values> [count] |
+ *                          start <rate-hz> [loop] | stop]
+ *
+ * The waveform is built in a buffer, one sample per "add" (repeated count
+ * times). All outputs in the waveform must be on the same port. Without
+ * arguments, the waveform generator state is displayed.
+ */
+static int32_t cmd_dio_wave(int32_t argc, const char** argv)
+{
+    struct cmd_arg_val arg_vals[3];
+    int32_t num_args;
+    uint32_t count;
+    uint32_t bsrr;
+    dio_port* port;
+    int32_t rc;
+
+    if (argc == 2) {
+        printf("State: %s samples=%lu loops=%lu\n",
+               wave.busy ? (wave.circular ? "loop" : "once") : "idle",
+               wave_bfr_len, wave.loops);
+        if (wave.rate_hz > 0)
+            printf("Last start: rate=%lu Hz samples=%lu\n", wave.rate_hz,
+                   wave.num_samples);
+        return 0;
+    }
+
+    if (strcasecmp(argv[2], "clear") == 0) {
+        if (wave.busy && wave.port == wave_bfr_port)
+            return MOD_ERR_STATE;
+        wave_bfr_len = 0;
+    } else if (strcasecmp(argv[2], "add") == 0) {
+        num_args = cmd_parse_args(argc-3, argv+3, "uu[u]", arg_vals);
+        if (num_args < 2)
+            return MOD_ERR_BAD_CMD;
+        count = num_args == 3 ? arg_vals[2].val.u : 1;
+        rc = dio_mask_to_bsrr(arg_vals[0].val.u, arg_vals[1].val.u, &port,
+                              &bsrr);
+        if (rc < 0) {
+            printf("Invalid output mask\n");
+            return rc;
+        }
+        if (wave_bfr_len > 0 && port != wave_bfr_port) {
+            printf("Outputs must be on the same port\n");
+            return MOD_ERR_ARG;
+        }
+        if (count > DIO_WAVE_MAX_SAMPLES - wave_bfr_len) {
+            printf("Too many samples (max %d)\n", DIO_WAVE_MAX_SAMPLES);
+            return MOD_ERR_ARG;
+        }
+        if (wave.busy)
+            return MOD_ERR_STATE;
+        wave_bfr_port = port;
+        while (count-- > 0)
+            wave_bfr[wave_bfr_len++] = bsrr;
+    } else if (strcasecmp(argv[2], "start") == 0) {
+        num_args = cmd_parse_args(argc-3, argv+3, "u[s]", arg_vals);
+        if (num_args < 1 ||
+            (num_args == 2 && strcasecmp(arg_vals[1].val.s, "loop") != 0))
+            return MOD_ERR_BAD_CMD;
+        if (wave_bfr_len == 0) {
+            printf("No samples\n");
+            return MOD_ERR_STATE;
+        }
+        rc = dio_wave_start(wave_bfr_port, wave_bfr, wave_bfr_len,
+                            arg_vals[0].val.u, num_args == 2);
+        if (rc < 0) {
+            printf("Wave start error %ld\n", rc);
+            return rc;
+        }
+    } else if (strcasecmp(argv[2], "stop") == 0) {
+        return dio_wave_stop();
+    } else {
+        return MOD_ERR_BAD_CMD;
+    }
+    return 0;
+}
+
+/*
+ * @brief Console command function for "dio la".
+ *
+ * @param[in] argc Number of arguments, including "dio".
+ * @param[in] argv Argument values, including "dio".
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * Command usage: dio la [start <port> <rate-hz> <samples> [<input-name> {0|1}]
+ *                        | stop | dump]
+ *
+ * The port is a letter (A, B, ...). If an input is given, the capture starts
+ * when the input changes to the given value. Without arguments, the logic
+ * analyzer state is displayed.
+ */
+static int32_t cmd_dio_la(int32_t argc, const char** argv)
+{
+    static const char* state_names[] = {
+        [LA_IDLE] = "idle",
+        [LA_ARMED] = "armed",
+        [LA_RUNNING] = "running",
+        [LA_DONE] = "done",
+    };
+    struct cmd_arg_val arg_vals[5];
+    int32_t num_args;
+    int32_t trig_din_idx = -1;
+    uint32_t trig_value = 0;
+    dio_port* port;
+    uint32_t idx;
+    int32_t rc;
+
+    if (argc == 2) {
+        printf("State: %s samples=%lu runs=%lu%s%s\n", state_names[la.state],
+               la.samples, la.num_runs, la.truncated ? " truncated" : "",
+               la.overrun ? " overrun" : "");
+        return 0;
+    }
+
+    if (strcasecmp(argv[2], "start") == 0) {
+        num_args = cmd_parse_args(argc-3, argv+3, "suu[su]", arg_vals);
+        if (num_args != 3 && num_args != 5)
+            return MOD_ERR_BAD_CMD;
+        port = port_from_name(arg_vals[0].val.s);
+        if (port == NULL) {
+            printf("Invalid port '%s'\n", arg_vals[0].val.s);
+            return MOD_ERR_ARG;
+        }
+        if (num_args == 5) {
+            for (idx = 0; idx < cfg->num_inputs; idx++)
+                if (strcasecmp(arg_vals[3].val.s, cfg->inputs[idx].name) == 0)
+                    break;
+            if (idx >= cfg->num_inputs) {
+                printf("Invalid dio name '%s'\n", arg_vals[3].val.s);
+                return MOD_ERR_ARG;
+            }
+            trig_din_idx = (int32_t)idx;
+            trig_value = arg_vals[4].val.u;
+        }
+        rc = dio_la_start(port, arg_vals[1].val.u, arg_vals[2].val.u,
+                          trig_din_idx, trig_value);
+        if (rc < 0) {
+            printf("Logic analyzer start error %ld\n", rc);
+            return rc;
+        }
+    } else if (strcasecmp(argv[2], "stop") == 0) {
+        return dio_la_stop();
+    } else if (strcasecmp(argv[2], "dump") == 0) {
+        if (la.state != LA_DONE) {
+            printf("No capture\n");
+            return MOD_ERR_STATE;
+        }
+        la_dump();
+    } else {
+        return MOD_ERR_BAD_CMD;
+    }
+    return 0;
+}
+
+/*
+ * @brief Console command function for "dio freq".
+ *
+ * @param[in] argc Number of arguments, including "dio".
+ * @param[in] argv Argument values, including "dio".
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * Command usage: dio freq [start <input-name> <gate-ms> | stop]
+ *
+ * Without arguments, the last measurement is displayed.
+ */
+static int32_t cmd_dio_freq(int32_t argc, const char** argv)
+{
+    struct cmd_arg_val arg_vals[2];
+    struct dio_freq_meas meas;
+    uint32_t din_idx;
+    uint64_t num;
+    int32_t rc;
+
+    if (argc == 2) {
+        if (dio_freq_get(&meas) < 0) {
+            printf("Counter not started\n");
+            return 0;
+        }
+        printf("Input %s (%s) gate %lu ms, %lu gates\n",
+               cfg->inputs[freq.din_idx].name,
+               freq.hw_cti != NULL ? "hardware" : "reciprocal", freq.gate_ms,
+               meas.gates);
+        if (meas.edges == 0 || meas.cycles == 0) {
+            printf("No measurement\n");
+            return 0;
+        }
+        if (meas.overflow) {
+            printf("Counter overflow, input too fast for hardware counting\n");
+            return 0;
+        }
+        // Print the frequency with 6 decimals, without 64-bit printf.
+        num = (uint64_t)meas.edges * SystemCoreClock;
+        printf("Freq %lu.%06lu Hz period %lu ns", (uint32_t)(num / meas.cycles),
+               (uint32_t)(num % meas.cycles * 1000000 / meas.cycles),
+               cycles_to_ns(meas.cycles, meas.edges));
+        if (meas.max_period_cycles != 0)
+            printf(" jitter %lu ns p-p (since start)",
+                   cycles_to_ns(meas.max_period_cycles -
+                                meas.min_period_cycles, 1));
+        printf("\n");
+        return 0;
+    }
+
+    if (strcasecmp(argv[2], "start") == 0) {
+        if (cmd_parse_args(argc-3, argv+3, "su", arg_vals) != 2)
+            return MOD_ERR_BAD_CMD;
+        for (din_idx = 0; din_idx < cfg->num_inputs; din_idx++)
+            if (strcasecmp(arg_vals[0].val.s, cfg->inputs[din_idx].name) == 0)
+                break;
+        if (din_idx >= cfg->num_inputs) {
+            printf("Invalid dio name '%s'\n", arg_vals[0].val.s);
+            return MOD_ERR_ARG;
+        }
+        rc = dio_freq_start(din_idx, arg_vals[1].val.u);
+        if (rc < 0) {
+            printf("Frequency counter start error %ld\n", rc);
+            return rc;
+        }
+    } else if (strcasecmp(argv[2], "stop") == 0) {
+        return dio_freq_stop();
+    } else {
+        return MOD_ERR_BAD_CMD;
+    }
+    return 0;
+}
+
+/*
+ * @brief Print the PWM state of an output, if it is active.
+ *
+ * @param[in] dout_idx Discrete output index per module configuration.
+ *
+ * The actual frequency is printed, which can differ slightly from the
+ * requested frequency.
+ */
+static void print_pwm(uint32_t dout_idx)
+{
+    uint32_t freq_x10;
+
+    if (tseq_pti != NULL && tseq_dout_idx == dout_idx) {
+        printf(" pwm=seq");
+        return;
+    }
+    if (dout_idx >= DIO_MAX_MASK_BITS || pwm_period_ticks[dout_idx] == 0) {
+        if (dout_idx < cfg->num_outputs &&
+            cfg->outputs[dout_idx].pwm_tmr != NULL)
+            printf(" pwm=off");
+        return;
+    }
+    freq_x10 = ((uint64_t)SystemCoreClock * 10 +
+                pwm_period_ticks[dout_idx] / 2) / pwm_period_ticks[dout_idx];
+    printf(" pwm=%lu.%lu Hz duty=%u.%u%%", freq_x10 / 10, freq_x10 % 10,
+           pwm_duty[dout_idx] / 10, pwm_duty[dout_idx] % 10);
+}
+
+/*
+ * @brief Calculate a timer prescaler and period for a frequency.
+ *
+ * @param[in] freq_hz The frequency.
+ * @param[in] cnt_max The maximum count of the timer (16 or 32 bits).
+ * @param[out] psc The prescaler register value.
+ * @param[out] arr The auto reload register value.
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * The smallest prescaler that fits the period in the counter is used, for the
+ * best resolution. The timer is assumed to run at the core clock.
+ */
+static int32_t calc_tmr_period(uint32_t freq_hz, uint32_t cnt_max,
+                               uint32_t* psc, uint32_t* arr)
+{
+    uint32_t ticks;
+
+    if (freq_hz == 0 || freq_hz > SystemCoreClock / 2)
+        return MOD_ERR_ARG;
+    ticks = (SystemCoreClock + freq_hz / 2) / freq_hz;
+    *psc = (ticks - 1) / ((uint64_t)cnt_max + 1);
+    if (*psc > 0xffff)
+        return MOD_ERR_ARG;
+    *arr = (ticks + (*psc + 1) / 2) / (*psc + 1) - 1;
+    return 0;
+}
+
+/*
+ * @brief Stop the waveform generator hardware.
+ *
+ * This is called with interrupts disabled, or from the DMA interrupt handler.
+ * If capture was suspended on the timer, the timer is made free running again
+ * and capture resumes.
+ */
+static void wave_hw_stop(void)
+{
+    LL_TIM_DisableDMAReq_UPDATE(DIO_SAMPLE_TMR);
+    LL_DMA_DisableStream(DIO_WAVE_DMA, DIO_WAVE_DMA_STREAM);
+    wave.busy = false;
+    sample_clk_stop(DIO_SAMPLE_USER_WAVE);
+}
+
+/*
+ * @brief Start the sample clock timer for a user.
+ *
+ * @param[in] user The user (DIO_SAMPLE_USER_xxx).
+ * @param[in] rate_hz The sample rate.
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * If the clock is already running for another user, the rate must be the
+ * same. Capture on the timer is suspended while the clock runs.
+ */
+static int32_t sample_clk_start(uint32_t user, uint32_t rate_hz)
+{
+    uint32_t idx;
+    uint32_t psc;
+    uint32_t arr;
+
+    if (sample_clk_users != 0) {
+        if (rate_hz != sample_clk_rate_hz)
+            return MOD_ERR_RESOURCE;
+        sample_clk_users |= user;
+        return 0;
+    }
+    for (idx = 0; idx < cfg->num_outputs && idx < DIO_MAX_MASK_BITS; idx++) {
+        if (cfg->outputs[idx].pwm_tmr == DIO_SAMPLE_TMR &&
+            pwm_period_ticks[idx] != 0)
+            return MOD_ERR_RESOURCE;
+    }
+    if (freq.hw_cti != NULL && freq.hw_cti->tmr == DIO_SAMPLE_TMR)
+        return MOD_ERR_RESOURCE;
+    if (calc_tmr_period(rate_hz, 0xffff, &psc, &arr) < 0)
+        return MOD_ERR_ARG;
+
+    for (idx = 0; idx < ARRAY_SIZE(capture_tmrs); idx++) {
+        if (capture_tmrs[idx].tmr == DIO_SAMPLE_TMR &&
+            (capture_tmr_mask & (1 << idx)) != 0) {
+            capture_suspend_mask |= 1 << idx;
+            log_info("dio: TIM1 capture suspended\n");
+        }
+    }
+
+    LL_APB2_GRP1_EnableClock(LL_APB2_GRP1_PERIPH_TIM1);
+    LL_TIM_DisableCounter(DIO_SAMPLE_TMR);
+    LL_TIM_SetPrescaler(DIO_SAMPLE_TMR, psc);
+    LL_TIM_SetAutoReload(DIO_SAMPLE_TMR, arr);
+    LL_TIM_GenerateEvent_UPDATE(DIO_SAMPLE_TMR);
+    DIO_SAMPLE_TMR->SR = 0;
+    LL_TIM_EnableCounter(DIO_SAMPLE_TMR);
+    sample_clk_rate_hz = rate_hz;
+    sample_clk_users = user;
+    return 0;
+}
+
+/*
+ * @brief Stop the sample clock timer for a user.
+ *
+ * @param[in] user The user (DIO_SAMPLE_USER_xxx).
+ *
+ * This is called with interrupts disabled, or from an interrupt handler.
+ * When there are no more users, the timer is made free running again for
+ * capture, if capture was suspended.
+ */
+static void sample_clk_stop(uint32_t user)
+{
+    uint32_t idx;
+
+    sample_clk_users &= ~user;
+    if (sample_clk_users != 0)
+        return;
+    LL_TIM_DisableCounter(DIO_SAMPLE_TMR);
+
+    for (idx = 0; idx < ARRAY_SIZE(capture_tmrs); idx++) {
+        if (capture_suspend_mask & (1 << idx)) {
+            LL_TIM_SetPrescaler(capture_tmrs[idx].tmr, 0);
+            LL_TIM_SetAutoReload(capture_tmrs[idx].tmr,
+                                 capture_tmrs[idx].cnt_mask);
+            LL_TIM_GenerateEvent_UPDATE(capture_tmrs[idx].tmr);
+            capture_tmrs[idx].tmr->SR = 0;
+            LL_TIM_EnableCounter(capture_tmrs[idx].tmr);
+            capture_suspend_mask &= ~(1 << idx);
+        }
+    }
+}
+
+/*
+ * @brief Stop the logic analyzer hardware.
+ *
+ * This is called with interrupts disabled, or from an interrupt handler.
+ */
+static void la_hw_stop(void)
+{
+    LL_TIM_DisableDMAReq_CC2(DIO_SAMPLE_TMR);
+    LL_DMA_DisableStream(DIO_LA_DMA, DIO_LA_DMA_STREAM);
+    la.state = LA_DONE;
+    sample_clk_stop(DIO_SAMPLE_USER_LA);
+}
+
+/*
+ * @brief Run length encode logic analyzer samples, from the DMA interrupt.
+ *
+ * @param[in] samples The samples (port IDR values).
+ * @param[in] num_samples Number of samples.
+ *
+ * Each run is a value and its count of consecutive samples. The capture is
+ * stopped when the requested number of samples is reached, or the runs buffer
+ * is full.
+ */
+static void la_encode(const uint16_t* samples, uint32_t num_samples)
+{
+    struct la_run* run;
+    uint32_t num_runs = la.num_runs;
+    uint32_t idx;
+
+    if (num_samples > la.num_samples - la.samples)
+        num_samples = la.num_samples - la.samples;
+    run = num_runs > 0 ? &la_runs[num_runs - 1] : NULL;
+    for (idx = 0; idx < num_samples; idx++) {
+        if (run != NULL && run->value == samples[idx] &&
+            run->count < DIO_LA_MAX_RUN_CNT) {
+            run->count++;
+            continue;
+        }
+        if (num_runs >= DIO_LA_MAX_RUNS) {
+            la.truncated = true;
+            break;
+        }
+        run = &la_runs[num_runs++];
+        run->value = samples[idx];
+        run->count = 1;
+    }
+    la.num_runs = num_runs;
+    la.samples += idx;
+    if (la.truncated || la.samples >= la.num_samples)
+        la_hw_stop();
+}
+
+/*
+ * @brief Print the logic analyzer capture in VCD format.
+ *
+ * Each pin of the port is a 1-bit wire, named after the port and pin (e.g.
+ * "PA5"). The timescale is 1 ns, and a value change is printed at the start of
+ * each run, for the pins that changed.
+ */
+static void la_dump(void)
+{
+    uint32_t run_idx;
+    uint32_t pin;
+    uint32_t sample = 0;
+    uint32_t changed;
+    uint16_t prev = 0;
+    char port_char = 'A' + (((uint32_t)la.port - (uint32_t)DIO_PORT_A) /
+                            ((uint32_t)DIO_PORT_B - (uint32_t)DIO_PORT_A));
+
+    printf("$comment dio la: rate %lu Hz, %lu samples, %lu runs%s%s $end\n",
+           la.rate_hz, la.samples, la.num_runs,
+           la.truncated ? ", truncated" : "", la.overrun ? ", overrun" : "");
+    printf("$timescale 1 ns $end\n$scope module dio $end\n");
+    for (pin = 0; pin < DIO_PINS_PER_PORT; pin++)
+        printf("$var wire 1 %c P%c%lu $end\n", (char)('!' + pin), port_char,
+               pin);
+    printf("$upscope $end\n$enddefinitions $end\n");
+
+    for (run_idx = 0; run_idx < la.num_runs; run_idx++) {
+        changed = run_idx == 0 ? 0xffff : la_runs[run_idx].value ^ prev;
+        la_print_time(sample);
+        for (; changed != 0; changed &= changed - 1) {
+            pin = __builtin_ctz(changed);
+            printf("%lu%c\n", (la_runs[run_idx].value >> pin) & 1UL,
+                   (char)('!' + pin));
+        }
+        prev = la_runs[run_idx].value;
+        sample += la_runs[run_idx].count;
+    }
+    la_print_time(sample);
+}
+
+/*
+ * @brief Print a VCD time stamp for a logic analyzer sample.
+ *
+ * @param[in] sample The sample number.
+ *
+ * The time is in ns, and can exceed 32 bits. The printf library doesn't
+ * support 64-bit integers, so the time is printed in two parts.
+ */
+static void la_print_time(uint32_t sample)
+{
+    uint64_t ns = (uint64_t)sample * 1000000000 / la.rate_hz;
+
+    if (ns >= 1000000000)
+        printf("#%lu%09lu\n", (uint32_t)(ns / 1000000000),
+               (uint32_t)(ns % 1000000000));
+    else
+        printf("#%lu\n", (uint32_t)ns);
+}
+
+/*
+ * @brief Handle a 0 to 1 edge for the reciprocal frequency counter.
+ *
+ * @param[in] cycles Cycle counter at the edge.
+ *
+ * This is called from the edge interrupt handler. The first edge opens the
+ * gate. The gate closes at the edge nearest the gate time, which also opens
+ * the next gate, so a 1 Hz signal with a 1 s gate gives one period per gate.
+ */
+static void freq_edge(uint32_t cycles)
+{
+    uint32_t period;
+
+    if (!freq.gate_open) {
+        freq.gate_open = true;
+        freq.gate_start_cycles = cycles;
+        freq.last_cycles = cycles;
+        freq.edges = 0;
+        freq.min_period_cycles = UINT32_MAX;
+        return;
+    }
+    period = cycles - freq.last_cycles;
+    freq.last_cycles = cycles;
+    freq.edges++;
+    if (period < freq.min_period_cycles)
+        freq.min_period_cycles = period;
+    if (period > freq.max_period_cycles)
+        freq.max_period_cycles = period;
+    freq_gate_check(cycles, period / 2);
+}
+
+/*
+ * @brief Close the frequency counter gate if the gate time has elapsed.
+ *
+ * @param[in] cycles Cycle counter at the gate close, if it closes.
+ * @param[in] slack_cycles How early the gate can close.
+ *
+ * The measurement is saved and the next gate is opened.
+ */
+static void freq_gate_check(uint32_t cycles, uint32_t slack_cycles)
+{
+    if (cycles - freq.gate_start_cycles + slack_cycles < freq.gate_cycles)
+        return;
+    freq.meas.gates++;
+    freq.meas.edges = freq.edges;
+    freq.meas.cycles = cycles - freq.gate_start_cycles;
+    freq.meas.overflow = freq.overflow;
+    if (freq.hw_cti == NULL) {
+        freq.meas.min_period_cycles = freq.min_period_cycles;
+        freq.meas.max_period_cycles = freq.max_period_cycles;
+    }
+    freq.gate_start_cycles = cycles;
+    freq.edges = 0;
+    freq.overflow = false;
+}
+
+/*
+ * @brief Timer callback to read the hardware frequency counter.
+ *
+ * @param[in] tmr_id Timer ID.
+ * @param[in] user_data User callback data (not used).
+ *
+ * @return TMR_CB_RESTART to keep running.
+ *
+ * The counter and cycle counter are read back to back, so the gate length
+ * error is small and doesn't accumulate.
+ *
+ * The update flag shows whether the counter wrapped since the last read. A
+ * 16-bit counter wraps more than once between reads for inputs above about
+ * 6.5 MHz (or if this callback is delayed). A single wrap can't be told from
+ * several if the counter has passed its last value, so the gate is flagged as
+ * an overflow. A wrap just after the flag is read is caught by reading the
+ * flag again after the counter; a small count means it belongs to this read.
+ */
+static enum tmr_cb_action freq_tmr_cb(int32_t tmr_id, uint32_t user_data)
+{
+    dio_tmr* tmr;
+    uint32_t cnt;
+    uint32_t cycles;
+    bool wrapped;
+
+    if (freq.hw_cti == NULL)
+        return TMR_CB_NONE;
+    tmr = freq.hw_cti->tmr;
+    __disable_irq();
+    wrapped = LL_TIM_IsActiveFlag_UPDATE(tmr);
+    LL_TIM_ClearFlag_UPDATE(tmr);
+    cnt = LL_TIM_GetCounter(tmr);
+    cycles = tmr_get_cycles();
+    if (LL_TIM_IsActiveFlag_UPDATE(tmr) && cnt < freq.hw_cti->cnt_mask / 2) {
+        LL_TIM_ClearFlag_UPDATE(tmr);
+        wrapped = true;
+    }
+    __enable_irq();
+    if (!freq.gate_open) {
+        freq.gate_open = true;
+        freq.gate_start_cycles = cycles;
+        freq.last_cnt = cnt;
+        return TMR_CB_RESTART;
+    }
+    if (wrapped && cnt >= freq.last_cnt)
+        freq.overflow = true;
+    freq.edges += (cnt - freq.last_cnt) & freq.hw_cti->cnt_mask;
+    freq.last_cnt = cnt;
+    __disable_irq();
+    freq_gate_check(cycles, 0);
+    __enable_irq();
+    return TMR_CB_RESTART;
+}
+
+/*
+ * @brief Convert a cycle count to ns.
+ *
+ * @param[in] cycles The cycle count.
+ * @param[in] div Divisor (e.g. number of periods), non-zero.
+ *
+ * @return The time in ns.
+ */
+static uint32_t cycles_to_ns(uint32_t cycles, uint32_t div)
+{
+    return (uint64_t)cycles * 1000000000 / ((uint64_t)SystemCoreClock * div);
+}
+
+/*
+ * @brief Get the PWM timer of an output.
+ *
+ * @param[in] dout_idx Discrete output index per module configuration.
+ *
+ * @return The timer info, or NULL if the output has no valid PWM timer.
+ */
+static const struct pwm_tmr_info* get_pwm_tmr(uint32_t dout_idx)
+{
+    const struct dio_out_info* doi = &cfg->outputs[dout_idx];
+    uint32_t idx;
+
+    if (doi->pwm_tmr == NULL || doi->pwm_chan < 1 ||
+        doi->pwm_chan > DIO_TMR_NUM_CHANS)
+        return NULL;
+    for (idx = 0; idx < ARRAY_SIZE(pwm_tmrs); idx++) {
+        if (pwm_tmrs[idx].tmr == doi->pwm_tmr)
+            return &pwm_tmrs[idx];
+    }
+    return NULL;
+}
+
+/*
+ * @brief Clear all interrupt flags of a DMA stream.
+ *
+ * @param[in] dma The DMA controller.
+ * @param[in] stream The stream (LL_DMA_STREAM_x).
+ *
+ * Streams 0-3 use LIFCR, and 4-7 HIFCR, with the same bit offsets.
+ */
+static void dma_clear_flags(DMA_TypeDef* dma, uint32_t stream)
+{
+    static const uint8_t shifts[] = {0, 6, 16, 22};
+    uint32_t bits = 0x3dUL << shifts[stream & 3];
+
+    if (stream < LL_DMA_STREAM_4)
+        dma->LIFCR = bits;
+    else
+        dma->HIFCR = bits;
+}
+
+/*
+ * @brief Get a port from its name.
+ *
+ * @param[in] name The port name, a letter from "A" to "H" (case insensitive).
+ *
+ * @return The port, or NULL if the name is not valid.
+ */
+static dio_port* port_from_name(const char* name)
+{
+    static dio_port* const all_ports[] = {
+        DIO_PORT_A, DIO_PORT_B, DIO_PORT_C, DIO_PORT_D, DIO_PORT_E,
+        DIO_PORT_F, DIO_PORT_G, DIO_PORT_H,
+    };
+    uint32_t idx = toupper((int)name[0]) - 'A';
+
+    if (name[0] == '\0' || name[1] != '\0' || idx >= ARRAY_SIZE(all_ports))
+        return NULL;
+    return all_ports[idx];
+}
+
+/*
+ * @brief Get the index of a port in the port table, adding it if needed.
+ *
+ * @param[in] port The port.
+ *
+ * @return Port index (non-negative) for success, else a "MOD_ERR" value. See
+ *         code for details.
+ */
+static int32_t get_port_idx(dio_port* port)
+{
+    uint32_t idx;
+
+    for (idx = 0; idx < num_ports; idx++) {
+        if (ports[idx] == port)
+            return idx;
+    }
+    if (num_ports >= DIO_MAX_PORTS)
+        return MOD_ERR_RESOURCE;
+    ports[num_ports] = port;
+    return num_ports++;
 }
@@ -0,0 +1,427 @@
+/*
+ * @brief Implementation of dop utility.
+ *
+ * This utility computes dilution of precision (DOP) values from the
+ * directions (azimuth and elevation) of the satellites used in a fix.
+ *
+ * Each satellite contributes a row to the geometry matrix G: the east, north
+ * and up components of the unit vector to the satellite, and 1 for the
+ * receiver clock. The DOP values come from the diagonal of inv(G'G):
+ *   GDOP = sqrt(q00 + q11 + q22 + q33)
+ *   PDOP = sqrt(q00 + q11 + q22)
+ *   HDOP = sqrt(q00 + q11)
+ *   VDOP = sqrt(q22)
+ *   TDOP = sqrt(q33)
+ *
+ * dop_calc() uses integer arithmetic only:
+ * - The trig functions use a table of sin() for whole degrees, in Q14 format
+ *   (16384 = 1.0). The receiver reports whole degrees, so no interpolation
+ *   is needed.
+ * - Each column of G is kept as an array of 16-bit values, so the dot
+ *   products for G'G can be done two satellites at a time, with the
+ *   Cortex-M4 SMLALD instruction (dual 16x16 multiply, 64-bit accumulate).
+ *   This is exact.
+ * - G'G is divided by the number of satellites, so its values are at most
+ *   1.0, and inverted by Gauss-Jordan elimination with partial pivoting,
+ *   using 64-bit values in Q20 format. If a pivot is too small, the geometry
+ *   is too poor for a useful result, and an error is returned. This also
+ *   bounds the intermediate values, so they can't overflow.
+ * - Square roots are done with an integer square root.
+ *
+ * The results are within 0.01 of the reference for a GDOP of up to 10, and
+ * within 0.05 up to 20 (see host_test/dop_test.c). For poorer geometry the
+ * error grows quickly, mainly due to the Q14 precision of the geometry
+ * matrix.
+ *
+ * dop_calc_ref() is a double-precision reference implementation, for
+ * checking dop_calc() (see the "gps dop test" command).
+ *
+ * MIT License
+ * 
+ * Copyright (c) 2021 Eugene R Schroeder
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "stm32f4xx.h"
+
+#include "dop.h"
+#include "module.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Common macros
+////////////////////////////////////////////////////////////////////////////////
+
+#define TRIG_Q 14
+#define INV_Q 20
+
+// Pivots smaller than this (in Q20) are treated as a singular matrix. With
+// G'G scaled to at most 1.0, this limits DOP values to about 64/sqrt(N).
+#define MIN_PIVOT (1 << (INV_Q - 12))
+
+// Multiply fixed point values, with rounding.
+#define MUL_Q(x, y, q) (((int64_t)(x) * (y) + (1LL << ((q) - 1))) >> (q))
+
+// Dual 16x16 multiply with 64-bit accumulate. Use the DSP instruction if
+// available, so this file can also be built for a host.
+#if defined(__ARM_FEATURE_DSP)
+#define SMLALD(x, y, acc) __SMLALD((x), (y), (acc))
+#else
+#define SMLALD(x, y, acc) ((acc) + \
+    (int64_t)((int32_t)(int16_t)(x) * (int16_t)(y)) + \
+    (int64_t)((int32_t)(int16_t)((x) >> 16) * (int16_t)((y) >> 16)))
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// Type definitions
+////////////////////////////////////////////////////////////////////////////////
+
+// A column of the geometry matrix, one Q14 value per satellite. It can also be
+// accessed as 32-bit words, each holding the values for two satellites.
+union geom_col {
+    int16_t h[DOP_MAX_SATS];
+    uint32_t w[DOP_MAX_SATS / 2];
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Private (static) function declarations
+////////////////////////////////////////////////////////////////////////////////
+
+static int32_t sin_q14(uint32_t deg);
+static int32_t cos_q14(uint32_t deg);
+static uint32_t isqrt(uint32_t value);
+static uint16_t dop_x100(int64_t q_sum, uint32_t num_sats);
+
+////////////////////////////////////////////////////////////////////////////////
+// Private (static) variables
+////////////////////////////////////////////////////////////////////////////////
+
+// sin() for 0-90 degrees, Q14 format.
+static const int16_t sin_table[91] = {
+        0,   286,   572,   857,  1143,  1428,  1713,  1997,  2280,  2563,
+     2845,  3126,  3406,  3686,  3964,  4240,  4516,  4790,  5063,  5334,
+     5604,  5872,  6138,  6402,  6664,  6924,  7182,  7438,  7692,  7943,
+     8192,  8438,  8682,  8923,  9162,  9397,  9630,  9860, 10087, 10311,
+    10531, 10749, 10963, 11174, 11381, 11585, 11786, 11982, 12176, 12365,
+    12551, 12733, 12911, 13085, 13255, 13421, 13583, 13741, 13894, 14044,
+    14189, 14330, 14466, 14598, 14726, 14849, 14968, 15082, 15191, 15296,
+    15396, 15491, 15582, 15668, 15749, 15826, 15897, 15964, 16026, 16083,
+    16135, 16182, 16225, 16262, 16294, 16322, 16344, 16362, 16374, 16382,
+    16384,
+};
+
+// Geometry matrix columns: east, north, up, clock. Static to keep them off the
+// stack.
+static union geom_col geom[4];
+
+////////////////////////////////////////////////////////////////////////////////
+// Public (global) variables and externs
+////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////
+// Public (global) functions
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * @brief Calculate DOP values, using integer arithmetic.
+ *
+ * @param[in] sats The satellite directions.
+ * @param[in] num_sats Number of satellites (4 to DOP_MAX_SATS).
+ * @param[out] result The DOP values.
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * MOD_ERR_STATE is returned if the geometry is too poor (e.g. all satellites
+ * at the same elevation).
+ */
+int32_t dop_calc(const struct dop_sat* sats, uint32_t num_sats,
+                 struct dop_result* result)
+{
+    int64_t a[4][4];
+    int64_t inv[4][4];
+    int64_t tmp;
+    int64_t acc;
+    int64_t f;
+    uint32_t idx;
+    uint32_t num_words;
+    uint32_t row;
+    uint32_t col;
+    uint32_t k;
+    uint32_t pivot_row;
+    int32_t cos_el;
+    uint32_t az;
+
+    if (sats == NULL || result == NULL || num_sats < 4 ||
+        num_sats > DOP_MAX_SATS)
+        return MOD_ERR_ARG;
+
+    // Build the geometry matrix columns, padded with zero to a whole number of
+    // words.
+    for (idx = 0; idx < num_sats; idx++) {
+        az = sats[idx].azimuth % 360;
+        cos_el = cos_q14(sats[idx].elevation);
+        geom[0].h[idx] = MUL_Q(cos_el, sin_q14(az), TRIG_Q);
+        geom[1].h[idx] = MUL_Q(cos_el, cos_q14(az), TRIG_Q);
+        geom[2].h[idx] = sin_q14(sats[idx].elevation);
+        geom[3].h[idx] = 1 << TRIG_Q;
+    }
+    num_words = (num_sats + 1) / 2;
+    if (num_sats & 1) {
+        for (col = 0; col < 4; col++)
+            geom[col].h[num_sats] = 0;
+    }
+
+    // G'G (symmetric), in Q28, scaled by 1/num_sats and converted to Q20.
+    for (row = 0; row < 4; row++) {
+        for (col = row; col < 4; col++) {
+            acc = 0;
+            for (idx = 0; idx < num_words; idx++)
+                acc = (int64_t)SMLALD(geom[row].w[idx], geom[col].w[idx],
+                                      (uint64_t)acc);
+            a[row][col] = acc / ((int64_t)num_sats << (2 * TRIG_Q - INV_Q));
+            a[col][row] = a[row][col];
+        }
+    }
+
+    // Gauss-Jordan elimination, with the identity matrix becoming the inverse.
+    for (row = 0; row < 4; row++) {
+        for (col = 0; col < 4; col++)
+            inv[row][col] = row == col ? (int64_t)1 << INV_Q : 0;
+    }
+    for (col = 0; col < 4; col++) {
+        pivot_row = col;
+        for (row = col + 1; row < 4; row++) {
+            if (llabs(a[row][col]) > llabs(a[pivot_row][col]))
+                pivot_row = row;
+        }
+        if (llabs(a[pivot_row][col]) < MIN_PIVOT)
+            return MOD_ERR_STATE;
+        if (pivot_row != col) {
+            for (k = 0; k < 4; k++) {
+                tmp = a[col][k];
+                a[col][k] = a[pivot_row][k];
+                a[pivot_row][k] = tmp;
+                tmp = inv[col][k];
+                inv[col][k] = inv[pivot_row][k];
+                inv[pivot_row][k] = tmp;
+            }
+        }
+
+        // Normalize the pivot row, then eliminate the column from the other
+        // rows.
+        f = a[col][col];
+        for (k = 0; k < 4; k++) {
+            a[col][k] = (a[col][k] << INV_Q) / f;
+            inv[col][k] = (inv[col][k] << INV_Q) / f;
+        }
+        for (row = 0; row < 4; row++) {
+            if (row == col)
+                continue;
+            f = a[row][col];
+            for (k = 0; k < 4; k++) {
+                a[row][k] -= MUL_Q(f, a[col][k], INV_Q);
+                inv[row][k] -= MUL_Q(f, inv[col][k], INV_Q);
+            }
+        }
+    }
+
+    result->gdop_x100 = dop_x100(inv[0][0] + inv[1][1] + inv[2][2] + inv[3][3],
+                                 num_sats);
+    result->pdop_x100 = dop_x100(inv[0][0] + inv[1][1] + inv[2][2], num_sats);
+    result->hdop_x100 = dop_x100(inv[0][0] + inv[1][1], num_sats);
+    result->vdop_x100 = dop_x100(inv[2][2], num_sats);
+    result->tdop_x100 = dop_x100(inv[3][3], num_sats);
+    return 0;
+}
+
+/*
+ * @brief Calculate DOP values, using double precision.
+ *
+ * @param[in] sats The satellite directions.
+ * @param[in] num_sats Number of satellites (4 to DOP_MAX_SATS).
+ * @param[out] result The DOP values.
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * This is a straightforward reference implementation, for testing dop_calc().
+ * It is much slower, as the MCU has no double precision hardware.
+ */
+int32_t dop_calc_ref(const struct dop_sat* sats, uint32_t num_sats,
+                     struct dop_result* result)
+{
+    double g[DOP_MAX_SATS][4];
+    double a[4][8];
+    double tmp;
+    double f;
+    double el;
+    double az;
+    uint32_t idx;
+    uint32_t row;
+    uint32_t col;
+    uint32_t k;
+    uint32_t pivot_row;
+
+    if (sats == NULL || result == NULL || num_sats < 4 ||
+        num_sats > DOP_MAX_SATS)
+        return MOD_ERR_ARG;
+
+    for (idx = 0; idx < num_sats; idx++) {
+        el = sats[idx].elevation * M_PI / 180.0;
+        az = sats[idx].azimuth * M_PI / 180.0;
+        g[idx][0] = cos(el) * sin(az);
+        g[idx][1] = cos(el) * cos(az);
+        g[idx][2] = sin(el);
+        g[idx][3] = 1.0;
+    }
+
+    // Augmented matrix [G'G | I].
+    for (row = 0; row < 4; row++) {
+        for (col = 0; col < 4; col++) {
+            a[row][col] = 0.0;
+            for (idx = 0; idx < num_sats; idx++)
+                a[row][col] += g[idx][row] * g[idx][col];
+            a[row][col + 4] = row == col ? 1.0 : 0.0;
+        }
+    }
+
+    for (col = 0; col < 4; col++) {
+        pivot_row = col;
+        for (row = col + 1; row < 4; row++) {
+            if (fabs(a[row][col]) > fabs(a[pivot_row][col]))
+                pivot_row = row;
+        }
+        if (fabs(a[pivot_row][col]) < 1e-12)
+            return MOD_ERR_STATE;
+        for (k = 0; k < 8; k++) {
+            tmp = a[col][k];
+            a[col][k] = a[pivot_row][k];
+            a[pivot_row][k] = tmp;
+        }
+        f = a[col][col];
+        for (k = 0; k < 8; k++)
+            a[col][k] /= f;
+        for (row = 0; row < 4; row++) {
+            if (row == col)
+                continue;
+            f = a[row][col];
+            for (k = 0; k < 8; k++)
+                a[row][k] -= f * a[col][k];
+        }
+    }
+
+    #define TO_X100(x) ((x) < 655.35 ? (uint16_t)((x) * 100.0 + 0.5) : \
+                        UINT16_MAX)
+    result->gdop_x100 = TO_X100(sqrt(a[0][4] + a[1][5] + a[2][6] + a[3][7]));
+    result->pdop_x100 = TO_X100(sqrt(a[0][4] + a[1][5] + a[2][6]));
+    result->hdop_x100 = TO_X100(sqrt(a[0][4] + a[1][5]));
+    result->vdop_x100 = TO_X100(sqrt(a[2][6]));
+    result->tdop_x100 = TO_X100(sqrt(a[3][7]));
+    #undef TO_X100
+    return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Private (static) functions
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * @brief Get sin() of an angle.
+ *
+ * @param[in] deg Angle in degrees (0-359).
+ *
+ * @return sin(deg), Q14 format.
+ */
+static int32_t sin_q14(uint32_t deg)
+{
+    if (deg <= 90)
+        return sin_table[deg];
+    else if (deg <= 180)
+        return sin_table[180 - deg];
+    else if (deg <= 270)
+        return -sin_table[deg - 180];
+    return -sin_table[360 - deg];
+}
+
+/*
+ * @brief Get cos() of an angle.
+ *
+ * @param[in] deg Angle in degrees (0-359).
+ *
+ * @return cos(deg), Q14 format.
+ */
+static int32_t cos_q14(uint32_t deg)
+{
+    return sin_q14((deg + 90) % 360);
+}
+
+/*
+ * @brief Integer square root.
+ *
+ * @param[in] value The value.
+ *
+ * @return floor(sqrt(value)).
+ *
+ * This is the bit-by-bit method, which only uses shifts, adds and compares.
+ */
+static uint32_t isqrt(uint32_t value)
+{
+    uint32_t root = 0;
+    uint32_t bit = 1UL << 30;
+
+    while (bit > value)
+        bit >>= 2;
+    while (bit != 0) {
+        if (value >= root + bit) {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+/*
+ * @brief Convert a sum of diagonal values of the inverse to a DOP value.
+ *
+ * @param[in] q_sum Sum of diagonal values of inv(G'G / num_sats), Q20.
+ * @param[in] num_sats Number of satellites.
+ *
+ * @return DOP value times 100, rounded.
+ */
+static uint16_t dop_x100(int64_t q_sum, uint32_t num_sats)
+{
+    uint64_t dop_sq_x4e4;
+
+    if (q_sum <= 0)
+        return 0;
+
+    // The DOP squared, times 40000. The square root is then twice the result,
+    // which gives the rounding bit.
+    dop_sq_x4e4 = ((uint64_t)q_sum * 40000 / num_sats) >> INV_Q;
+    if (dop_sq_x4e4 > UINT32_MAX)
+        return UINT16_MAX;
+    return (isqrt((uint32_t)dop_sq_x4e4) + 1) / 2;
+}
@@ -0,0 +1,435 @@
+/*
+ * @brief Implementation of evt module.
+ *
+ * This module provides a publish/subscribe event bus between modules.
+ *
+ * A module publishes an event on a topic (see enum evt_topic), and all
+ * subscribers to that topic are called with the event from evt_run(), in the
+ * super loop. Events can be published from interrupt handlers, as well as
+ * from the super loop.
+ *
+ * Each topic has a fixed size queue of event slots, and a fixed size
+ * subscriber list, so there is no dynamic allocation. If a topic queue is
+ * full, the new event is dropped and counted.
+ *
+ * For each topic, the number of events published, delivered, and dropped are
+ * kept, as well as a histogram of the delivery latency (time from publish to
+ * the start of the subscriber calls).
+ *
+ * The following console commands are provided:
+ * > evt status
+ * > evt trace
+ * See code for details.
+ *
+ * MIT License
+ * 
+ * Copyright (c) 2021 Eugene R Schroeder
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "stm32f4xx.h"
+
+#include "cmd.h"
+#include "evt.h"
+#include "log.h"
+#include "module.h"
+#include "stat.h"
+#include "tmr.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Common macros
+////////////////////////////////////////////////////////////////////////////////
+
+#define EVT_QUEUE_LEN 8 // Event slots per topic.
+#define EVT_MAX_SUBS 4  // Subscribers per topic.
+
+////////////////////////////////////////////////////////////////////////////////
+// Type definitions
+////////////////////////////////////////////////////////////////////////////////
+
+struct evt_sub {
+    evt_cb cb;
+    uint32_t user_data;
+};
+
+struct evt_topic_state {
+    struct evt queue[EVT_QUEUE_LEN];
+
+    // Free running indexes, the difference is the number of queued events.
+    // put_idx is only changed by evt_publish(), and get_idx by evt_run().
+    volatile uint32_t put_idx;
+    volatile uint32_t get_idx;
+
+    struct evt_sub subs[EVT_MAX_SUBS];
+    uint32_t num_subs;
+
+    uint32_t published;
+    uint32_t delivered;
+    uint32_t dropped;
+    uint32_t max_queued;
+    struct stat_hist latency_us;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Private (static) function declarations
+////////////////////////////////////////////////////////////////////////////////
+
+static int32_t cmd_evt_status(int32_t argc, const char** argv);
+static int32_t cmd_evt_trace(int32_t argc, const char** argv);
+
+static void stats_init(void);
+static void trace_evt(const struct evt* evt);
+
+////////////////////////////////////////////////////////////////////////////////
+// Private (static) variables
+////////////////////////////////////////////////////////////////////////////////
+
+static struct evt_cfg cfg;
+
+static struct evt_topic_state topics[EVT_NUM_TOPICS];
+
+static bool trace_on;
+
+static const char* topic_names[EVT_NUM_TOPICS] = {
+    [EVT_TOPIC_GPS_CYCLE] = "gps_cycle",
+    [EVT_TOPIC_DIO_EDGE] = "dio_edge",
+    [EVT_TOPIC_DIO_BUTTON] = "dio_button",
+    [EVT_TOPIC_TTYS_LINE] = "ttys_line",
+};
+
+static struct cmd_cmd_info cmds[] = {
+    {
+        .name = "status",
+        .func = cmd_evt_status,
+        .help = "Get module status, usage: evt status [clear]",
+    },
+    {
+        .name = "trace",
+        .func = cmd_evt_trace,
+        .help = "Log delivered events, usage: evt trace {on|off}",
+    },
+};
+
+static int32_t log_level = LOG_DEFAULT;
+
+static struct cmd_client_info cmd_info = {
+    .name = "evt",
+    .num_cmds = ARRAY_SIZE(cmds),
+    .cmds = cmds,
+    .log_level_ptr = &log_level,
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Public (global) variables and externs
+////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////
+// Public (global) functions
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * @brief Get default evt configuration.
+ *
+ * @param[out] cfg The evt configuration with defaults filled in.
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ */
+int32_t evt_get_def_cfg(struct evt_cfg* cfg)
+{
+    if (cfg == NULL)
+        return MOD_ERR_ARG;
+
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->latency_bin_us = 100;
+    return 0;
+}
+
+/*
+ * @brief Initialize evt instance.
+ *
+ * @param[in] cfg The evt configuration.
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * This function initializes the evt singleton module. Generally, it should
+ * not access other modules as they might not have been initialized yet. An
+ * exception is the log module.
+ *
+ * It should be called before other modules are started, as they might
+ * subscribe to topics when started.
+ */
+int32_t evt_init(struct evt_cfg* _cfg)
+{
+    if (_cfg == NULL)
+        return MOD_ERR_ARG;
+
+    memset(topics, 0, sizeof(topics));
+    cfg = *_cfg;
+    stats_init();
+    return 0;
+}
+
+/*
+ * @brief Start evt instance.
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * This function starts the evt singleton module, to enter normal operation.
+ */
+int32_t evt_start(void)
+{
+    int32_t result;
+
+    result = cmd_register(&cmd_info);
+    if (result < 0) {
+        log_error("evt_start: cmd error %d\n", result);
+        return MOD_ERR_RESOURCE;
+    }
+    return 0;
+}
+
+/*
+ * @brief Run evt instance.
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * @note This function should not block.
+ *
+ * This function delivers queued events to subscribers. At most one queue's
+ * worth of events is delivered per topic per call, so a subscriber that
+ * publishes on its own topic can't keep this function from returning.
+ */
+int32_t evt_run(void)
+{
+    struct evt_topic_state* ts;
+    struct evt evt;
+    uint32_t topic;
+    uint32_t ctr;
+    uint32_t idx;
+
+    for (topic = 0; topic < EVT_NUM_TOPICS; topic++) {
+        ts = &topics[topic];
+        for (ctr = 0; ctr < EVT_QUEUE_LEN && ts->get_idx != ts->put_idx;
+             ctr++) {
+            // Copy the event out and free the slot before calling
+            // subscribers.
+            evt = ts->queue[ts->get_idx % EVT_QUEUE_LEN];
+            ts->get_idx++;
+
+            stat_hist_add(&ts->latency_us, (tmr_get_cycles() - evt.pub_cycles) /
+                          (SystemCoreClock / 1000000));
+            if (trace_on)
+                trace_evt(&evt);
+            for (idx = 0; idx < ts->num_subs; idx++)
+                ts->subs[idx].cb(&evt, ts->subs[idx].user_data);
+            ts->delivered++;
+        }
+    }
+    return 0;
+}
+
+/*
+ * @brief Subscribe to a topic.
+ *
+ * @param[in] topic The topic.
+ * @param[in] cb The function called for each event on the topic.
+ * @param[in] user_data User data passed to the callback.
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ */
+int32_t evt_subscribe(enum evt_topic topic, evt_cb cb, uint32_t user_data)
+{
+    struct evt_topic_state* ts;
+
+    if (topic >= EVT_NUM_TOPICS || cb == NULL)
+        return MOD_ERR_ARG;
+
+    ts = &topics[topic];
+    if (ts->num_subs >= EVT_MAX_SUBS) {
+        log_error("evt_subscribe: topic %s full\n", topic_names[topic]);
+        return MOD_ERR_RESOURCE;
+    }
+    ts->subs[ts->num_subs].cb = cb;
+    ts->subs[ts->num_subs].user_data = user_data;
+    ts->num_subs++;
+    return 0;
+}
+
+/*
+ * @brief Publish an event.
+ *
+ * @param[in] evt The event, with topic and data filled in. The pub_cycles
+ *                field is set by this function.
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * The event is copied into a slot in the topic queue, so the caller's copy
+ * can be reused as soon as this function returns.
+ *
+ * This function can be called from an interrupt handler.
+ */
+int32_t evt_publish(struct evt* evt)
+{
+    struct evt_topic_state* ts;
+    uint32_t primask;
+    uint32_t queued;
+    int32_t rc = 0;
+
+    if (evt == NULL || evt->topic >= EVT_NUM_TOPICS)
+        return MOD_ERR_ARG;
+
+    ts = &topics[evt->topic];
+    evt->pub_cycles = tmr_get_cycles();
+
+    // Might be called from an interrupt handler, or with interrupts already
+    // disabled, so restore the previous interrupt state rather than enabling
+    // interrupts.
+    primask = __get_PRIMASK();
+    __disable_irq();
+    queued = ts->put_idx - ts->get_idx;
+    if (queued >= EVT_QUEUE_LEN) {
+        ts->dropped++;
+        rc = MOD_ERR_BUF_OVERRUN;
+    } else {
+        ts->queue[ts->put_idx % EVT_QUEUE_LEN] = *evt;
+        ts->put_idx++;
+        ts->published++;
+        if (queued + 1 > ts->max_queued)
+            ts->max_queued = queued + 1;
+    }
+    __set_PRIMASK(primask);
+    return rc;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Private (static) functions
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * @brief Console command function for "evt status".
+ *
+ * @param[in] argc Number of arguments, including "evt"
+ * @param[in] argv Argument values, including "evt"
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * Command usage: evt status [clear]
+ */
+static int32_t cmd_evt_status(int32_t argc, const char** argv)
+{
+    struct evt_topic_state* ts;
+    uint32_t topic;
+
+    if (argc == 3 && strcasecmp(argv[2], "clear") == 0) {
+        stats_init();
+        return 0;
+    } else if (argc != 2) {
+        printf("Invalid arguments\n");
+        return MOD_ERR_ARG;
+    }
+
+    for (topic = 0; topic < EVT_NUM_TOPICS; topic++) {
+        ts = &topics[topic];
+        printf("%s: subs=%lu published=%lu delivered=%lu dropped=%lu "
+               "max_queued=%lu/%u\n", topic_names[topic], ts->num_subs,
+               ts->published, ts->delivered, ts->dropped, ts->max_queued,
+               EVT_QUEUE_LEN);
+        if (ts->latency_us.samples > 0) {
+            printf(" Delivery latency:\n");
+            stat_hist_print(&ts->latency_us, "us");
+        }
+    }
+    return 0;
+}
+
+/*
+ * @brief Console command function for "evt trace".
+ *
+ * @param[in] argc Number of arguments, including "evt"
+ * @param[in] argv Argument values, including "evt"
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * Command usage: evt trace {on|off}
+ */
+static int32_t cmd_evt_trace(int32_t argc, const char** argv)
+{
+    if (argc == 3 && strcasecmp(argv[2], "on") == 0) {
+        trace_on = true;
+    } else if (argc == 3 && strcasecmp(argv[2], "off") == 0) {
+        trace_on = false;
+    } else {
+        printf("Invalid arguments\n");
+        return MOD_ERR_ARG;
+    }
+    return 0;
+}
+
+/*
+ * @brief Clear the per-topic statistics.
+ */
+static void stats_init(void)
+{
+    struct evt_topic_state* ts;
+    uint32_t topic;
+
+    for (topic = 0; topic < EVT_NUM_TOPICS; topic++) {
+        ts = &topics[topic];
+        ts->published = 0;
+        ts->delivered = 0;
+        ts->dropped = 0;
+        ts->max_queued = 0;
+        stat_hist_init(&ts->latency_us, cfg.latency_bin_us);
+    }
+}
+
+/*
+ * @brief Log an event being delivered.
+ *
+ * @param[in] evt The event.
+ */
+static void trace_evt(const struct evt* evt)
+{
+    switch (evt->topic) {
+        case EVT_TOPIC_GPS_CYCLE:
+            printf("evt %s: inst=%u sats=%u valid=%d utc=%lu\n",
+                   topic_names[evt->topic], evt->data.gps_cycle.instance_id,
+                   evt->data.gps_cycle.num_sats, evt->data.gps_cycle.fix_valid,
+                   evt->data.gps_cycle.utc_sec);
+            break;
+        case EVT_TOPIC_DIO_EDGE:
+        case EVT_TOPIC_DIO_BUTTON:
+            printf("evt %s: din=%u value=%u cycles=%lu\n",
+                   topic_names[evt->topic], evt->data.dio_edge.din_idx,
+                   evt->data.dio_edge.value, evt->data.dio_edge.cycles);
+            break;
+        case EVT_TOPIC_TTYS_LINE:
+            printf("evt %s: inst=%u len=%u\n", topic_names[evt->topic],
+                   evt->data.ttys_line.instance_id, evt->data.ttys_line.len);
+            break;
+        default:
+            break;
+    }
+}
@@ -9,10 +9,71 @@
  * - Parsing of the GGPS GTU7 output messages that contain satellite positions.
  * - Map satellite positions to a 2-D grid, and plot it to the console, using
  *   ANSI escape sequences so the satellite map stays at a fixed position.
+ * - Parsing of the UTC time in the RMC message, and capture of the PPS edges
+ *   (dio edge events, from the interrupt handler). The edges are passed to
+ *   the tmr module, and the UTC time is published in the EVT_TOPIC_GPS_CYCLE
+ *   event (see below) for the application to pass on. The tmr module uses
+ *   them to discipline its timebase and provide UTC time.
+ * - Configuration of the receiver at start, using UBX protocol CFG messages:
+ *   the baud rate (CFG-PRT), which NMEA messages are output (CFG-MSG), and the
+ *   update rate (CFG-RATE). Each message is retried until acknowledged
+ *   (ACK-ACK/ACK-NAK). The receiver does not acknowledge a baud rate change, so
+ *   the following message is used to check the link at the new baud rate, and
+ *   if that fails, the original baud rate is restored.
+ * - Selection of the receiver output protocol, either NMEA (ASCII) or UBX
+ *   (binary). For UBX, the NAV-PVT (fix and time) and NAV-SVINFO (satellites)
+ *   messages are enabled, and decoded directly into the same data structures
+ *   as the NMEA messages. NAV-SAT, the newer replacement for NAV-SVINFO, is
+ *   decoded as well, if the receiver sends it.
+ * - Throughput measurements (bytes and CPU cycles per navigation epoch), to
+ *   compare the protocols.
+ * - NMEA checksum validation. Sentences with a bad or missing checksum (e.g.
+ *   truncated by a receive overrun) are dropped.
+ * - A history of SNR samples for each satellite, at a configurable
+ *   decimation, with running mean/min/max and a dropout count, displayed as a
+ *   sparkline. A satellite missing from a report cycle (GSV sequence or UBX
+ *   message) adds a dropout, as does a reported SNR of 0. Memory use is
+ *   fixed, no matter how long the unit runs.
+ * - An NMEA message filter, called by ttys as characters arrive (in the UART
+ *   interrupt). It looks at the message type in the "$ttSSS" prefix, and drops
+ *   unwanted messages before they use receive buffer space or super loop time.
+ *   UBX frames are passed, using their length field to find their end.
+ * - Health measurements: messages per second by type, the latency from
+ *   message arrival (in the receive filter) to processing, the interval
+ *   between navigation epochs, time-to-first-fix, and time-to-N-satellites.
+ *   Checksum failures and truncated messages are counted for each
+ *   instance.
+ * - An NMEA load generator, for stress testing the receive and parse path.
+ *   It synthesizes RMC, GGA and GSV sentences (valid checksums) for a
+ *   configurable number of satellites and epoch rate, and sends them out
+ *   UART1, to be looped back into the receive UART of a gps instance (with
+ *   the receiver disconnected). Overrun and parse counters can then be
+ *   measured well beyond the receiver's normal load.
+ * - Dilution of precision (GDOP/PDOP/HDOP/VDOP/TDOP) computed on board from
+ *   the directions of the tracked satellites, using the dop utility
+ *   (fixed-point), with a self test against a double-precision reference.
+ * - An EVT_TOPIC_GPS_CYCLE event published at the end of each navigation
+ *   epoch (RMC or NAV-PVT message), so other modules can react to updates.
+ *   The UTC time in the event is only set if the epoch's message had a valid
+ *   time.
+ *
+ * Multiple receivers are supported, each handled by a module instance with
+ * its own ttys instance and data. A single run function and cleanup timer
+ * service all started instances. The console commands apply to the instance
+ * selected by "gps inst".
  *
  * The following console commands are provided:
+ * > gps inst
  * > gps status
  * > gps map
+ * > gps rcvr
+ * > gps proto
+ * > gps tput
+ * > gps snr
+ * > gps filter
+ * > gps health
+ * > gps gen
+ * > gps dop
  * See code for details.
  *
  * MIT License
@@ -44,9 +105,13 @@
 #include <stdlib.h>
 
 #include "cmd.h"
+#include "dio.h"
+#include "dop.h"
+#include "evt.h"
 #include "gps_gtu7.h"
 #include "log.h"
 #include "module.h"
+#include "stat.h"
 #include "tmr.h"
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -56,51 +121,362 @@
 #define GPS_IN_BFR_SIZE 80
 #define MAX_SATS 32
 #define CLEANUP_TMR_MS 5000
+#define SNR_HIST_LEN 64
+#define SNR_SPARK_MAX 50 // SNR for the top sparkline level.
+
+// NMEA load generator.
+#define GEN_TTYS_INSTANCE TTYS_INSTANCE_UART1
+#define GEN_MAX_RATE_HZ 100
+#define GEN_BFR_SIZE 84 // Max NMEA sentence (82) plus margin.
+#define GEN_SATS_PER_GSV 4
+
+// DOP self test.
+#define DOP_TEST_MAX_GDOP_X100 2000
+#define DOP_TEST_MAX_ERR_X100 5
+
+// Receiver configuration.
+#define GPS_RCVR_DEF_BAUD 9600      // Receiver factory baud rate.
+#define RCVR_CFG_DELAY_MS 1000      // Time for receiver to boot.
+#define RCVR_CFG_BAUD_SETTLE_MS 100 // Time for receiver to change baud rate.
+#define RCVR_CFG_ACK_TMO_MS 500
+#define RCVR_CFG_MAX_TRIES 3
+#define RCVR_CFG_MAX_CMDS 12
+#define RCVR_CFG_MAX_PAYLOAD 20
+
+// UBX protocol.
+#define UBX_SYNC1 0xb5
+#define UBX_SYNC2 0x62
+#define UBX_CLASS_ACK 0x05
+#define UBX_ID_ACK_NAK 0x00
+#define UBX_ID_ACK_ACK 0x01
+#define UBX_CLASS_CFG 0x06
+#define UBX_ID_CFG_PRT 0x00
+#define UBX_ID_CFG_MSG 0x01
+#define UBX_ID_CFG_RATE 0x08
+#define UBX_CLASS_NAV 0x01
+#define UBX_ID_NAV_PVT 0x07
+#define UBX_ID_NAV_SVINFO 0x30
+#define UBX_ID_NAV_SAT 0x35
+#define UBX_CLASS_NMEA 0xf0
+#define UBX_NAV_PVT_MIN_LEN 84
+#define UBX_MAX_PAYLOAD (8 + 12 * 40) // NAV-SVINFO/NAV-SAT for 40 satellites.
 
 ////////////////////////////////////////////////////////////////////////////////
 // Type definitions
 ////////////////////////////////////////////////////////////////////////////////
 
+// SNR history. The ring holds every sample (including 0, meaning not
+// tracked or missing from a report cycle), while the statistics only include
+// tracked samples.
+struct snr_hist {
+    uint8_t samples[SNR_HIST_LEN]; // Ring buffer, oldest at head.
+    uint8_t head;
+    uint8_t num;
+    uint8_t min;
+    uint8_t max;
+    uint16_t decim_cnt;
+    uint64_t sum;
+    uint32_t cnt;
+    uint32_t dropouts; // Samples with SNR 0.
+};
+
 struct sat_data {
     uint32_t last_update_ms;  // Used to detect disappering satellites.
     uint16_t azimuth;   // 0-359 degress
     uint8_t present;    // 1 if satellite being reported.
     uint8_t elevation;  // 0-90 maximum
     uint8_t snr;        // 0-99 dB
+    bool cycle_updated; // Reported in the current report cycle.
+    struct snr_hist snr_hist;
+};
+
+// UTC time from the RMC message.
+struct gps_utc {
+    uint32_t epoch_sec;     // Seconds since 1970-01-01.
+    uint32_t rx_ms;         // ms time the message was processed.
+    uint16_t year;
+    uint8_t month;
+    uint8_t day;
+    uint8_t hour;
+    uint8_t min;
+    uint8_t sec;
+    bool valid;
+};
+
+// Position fix. Fields marked (U) are only available with UBX protocol.
+struct gps_fix {
+    int32_t lat;        // Latitude, 1e-7 degrees.
+    int32_t lon;        // Longitude, 1e-7 degrees.
+    int32_t height_mm;  // (U) Height above mean sea level.
+    uint32_t h_acc_mm;  // (U) Horizontal accuracy estimate.
+    uint32_t rx_ms;     // ms time the message was processed.
+    uint8_t fix_type;   // (U) 0=none, 2=2D, 3=3D, ...
+    uint8_t num_sv;     // (U) Satellites used in the fix.
+    bool valid;
+};
+
+// NMEA load generator. It sends one sentence at a time, as TX buffer space
+// allows, and starts a new epoch every period_ms.
+struct nmea_gen {
+    bool on;
+    uint32_t rate_hz;
+    uint32_t num_sats;
+    uint32_t period_ms;
+    uint32_t next_ms;        // ms time to start the next epoch.
+    uint32_t start_ms;
+    uint32_t tod_ms;         // Simulated UTC time of day.
+    uint32_t rand;
+    char time_str[10];       // hhmmss.ss for the current epoch.
+    uint32_t sentence_idx;   // Next sentence of the epoch to build.
+    uint32_t num_sentences;  // Sentences per epoch.
+    char bfr[GEN_BFR_SIZE];  // Sentence being sent.
+    uint32_t bfr_len;
+    uint32_t bfr_idx;
+    enum gps_instance_id instance_id; // Instance looped back to.
+    uint16_t start_cksum_errs; // Instance counters at start.
+    uint16_t start_truncs;
+    uint32_t epochs;
+    uint32_t late_epochs;    // Epochs started a full period late.
+    uint32_t sentences;
+    uint32_t bytes;
+};
+
+// NMEA receive filter. It runs in the UART interrupt handler.
+#define NMEA_PREFIX_LEN 6 // "$ttSSS", tt = talker, SSS = sentence type.
+#define NMEA_NUM_MSG_IDS 9
+
+// Health measurements.
+#define HEALTH_RATE_PERIOD_MS 1000
+
+// Arrival times of the last ARRIVAL_RING_SIZE lines passed by the receive
+// filter, indexed by line sequence number. The filter puts a tag byte with the
+// low bits of the sequence number before each line end. It is a control
+// character, which the parser would otherwise ignore.
+#define ARRIVAL_RING_SIZE 8
+#define ARRIVAL_TAG_BASE 0x10
+#define ARRIVAL_TAG_MASK 0x0f
+#define ARRIVAL_NO_TAG -1
+
+enum filter_state {
+    FILTER_IDLE,   // Between messages.
+    FILTER_PREFIX, // Collecting NMEA prefix.
+    FILTER_PASS,   // Passing NMEA message.
+    FILTER_DROP,   // Dropping NMEA message.
+    FILTER_UBX,    // Passing UBX frame.
+};
+
+struct nmea_filter {
+    enum filter_state state;
+    char prefix[NMEA_PREFIX_LEN];
+    uint8_t prefix_len;
+    uint16_t ubx_idx;       // Index of UBX frame byte.
+    uint16_t ubx_remaining; // UBX bytes remaining after the header.
+    uint32_t accepted;
+    uint32_t dropped;
+    uint8_t arrival_seq;    // Sequence number of the next line.
+    uint8_t arrival_seqs[ARRIVAL_RING_SIZE];
+    uint32_t arrival_cyc[ARRIVAL_RING_SIZE];
+};
+
+// Health measurements. Arrival times are recorded by the receive filter, see
+// ARRIVAL_RING_SIZE.
+struct gps_health {
+    uint32_t msg_cnts[NMEA_NUM_MSG_IDS];
+    uint32_t msg_cnts_prev[NMEA_NUM_MSG_IDS];
+    uint16_t msg_rates[NMEA_NUM_MSG_IDS]; // Messages in the last period.
+    uint16_t nmea_cksum_errs;
+    uint16_t nmea_truncs;
+    uint32_t rate_ms;        // Start of the current rate period.
+    uint32_t ttff_ms;        // Time to first fix, 0 if none yet.
+    uint32_t ttns_ms;        // Time to N satellites, 0 if not yet.
+    uint32_t last_epoch_ms;
+    struct stat_hist latency_us;
+    struct stat_hist epoch_interval_ms;
+};
+
+// Throughput measurements, per protocol.
+struct gps_tput {
+    uint32_t bytes;
+    uint32_t epochs;
+    uint64_t cycles;
+};
+
+// UBX frame receiver.
+enum ubx_rx_state {
+    UBX_RX_IDLE,
+    UBX_RX_SYNC2,
+    UBX_RX_CLASS,
+    UBX_RX_ID,
+    UBX_RX_LEN1,
+    UBX_RX_LEN2,
+    UBX_RX_PAYLOAD,
+    UBX_RX_CK_A,
+    UBX_RX_CK_B,
+};
+
+struct ubx_rx {
+    enum ubx_rx_state state;
+    uint8_t cls;
+    uint8_t id;
+    uint16_t len;
+    uint16_t idx;
+    uint8_t ck_a;
+    uint8_t ck_b;
+    uint8_t payload[UBX_MAX_PAYLOAD];
+};
+
+// A receiver configuration command (UBX CFG message).
+enum rcvr_cmd_result {
+    RCVR_CMD_PENDING,
+    RCVR_CMD_SENT,      // Sent, no acknowledgement expected.
+    RCVR_CMD_ACK,
+    RCVR_CMD_NAK,
+    RCVR_CMD_FAIL,      // No acknowledgement.
+};
+
+struct rcvr_cmd {
+    uint8_t id;
+    uint8_t len;
+    uint8_t payload[RCVR_CFG_MAX_PAYLOAD];
+    enum rcvr_cmd_result result;
+};
+
+enum rcvr_cfg_state {
+    RCVR_CFG_OFF,
+    RCVR_CFG_DELAY,
+    RCVR_CFG_SEND,
+    RCVR_CFG_WAIT_TX,
+    RCVR_CFG_WAIT_ACK,
+    RCVR_CFG_DONE,
+};
+
+struct rcvr_cfg {
+    enum rcvr_cfg_state state;
+    struct rcvr_cmd cmds[RCVR_CFG_MAX_CMDS];
+    uint32_t num_cmds;
+    uint32_t cmd_idx;
+    uint32_t tries;
+    uint32_t state_ms;   // ms time of entering current state.
+    bool baud_switched;  // Local baud rate changed to cfg.baud.
+    bool link_ok;        // Got an acknowledgement since the baud rate change.
 };
 
 struct gps_state {
-    enum ttys_instance_id ttys_instance_id;
+    struct gps_cfg cfg;
+    struct gps_utc utc;
+    struct gps_fix fix;
+    struct gps_tput tput[GPS_NUM_PROTOCOLS];
+    struct ubx_rx ubx_rx;
+    struct rcvr_cfg rcvr;
     char in_bfr[GPS_IN_BFR_SIZE];
     uint16_t in_bfr_chars;
+    bool in_bfr_overflow; // Discarding rest of a too-long line.
+    int16_t arrival_tag;  // Arrival tag of the current line, or ARRIVAL_NO_TAG.
+    struct nmea_filter filter;
+    struct gps_health health;
     struct sat_data sat_data[MAX_SATS];
     bool disp_map_on;
     bool disp_map_clear_screen;
     bool disp_map_update;
     bool disp_map_clear_history;
-    int32_t cleanup_tmr_id;
+    bool started;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
 // Private (static) function declarations
 ////////////////////////////////////////////////////////////////////////////////
 
+static int32_t cmd_gps_inst(int32_t argc, const char** argv);
 static int32_t cmd_gps_status(int32_t argc, const char** argv);
 static int32_t cmd_gps_map(int32_t argc, const char** argv);
+static int32_t cmd_gps_rcvr(int32_t argc, const char** argv);
+static int32_t cmd_gps_proto(int32_t argc, const char** argv);
+static int32_t cmd_gps_tput(int32_t argc, const char** argv);
+static int32_t cmd_gps_snr(int32_t argc, const char** argv);
+static int32_t cmd_gps_filter(int32_t argc, const char** argv);
+static int32_t cmd_gps_health(int32_t argc, const char** argv);
+static int32_t cmd_gps_gen(int32_t argc, const char** argv);
+static int32_t cmd_gps_dop(int32_t argc, const char** argv);
+static int32_t dop_test(uint32_t trials);
 
-static void process_msg(char* msg);
+static uint32_t nmea_filter_cb(char c, char* out, uint32_t user_data);
+static void pps_edge_cb(const struct dio_edge* edge, uint32_t user_data);
+static int32_t nmea_prefix_to_msg_id(const char* prefix);
+static void process_byte(struct gps_state* st, char c);
+static void health_init(struct gps_state* st);
+static void health_run(struct gps_state* st);
+static uint32_t health_arrival_put(struct gps_state* st, char* out);
+static void health_line_end(struct gps_state* st);
+static void health_epoch(struct gps_state* st, enum gps_protocol protocol);
+static void health_fix(struct gps_state* st);
+static void health_sat_added(struct gps_state* st);
+static void publish_cycle(struct gps_state* st);
+static void gen_run(void);
+static void gen_start_epoch(void);
+static void gen_build_sentence(uint32_t sentence_idx);
+static void gen_finish_sentence(uint32_t len);
+static bool nmea_check(struct gps_state* st, char* msg);
+static void process_msg(struct gps_state* st, char* msg);
+static void process_rmc_time(struct gps_state* st, const char* time_str,
+                             const char* date_str);
+static uint32_t two_digits(const char* str);
+static void process_rmc_pos(struct gps_state* st, const char* lat_str,
+                            const char* ns_str, const char* lon_str,
+                            const char* ew_str);
+static int32_t nmea_to_deg_1e7(const char* str);
+static void set_utc(struct gps_state* st, uint32_t year, uint32_t month,
+                    uint32_t day, uint32_t hour, uint32_t min, uint32_t sec);
+static void update_sat(struct gps_state* st, int32_t sat_idx, uint8_t elevation,
+                       uint16_t azimuth, uint8_t snr);
+static void update_snr_hist(struct snr_hist* hist, uint8_t snr,
+                            uint16_t decimation);
+static void sat_cycle_end(struct gps_state* st);
+static void process_nav_pvt(struct gps_state* st, const uint8_t* payload,
+                            uint16_t len);
+static void process_nav_svinfo(struct gps_state* st, const uint8_t* payload,
+                               uint16_t len);
+static void process_nav_sat(struct gps_state* st, const uint8_t* payload,
+                            uint16_t len);
+static uint32_t utc_to_epoch(uint32_t year, uint32_t month, uint32_t day,
+                             uint32_t hour, uint32_t min, uint32_t sec);
 static char sat_idx_to_char(int32_t sat_idx);
 static char* csv_get_token(char* start, char** next_start);
-static void display_map(void);
+static void display_map(struct gps_state* st);
 static enum tmr_cb_action cleanup_tmr_cb(int32_t tmr_id, uint32_t user_data);
+static bool ubx_rx_byte(struct gps_state* st, uint8_t c);
+static void process_ubx_msg(struct gps_state* st, uint8_t cls, uint8_t id,
+                            const uint8_t* payload, uint16_t len);
+static int32_t ubx_send(struct gps_state* st, uint8_t cls, uint8_t id,
+                        const uint8_t* payload, uint16_t len);
+static void rcvr_cfg_build(struct gps_state* st);
+static void rcvr_cfg_run(struct gps_state* st);
+static void rcvr_cfg_next_cmd(struct gps_state* st);
+static int32_t rcvr_cfg_restart(struct gps_state* st);
+static void put_u16_le(uint8_t* p, uint16_t value);
+static void put_u32_le(uint8_t* p, uint32_t value);
+static uint16_t get_u16_le(const uint8_t* p);
+static uint32_t get_u32_le(const uint8_t* p);
 
 ////////////////////////////////////////////////////////////////////////////////
 // Private (static) variables
 ////////////////////////////////////////////////////////////////////////////////
 
-static struct gps_state gps_state;
+static struct gps_state gps_states[GPS_NUM_INSTANCES];
+
+// Shared by all instances.
+static int32_t cleanup_tmr_id = -1;
+
+// Instance the console commands apply to.
+static enum gps_instance_id cmd_instance_id;
+
+static struct nmea_gen gen;
 
 static struct cmd_cmd_info cmds[] = {
+    {
+        .name = "inst",
+        .func = cmd_gps_inst,
+        .help = "Select instance for other commands, usage: gps inst [<id>]",
+    },
     {
         .name = "status",
         .func = cmd_gps_status,
@@ -110,16 +486,87 @@ static struct cmd_cmd_info cmds[] = {
         .name = "map",
         .func = cmd_gps_map,
         .help = "Map display on/off/clear, usage: gps map {on|off|clear}",
-    }
+    },
+    {
+        .name = "rcvr",
+        .func = cmd_gps_rcvr,
+        .help = "Get receiver config status, usage: gps rcvr [restart]",
+    },
+    {
+        .name = "proto",
+        .func = cmd_gps_proto,
+        .help = "Set receiver protocol, usage: gps proto {nmea|ubx}",
+    },
+    {
+        .name = "tput",
+        .func = cmd_gps_tput,
+        .help = "Get protocol throughput, usage: gps tput [clear]",
+    },
+    {
+        .name = "snr",
+        .func = cmd_gps_snr,
+        .help = "Get SNR history, usage: gps snr [prn]",
+    },
+    {
+        .name = "filter",
+        .func = cmd_gps_filter,
+        .help = "NMEA RX filter, usage: gps filter [on|off|clear]",
+    },
+    {
+        .name = "health",
+        .func = cmd_gps_health,
+        .help = "Get receiver health, usage: gps health [clear]",
+    },
+    {
+        .name = "gen",
+        .func = cmd_gps_gen,
+        .help = "NMEA load generator, usage: gps gen [off | <rate-hz> "
+        "<num-sats> [baud]]",
+    },
+    {
+        .name = "dop",
+        .func = cmd_gps_dop,
+        .help = "Get DOP from tracked sats, usage: gps dop [test [trials]]",
+    },
 };
 
 static int32_t log_level = LOG_DEFAULT;
 
+enum gps_u16_pms {
+    CNT_UBX_CKSUM_ERR,
+    CNT_UBX_TOO_LONG,
+    CNT_RCVR_CFG_NAK,
+    CNT_RCVR_CFG_FAIL,
+    CNT_RCVR_BAUD_FAIL,
+    CNT_ARRIVAL_LOST,
+
+    NUM_U16_PMS
+};
+
+static uint16_t cnts_u16[NUM_U16_PMS];
+
+static const char* cnts_u16_names[NUM_U16_PMS] = {
+    "ubx checksum err",
+    "ubx msg too long",
+    "rcvr cfg nak",
+    "rcvr cfg no ack",
+    "rcvr baud change fail",
+    "arrival time lost",
+};
+
 static struct cmd_client_info cmd_info = {
     .name = "gps",
     .num_cmds = ARRAY_SIZE(cmds),
     .cmds = cmds,
     .log_level_ptr = &log_level,
+    .num_u16_pms = NUM_U16_PMS,
+    .u16_pms = cnts_u16,
+    .u16_pm_names = cnts_u16_names,
+};
+
+// NMEA message names, indexed by UBX message ID.
+static const char* nmea_msg_names[NMEA_NUM_MSG_IDS] = {
+    "GGA", "GLL", "GSA", "GSV", "RMC", "VTG", NULL, NULL, "ZDA",
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -133,103 +580,200 @@ static struct cmd_client_info cmd_info = {
 /*
  * @brief Get default gps configuration.
  *
+ * @param[in] instance_id Identifies the gps instance.
  * @param[out] cfg The gps configuration with defaults filled in.
  *
  * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * Instance 1 uses UART6 and the PPS input. Other instances use the software
+ * UART, without PPS (UART1 is used by the load generator, and UART2 by the
+ * console). The PPS dio input index has no default, and must be set if PPS is
+ * enabled.
  */
-int32_t gps_get_def_cfg(struct gps_cfg* cfg)
+int32_t gps_get_def_cfg(enum gps_instance_id instance_id, struct gps_cfg* cfg)
 {
-    if (cfg == NULL)
+    if (instance_id >= GPS_NUM_INSTANCES || cfg == NULL)
         return MOD_ERR_ARG;
 
     memset(cfg, 0, sizeof(*cfg));
-    cfg->ttys_instance_id = TTYS_INSTANCE_UART6;
+    cfg->pps_din_idx = -1;
+    if (instance_id == GPS_INSTANCE_1) {
+        cfg->ttys_instance_id = TTYS_INSTANCE_UART6;
+        cfg->pps_enable = true;
+    } else {
+        cfg->ttys_instance_id = TTYS_INSTANCE_SWUART;
+        cfg->pps_enable = false;
+    }
+    cfg->protocol = GPS_PROTOCOL_NMEA;
+    cfg->rcvr_cfg_enable = true;
+    cfg->nmea_msgs = GPS_NMEA_GSV | GPS_NMEA_RMC;
+    cfg->meas_rate_ms = 1000;
+    cfg->baud = 38400;
+    cfg->snr_decimation = 10;
+    cfg->nmea_filter_enable = true;
+    cfg->nmea_filter_msgs = GPS_NMEA_GSV | GPS_NMEA_RMC;
+    cfg->ttns_num_sats = 4;
+    cfg->latency_bin_us = 1000;
+    cfg->epoch_interval_bin_ms = 200;
     return 0;
 }
 
 /*
  * @brief Initialize gps module instance.
  *
+ * @param[in] instance_id Identifies the gps instance.
  * @param[in] cfg The gps module configuration.
  *
  * @return 0 for success, else a "MOD_ERR" value. See code for details.
  *
- * This function initializes a gps singleton module. Generally, it should not
+ * This function initializes a gps module instance. Generally, it should not
  * access other modules as they might not have been initialized yet.
  */
-int32_t gps_init(struct gps_cfg* cfg)
+int32_t gps_init(enum gps_instance_id instance_id, struct gps_cfg* cfg)
 {
-    if (cfg == NULL) {
+    struct gps_state* st;
+
+    if (instance_id >= GPS_NUM_INSTANCES || cfg == NULL) {
         return MOD_ERR_ARG;
     }
-    memset(&gps_state, 0, sizeof(gps_state));
-    gps_state.ttys_instance_id = cfg->ttys_instance_id;
-    gps_state.disp_map_clear_history = true;
+    st = &gps_states[instance_id];
+    memset(st, 0, sizeof(*st));
+    st->cfg = *cfg;
+    st->arrival_tag = ARRIVAL_NO_TAG;
+    if (st->cfg.snr_decimation == 0)
+        st->cfg.snr_decimation = 1;
+    health_init(st);
+    st->disp_map_clear_history = true;
     return 0;
 }
 
 /*
  * @brief Start gps module instance.
  *
+ * @param[in] instance_id Identifies the gps instance.
+ *
  * @return 0 for success, else a "MOD_ERR" value. See code for details.
  *
- * This function starts a gps module instance, to enter normal operation.
+ * This function starts a gps module instance, to enter normal operation. The
+ * console commands and cleanup timer are set up when the first instance is
+ * started. The ttys instance must not be used by another started instance, or
+ * by the load generator.
  */
-int32_t gps_start(void)
+int32_t gps_start(enum gps_instance_id instance_id)
 {
+    struct gps_state* st;
+    enum gps_instance_id idx;
     int32_t result;
 
-    cmd_register(&cmd_info);
-    result = cmd_register(&cmd_info);
-    if (result < 0) {
-        log_error("gps_start: cmd error %d\n", result);
+    if (instance_id >= GPS_NUM_INSTANCES)
+        return MOD_ERR_BAD_INSTANCE;
+    st = &gps_states[instance_id];
+    if (st->started)
+        return MOD_ERR_STATE;
+    if (st->cfg.ttys_instance_id == GEN_TTYS_INSTANCE) {
+        log_error("gps_start: ttys %d used by load generator\n",
+                  st->cfg.ttys_instance_id);
         return MOD_ERR_RESOURCE;
     }
-    gps_state.cleanup_tmr_id = tmr_inst_get_cb(CLEANUP_TMR_MS,
-                                               cleanup_tmr_cb,
-                                               0);
-    if (gps_state.cleanup_tmr_id < 0) {
-        log_error("gps_start: tmr error %d\n", gps_state.cleanup_tmr_id);
-        return MOD_ERR_RESOURCE;
+    for (idx = 0; idx < GPS_NUM_INSTANCES; idx++) {
+        if (gps_states[idx].started &&
+            gps_states[idx].cfg.ttys_instance_id == st->cfg.ttys_instance_id) {
+            log_error("gps_start: ttys %d in use by instance %d\n",
+                      st->cfg.ttys_instance_id, idx);
+            return MOD_ERR_RESOURCE;
+        }
+    }
+    if (st->cfg.pps_enable) {
+        if (st->cfg.pps_din_idx < 0) {
+            log_error("gps_start: PPS dio input not set\n");
+            return MOD_ERR_ARG;
+        }
+        for (idx = 0; idx < GPS_NUM_INSTANCES; idx++) {
+            if (gps_states[idx].started && gps_states[idx].cfg.pps_enable) {
+                log_error("gps_start: PPS in use by instance %d\n", idx);
+                return MOD_ERR_RESOURCE;
+            }
+        }
+    }
+
+    if (cleanup_tmr_id < 0) {
+        result = cmd_register(&cmd_info);
+        if (result < 0) {
+            log_error("gps_start: cmd error %d\n", result);
+            return MOD_ERR_RESOURCE;
+        }
+        cleanup_tmr_id = tmr_inst_get_cb(CLEANUP_TMR_MS, cleanup_tmr_cb, 0);
+        if (cleanup_tmr_id < 0) {
+            log_error("gps_start: tmr error %d\n", cleanup_tmr_id);
+            return MOD_ERR_RESOURCE;
+        }
+        cmd_instance_id = instance_id;
+    }
+
+    if (st->cfg.rcvr_cfg_enable) {
+        rcvr_cfg_build(st);
+        st->rcvr.state = RCVR_CFG_DELAY;
+        st->rcvr.state_ms = tmr_get_ms();
     }
 
+    if (st->cfg.nmea_filter_enable)
+        ttys_set_rx_filter(st->cfg.ttys_instance_id, nmea_filter_cb,
+                           instance_id);
+
+    if (st->cfg.pps_enable) {
+        // The PPS input must be configured for rising edge events in the dio
+        // module, preferably using timer capture. The callback is called from
+        // the interrupt handler, to minimize latency.
+        result = dio_set_edge_isr_cb(st->cfg.pps_din_idx, pps_edge_cb, 0);
+        if (result < 0) {
+            log_error("gps_start: PPS dio error %d\n", result);
+            return MOD_ERR_RESOURCE;
+        }
+    }
+    st->started = true;
     return 0;
 }
 
 /*
- * @brief Run gps module instance.
+ * @brief Run gps module.
  *
  * @return 0 for success, else a "MOD_ERR" value. See code for details.
  *
+ * All started instances are serviced in one pass.
+ *
  * @note This function should not block.
  */
 int32_t gps_run(void)
 {
+    struct gps_state* st;
     char c;
-    while (ttys_getc(gps_state.ttys_instance_id, &c)) {
-        if (c == '\n' || c == '\r') {
-            if (gps_state.in_bfr_chars > 0) {
-                gps_state.in_bfr[gps_state.in_bfr_chars] = '\0';
-                process_msg(gps_state.in_bfr);
-                gps_state.in_bfr_chars = 0;
-            }
+    uint32_t start_cyc;
+    uint32_t bytes;
+
+    for (st = gps_states; st < &gps_states[GPS_NUM_INSTANCES]; st++) {
+        if (!st->started)
             continue;
+
+        rcvr_cfg_run(st);
+
+        bytes = 0;
+        start_cyc = tmr_get_cycles();
+        while (ttys_getc(st->cfg.ttys_instance_id, &c)) {
+            bytes++;
+            process_byte(st, c);
         }
-        if (isprint(c)) {
-            if (gps_state.in_bfr_chars < (GPS_IN_BFR_SIZE-1)) {
-                gps_state.in_bfr[gps_state.in_bfr_chars++] = c;
-            } else {
-                gps_state.in_bfr[GPS_IN_BFR_SIZE-1] = '\0';
-                log_debug("Truncated: %s\n", gps_state.in_bfr);
-                gps_state.in_bfr_chars = 0;
-            }
-            continue;
+        if (bytes > 0) {
+            struct gps_tput* tput = &st->tput[st->cfg.protocol];
+            tput->cycles += tmr_get_cycles() - start_cyc;
+            tput->bytes += bytes;
+        }
+        health_run(st);
+        if (st->disp_map_on && st->disp_map_update) {
+            display_map(st);
+            st->disp_map_update = false;
         }
     }
-    if (gps_state.disp_map_on && gps_state.disp_map_update) {
-        display_map();
-        gps_state.disp_map_update = false;
-    }
+    gen_run();
     return 0;
 }
 
@@ -237,6 +781,69 @@ int32_t gps_run(void)
 // Private (static) functions
 ////////////////////////////////////////////////////////////////////////////////
 
+/*
+ * @brief PPS edge callback, called from the dio interrupt handler.
+ *
+ * @param[in] edge The edge event.
+ * @param[in] user_data Not used.
+ */
+static void pps_edge_cb(const struct dio_edge* edge, uint32_t user_data)
+{
+    tmr_pps_edge(edge->cycles);
+}
+
+/*
+ * @brief Console command function for "gps inst".
+ *
+ * @param[in] argc Number of arguments, including "gps"
+ * @param[in] argv Argument values, including "gps"
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * Command usage: gps inst [<id>]
+ *
+ * Without an ID, the instances are listed.
+ */
+static int32_t cmd_gps_inst(int32_t argc, const char** argv)
+{
+    struct cmd_arg_val arg_vals[1];
+    enum gps_instance_id idx;
+    struct gps_state* st;
+
+    if (cmd_parse_args(argc-2, argv+2, "[u]", arg_vals) < 0)
+        return MOD_ERR_BAD_CMD;
+
+    if (argc == 2) {
+        for (idx = 0; idx < GPS_NUM_INSTANCES; idx++) {
+            st = &gps_states[idx];
+            printf("%c%d: %s ttys=%d pps=%d\n",
+                   idx == cmd_instance_id ? '*' : ' ', idx,
+                   st->started ? "started" : "not started",
+                   st->cfg.ttys_instance_id, st->cfg.pps_enable);
+        }
+        return 0;
+    }
+    if (arg_vals[0].val.u >= GPS_NUM_INSTANCES ||
+        !gps_states[arg_vals[0].val.u].started) {
+        printf("Instance %lu not started\n", arg_vals[0].val.u);
+        return MOD_ERR_BAD_INSTANCE;
+    }
+    if (arg_vals[0].val.u != cmd_instance_id) {
+        // Only one instance can display the map.
+        st = &gps_states[cmd_instance_id];
+        if (st->disp_map_on) {
+            st->disp_map_on = false;
+            st = &gps_states[arg_vals[0].val.u];
+            st->disp_map_on = true;
+            st->disp_map_clear_screen = true;
+            st->disp_map_clear_history = true;
+            st->disp_map_update = true;
+        }
+        cmd_instance_id = arg_vals[0].val.u;
+    }
+    return 0;
+}
+
 /*
  * @brief Console command function for "gps status".
  *
@@ -249,11 +856,12 @@ int32_t gps_run(void)
  */
 static int32_t cmd_gps_status(int32_t argc, const char** argv)
 {
+    struct gps_state* st = &gps_states[cmd_instance_id];
     int32_t idx;
 
-    printf("Reported satellites:\n");
+    printf("Instance %d reported satellites:\n", cmd_instance_id);
     for (idx = 0; idx < MAX_SATS; idx++) {
-        struct sat_data* sat_data = &gps_state.sat_data[idx];
+        struct sat_data* sat_data = &st->sat_data[idx];
         if (sat_data->present) {
             printf("  %c: azimuth=%3d deg elevation=%2d deg snr=%2d dB "
                    "data-age=%lu ms\n",
@@ -264,7 +872,28 @@ static int32_t cmd_gps_status(int32_t argc, const char** argv)
                    tmr_get_ms() - sat_data->last_update_ms);
         }
     }
-    printf("gps map: %s\n", gps_state.disp_map_on ? "on" : "off");
+    if (st->utc.valid)
+        printf("UTC: %04u-%02u-%02u %02u:%02u:%02u (epoch %lu) "
+               "data-age=%lu ms\n",
+               st->utc.year, st->utc.month, st->utc.day,
+               st->utc.hour, st->utc.min, st->utc.sec,
+               st->utc.epoch_sec,
+               tmr_get_ms() - st->utc.rx_ms);
+    else
+        printf("UTC: not available\n");
+    if (st->fix.valid)
+        printf("Fix: lat=%ld lon=%ld (1e-7 deg) height=%ld mm h-acc=%lu mm "
+               "type=%u num-sv=%u data-age=%lu ms\n",
+               st->fix.lat, st->fix.lon, st->fix.height_mm,
+               st->fix.h_acc_mm, st->fix.fix_type,
+               st->fix.num_sv, tmr_get_ms() - st->fix.rx_ms);
+    else
+        printf("Fix: not available\n");
+    printf("NMEA filter: accepted=%lu dropped=%lu\n", st->filter.accepted,
+           st->filter.dropped);
+    printf("Protocol: %s\n",
+           st->cfg.protocol == GPS_PROTOCOL_UBX ? "ubx" : "nmea");
+    printf("gps map: %s\n", st->disp_map_on ? "on" : "off");
     return 0;
 }
 
@@ -280,6 +909,7 @@ static int32_t cmd_gps_status(int32_t argc, const char** argv)
  */
 static int32_t cmd_gps_map(int32_t argc, const char** argv)
 {
+    struct gps_state* st = &gps_states[cmd_instance_id];
     struct cmd_arg_val arg_vals[1];
     const char* op;
 
@@ -287,12 +917,12 @@ static int32_t cmd_gps_map(int32_t argc, const char** argv)
         return MOD_ERR_BAD_CMD;
     op = arg_vals[0].val.s;
     if (strcasecmp(op, "on") == 0) {
-        gps_state.disp_map_on = true;
-        gps_state.disp_map_clear_screen = true;
+        st->disp_map_on = true;
+        st->disp_map_clear_screen = true;
     } else if (strcasecmp(op, "off") == 0) {
-        gps_state.disp_map_on = false;
+        st->disp_map_on = false;
     } else if (strcasecmp(op, "clear") == 0) {
-        gps_state.disp_map_clear_history = false;
+        st->disp_map_clear_history = false;
     } else {
         printf("Invalid operation '%s'\n", op);
         return MOD_ERR_ARG;
@@ -301,150 +931,1948 @@ static int32_t cmd_gps_map(int32_t argc, const char** argv)
 }
 
 /*
- * @brief Process a message received from the GPS hardware module.
+ * @brief Console command function for "gps rcvr".
  *
- * @param[in] msg GPS hardware module message.
+ * @param[in] argc Number of arguments, including "gps"
+ * @param[in] argv Argument values, including "gps"
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * Command usage: gps rcvr [restart]
  */
-static void process_msg(char* msg)
+static int32_t cmd_gps_rcvr(int32_t argc, const char** argv)
 {
-    enum parse_state {
-        PARSE_STATE_START,
-        PARSE_STATE_GPGSV,
-        PARSE_STATE_IGNORE,
+    struct gps_state* st = &gps_states[cmd_instance_id];
+    static const char* result_names[] = {
+        "pending", "sent", "ack", "nak", "no-ack",
     };
+    struct rcvr_cfg* rc = &st->rcvr;
+    struct rcvr_cmd* cmd;
+    uint32_t idx;
 
-    char* next = msg;
-    enum parse_state parse_state = PARSE_STATE_START;
-    int32_t field_num = 0;
-    int32_t satellite_num = -1;
-    uint16_t msg_azimuth;
-    uint8_t msg_elevation;
-    uint8_t msg_snr;
-    struct sat_data* sat_data;
+    if (argc == 3 && strcasecmp(argv[2], "restart") == 0) {
+        return rcvr_cfg_restart(st);
+    } else if (argc != 2) {
+        printf("Invalid arguments\n");
+        return MOD_ERR_ARG;
+    }
 
-    log_trace("Msg: %s\n", msg);
-    while (1) {
-        if (next == NULL)
-            break;
-        char* token = csv_get_token(next, &next);
-        field_num++;
-        switch (parse_state) {
-            case PARSE_STATE_START:
-                parse_state = strcasecmp(token, "$GPGSV") == 0 ?
-                    PARSE_STATE_GPGSV : PARSE_STATE_IGNORE;
+    printf("Receiver config state=%d baud-switched=%d link-ok=%d\n",
+           rc->state, rc->baud_switched, rc->link_ok);
+    for (idx = 0; idx < rc->num_cmds; idx++) {
+        cmd = &rc->cmds[idx];
+        switch (cmd->id) {
+            case UBX_ID_CFG_PRT:
+                printf("  CFG-PRT baud=%lu", st->cfg.baud);
                 break;
-            case PARSE_STATE_GPGSV:
-                switch ((field_num - 5) % 4) {
-                    case 0:
-                        // Satellite PRN number
-                        satellite_num = atoi(token);
-                        if (satellite_num < 1 || satellite_num > 32) {
-                            log_debug("Unused satellite, number=%s\n", token);
-                            parse_state = PARSE_STATE_IGNORE;
-                        } else {
-                            // Make satellite number zero-based.
-                            satellite_num--;
-                        }
-                        break;
-                    case 1:
-                        // Elevation degress (0-90)
-                        msg_elevation = atoi(token);
-                        break;
-                    case 2:
-                        // Azimuth degress (000-359)
-                        msg_azimuth = atoi(token);
-                        break;
-                    case 3:
-                        // SNR (00-99)
-                        msg_snr = atoi(token);
-                        sat_data = &gps_state.sat_data[satellite_num];
-                        if ((!sat_data->present) ||
-                            (msg_elevation != sat_data->elevation) ||
-                            (msg_azimuth != sat_data->azimuth)) {
-                            log_debug("Update sat %d ele=%d az=%d snr=%d\n",
-                                      satellite_num+1, msg_elevation,
-                                      msg_azimuth, msg_snr);
-                            sat_data->present = true;
-                            sat_data->elevation = msg_elevation;
-                            sat_data->azimuth = msg_azimuth;
-                            gps_state.disp_map_update = true;
-                        }
-                        sat_data->snr = msg_snr;
-                        sat_data->last_update_ms = tmr_get_ms();
-                        break;
-                }
+            case UBX_ID_CFG_MSG:
+                if (cmd->payload[0] == UBX_CLASS_NMEA)
+                    printf("  CFG-MSG %s", nmea_msg_names[cmd->payload[1]]);
+                else
+                    printf("  CFG-MSG NAV-%s", cmd->payload[1] ==
+                           UBX_ID_NAV_PVT ? "PVT" : "SVINFO");
+                printf(" rate=%u", cmd->payload[2]);
+                break;
+            case UBX_ID_CFG_RATE:
+                printf("  CFG-RATE meas-rate=%u ms",
+                       cmd->payload[0] | (cmd->payload[1] << 8));
                 break;
-            case PARSE_STATE_IGNORE:
-                continue;
         }
-        if (next == NULL)
-            break;
+        printf(": %s\n", result_names[cmd->result]);
     }
+    return 0;
 }
 
 /*
- * @brief Convert statellite index of the display char.
+ * @brief Console command function for "gps proto".
  *
- * @param[in] sat_idx Satellite index (zero-based).
+ * @param[in] argc Number of arguments, including "gps"
+ * @param[in] argv Argument values, including "gps"
  *
- * @return The satellite dislay char.
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * Command usage: gps proto {nmea|ubx}
+ *
+ * The receiver is reconfigured for the new protocol.
  */
-static char sat_idx_to_char(int32_t sat_idx)
+static int32_t cmd_gps_proto(int32_t argc, const char** argv)
 {
-    if (sat_idx < 9)
-        return '1' + sat_idx;
-    return 'A' + (sat_idx - 9);
+    struct gps_state* st = &gps_states[cmd_instance_id];
+    struct cmd_arg_val arg_vals[1];
+    const char* op;
+
+    if (cmd_parse_args(argc-2, argv+2, "s", arg_vals) != 1)
+        return MOD_ERR_BAD_CMD;
+    op = arg_vals[0].val.s;
+    if (strcasecmp(op, "nmea") == 0) {
+        st->cfg.protocol = GPS_PROTOCOL_NMEA;
+    } else if (strcasecmp(op, "ubx") == 0) {
+        st->cfg.protocol = GPS_PROTOCOL_UBX;
+    } else {
+        printf("Invalid protocol '%s'\n", op);
+        return MOD_ERR_ARG;
+    }
+    return rcvr_cfg_restart(st);
 }
 
 /*
- * @brief Tokenize a CSV string in-place, incrementally.
+ * @brief Console command function for "gps tput".
  *
- * @param[in] start The current point in the string, typically pointing to the
- *            next token.
- * @param[out] next_start The start of the next token. This should be passed in
- *             as "start" in the next call. If there are no more tokens, it will
- *             be set to NULL.
+ * @param[in] argc Number of arguments, including "gps"
+ * @param[in] argv Argument values, including "gps"
  *
- * @return The next token to process. The token might have zero length (e.g.
- *         in the case of consecutive commas).
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
  *
- * @note The char '*' is also treated as a separator (i.e. like a ',').
+ * Command usage: gps tput [clear]
+ *
+ * For each protocol, the bytes received and the CPU cycles used to receive
+ * and parse them are reported per navigation epoch (an RMC or NAV-PVT
+ * message).
  */
-static char* csv_get_token(char* start, char** next_start)
+static int32_t cmd_gps_tput(int32_t argc, const char** argv)
 {
-    char* p = start;
-    while (*p && *p != ',' && *p != '*') p++;
-    if (*p == ',' || *p == '*') {
-        *p++ = '\0';
-        *next_start = p;
-    } else {
-        *next_start = NULL;
+    struct gps_state* st = &gps_states[cmd_instance_id];
+    static const char* protocol_names[GPS_NUM_PROTOCOLS] = { "nmea", "ubx" };
+    struct gps_tput* tput;
+    uint32_t idx;
+
+    if (argc == 3 && strcasecmp(argv[2], "clear") == 0) {
+        memset(st->tput, 0, sizeof(st->tput));
+        return 0;
+    } else if (argc != 2) {
+        printf("Invalid arguments\n");
+        return MOD_ERR_ARG;
     }
-    return start;
+
+    printf("Proto   Bytes    Epochs   Bytes/ep Cycles/ep  Cycles/byte\n");
+    printf("----- ---------- -------- -------- ---------- -----------\n");
+    for (idx = 0; idx < GPS_NUM_PROTOCOLS; idx++) {
+        tput = &st->tput[idx];
+        printf("%-5s %10lu %8lu %8lu %10lu %11lu\n", protocol_names[idx],
+               tput->bytes, tput->epochs,
+               tput->epochs ? tput->bytes / tput->epochs : 0,
+               tput->epochs ? (uint32_t)(tput->cycles / tput->epochs) : 0,
+               tput->bytes ? (uint32_t)(tput->cycles / tput->bytes) : 0);
+    }
+    return 0;
 }
 
 /*
- * @brief Display the satellite positions as a map.
+ * @brief Console command function for "gps snr".
+ *
+ * @param[in] argc Number of arguments, including "gps"
+ * @param[in] argv Argument values, including "gps"
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * Command usage: gps snr [prn]
+ *
+ * Without a PRN, the SNR statistics of all satellites with history are
+ * listed. With a PRN, the history of that satellite is shown as a sparkline,
+ * oldest sample first.
  */
-static void display_map(void)
+static int32_t cmd_gps_snr(int32_t argc, const char** argv)
 {
-    #define DISP_MAX_RAD 10
-    #define DISP_ROWS (1 + 2*DISP_MAX_RAD)
-    #define DISP_COLS (1 + 2*DISP_MAX_RAD)
-    #define DISP_X_OFFSET DISP_MAX_RAD
-    #define DISP_Y_OFFSET DISP_MAX_RAD
-    #define DEG_TO_RAD(d) ((double)(d) * M_PI / 180.0)
+    struct gps_state* st = &gps_states[cmd_instance_id];
+    static const char levels[] = " _.-~=*#";
+    struct cmd_arg_val arg_vals[1];
+    struct snr_hist* hist;
+    uint32_t prn;
+    uint32_t idx;
+    uint32_t level;
 
-    static char map[DISP_COLS][DISP_ROWS];
-    int32_t idx;
-    int32_t idy;
+    if (cmd_parse_args(argc-2, argv+2, "[u]", arg_vals) < 0)
+        return MOD_ERR_BAD_CMD;
+
+    if (argc == 2) {
+        printf("PRN Mean Min Max  Samples   Dropouts History\n");
+        printf("--- ---- --- --- ---------- -------- -------\n");
+        for (idx = 0; idx < MAX_SATS; idx++) {
+            hist = &st->sat_data[idx].snr_hist;
+            if (hist->num == 0)
+                continue;
+            printf("%3lu %4lu %3u %3u %10lu %8lu %7u\n", idx + 1,
+                   hist->cnt ? (uint32_t)(hist->sum / hist->cnt) : 0, hist->min,
+                   hist->max, hist->cnt, hist->dropouts, hist->num);
+        }
+        return 0;
+    }
+
+    prn = arg_vals[0].val.u;
+    if (prn < 1 || prn > MAX_SATS) {
+        printf("Invalid PRN %lu\n", prn);
+        return MOD_ERR_ARG;
+    }
+    hist = &st->sat_data[prn - 1].snr_hist;
+    if (hist->num == 0) {
+        printf("No history for PRN %lu\n", prn);
+        return 0;
+    }
+    printf("PRN %lu: mean=%lu min=%u max=%u samples=%lu dropouts=%lu "
+           "(1 per %u updates)\n",
+           prn, hist->cnt ? (uint32_t)(hist->sum / hist->cnt) : 0,
+           hist->min, hist->max, hist->cnt, hist->dropouts,
+           st->cfg.snr_decimation);
+    printf("%2u |", SNR_SPARK_MAX);
+    for (idx = 0; idx < hist->num; idx++) {
+        level = hist->samples[(hist->head + idx) % SNR_HIST_LEN];
+        level = CLAMP(level, 0, SNR_SPARK_MAX) * (sizeof(levels) - 2) /
+            SNR_SPARK_MAX;
+        printf("%c", levels[level]);
+    }
+    printf("|\n");
+    return 0;
+}
+
+/*
+ * @brief Console command function for "gps health".
+ *
+ * @param[in] argc Number of arguments, including "gps"
+ * @param[in] argv Argument values, including "gps"
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * Command usage: gps health [clear]
+ *
+ * The clear operation does not clear time-to-first-fix and
+ * time-to-N-satellites, which are measured from boot.
+ */
+static int32_t cmd_gps_health(int32_t argc, const char** argv)
+{
+    struct gps_state* st = &gps_states[cmd_instance_id];
+    struct gps_health* health = &st->health;
+    uint32_t msg_id;
+
+    if (argc == 3 && strcasecmp(argv[2], "clear") == 0) {
+        health_init(st);
+        return 0;
+    } else if (argc != 2) {
+        printf("Invalid arguments\n");
+        return MOD_ERR_ARG;
+    }
+
+    printf("Messages (rate/sec total):");
+    for (msg_id = 0; msg_id < NMEA_NUM_MSG_IDS; msg_id++) {
+        if (nmea_msg_names[msg_id] != NULL && health->msg_cnts[msg_id] > 0)
+            printf(" %s=%u/%lu", nmea_msg_names[msg_id],
+                   health->msg_rates[msg_id], health->msg_cnts[msg_id]);
+    }
+    printf("\nChecksum errors=%u truncated=%u\n", health->nmea_cksum_errs,
+           health->nmea_truncs);
+    if (health->ttff_ms != 0)
+        printf("Time to first fix: %lu ms\n", health->ttff_ms);
+    else
+        printf("Time to first fix: no fix yet\n");
+    if (health->ttns_ms != 0)
+        printf("Time to %u satellites: %lu ms\n", st->cfg.ttns_num_sats,
+               health->ttns_ms);
+    else
+        printf("Time to %u satellites: not yet\n", st->cfg.ttns_num_sats);
+    printf("Arrival to processing latency:\n");
+    stat_hist_print(&health->latency_us, "us");
+    printf("Epoch interval:\n");
+    stat_hist_print(&health->epoch_interval_ms, "ms");
+    return 0;
+}
+
+/*
+ * @brief Console command function for "gps filter".
+ *
+ * @param[in] argc Number of arguments, including "gps"
+ * @param[in] argv Argument values, including "gps"
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * Command usage: gps filter [on|off|clear]
+ */
+static int32_t cmd_gps_filter(int32_t argc, const char** argv)
+{
+    struct gps_state* st = &gps_states[cmd_instance_id];
+    uint32_t msg_id;
+
+    if (argc == 3 && strcasecmp(argv[2], "on") == 0) {
+        st->filter.state = FILTER_IDLE;
+        st->cfg.nmea_filter_enable = true;
+        return ttys_set_rx_filter(st->cfg.ttys_instance_id, nmea_filter_cb,
+                                  cmd_instance_id);
+    } else if (argc == 3 && strcasecmp(argv[2], "off") == 0) {
+        st->cfg.nmea_filter_enable = false;
+        return ttys_set_rx_filter(st->cfg.ttys_instance_id, NULL, 0);
+    } else if (argc == 3 && strcasecmp(argv[2], "clear") == 0) {
+        st->filter.accepted = 0;
+        st->filter.dropped = 0;
+        return 0;
+    } else if (argc != 2) {
+        printf("Invalid arguments\n");
+        return MOD_ERR_ARG;
+    }
+
+    printf("NMEA filter %s, passes:",
+           st->cfg.nmea_filter_enable ? "on" : "off");
+    for (msg_id = 0; msg_id < ARRAY_SIZE(nmea_msg_names); msg_id++) {
+        if (nmea_msg_names[msg_id] != NULL &&
+            (st->cfg.nmea_filter_msgs & (1 << msg_id)))
+            printf(" %s", nmea_msg_names[msg_id]);
+    }
+    printf("\nAccepted=%lu dropped=%lu\n", st->filter.accepted,
+           st->filter.dropped);
+    return 0;
+}
+
+/*
+ * @brief Console command function for "gps gen".
+ *
+ * @param[in] argc Number of arguments, including "gps"
+ * @param[in] argv Argument values, including "gps"
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * Command usage: gps gen [off | <rate-hz> <num-sats> [baud]]
+ *
+ * With no arguments, the generator status is displayed. If a baud rate is
+ * given, it is set on the generator UART and on the UART of the selected gps
+ * instance, which should be looped back to it.
+ */
+static int32_t cmd_gps_gen(int32_t argc, const char** argv)
+{
+    struct gps_state* st = &gps_states[cmd_instance_id];
+    struct cmd_arg_val arg_vals[3];
+    struct gps_health* health;
+    int32_t num_args;
+    int32_t rc;
+    uint32_t elapsed_ms;
+    uint32_t bytes_per_sec;
+    uint32_t baud;
+
+    if (argc == 2) {
+        health = &gps_states[gen.instance_id].health;
+        elapsed_ms = tmr_get_ms() - gen.start_ms;
+        bytes_per_sec = elapsed_ms > 0 ?
+            (uint32_t)((uint64_t)gen.bytes * 1000 / elapsed_ms) : 0;
+        printf("Generator %s: rate=%lu Hz sats=%lu sentences/epoch=%lu\n",
+               gen.on ? "on" : "off", gen.rate_hz, gen.num_sats,
+               gen.num_sentences);
+        printf("Sent: epochs=%lu late=%lu sentences=%lu bytes=%lu\n",
+               gen.epochs, gen.late_epochs, gen.sentences, gen.bytes);
+        // 10 bits per character (8N1).
+        baud = ttys_get_baud(GEN_TTYS_INSTANCE);
+        printf("Load: %lu bytes/sec (%lu%% of the %lu baud link)\n",
+               bytes_per_sec,
+               baud > 0 ? (uint32_t)((uint64_t)bytes_per_sec * 1000 / baud) : 0,
+               baud);
+        printf("Rejected by instance %d since start: checksum=%u "
+               "truncated=%u\n", gen.instance_id,
+               (uint16_t)(health->nmea_cksum_errs - gen.start_cksum_errs),
+               (uint16_t)(health->nmea_truncs - gen.start_truncs));
+        return 0;
+    }
+    if (argc == 3 && strcasecmp(argv[2], "off") == 0) {
+        gen.on = false;
+        return 0;
+    }
+
+    num_args = cmd_parse_args(argc-2, argv+2, "uu[u]", arg_vals);
+    if (num_args < 2)
+        return MOD_ERR_BAD_CMD;
+    if (arg_vals[0].val.u < 1 || arg_vals[0].val.u > GEN_MAX_RATE_HZ ||
+        arg_vals[1].val.u > MAX_SATS) {
+        printf("Rate must be 1-%u Hz, sats 0-%u\n", GEN_MAX_RATE_HZ, MAX_SATS);
+        return MOD_ERR_ARG;
+    }
+    if (num_args == 3) {
+        rc = ttys_set_baud(GEN_TTYS_INSTANCE, arg_vals[2].val.u);
+        if (rc == 0)
+            rc = ttys_set_baud(st->cfg.ttys_instance_id, arg_vals[2].val.u);
+        if (rc < 0) {
+            printf("Baud rate change failed: %ld\n", rc);
+            return rc;
+        }
+    }
+
+    memset(&gen, 0, sizeof(gen));
+    gen.rate_hz = arg_vals[0].val.u;
+    gen.num_sats = arg_vals[1].val.u;
+    gen.period_ms = 1000 / gen.rate_hz;
+    gen.num_sentences = 2 + (gen.num_sats == 0 ? 1 :
+                             (gen.num_sats + GEN_SATS_PER_GSV - 1) /
+                             GEN_SATS_PER_GSV);
+    gen.sentence_idx = gen.num_sentences;
+    gen.start_ms = tmr_get_ms();
+    gen.next_ms = gen.start_ms;
+    gen.tod_ms = 12 * 3600 * 1000;
+    gen.rand = 1;
+    gen.instance_id = cmd_instance_id;
+    gen.start_cksum_errs = st->health.nmea_cksum_errs;
+    gen.start_truncs = st->health.nmea_truncs;
+    gen.on = true;
+    return 0;
+}
+
+/*
+ * @brief Console command function for "gps dop".
+ *
+ * @param[in] argc Number of arguments, including "gps"
+ * @param[in] argv Argument values, including "gps"
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * Command usage: gps dop [test [trials]]
+ *
+ * The DOP values are calculated from the tracked satellites (those with a
+ * non-zero SNR). With "test", random geometries are used instead, and the
+ * results are compared with the double-precision reference.
+ */
+static int32_t cmd_gps_dop(int32_t argc, const char** argv)
+{
+    struct gps_state* st = &gps_states[cmd_instance_id];
+    struct cmd_arg_val arg_vals[1];
+    struct dop_sat sats[DOP_MAX_SATS];
+    struct dop_result result;
+    uint32_t num_sats = 0;
+    uint32_t idx;
+    uint32_t cycles;
+    int32_t rc;
+
+    if (argc >= 3 && strcasecmp(argv[2], "test") == 0) {
+        if (cmd_parse_args(argc-3, argv+3, "[u]", arg_vals) < 0)
+            return MOD_ERR_BAD_CMD;
+        return dop_test(argc > 3 ? arg_vals[0].val.u : 1000);
+    } else if (argc != 2) {
+        printf("Invalid arguments\n");
+        return MOD_ERR_ARG;
+    }
+
+    for (idx = 0; idx < MAX_SATS && num_sats < DOP_MAX_SATS; idx++) {
+        if (st->sat_data[idx].present && st->sat_data[idx].snr > 0) {
+            sats[num_sats].azimuth = st->sat_data[idx].azimuth;
+            sats[num_sats].elevation = st->sat_data[idx].elevation;
+            num_sats++;
+        }
+    }
+    cycles = tmr_get_cycles();
+    rc = dop_calc(sats, num_sats, &result);
+    cycles = tmr_get_cycles() - cycles;
+    if (rc == MOD_ERR_ARG) {
+        printf("Need at least 4 tracked sats, have %lu\n", num_sats);
+        return 0;
+    } else if (rc < 0) {
+        printf("Geometry too poor (%lu sats)\n", num_sats);
+        return 0;
+    }
+    #define X100(v) (v) / 100, (v) % 100
+    printf("Sats=%lu GDOP=%u.%02u PDOP=%u.%02u HDOP=%u.%02u VDOP=%u.%02u "
+           "TDOP=%u.%02u (%lu cycles)\n", num_sats, X100(result.gdop_x100),
+           X100(result.pdop_x100), X100(result.hdop_x100),
+           X100(result.vdop_x100), X100(result.tdop_x100), cycles);
+    #undef X100
+    return 0;
+}
+
+/*
+ * @brief Test the fixed-point DOP calculation against the reference.
+ *
+ * @param[in] trials Number of random geometries.
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * Results are only compared for geometries with a GDOP of up to 20. Beyond
+ * that (poor geometry), the error of the fixed-point calculation grows
+ * quickly.
+ */
+static int32_t dop_test(uint32_t trials)
+{
+    struct dop_sat sats[DOP_MAX_SATS];
+    struct dop_result result;
+    struct dop_result ref;
+    const uint16_t* vals;
+    const uint16_t* ref_vals;
+    uint32_t rand = 1;
+    uint32_t trial;
+    uint32_t num_sats;
+    uint32_t idx;
+    uint32_t err;
+    uint32_t max_err = 0;
+    uint32_t fails = 0;
+    uint32_t poor = 0;
+    uint32_t cycles;
+    uint64_t calc_cycles = 0;
+    uint64_t ref_cycles = 0;
+    int32_t rc;
+    int32_t ref_rc;
+
+    if (trials == 0)
+        return MOD_ERR_ARG;
+
+    #define NEXT_RAND(r) ((r) = (r) * 1103515245 + 12345, (r) >> 16)
+    for (trial = 0; trial < trials; trial++) {
+        num_sats = 4 + NEXT_RAND(rand) % (DOP_MAX_SATS - 3);
+        for (idx = 0; idx < num_sats; idx++) {
+            sats[idx].azimuth = NEXT_RAND(rand) % 360;
+            sats[idx].elevation = NEXT_RAND(rand) % 91;
+        }
+        cycles = tmr_get_cycles();
+        rc = dop_calc(sats, num_sats, &result);
+        calc_cycles += tmr_get_cycles() - cycles;
+        cycles = tmr_get_cycles();
+        ref_rc = dop_calc_ref(sats, num_sats, &ref);
+        ref_cycles += tmr_get_cycles() - cycles;
+
+        // Poor geometry can be rejected by the fixed-point calculation only.
+        if (rc < 0 || ref_rc < 0 || ref.gdop_x100 > DOP_TEST_MAX_GDOP_X100) {
+            poor++;
+            if (rc == 0 && ref_rc < 0)
+                fails++;
+            continue;
+        }
+        vals = &result.gdop_x100;
+        ref_vals = &ref.gdop_x100;
+        for (idx = 0; idx < 5; idx++) {
+            err = abs(vals[idx] - ref_vals[idx]);
+            if (err > DOP_TEST_MAX_ERR_X100) {
+                if (fails < 5)
+                    printf("Fail: sats=%lu dop %lu: %u vs ref %u\n", num_sats,
+                           idx, vals[idx], ref_vals[idx]);
+                fails++;
+            }
+            if (err > max_err)
+                max_err = err;
+        }
+    }
+    #undef NEXT_RAND
+
+    printf("Trials=%lu poor geometry=%lu fails=%lu max err=%lu.%02lu\n",
+           trials, poor, fails, max_err / 100, max_err % 100);
+    printf("Avg cycles: fixed-point=%lu reference=%lu\n",
+           (uint32_t)(calc_cycles / trials), (uint32_t)(ref_cycles / trials));
+    return fails == 0 ? 0 : MOD_ERR_STATE;
+}
+
+/*
+ * @brief NMEA receive filter, called by ttys for each received character.
+ *
+ * @param[in] c The received character.
+ * @param[out] out The characters to add to the receive buffer.
+ * @param[in] user_data The gps instance ID.
+ *
+ * @return Number of characters in "out".
+ *
+ * The prefix of an NMEA message is held back until the message type is known.
+ * Then it is either released along with the rest of the message, or the
+ * whole message is dropped. Other input is passed, so the gps module still
+ * sees line endings, UBX frames, and garbage (which it counts).
+ *
+ * @note This function is called from the UART interrupt handler.
+ */
+static uint32_t nmea_filter_cb(char c, char* out, uint32_t user_data)
+{
+    struct gps_state* st = &gps_states[user_data];
+    struct nmea_filter* f = &st->filter;
+    uint32_t num_out;
+    int32_t msg_id;
+
+    // Start of an NMEA message, even in the middle of another one (e.g. if
+    // the end of the previous one was lost).
+    if (c == '$' && f->state != FILTER_UBX) {
+        f->prefix[0] = c;
+        f->prefix_len = 1;
+        f->state = FILTER_PREFIX;
+        return 0;
+    }
+
+    switch (f->state) {
+        case FILTER_IDLE:
+            if ((uint8_t)c == UBX_SYNC1) {
+                f->ubx_idx = 1;
+                f->state = FILTER_UBX;
+            }
+            break;
+
+        case FILTER_PREFIX:
+            if (c == '\r' || c == '\n') {
+                // Runt message, release it for the gps module to count.
+                memcpy(out, f->prefix, f->prefix_len);
+                num_out = f->prefix_len;
+                num_out += health_arrival_put(st, out + num_out);
+                out[num_out++] = c;
+                f->state = FILTER_IDLE;
+                return num_out;
+            }
+            f->prefix[f->prefix_len++] = c;
+            if (f->prefix_len < NMEA_PREFIX_LEN)
+                return 0;
+            msg_id = nmea_prefix_to_msg_id(f->prefix);
+            if (msg_id >= 0 && (st->cfg.nmea_filter_msgs & (1 << msg_id))) {
+                f->accepted++;
+                f->state = FILTER_PASS;
+                memcpy(out, f->prefix, NMEA_PREFIX_LEN);
+                return NMEA_PREFIX_LEN;
+            }
+            f->dropped++;
+            f->state = FILTER_DROP;
+            return 0;
+
+        case FILTER_PASS:
+            if (c == '\r' || c == '\n') {
+                f->state = FILTER_IDLE;
+                num_out = health_arrival_put(st, out);
+                out[num_out++] = c;
+                return num_out;
+            }
+            break;
+
+        case FILTER_DROP:
+            if (c == '\r' || c == '\n')
+                f->state = FILTER_IDLE;
+            return 0;
+
+        case FILTER_UBX:
+            // Header is sync1, sync2, class, ID, and 16-bit length, followed by
+            // the payload and 2 checksum bytes.
+            f->ubx_idx++;
+            if (f->ubx_idx == 2 && (uint8_t)c != UBX_SYNC2) {
+                f->state = FILTER_IDLE;
+            } else if (f->ubx_idx == 5) {
+                f->ubx_remaining = (uint8_t)c;
+            } else if (f->ubx_idx == 6) {
+                f->ubx_remaining |= (uint8_t)c << 8;
+                f->ubx_remaining += 2; // Checksum.
+            } else if (f->ubx_idx > 6 && --f->ubx_remaining == 0) {
+                f->state = FILTER_IDLE;
+            }
+            break;
+    }
+    out[0] = c;
+    return 1;
+}
+
+/*
+ * @brief Get the message ID of an NMEA message prefix.
+ *
+ * @param[in] prefix The prefix ("$ttSSS").
+ *
+ * @return The message ID (bit number of GPS_NMEA_xxx), or -1 if unknown.
+ *
+ * The talker ID is ignored.
+ */
+static int32_t nmea_prefix_to_msg_id(const char* prefix)
+{
+    int32_t msg_id;
+    const char* name;
+
+    for (msg_id = 0; msg_id < NMEA_NUM_MSG_IDS; msg_id++) {
+        name = nmea_msg_names[msg_id];
+        if (name != NULL && name[0] == prefix[3] && name[1] == prefix[4] &&
+            name[2] == prefix[5])
+            return msg_id;
+    }
+    return -1;
+}
+
+/*
+ * @brief Process a byte received from the GPS hardware module.
+ *
+ * @param[in] st The gps instance state.
+ * @param[in] c The byte.
+ */
+static void process_byte(struct gps_state* st, char c)
+{
+    int32_t msg_id;
+
+    if (ubx_rx_byte(st, (uint8_t)c))
+        return;
+    if (((uint8_t)c & ~ARRIVAL_TAG_MASK) == ARRIVAL_TAG_BASE) {
+        st->arrival_tag = (uint8_t)c & ARRIVAL_TAG_MASK;
+        return;
+    }
+    if (c == '\n' || c == '\r') {
+        if (st->in_bfr_chars > 0 && st->in_bfr[0] == '$')
+            health_line_end(st);
+        st->arrival_tag = ARRIVAL_NO_TAG;
+        if (st->in_bfr_overflow) {
+            st->in_bfr_overflow = false;
+        } else if (st->in_bfr_chars > 0) {
+            st->in_bfr[st->in_bfr_chars] = '\0';
+            if (nmea_check(st, st->in_bfr)) {
+                if (st->in_bfr_chars >= NMEA_PREFIX_LEN &&
+                    (msg_id = nmea_prefix_to_msg_id(st->in_bfr)) >= 0)
+                    st->health.msg_cnts[msg_id]++;
+                process_msg(st, st->in_bfr);
+            }
+        }
+        st->in_bfr_chars = 0;
+        return;
+    }
+    if (isprint((unsigned char)c) && !st->in_bfr_overflow) {
+        if (st->in_bfr_chars < (GPS_IN_BFR_SIZE-1)) {
+            st->in_bfr[st->in_bfr_chars++] = c;
+        } else {
+            st->in_bfr[GPS_IN_BFR_SIZE-1] = '\0';
+            log_debug("Truncated: %s\n", st->in_bfr);
+            INC_SAT_U16(st->health.nmea_truncs);
+            st->in_bfr_overflow = true;
+        }
+    }
+}
+
+/*
+ * @brief Initialize the health measurements.
+ *
+ * @param[in] st The gps instance state.
+ */
+static void health_init(struct gps_state* st)
+{
+    struct gps_health* health = &st->health;
+    uint32_t ttff_ms = health->ttff_ms;
+    uint32_t ttns_ms = health->ttns_ms;
+
+    // The times since boot are kept.
+    memset(health, 0, sizeof(*health));
+    health->ttff_ms = ttff_ms;
+    health->ttns_ms = ttns_ms;
+    health->rate_ms = tmr_get_ms();
+    stat_hist_init(&health->latency_us, st->cfg.latency_bin_us);
+    stat_hist_init(&health->epoch_interval_ms, st->cfg.epoch_interval_bin_ms);
+}
+
+/*
+ * @brief Update the message rates, once per period.
+ *
+ * @param[in] st The gps instance state.
+ */
+static void health_run(struct gps_state* st)
+{
+    struct gps_health* health = &st->health;
+    uint32_t msg_id;
+
+    if (tmr_get_ms() - health->rate_ms < HEALTH_RATE_PERIOD_MS)
+        return;
+    health->rate_ms += HEALTH_RATE_PERIOD_MS;
+    for (msg_id = 0; msg_id < NMEA_NUM_MSG_IDS; msg_id++) {
+        health->msg_rates[msg_id] = health->msg_cnts[msg_id] -
+            health->msg_cnts_prev[msg_id];
+        health->msg_cnts_prev[msg_id] = health->msg_cnts[msg_id];
+    }
+}
+
+/*
+ * @brief Record the arrival time of a message.
+ *
+ * @param[in] st The gps instance state.
+ * @param[out] out Where to put the arrival tag.
+ *
+ * @return Number of characters put in "out" (1).
+ *
+ * The tag goes before the line end, so the parser sees it first.
+ *
+ * @note This function is called from the UART interrupt handler.
+ */
+static uint32_t health_arrival_put(struct gps_state* st, char* out)
+{
+    struct nmea_filter* f = &st->filter;
+    uint32_t idx = f->arrival_seq % ARRIVAL_RING_SIZE;
+
+    f->arrival_cyc[idx] = tmr_get_cycles();
+    f->arrival_seqs[idx] = f->arrival_seq;
+    out[0] = ARRIVAL_TAG_BASE | (f->arrival_seq & ARRIVAL_TAG_MASK);
+    f->arrival_seq++;
+    return 1;
+}
+
+/*
+ * @brief Record the latency of a message, at the end of its line.
+ *
+ * @param[in] st The gps instance state.
+ *
+ * The arrival tag of the line, if any, selects the arrival time recorded by
+ * the receive filter. A line whose tag was lost (e.g. on a receive buffer
+ * overrun) gets no latency sample, and doesn't affect later lines. A tag
+ * whose time was already overwritten (the parser is more than
+ * ARRIVAL_RING_SIZE lines behind) is counted as lost.
+ */
+static void health_line_end(struct gps_state* st)
+{
+    struct nmea_filter* f = &st->filter;
+    uint32_t idx;
+    uint32_t cycles;
+    uint8_t seq;
+
+    if (st->arrival_tag == ARRIVAL_NO_TAG)
+        return;
+    idx = st->arrival_tag % ARRIVAL_RING_SIZE;
+    __disable_irq();
+    cycles = f->arrival_cyc[idx];
+    seq = f->arrival_seqs[idx];
+    __enable_irq();
+    if ((seq & ARRIVAL_TAG_MASK) != st->arrival_tag) {
+        INC_SAT_U16(cnts_u16[CNT_ARRIVAL_LOST]);
+        return;
+    }
+    cycles = tmr_get_cycles() - cycles;
+    stat_hist_add(&st->health.latency_us,
+                  cycles / (SystemCoreClock / 1000000));
+}
+
+/*
+ * @brief Record the end of a navigation epoch (RMC or NAV-PVT message).
+ *
+ * @param[in] st The gps instance state.
+ * @param[in] protocol The protocol of the message.
+ */
+static void health_epoch(struct gps_state* st, enum gps_protocol protocol)
+{
+    struct gps_health* health = &st->health;
+    uint32_t now_ms = tmr_get_ms();
+
+    st->tput[protocol].epochs++;
+    if (health->last_epoch_ms != 0)
+        stat_hist_add(&health->epoch_interval_ms,
+                      now_ms - health->last_epoch_ms);
+    health->last_epoch_ms = now_ms;
+}
+
+/*
+ * @brief Record a valid fix, for time-to-first-fix.
+ *
+ * @param[in] st The gps instance state.
+ */
+static void health_fix(struct gps_state* st)
+{
+    if (st->health.ttff_ms == 0)
+        st->health.ttff_ms = tmr_get_ms();
+}
+
+/*
+ * @brief Record a satellite being added, for time-to-N-satellites.
+ *
+ * @param[in] st The gps instance state.
+ */
+static void health_sat_added(struct gps_state* st)
+{
+    uint32_t num_sats = 0;
+    uint32_t idx;
+
+    if (st->health.ttns_ms != 0)
+        return;
+    for (idx = 0; idx < MAX_SATS; idx++)
+        num_sats += st->sat_data[idx].present;
+    if (num_sats >= st->cfg.ttns_num_sats)
+        st->health.ttns_ms = tmr_get_ms();
+}
+
+/*
+ * @brief Publish a navigation epoch event.
+ *
+ * @param[in] st The gps instance state.
+ */
+static void publish_cycle(struct gps_state* st)
+{
+    struct evt evt;
+    uint32_t num_sats = 0;
+    uint32_t idx;
+
+    for (idx = 0; idx < MAX_SATS; idx++)
+        num_sats += st->sat_data[idx].present;
+    evt.topic = EVT_TOPIC_GPS_CYCLE;
+    evt.data.gps_cycle.instance_id = st - gps_states;
+    evt.data.gps_cycle.num_sats = num_sats;
+    evt.data.gps_cycle.fix_valid = st->fix.valid;
+    evt.data.gps_cycle.utc_sec = st->utc.valid ? st->utc.epoch_sec : 0;
+    evt_publish(&evt);
+}
+
+/*
+ * @brief Run the NMEA load generator.
+ *
+ * The current sentence is put in the TX buffer as space allows. When the
+ * epoch's sentences have all been sent, the next epoch is started at its
+ * scheduled time. If the link can't keep up, epochs start late, and an epoch
+ * a full period late resets the schedule.
+ */
+static void gen_run(void)
+{
+    uint32_t space;
+    uint32_t now_ms;
+
+    if (!gen.on)
+        return;
+
+    while (1) {
+        if (gen.bfr_idx < gen.bfr_len) {
+            space = ttys_get_tx_free(GEN_TTYS_INSTANCE);
+            while (space > 0 && gen.bfr_idx < gen.bfr_len) {
+                ttys_putc(GEN_TTYS_INSTANCE, gen.bfr[gen.bfr_idx++]);
+                space--;
+                gen.bytes++;
+            }
+            if (gen.bfr_idx < gen.bfr_len)
+                return;
+        }
+        if (gen.sentence_idx < gen.num_sentences) {
+            gen_build_sentence(gen.sentence_idx++);
+            continue;
+        }
+        now_ms = tmr_get_ms();
+        if ((int32_t)(now_ms - gen.next_ms) < 0)
+            return;
+        if (now_ms - gen.next_ms >= gen.period_ms) {
+            gen.late_epochs++;
+            gen.next_ms = now_ms;
+        }
+        gen.next_ms += gen.period_ms;
+        gen_start_epoch();
+    }
+}
+
+/*
+ * @brief Start a generator epoch.
+ */
+static void gen_start_epoch(void)
+{
+    uint32_t sec = gen.tod_ms / 1000;
+
+    snprintf(gen.time_str, sizeof(gen.time_str), "%02lu%02lu%02lu.%02lu",
+             sec / 3600, sec / 60 % 60, sec % 60, gen.tod_ms % 1000 / 10);
+    gen.tod_ms = (gen.tod_ms + gen.period_ms) % (24 * 3600 * 1000);
+    gen.sentence_idx = 0;
+    gen.epochs++;
+}
+
+/*
+ * @brief Build a generator sentence.
+ *
+ * @param[in] sentence_idx Index of the sentence in the epoch: RMC, GGA, then
+ *                         the GSV sentences.
+ *
+ * The position and date are fixed. Satellite N has PRN N+1, with a position
+ * that slowly moves, and a randomly varying SNR.
+ */
+static void gen_build_sentence(uint32_t sentence_idx)
+{
+    // Leave room for '$' at the start, and "*XX\r\n" at the end.
+    char* p = &gen.bfr[1];
+    uint32_t size = GEN_BFR_SIZE - 7;
+    uint32_t len;
+    uint32_t num_gsv;
+    uint32_t gsv_idx;
+    uint32_t sat;
+    uint32_t sat_end;
+
+    if (sentence_idx == 0) {
+        len = snprintf(p, size, "GPRMC,%s,A,4807.03800,N,01131.00000,E,0.004,"
+                       ",180926,,,A", gen.time_str);
+    } else if (sentence_idx == 1) {
+        len = snprintf(p, size, "GPGGA,%s,4807.03800,N,01131.00000,E,1,%02lu,"
+                       "0.9,545.4,M,46.9,M,,", gen.time_str, gen.num_sats);
+    } else {
+        num_gsv = gen.num_sentences - 2;
+        gsv_idx = sentence_idx - 2;
+        len = snprintf(p, size, "GPGSV,%lu,%lu,%02lu", num_gsv, gsv_idx + 1,
+                       gen.num_sats);
+        sat = gsv_idx * GEN_SATS_PER_GSV;
+        sat_end = sat + GEN_SATS_PER_GSV;
+        if (sat_end > gen.num_sats)
+            sat_end = gen.num_sats;
+        for (; sat < sat_end; sat++) {
+            gen.rand = gen.rand * 1103515245 + 12345;
+            len += snprintf(p + len, size - len, ",%02lu,%02lu,%03lu,%02lu",
+                            sat + 1, 5 + (sat * 37 + gen.epochs / 100) % 85,
+                            (sat * 83 + gen.epochs / 10) % 360,
+                            15 + (sat * 7 + (gen.rand >> 16) % 5) % 35);
+        }
+    }
+    gen_finish_sentence(len);
+}
+
+/*
+ * @brief Add the framing and checksum to a generator sentence.
+ *
+ * @param[in] len Length of the sentence body, after the '$'.
+ */
+static void gen_finish_sentence(uint32_t len)
+{
+    uint8_t cksum = 0;
+    uint32_t idx;
+
+    gen.bfr[0] = '$';
+    for (idx = 1; idx <= len; idx++)
+        cksum ^= gen.bfr[idx];
+    len += 1 + snprintf(&gen.bfr[len + 1], GEN_BFR_SIZE - len - 1,
+                        "*%02X\r\n", cksum);
+    gen.bfr_len = len;
+    gen.bfr_idx = 0;
+    gen.sentences++;
+}
+
+/*
+ * @brief Validate the checksum of an NMEA message.
+ *
+ * @param[in] st The gps instance state, for the error counters.
+ * @param[in,out] msg The message, starting with '$'. If valid, the checksum
+ *                    is removed.
+ *
+ * @return true if the checksum is valid, else false.
+ *
+ * The checksum is the XOR of the characters between the '$' and '*', as two
+ * hex digits after the '*'.
+ */
+static bool nmea_check(struct gps_state* st, char* msg)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    uint8_t sum = 0;
+    char* p;
+
+    for (p = msg + 1; *p != '\0' && *p != '*'; p++)
+        sum ^= (uint8_t)*p;
+    if (msg[0] != '$' || *p != '*' || p[1] == '\0' || p[2] == '\0') {
+        log_debug("Truncated: %s\n", msg);
+        INC_SAT_U16(st->health.nmea_truncs);
+        return false;
+    }
+    if (toupper((unsigned char)p[1]) != hex[sum >> 4] ||
+        toupper((unsigned char)p[2]) != hex[sum & 0xf]) {
+        log_debug("Checksum err: %s\n", msg);
+        INC_SAT_U16(st->health.nmea_cksum_errs);
+        return false;
+    }
+    *p = '\0';
+    return true;
+}
+
+/*
+ * @brief Process a message received from the GPS hardware module.
+ *
+ * @param[in] st The gps instance state.
+ * @param[in] msg GPS hardware module message.
+ */
+static void process_msg(struct gps_state* st, char* msg)
+{
+    enum parse_state {
+        PARSE_STATE_START,
+        PARSE_STATE_GPGSV,
+        PARSE_STATE_RMC,
+        PARSE_STATE_IGNORE,
+    };
+
+    char* next = msg;
+    enum parse_state parse_state = PARSE_STATE_START;
+    int32_t field_num = 0;
+    int32_t satellite_num = -1;
+    uint16_t msg_azimuth;
+    uint8_t msg_elevation;
+    uint8_t msg_snr;
+    int32_t gsv_num_msgs = 0;
+    int32_t gsv_msg_num = -1;
+    const char* rmc_time = NULL;
+    const char* rmc_lat = NULL;
+    const char* rmc_ns = NULL;
+    const char* rmc_lon = NULL;
+    bool rmc_active = false;
+
+    log_trace("Msg: %s\n", msg);
+    while (1) {
+        if (next == NULL)
+            break;
+        char* token = csv_get_token(next, &next);
+        field_num++;
+        switch (parse_state) {
+            case PARSE_STATE_START:
+                if (strcasecmp(token, "$GPGSV") == 0)
+                    parse_state = PARSE_STATE_GPGSV;
+                else if (strcasecmp(token, "$GPRMC") == 0 ||
+                         strcasecmp(token, "$GNRMC") == 0)
+                    parse_state = PARSE_STATE_RMC;
+                else
+                    parse_state = PARSE_STATE_IGNORE;
+                break;
+            case PARSE_STATE_RMC:
+                // Fields: 2=hhmmss.ss 3=status (A=active) 4=lat 5=N/S
+                // 6=lon 7=E/W 10=ddmmyy
+                if (field_num == 2) {
+                    rmc_time = token;
+                } else if (field_num == 3) {
+                    rmc_active = token[0] == 'A';
+                } else if (field_num == 4) {
+                    rmc_lat = token;
+                } else if (field_num == 5) {
+                    rmc_ns = token;
+                } else if (field_num == 6) {
+                    rmc_lon = token;
+                } else if (field_num == 7) {
+                    if (rmc_active)
+                        process_rmc_pos(st, rmc_lat, rmc_ns, rmc_lon, token);
+                    else
+                        st->fix.valid = false;
+                } else if (field_num == 10) {
+                    health_epoch(st, GPS_PROTOCOL_NMEA);
+                    if (rmc_active && rmc_time != NULL)
+                        process_rmc_time(st, rmc_time, token);
+                    else
+                        st->utc.valid = false;
+                    publish_cycle(st);
+                    parse_state = PARSE_STATE_IGNORE;
+                }
+                break;
+            case PARSE_STATE_GPGSV:
+                // Fields: 2=number of messages 3=message number, then 4
+                // fields per satellite starting at 5.
+                if (field_num == 2)
+                    gsv_num_msgs = atoi(token);
+                else if (field_num == 3)
+                    gsv_msg_num = atoi(token);
+                if (field_num < 5)
+                    break;
+                switch ((field_num - 5) % 4) {
+                    case 0:
+                        // Satellite PRN number
+                        satellite_num = atoi(token);
+                        if (satellite_num < 1 || satellite_num > 32) {
+                            log_debug("Unused satellite, number=%s\n", token);
+                            parse_state = PARSE_STATE_IGNORE;
+                        } else {
+                            // Make satellite number zero-based.
+                            satellite_num--;
+                        }
+                        break;
+                    case 1:
+                        // Elevation degress (0-90)
+                        msg_elevation = atoi(token);
+                        break;
+                    case 2:
+                        // Azimuth degress (000-359)
+                        msg_azimuth = atoi(token);
+                        break;
+                    case 3:
+                        // SNR (00-99)
+                        msg_snr = atoi(token);
+                        update_sat(st, satellite_num, msg_elevation,
+                                   msg_azimuth, msg_snr);
+                        break;
+                }
+                break;
+            case PARSE_STATE_IGNORE:
+                continue;
+        }
+        if (next == NULL)
+            break;
+    }
+    // The last GSV message ends the report cycle.
+    if (gsv_msg_num == gsv_num_msgs)
+        sat_cycle_end(st);
+}
+
+/*
+ * @brief Process the UTC time and date from an RMC message.
+ *
+ * @param[in] st The gps instance state.
+ * @param[in] time_str Time string (hhmmss.ss).
+ * @param[in] date_str Date string (ddmmyy).
+ */
+static void process_rmc_time(struct gps_state* st, const char* time_str,
+                             const char* date_str)
+{
+    int32_t idx;
+
+    for (idx = 0; idx < 6; idx++) {
+        if (!isdigit((unsigned char)time_str[idx]) ||
+            !isdigit((unsigned char)date_str[idx])) {
+            log_debug("Bad RMC time/date %s %s\n", time_str, date_str);
+            st->utc.valid = false;
+            return;
+        }
+    }
+    set_utc(st, 2000 + two_digits(date_str + 4), two_digits(date_str + 2),
+            two_digits(date_str), two_digits(time_str),
+            two_digits(time_str + 2), two_digits(time_str + 4));
+}
+
+/*
+ * @brief Convert two decimal digits.
+ *
+ * @param[in] str The digits (already checked).
+ *
+ * @return The value, 0 to 99.
+ */
+static uint32_t two_digits(const char* str)
+{
+    return (str[0] - '0') * 10 + (str[1] - '0');
+}
+
+/*
+ * @brief Process the position from an RMC message.
+ *
+ * @param[in] st The gps instance state.
+ * @param[in] lat_str Latitude string (ddmm.mmmm).
+ * @param[in] ns_str N or S.
+ * @param[in] lon_str Longitude string (dddmm.mmmm).
+ * @param[in] ew_str E or W.
+ */
+static void process_rmc_pos(struct gps_state* st, const char* lat_str,
+                            const char* ns_str, const char* lon_str,
+                            const char* ew_str)
+{
+    struct gps_fix* fix = &st->fix;
+
+    if (lat_str == NULL || ns_str == NULL || lon_str == NULL ||
+        *lat_str == '\0' || *lon_str == '\0') {
+        fix->valid = false;
+        return;
+    }
+    fix->lat = nmea_to_deg_1e7(lat_str);
+    if (*ns_str == 'S')
+        fix->lat = -fix->lat;
+    fix->lon = nmea_to_deg_1e7(lon_str);
+    if (*ew_str == 'W')
+        fix->lon = -fix->lon;
+    fix->rx_ms = tmr_get_ms();
+    fix->valid = true;
+    health_fix(st);
+}
+
+/*
+ * @brief Convert an NMEA latitude or longitude to 1e-7 degrees.
+ *
+ * @param[in] str Latitude/longitude string ([d]ddmm.mmmmm).
+ *
+ * @return Value in 1e-7 degrees (unsigned).
+ */
+static int32_t nmea_to_deg_1e7(const char* str)
+{
+    int32_t deg_min = 0;
+    int32_t min_frac_1e5 = 0;
+    int32_t frac_digits = 0;
+
+    while (isdigit((unsigned char)*str))
+        deg_min = deg_min * 10 + (*str++ - '0');
+    if (*str == '.') {
+        str++;
+        while (isdigit((unsigned char)*str) && frac_digits < 5) {
+            min_frac_1e5 = min_frac_1e5 * 10 + (*str++ - '0');
+            frac_digits++;
+        }
+    }
+    while (frac_digits++ < 5)
+        min_frac_1e5 *= 10;
+
+    // 1 minute is 1e7/60 units, so 1e-5 minute is 5/3 units.
+    return (deg_min / 100) * 10000000 +
+        ((deg_min % 100) * 100000 + min_frac_1e5) * 5 / 3;
+}
+
+/*
+ * @brief Set the UTC time from a GPS message.
+ *
+ * @param[in] st The gps instance state.
+ * @param[in] year Year.
+ * @param[in] month Month (1-12).
+ * @param[in] day Day of month (1-31).
+ * @param[in] hour Hour (0-23).
+ * @param[in] min Minute (0-59).
+ * @param[in] sec Second (0-60).
+ *
+ * The messages report the time of the most recent PPS edge. The time is
+ * published in the EVT_TOPIC_GPS_CYCLE event, so it can be passed to the tmr
+ * module to label that edge.
+ */
+static void set_utc(struct gps_state* st, uint32_t year, uint32_t month,
+                    uint32_t day, uint32_t hour, uint32_t min, uint32_t sec)
+{
+    struct gps_utc* utc = &st->utc;
+
+    if (year < 2000 || month < 1 || month > 12 || day < 1 || day > 31 ||
+        hour > 23 || min > 59 || sec > 60) {
+        log_debug("Bad UTC %lu-%lu-%lu %lu:%lu:%lu\n", year, month, day,
+                  hour, min, sec);
+        utc->valid = false;
+        return;
+    }
+    utc->year = year;
+    utc->month = month;
+    utc->day = day;
+    utc->hour = hour;
+    utc->min = min;
+    utc->sec = sec;
+    utc->epoch_sec = utc_to_epoch(year, month, day, hour, min, sec);
+    utc->rx_ms = tmr_get_ms();
+    utc->valid = true;
+}
+
+/*
+ * @brief Update the data for a satellite.
+ *
+ * @param[in] st The gps instance state.
+ * @param[in] sat_idx Satellite index (zero-based, i.e. PRN - 1).
+ * @param[in] elevation Elevation (0-90 degrees).
+ * @param[in] azimuth Azimuth (0-359 degrees).
+ * @param[in] snr SNR (C/N0, dB-Hz).
+ */
+static void update_sat(struct gps_state* st, int32_t sat_idx, uint8_t elevation,
+                       uint16_t azimuth, uint8_t snr)
+{
+    struct sat_data* sat_data = &st->sat_data[sat_idx];
+
+    if ((!sat_data->present) ||
+        (elevation != sat_data->elevation) ||
+        (azimuth != sat_data->azimuth)) {
+        log_debug("Update sat %d ele=%d az=%d snr=%d\n",
+                  sat_idx+1, elevation, azimuth, snr);
+        if (!sat_data->present) {
+            sat_data->present = true;
+            health_sat_added(st);
+        }
+        sat_data->elevation = elevation;
+        sat_data->azimuth = azimuth;
+        st->disp_map_update = true;
+    }
+    sat_data->snr = snr;
+    sat_data->cycle_updated = true;
+    sat_data->last_update_ms = tmr_get_ms();
+    update_snr_hist(&sat_data->snr_hist, snr, st->cfg.snr_decimation);
+}
+
+/*
+ * @brief Add an SNR update to a satellite's SNR history.
+ *
+ * @param[in] hist The SNR history.
+ * @param[in] snr SNR (C/N0, dB-Hz), 0 if not tracked.
+ * @param[in] decimation Store every Nth update.
+ *
+ * All tracked samples are included in the statistics, but only every Nth
+ * update is stored in the ring.
+ */
+static void update_snr_hist(struct snr_hist* hist, uint8_t snr,
+                            uint16_t decimation)
+{
+    if (snr > 0) {
+        if (hist->cnt == 0 || snr < hist->min)
+            hist->min = snr;
+        if (hist->cnt == 0 || snr > hist->max)
+            hist->max = snr;
+        hist->sum += snr;
+        hist->cnt++;
+    } else {
+        hist->dropouts++;
+    }
+
+    if (hist->decim_cnt == 0) {
+        if (hist->num < SNR_HIST_LEN) {
+            hist->samples[(hist->head + hist->num++) % SNR_HIST_LEN] = snr;
+        } else {
+            // Full, overwrite the oldest.
+            hist->samples[hist->head] = snr;
+            hist->head = (hist->head + 1) % SNR_HIST_LEN;
+        }
+    }
+    if (++hist->decim_cnt >= decimation)
+        hist->decim_cnt = 0;
+}
+
+/*
+ * @brief End a satellite report cycle (GSV sequence, NAV-SVINFO or NAV-SAT).
+ *
+ * @param[in] st The gps instance state.
+ *
+ * Satellites still present (not yet cleaned up) but missing from the cycle
+ * get an SNR 0 sample, so a lost signal shows as a dropout the same as a
+ * reported SNR of 0.
+ */
+static void sat_cycle_end(struct gps_state* st)
+{
+    struct sat_data* sat_data;
+
+    for (sat_data = st->sat_data; sat_data < &st->sat_data[MAX_SATS];
+         sat_data++) {
+        if (sat_data->present && !sat_data->cycle_updated) {
+            sat_data->snr = 0;
+            update_snr_hist(&sat_data->snr_hist, 0, st->cfg.snr_decimation);
+        }
+        sat_data->cycle_updated = false;
+    }
+}
+
+/*
+ * @brief Convert a UTC date and time to seconds since 1970-01-01.
+ *
+ * @param[in] year Year (>= 1970).
+ * @param[in] month Month (1-12).
+ * @param[in] day Day of month (1-31).
+ * @param[in] hour Hour (0-23).
+ * @param[in] min Minute (0-59).
+ * @param[in] sec Second (0-60).
+ *
+ * @return Seconds since 1970-01-01 00:00:00.
+ *
+ * The day number is computed with a March-based year, so the leap day is at
+ * the end of the year.
+ */
+static uint32_t utc_to_epoch(uint32_t year, uint32_t month, uint32_t day,
+                             uint32_t hour, uint32_t min, uint32_t sec)
+{
+    uint32_t era_year = month <= 2 ? year - 1 : year;
+    uint32_t month_idx = month <= 2 ? month + 9 : month - 3;
+    uint32_t days;
+
+    days = 365 * era_year + era_year / 4 - era_year / 100 + era_year / 400 +
+        (153 * month_idx + 2) / 5 + day - 1;
+    // Subtract day number of 1970-01-01.
+    days -= 719468;
+    return days * 86400 + hour * 3600 + min * 60 + sec;
+}
+
+/*
+ * @brief Process a byte for the UBX frame receiver.
+ *
+ * @param[in] st The gps instance state.
+ * @param[in] c The received byte.
+ *
+ * @return true if the byte is part of a UBX frame, false if it should be
+ *         processed as NMEA.
+ *
+ * UBX frames start with a sync byte that never occurs in NMEA messages. A
+ * complete frame with a valid checksum is passed to process_ubx_msg().
+ */
+static bool ubx_rx_byte(struct gps_state* st, uint8_t c)
+{
+    struct ubx_rx* rx = &st->ubx_rx;
+
+    switch (rx->state) {
+        case UBX_RX_IDLE:
+            if (c != UBX_SYNC1)
+                return false;
+            rx->state = UBX_RX_SYNC2;
+            break;
+        case UBX_RX_SYNC2:
+            rx->state = c == UBX_SYNC2 ? UBX_RX_CLASS : UBX_RX_IDLE;
+            break;
+        case UBX_RX_CLASS:
+            rx->cls = c;
+            rx->ck_a = c;
+            rx->ck_b = c;
+            rx->state = UBX_RX_ID;
+            break;
+        case UBX_RX_ID:
+            rx->id = c;
+            rx->ck_a += c;
+            rx->ck_b += rx->ck_a;
+            rx->state = UBX_RX_LEN1;
+            break;
+        case UBX_RX_LEN1:
+            rx->len = c;
+            rx->ck_a += c;
+            rx->ck_b += rx->ck_a;
+            rx->state = UBX_RX_LEN2;
+            break;
+        case UBX_RX_LEN2:
+            rx->len |= c << 8;
+            rx->ck_a += c;
+            rx->ck_b += rx->ck_a;
+            rx->idx = 0;
+            if (rx->len > UBX_MAX_PAYLOAD) {
+                // Don't swallow NMEA input due to a bad (or unsupported)
+                // length. The rest of the frame will be ignored as NMEA.
+                INC_SAT_U16(cnts_u16[CNT_UBX_TOO_LONG]);
+                rx->state = UBX_RX_IDLE;
+            } else {
+                rx->state = rx->len == 0 ? UBX_RX_CK_A : UBX_RX_PAYLOAD;
+            }
+            break;
+        case UBX_RX_PAYLOAD:
+            rx->payload[rx->idx++] = c;
+            rx->ck_a += c;
+            rx->ck_b += rx->ck_a;
+            if (rx->idx >= rx->len)
+                rx->state = UBX_RX_CK_A;
+            break;
+        case UBX_RX_CK_A:
+            if (c == rx->ck_a) {
+                rx->state = UBX_RX_CK_B;
+            } else {
+                INC_SAT_U16(cnts_u16[CNT_UBX_CKSUM_ERR]);
+                rx->state = UBX_RX_IDLE;
+            }
+            break;
+        case UBX_RX_CK_B:
+            rx->state = UBX_RX_IDLE;
+            if (c == rx->ck_b)
+                process_ubx_msg(st, rx->cls, rx->id, rx->payload, rx->len);
+            else
+                INC_SAT_U16(cnts_u16[CNT_UBX_CKSUM_ERR]);
+            break;
+    }
+    return true;
+}
+
+/*
+ * @brief Process a UBX message received from the GPS hardware module.
+ *
+ * @param[in] st The gps instance state.
+ * @param[in] cls Message class.
+ * @param[in] id Message ID.
+ * @param[in] payload Message payload.
+ * @param[in] len Payload length.
+ */
+static void process_ubx_msg(struct gps_state* st, uint8_t cls, uint8_t id,
+                            const uint8_t* payload, uint16_t len)
+{
+    struct rcvr_cfg* rc = &st->rcvr;
+    struct rcvr_cmd* cmd;
+
+    log_trace("UBX msg class=0x%02x id=0x%02x len=%u\n", cls, id, len);
+    if (cls == UBX_CLASS_NAV) {
+        switch (id) {
+            case UBX_ID_NAV_PVT:
+                process_nav_pvt(st, payload, len);
+                break;
+            case UBX_ID_NAV_SVINFO:
+                process_nav_svinfo(st, payload, len);
+                break;
+            case UBX_ID_NAV_SAT:
+                process_nav_sat(st, payload, len);
+                break;
+        }
+    } else if (cls == UBX_CLASS_ACK && len == 2) {
+        rc->link_ok = true;
+        if (rc->state != RCVR_CFG_WAIT_ACK)
+            return;
+        cmd = &rc->cmds[rc->cmd_idx];
+        if (payload[0] != UBX_CLASS_CFG || payload[1] != cmd->id)
+            return;
+        if (id == UBX_ID_ACK_ACK) {
+            cmd->result = RCVR_CMD_ACK;
+        } else {
+            cmd->result = RCVR_CMD_NAK;
+            INC_SAT_U16(cnts_u16[CNT_RCVR_CFG_NAK]);
+        }
+    }
+}
+
+/*
+ * @brief Process a UBX NAV-PVT (position, velocity, time) message.
+ *
+ * @param[in] st The gps instance state.
+ * @param[in] payload Message payload.
+ * @param[in] len Payload length.
+ */
+static void process_nav_pvt(struct gps_state* st, const uint8_t* payload,
+                            uint16_t len)
+{
+    struct gps_fix* fix = &st->fix;
+
+    if (len < UBX_NAV_PVT_MIN_LEN) {
+        log_debug("Short NAV-PVT len=%u\n", len);
+        return;
+    }
+    health_epoch(st, GPS_PROTOCOL_UBX);
+
+    // Byte 11 is the validity flags: bit 0 = date, bit 1 = time.
+    if ((payload[11] & 0x03) == 0x03)
+        set_utc(st, get_u16_le(&payload[4]), payload[6], payload[7], payload[8],
+                payload[9], payload[10]);
+    else
+        st->utc.valid = false;
+
+    // Byte 21 is the fix flags: bit 0 = fix OK.
+    fix->fix_type = payload[20];
+    fix->valid = (payload[21] & 0x01) && fix->fix_type >= 2;
+    fix->num_sv = payload[23];
+    fix->lon = (int32_t)get_u32_le(&payload[24]);
+    fix->lat = (int32_t)get_u32_le(&payload[28]);
+    fix->height_mm = (int32_t)get_u32_le(&payload[36]);
+    fix->h_acc_mm = get_u32_le(&payload[40]);
+    fix->rx_ms = tmr_get_ms();
+    if (fix->valid)
+        health_fix(st);
+    publish_cycle(st);
+}
+
+/*
+ * @brief Process a UBX NAV-SVINFO (satellite information) message.
+ *
+ * @param[in] st The gps instance state.
+ * @param[in] payload Message payload.
+ * @param[in] len Payload length.
+ *
+ * The message has an 8 byte header, followed by a 12 byte block per channel.
+ */
+static void process_nav_svinfo(struct gps_state* st, const uint8_t* payload,
+                               uint16_t len)
+{
+    uint32_t num_ch;
+    const uint8_t* blk;
+    int16_t elevation;
+    int16_t azimuth;
+
+    num_ch = len >= 8 ? payload[4] : 0;
+    if (len < 8 + 12 * num_ch) {
+        log_debug("Short NAV-SVINFO len=%u\n", len);
+        return;
+    }
+    for (blk = payload + 8; num_ch > 0; num_ch--, blk += 12) {
+        // svid: GPS is 1-32.
+        if (blk[1] < 1 || blk[1] > MAX_SATS)
+            continue;
+        elevation = (int8_t)blk[5];
+        azimuth = (int16_t)get_u16_le(&blk[6]);
+        if (elevation < 0 || azimuth < 0)
+            continue;
+        update_sat(st, blk[1] - 1, elevation, azimuth, blk[4]);
+    }
+    sat_cycle_end(st);
+}
+
+/*
+ * @brief Process a UBX NAV-SAT (satellite information) message.
+ *
+ * @param[in] st The gps instance state.
+ * @param[in] payload Message payload.
+ * @param[in] len Payload length.
+ *
+ * The message has an 8 byte header, followed by a 12 byte block per satellite.
+ */
+static void process_nav_sat(struct gps_state* st, const uint8_t* payload,
+                            uint16_t len)
+{
+    uint32_t num_svs;
+    const uint8_t* blk;
+    int16_t elevation;
+    int16_t azimuth;
+
+    num_svs = len >= 8 ? payload[5] : 0;
+    if (len < 8 + 12 * num_svs) {
+        log_debug("Short NAV-SAT len=%u\n", len);
+        return;
+    }
+    for (blk = payload + 8; num_svs > 0; num_svs--, blk += 12) {
+        // gnssId 0 is GPS, with svId 1-32.
+        if (blk[0] != 0 || blk[1] < 1 || blk[1] > MAX_SATS)
+            continue;
+        elevation = (int8_t)blk[3];
+        azimuth = (int16_t)get_u16_le(&blk[4]);
+        if (elevation < 0 || azimuth < 0)
+            continue;
+        update_sat(st, blk[1] - 1, elevation, azimuth, blk[2]);
+    }
+    sat_cycle_end(st);
+}
+
+/*
+ * @brief Send a UBX message to the GPS hardware module.
+ *
+ * @param[in] st The gps instance state.
+ * @param[in] cls Message class.
+ * @param[in] id Message ID.
+ * @param[in] payload Message payload.
+ * @param[in] len Payload length.
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * The frame checksum is the 8-bit Fletcher algorithm over the class, ID,
+ * length, and payload.
+ */
+static int32_t ubx_send(struct gps_state* st, uint8_t cls, uint8_t id,
+                        const uint8_t* payload, uint16_t len)
+{
+    uint8_t hdr[6] = { UBX_SYNC1, UBX_SYNC2, cls, id, len & 0xff, len >> 8 };
+    enum ttys_instance_id ttys_id = st->cfg.ttys_instance_id;
+    uint8_t ck_a = 0;
+    uint8_t ck_b = 0;
+    int32_t rc = 0;
+    uint32_t idx;
+
+    for (idx = 0; idx < sizeof(hdr); idx++) {
+        if (idx >= 2) {
+            ck_a += hdr[idx];
+            ck_b += ck_a;
+        }
+        rc |= ttys_putc(ttys_id, hdr[idx]);
+    }
+    for (idx = 0; idx < len; idx++) {
+        ck_a += payload[idx];
+        ck_b += ck_a;
+        rc |= ttys_putc(ttys_id, payload[idx]);
+    }
+    rc |= ttys_putc(ttys_id, ck_a);
+    rc |= ttys_putc(ttys_id, ck_b);
+    return rc < 0 ? MOD_ERR_BUF_OVERRUN : 0;
+}
+
+/*
+ * @brief Build the list of receiver configuration commands.
+ *
+ * @param[in] st The gps instance state.
+ */
+static void rcvr_cfg_build(struct gps_state* st)
+{
+    static const uint8_t nav_msg_ids[] = { UBX_ID_NAV_PVT, UBX_ID_NAV_SVINFO };
+    struct rcvr_cfg* rc = &st->rcvr;
+    struct rcvr_cmd* cmd;
+    uint32_t msg_id;
+    uint32_t idx;
+    uint32_t nmea_msgs;
+    bool ubx = st->cfg.protocol == GPS_PROTOCOL_UBX;
+
+    memset(rc, 0, sizeof(*rc));
+
+    if (st->cfg.baud != 0 && st->cfg.baud != GPS_RCVR_DEF_BAUD) {
+        // Receiver UART: 8N1, UBX and NMEA in and out.
+        cmd = &rc->cmds[rc->num_cmds++];
+        cmd->id = UBX_ID_CFG_PRT;
+        cmd->len = 20;
+        cmd->payload[0] = 1;
+        put_u32_le(&cmd->payload[4], 0x000008d0);
+        put_u32_le(&cmd->payload[8], st->cfg.baud);
+        put_u16_le(&cmd->payload[12], 0x0003);
+        put_u16_le(&cmd->payload[14], 0x0003);
+    }
+
+    // With UBX protocol, all NMEA messages are disabled.
+    nmea_msgs = ubx ? 0 : st->cfg.nmea_msgs;
+    for (msg_id = 0; msg_id < ARRAY_SIZE(nmea_msg_names); msg_id++) {
+        if (nmea_msg_names[msg_id] == NULL)
+            continue;
+        cmd = &rc->cmds[rc->num_cmds++];
+        cmd->id = UBX_ID_CFG_MSG;
+        cmd->len = 3;
+        cmd->payload[0] = UBX_CLASS_NMEA;
+        cmd->payload[1] = msg_id;
+        cmd->payload[2] = (nmea_msgs & (1 << msg_id)) ? 1 : 0;
+    }
+
+    for (idx = 0; idx < ARRAY_SIZE(nav_msg_ids); idx++) {
+        cmd = &rc->cmds[rc->num_cmds++];
+        cmd->id = UBX_ID_CFG_MSG;
+        cmd->len = 3;
+        cmd->payload[0] = UBX_CLASS_NAV;
+        cmd->payload[1] = nav_msg_ids[idx];
+        cmd->payload[2] = ubx ? 1 : 0;
+    }
+
+    // Measurement rate, one navigation solution per measurement, GPS time.
+    cmd = &rc->cmds[rc->num_cmds++];
+    cmd->id = UBX_ID_CFG_RATE;
+    cmd->len = 6;
+    put_u16_le(&cmd->payload[0], CLAMP(st->cfg.meas_rate_ms, 100, 1000));
+    put_u16_le(&cmd->payload[2], 1);
+    put_u16_le(&cmd->payload[4], 1);
+}
+
+/*
+ * @brief Run the receiver configuration state machine.
+ *
+ * @param[in] st The gps instance state.
+ */
+static void rcvr_cfg_run(struct gps_state* st)
+{
+    struct rcvr_cfg* rc = &st->rcvr;
+    struct rcvr_cmd* cmd = &rc->cmds[rc->cmd_idx];
+    enum ttys_instance_id ttys_id = st->cfg.ttys_instance_id;
+    uint32_t now_ms = tmr_get_ms();
+
+    switch (rc->state) {
+        case RCVR_CFG_OFF:
+        case RCVR_CFG_DONE:
+            break;
+
+        case RCVR_CFG_DELAY:
+            if (now_ms - rc->state_ms >= RCVR_CFG_DELAY_MS)
+                rc->state = RCVR_CFG_SEND;
+            break;
+
+        case RCVR_CFG_SEND:
+            if (rc->cmd_idx >= rc->num_cmds) {
+                log_info("Receiver configuration done\n");
+                rc->state = RCVR_CFG_DONE;
+                break;
+            }
+            log_debug("Send CFG 0x%02x try %lu\n", cmd->id, rc->tries + 1);
+            ubx_send(st, UBX_CLASS_CFG, cmd->id, cmd->payload, cmd->len);
+            rc->tries++;
+            rc->state_ms = now_ms;
+            rc->state = cmd->id == UBX_ID_CFG_PRT ? RCVR_CFG_WAIT_TX :
+                RCVR_CFG_WAIT_ACK;
+            break;
+
+        case RCVR_CFG_WAIT_TX:
+            // Wait for the CFG-PRT to be sent, and for the receiver to switch
+            // its baud rate, then switch ours.
+            if (!ttys_is_tx_idle(ttys_id)) {
+                rc->state_ms = now_ms;
+            } else if (now_ms - rc->state_ms >= RCVR_CFG_BAUD_SETTLE_MS) {
+                ttys_set_baud(ttys_id, st->cfg.baud);
+                rc->baud_switched = true;
+                rc->link_ok = false;
+                cmd->result = RCVR_CMD_SENT;
+                rcvr_cfg_next_cmd(st);
+            }
+            break;
+
+        case RCVR_CFG_WAIT_ACK:
+            if (cmd->result != RCVR_CMD_PENDING) {
+                rcvr_cfg_next_cmd(st);
+            } else if (now_ms - rc->state_ms >= RCVR_CFG_ACK_TMO_MS) {
+                if (rc->tries < RCVR_CFG_MAX_TRIES) {
+                    rc->state = RCVR_CFG_SEND;
+                } else if (rc->baud_switched && !rc->link_ok) {
+                    // Assume the receiver did not change its baud rate.
+                    log_warning("Receiver baud change failed\n");
+                    INC_SAT_U16(cnts_u16[CNT_RCVR_BAUD_FAIL]);
+                    ttys_set_baud(ttys_id, GPS_RCVR_DEF_BAUD);
+                    rc->baud_switched = false;
+                    rc->cmds[0].result = RCVR_CMD_FAIL;
+                    rc->tries = 0;
+                    rc->state = RCVR_CFG_SEND;
+                } else {
+                    cmd->result = RCVR_CMD_FAIL;
+                    INC_SAT_U16(cnts_u16[CNT_RCVR_CFG_FAIL]);
+                    rcvr_cfg_next_cmd(st);
+                }
+            }
+            break;
+    }
+}
+
+/*
+ * @brief Advance to the next receiver configuration command.
+ *
+ * @param[in] st The gps instance state.
+ */
+static void rcvr_cfg_next_cmd(struct gps_state* st)
+{
+    st->rcvr.cmd_idx++;
+    st->rcvr.tries = 0;
+    st->rcvr.state = RCVR_CFG_SEND;
+}
+
+/*
+ * @brief Restart the receiver configuration.
+ *
+ * @param[in] st The gps instance state.
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * The receiver is assumed to be back at its default baud rate.
+ */
+static int32_t rcvr_cfg_restart(struct gps_state* st)
+{
+    if (st->rcvr.baud_switched)
+        ttys_set_baud(st->cfg.ttys_instance_id, GPS_RCVR_DEF_BAUD);
+    rcvr_cfg_build(st);
+    st->rcvr.state = RCVR_CFG_SEND;
+    return 0;
+}
+
+/*
+ * @brief Store a 16-bit value in little-endian byte order.
+ *
+ * @param[out] p Location to store value.
+ * @param[in] value The value.
+ */
+static void put_u16_le(uint8_t* p, uint16_t value)
+{
+    p[0] = value & 0xff;
+    p[1] = value >> 8;
+}
+
+/*
+ * @brief Store a 32-bit value in little-endian byte order.
+ *
+ * @param[out] p Location to store value.
+ * @param[in] value The value.
+ */
+static void put_u32_le(uint8_t* p, uint32_t value)
+{
+    put_u16_le(p, value & 0xffff);
+    put_u16_le(p + 2, value >> 16);
+}
+
+/*
+ * @brief Get a 16-bit value stored in little-endian byte order.
+ *
+ * @param[in] p Location of value.
+ *
+ * @return The value.
+ */
+static uint16_t get_u16_le(const uint8_t* p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+/*
+ * @brief Get a 32-bit value stored in little-endian byte order.
+ *
+ * @param[in] p Location of value.
+ *
+ * @return The value.
+ */
+static uint32_t get_u32_le(const uint8_t* p)
+{
+    return get_u16_le(p) | ((uint32_t)get_u16_le(p + 2) << 16);
+}
+
+/*
+ * @brief Convert statellite index of the display char.
+ *
+ * @param[in] sat_idx Satellite index (zero-based).
+ *
+ * @return The satellite dislay char.
+ */
+static char sat_idx_to_char(int32_t sat_idx)
+{
+    if (sat_idx < 9)
+        return '1' + sat_idx;
+    return 'A' + (sat_idx - 9);
+}
+
+/*
+ * @brief Tokenize a CSV string in-place, incrementally.
+ *
+ * @param[in] start The current point in the string, typically pointing to the
+ *            next token.
+ * @param[out] next_start The start of the next token. This should be passed in
+ *             as "start" in the next call. If there are no more tokens, it will
+ *             be set to NULL.
+ *
+ * @return The next token to process. The token might have zero length (e.g.
+ *         in the case of consecutive commas).
+ *
+ * @note The char '*' is also treated as a separator (i.e. like a ',').
+ */
+static char* csv_get_token(char* start, char** next_start)
+{
+    char* p = start;
+    while (*p && *p != ',' && *p != '*') p++;
+    if (*p == ',' || *p == '*') {
+        *p++ = '\0';
+        *next_start = p;
+    } else {
+        *next_start = NULL;
+    }
+    return start;
+}
+
+/*
+ * @brief Display the satellite positions as a map.
+ *
+ * @param[in] st The gps instance state.
+ */
+static void display_map(struct gps_state* st)
+{
+    #define DISP_MAX_RAD 10
+    #define DISP_ROWS (1 + 2*DISP_MAX_RAD)
+    #define DISP_COLS (1 + 2*DISP_MAX_RAD)
+    #define DISP_X_OFFSET DISP_MAX_RAD
+    #define DISP_Y_OFFSET DISP_MAX_RAD
+    #define DEG_TO_RAD(d) ((double)(d) * M_PI / 180.0)
+
+    static char map[DISP_COLS][DISP_ROWS];
+    int32_t idx;
+    int32_t idy;
 
-    if (gps_state.disp_map_clear_history) {
+    if (st->disp_map_clear_history) {
         memset(map, '.', sizeof(map));
-        gps_state.disp_map_clear_history = false;
+        st->disp_map_clear_history = false;
     }
     for (idx = 0; idx < MAX_SATS; idx++) {
-        struct sat_data* sat_data = &gps_state.sat_data[idx];
+        struct sat_data* sat_data = &st->sat_data[idx];
         if (sat_data->present && sat_data->elevation <= 90) {
             double r = cos(DEG_TO_RAD(sat_data->elevation)) * (double)(DISP_MAX_RAD);
             double theta = DEG_TO_RAD(90 - sat_data->azimuth);
@@ -465,8 +2893,8 @@ static void display_map(void)
     }
 
     printf("\x1B[?25l");
-    if (gps_state.disp_map_clear_screen) {
-        gps_state.disp_map_clear_screen = false;
+    if (st->disp_map_clear_screen) {
+        st->disp_map_clear_screen = false;
         printf("\x1B[2J");
     }
     printf("\x1B[1;1H");
@@ -485,21 +2913,27 @@ static void display_map(void)
  * @param[in] user_data User data for the timer (not used).
  *
  * If a satellite has not been reported for some amount of time, it is removed.
+ * One timer services all instances.
  */
 static enum tmr_cb_action cleanup_tmr_cb(int32_t tmr_id, uint32_t user_data)
 {
+    struct gps_state* st;
     uint32_t now_ms = tmr_get_ms();
     uint32_t idx;
 
     log_debug("In cleanup_tmr_cb()\n");
-    for (idx = 0; idx < MAX_SATS; idx++) {
-        struct sat_data* sat_data = &gps_state.sat_data[idx];
-        if (sat_data->present &&
-            ((now_ms - sat_data->last_update_ms) >
-             CLEANUP_TMR_MS)) {
-            log_debug("Clean up satellite %d\n", idx+1);
-            sat_data->present = false;
-            gps_state.disp_map_update = true;
+    for (st = gps_states; st < &gps_states[GPS_NUM_INSTANCES]; st++) {
+        if (!st->started)
+            continue;
+        for (idx = 0; idx < MAX_SATS; idx++) {
+            struct sat_data* sat_data = &st->sat_data[idx];
+            if (sat_data->present &&
+                ((now_ms - sat_data->last_update_ms) >
+                 CLEANUP_TMR_MS)) {
+                log_debug("Clean up satellite %d\n", idx+1);
+                sat_data->present = false;
+                st->disp_map_update = true;
+            }
         }
     }
     return TMR_CB_RESTART;
@@ -29,9 +29,19 @@
  * SOFTWARE.
  */
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
+// Each instance blinks its own LED. All instances share one tmr timer.
+enum blinky_instance_id {
+    BLINKY_INSTANCE_1,
+    BLINKY_INSTANCE_2,
+    BLINKY_INSTANCE_3,
+
+    BLINKY_NUM_INSTANCES
+};
+
 struct blinky_cfg
 {
     uint32_t dout_idx;
@@ -39,18 +49,25 @@ struct blinky_cfg
     uint32_t code_period_ms;  // T1.
     uint32_t sep_num_blinks; // N2.
     uint32_t sep_period_ms;  // T2.
-
+    bool hw_enable; // Play the pattern with a dio toggle sequence (timer and
+                    // DMA), if the output supports it.
 };
 
 // Core module interface functions.
-int32_t blinky_get_def_cfg(struct blinky_cfg* cfg);
-int32_t blinky_init(struct blinky_cfg* cfg);
-int32_t blinky_start(void;);
+int32_t blinky_get_def_cfg(enum blinky_instance_id instance_id,
+                           struct blinky_cfg* cfg);
+int32_t blinky_init(enum blinky_instance_id instance_id,
+                    struct blinky_cfg* cfg);
+int32_t blinky_start(enum blinky_instance_id instance_id);
 
 // Other module-level APIs:
-int32_t blinky_set_code_blinks(uint32_t num_blinks);
-int32_t blinky_set_code_period(uint32_t period_ms);
-int32_t blinky_set_sep_blinks(uint32_t num_blinks);
-int32_t blinky_set_sep_period(uint32_t period_ms);
+int32_t blinky_set_code_blinks(enum blinky_instance_id instance_id,
+                               uint32_t num_blinks);
+int32_t blinky_set_code_period(enum blinky_instance_id instance_id,
+                               uint32_t period_ms);
+int32_t blinky_set_sep_blinks(enum blinky_instance_id instance_id,
+                              uint32_t num_blinks);
+int32_t blinky_set_sep_period(enum blinky_instance_id instance_id,
+                              uint32_t period_ms);
 
 #endif // _BLINKY_H_
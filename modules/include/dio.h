@@ -29,9 +29,12 @@
  * SOFTWARE.
  */
 
+#include <stdbool.h>
 #include <stdint.h>
 
+#include "stm32f4xx_ll_dma.h"
 #include "stm32f4xx_ll_gpio.h"
+#include "stm32f4xx_ll_tim.h"
 
 /*
  * Guide to defining dio inputs and outputs.
@@ -54,6 +57,35 @@
  *     + DIO_PULL_DOWN
  *   - invert : True to invert the signal value.
  *
+ * Fields for inputs only:
+ *   - edge : Pin edges that generate edge events (EXTI interrupt), one of:
+ *     + DIO_EDGE_NONE (default)
+ *     + DIO_EDGE_RISING
+ *     + DIO_EDGE_FALLING
+ *     + DIO_EDGE_BOTH
+ *     The edges are those of the pin, before any inversion. Only one input
+ *     per pin number (0-15) can use edge events.
+ *   - capture_tmr : Timer used to capture the edges in hardware, instead of
+ *     EXTI, for inputs on a timer channel pin. NULL (default) for none, or one
+ *     of:
+ *     + DIO_TMR_1
+ *     + DIO_TMR_4
+ *     + DIO_TMR_5
+ *     The timer is used only by dio, and is assumed to run at the core clock.
+ *   - capture_chan : Timer channel, 1 to 4.
+ *   - capture_af : Pin alternate function for the timer channel, one of:
+ *     + DIO_AF_1 (TIM1)
+ *     + DIO_AF_2 (TIM4, TIM5)
+ *   - debounce : Debounce filter, sampled every debounce_ms (see dio_cfg), one
+ *     of:
+ *     + DIO_DEBOUNCE_NONE (default)
+ *     + DIO_DEBOUNCE_SHIFT : The stable value changes when the last
+ *       debounce_samples samples all have the new value.
+ *     + DIO_DEBOUNCE_INTEG : An integrator counts up (value 1) or down (value
+ *       0) each sample, between 0 and debounce_samples. The stable value
+ *       changes when the count reaches 0 or debounce_samples.
+ *   - debounce_samples : The filter window, 1 to DIO_DEBOUNCE_MAX_SAMPLES.
+ *
  * Fields for outputs only:
  *   - init_value : 0 or 1
  *   - speed : One of:
@@ -64,6 +96,16 @@
  *   - output_type : One of:
  *     + DIO_OUTPUT_PUSHPULL
  *     + DIO_OUTPUT_OPENDRAIN
+ *   - pwm_tmr : Timer used to generate PWM, for outputs on a timer channel
+ *     pin. NULL (default) for none, or one of DIO_TMR_1, DIO_TMR_2, ...
+ *     The timer is used only by dio, and is assumed to run at the core clock.
+ *     Outputs on the same timer share the PWM frequency. The timer is also
+ *     used for toggle sequences (TIM2 to TIM5 only).
+ *   - pwm_chan : Timer channel, 1 to 4.
+ *   - pwm_af : Pin alternate function for the timer channel, one of:
+ *     + DIO_AF_1 (TIM1, TIM2)
+ *     + DIO_AF_2 (TIM3, TIM4, TIM5)
+ *     + DIO_AF_3 (TIM9, TIM10, TIM11)
  */
 
 //
@@ -107,7 +149,39 @@
 #define DIO_OUTPUT_PUSHPULL (LL_GPIO_OUTPUT_PUSHPULL)
 #define DIO_OUTPUT_OPENDRAIN (LL_GPIO_OUTPUT_OPENDRAIN)
 
+#define DIO_EDGE_NONE 0
+#define DIO_EDGE_RISING 1
+#define DIO_EDGE_FALLING 2
+#define DIO_EDGE_BOTH 3
+
+#define DIO_DEBOUNCE_NONE 0
+#define DIO_DEBOUNCE_SHIFT 1
+#define DIO_DEBOUNCE_INTEG 2
+
+#define DIO_DEBOUNCE_MAX_SAMPLES 7
+
+#define DIO_TMR_1 (TIM1)
+#define DIO_TMR_2 (TIM2)
+#define DIO_TMR_3 (TIM3)
+#define DIO_TMR_4 (TIM4)
+#define DIO_TMR_5 (TIM5)
+#define DIO_TMR_9 (TIM9)
+#define DIO_TMR_10 (TIM10)
+#define DIO_TMR_11 (TIM11)
+
+#define DIO_AF_1 (LL_GPIO_AF_1)
+#define DIO_AF_2 (LL_GPIO_AF_2)
+#define DIO_AF_3 (LL_GPIO_AF_3)
+
+#define DIO_PWM_DUTY_MAX 1000 // PWM duty is in units of 0.1%.
+
+#define DIO_TOGGLE_SEQ_MAX 64 // Maximum toggle sequence length.
+
 typedef GPIO_TypeDef dio_port;
+typedef TIM_TypeDef dio_tmr;
+
+// Inputs/outputs that can be accessed by a mask of indexes (bit N for index N).
+#define DIO_MAX_MASK_BITS 32
 
 struct dio_in_info {
     const char* const name;
@@ -115,6 +189,12 @@ struct dio_in_info {
     const uint32_t pin;
     const uint32_t pull;
     const uint8_t invert;
+    const uint8_t edge;
+    const uint8_t debounce;
+    const uint8_t debounce_samples;
+    dio_tmr* const capture_tmr;
+    const uint8_t capture_chan;
+    const uint32_t capture_af;
 };
 
 struct dio_out_info {
@@ -126,6 +206,9 @@ struct dio_out_info {
     const uint8_t init_value;
     const uint32_t speed;
     const uint32_t output_type;
+    dio_tmr* const pwm_tmr;
+    const uint8_t pwm_chan;
+    const uint32_t pwm_af;
 };
 
 struct dio_cfg
@@ -134,18 +217,112 @@ struct dio_cfg
     const struct dio_in_info* const inputs;
     const uint32_t num_outputs;
     const struct dio_out_info* const outputs;
+    const uint32_t debounce_ms; // Debounce sample period (0 for none).
+};
+
+// An edge on an input.
+struct dio_edge {
+    uint8_t din_idx;
+    uint8_t value;   // Input value after the edge (inversion applied).
+    uint32_t cycles; // Cycle counter (tmr_get_cycles()) at the edge.
+};
+
+// Edge measurements for an input. The period and high time are 0 until
+// measured.
+struct dio_edge_meas {
+    uint32_t edges;
+    uint32_t period_cycles; // Between the last two 0 to 1 edges.
+    uint32_t high_cycles;   // Between the last 0 to 1 and 1 to 0 edges.
 };
 
+// Frequency counter measurement, for the last completed gate. The frequency is
+// edges * SystemCoreClock / cycles.
+struct dio_freq_meas {
+    uint32_t gates;  // Gates completed since the counter was started.
+    uint32_t edges;  // 0 to 1 edges (periods) counted in the gate.
+    uint32_t cycles; // Gate length, in cycles.
+    uint32_t min_period_cycles; // Period extremes since the counter was
+    uint32_t max_period_cycles; // started, 0 if not measured (hardware
+                                // counting).
+    bool overflow;   // Hardware counter wrapped more than once between reads,
+                     // so edges is too low.
+};
+
+#define DIO_FREQ_MIN_GATE_MS 10
+#define DIO_FREQ_MAX_GATE_MS 10000
+
+// Edge callback. Depending on how it is set, it is called from the interrupt
+// handler, or from dio_run().
+typedef void (*dio_edge_cb)(const struct dio_edge* edge, uint32_t user_data);
+
+// Precomputed pin access info, for the inline fast path functions. Only for
+// the first DIO_MAX_MASK_BITS inputs/outputs.
+struct dio_fast_in {
+    volatile uint32_t* idr;
+    uint8_t shift;  // Pin number.
+    uint8_t invert;
+};
+
+struct dio_fast_out {
+    volatile uint32_t* bsrr;
+    uint32_t bsrr_val[2]; // BSRR values for output values 0 and 1.
+};
+
+extern struct dio_fast_in _dio_fast_ins[DIO_MAX_MASK_BITS];
+extern struct dio_fast_out _dio_fast_outs[DIO_MAX_MASK_BITS];
+
 // Core module interface functions.
 //  Note: dio_init() keeps a copy of the cfg pointer.
 int32_t dio_init(struct dio_cfg* cfg);
 int32_t dio_start(void);
+int32_t dio_run(void);
 
 // Other APIs.
 int32_t dio_get(uint32_t din_idx);
 int32_t dio_get_out(uint32_t dout_idx);
 int32_t dio_set(uint32_t dout_idx, uint32_t value);
+int32_t dio_get_mask(uint32_t din_mask, uint32_t* values);
+int32_t dio_set_mask(uint32_t dout_mask, uint32_t values);
+int32_t dio_toggle(uint32_t dout_mask);
+int32_t dio_set_pwm(uint32_t dout_idx, uint32_t freq_hz, uint32_t duty);
+int32_t dio_toggle_seq_start(uint32_t dout_idx, const uint32_t* ticks,
+                             uint32_t num_ticks, uint32_t tick_hz);
+int32_t dio_toggle_seq_stop(uint32_t dout_idx);
+int32_t dio_reserve_tmr(dio_tmr* tmr);
+int32_t dio_mask_to_bsrr(uint32_t dout_mask, uint32_t values, dio_port** port,
+                         uint32_t* bsrr);
+int32_t dio_wave_start(dio_port* port, const uint32_t* bsrr_words,
+                       uint32_t num_samples, uint32_t rate_hz, bool circular);
+int32_t dio_wave_stop(void);
+bool dio_wave_is_busy(void);
+int32_t dio_la_start(dio_port* port, uint32_t rate_hz, uint32_t num_samples,
+                     int32_t trig_din_idx, uint32_t trig_value);
+int32_t dio_la_stop(void);
+int32_t dio_freq_start(uint32_t din_idx, uint32_t gate_ms);
+int32_t dio_freq_stop(void);
+int32_t dio_freq_get(struct dio_freq_meas* meas);
+int32_t dio_get_stable(uint32_t din_idx);
+bool dio_get_edge(struct dio_edge* edge);
+int32_t dio_set_edge_cb(uint32_t din_idx, dio_edge_cb cb, uint32_t user_data);
+int32_t dio_set_edge_isr_cb(uint32_t din_idx, dio_edge_cb cb,
+                            uint32_t user_data);
+int32_t dio_get_edge_meas(uint32_t din_idx, struct dio_edge_meas* meas);
 int32_t dio_get_num_in(void);
 int32_t dio_get_num_out(void);
 
+// Fast path functions. There are no checks, so the index must be valid (less
+// than DIO_MAX_MASK_BITS and the number of inputs/outputs), and dio_init()
+// must have been called. Setting an output is a single BSRR store.
+static inline uint32_t dio_get_fast(uint32_t din_idx)
+{
+    const struct dio_fast_in* fi = &_dio_fast_ins[din_idx];
+    return ((*fi->idr >> fi->shift) & 1) ^ fi->invert;
+}
+
+static inline void dio_set_fast(uint32_t dout_idx, uint32_t value)
+{
+    const struct dio_fast_out* fo = &_dio_fast_outs[dout_idx];
+    *fo->bsrr = fo->bsrr_val[value & 1];
+}
+
 #endif // _DIO_H_
@@ -0,0 +1,56 @@
+#ifndef _DOP_H_
+#define _DOP_H_
+
+/*
+ * @brief Interface declaration of dop utility.
+ *
+ * See implementation file for information about this utility.
+ *
+ * MIT License
+ * 
+ * Copyright (c) 2021 Eugene R Schroeder
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdint.h>
+
+#define DOP_MAX_SATS 32
+
+// Satellite direction, as reported by a receiver.
+struct dop_sat {
+    uint16_t azimuth;  // 0-359 degrees
+    uint8_t elevation; // 0-90 degrees
+};
+
+// Dilution of precision values, times 100 (e.g. 153 for 1.53).
+struct dop_result {
+    uint16_t gdop_x100; // Geometric (position and time).
+    uint16_t pdop_x100; // Position (3-D).
+    uint16_t hdop_x100; // Horizontal.
+    uint16_t vdop_x100; // Vertical.
+    uint16_t tdop_x100; // Time.
+};
+
+int32_t dop_calc(const struct dop_sat* sats, uint32_t num_sats,
+                 struct dop_result* result);
+int32_t dop_calc_ref(const struct dop_sat* sats, uint32_t num_sats,
+                     struct dop_result* result);
+
+#endif // _DOP_H_
@@ -0,0 +1,91 @@
+#ifndef _EVT_H_
+#define _EVT_H_
+
+/*
+ * @brief Interface declaration of evt module.
+ *
+ * See implementation file for information about this module.
+ *
+ * MIT License
+ * 
+ * Copyright (c) 2021 Eugene R Schroeder
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Event topics. Each topic has its own queue and subscriber list.
+enum evt_topic {
+    EVT_TOPIC_GPS_CYCLE,  // A gps navigation epoch was processed.
+    EVT_TOPIC_DIO_EDGE,   // An edge on a dio input.
+    EVT_TOPIC_DIO_BUTTON, // A debounced button press/release.
+    EVT_TOPIC_TTYS_LINE,  // A console line is ready.
+
+    EVT_NUM_TOPICS
+};
+
+struct evt_gps_cycle {
+    uint8_t instance_id;  // enum gps_instance_id
+    uint8_t num_sats;     // Satellites in view.
+    bool fix_valid;
+    uint32_t utc_sec;     // Seconds since 1970-01-01 (0 if unknown).
+};
+
+struct evt_dio_edge {
+    uint8_t din_idx;      // Index in dio_cfg inputs.
+    uint8_t value;        // Input value after the edge.
+    uint32_t cycles;      // Cycle counter (tmr_get_cycles()) at the edge.
+};
+
+struct evt_ttys_line {
+    uint8_t instance_id;  // enum ttys_instance_id
+    uint16_t len;         // Line length.
+};
+
+struct evt {
+    enum evt_topic topic;
+    uint32_t pub_cycles;  // Set by evt_publish().
+    union {
+        struct evt_gps_cycle gps_cycle;
+        struct evt_dio_edge dio_edge;    // Also for EVT_TOPIC_DIO_BUTTON.
+        struct evt_ttys_line ttys_line;
+    } data;
+};
+
+// Subscriber callback, called from evt_run() (super loop context).
+typedef void (*evt_cb)(const struct evt* evt, uint32_t user_data);
+
+struct evt_cfg
+{
+    uint32_t latency_bin_us; // Delivery latency histogram bin width.
+};
+
+// Core module interface functions.
+int32_t evt_get_def_cfg(struct evt_cfg* cfg);
+int32_t evt_init(struct evt_cfg* cfg);
+int32_t evt_start(void);
+int32_t evt_run(void);
+
+// Other APIs.
+int32_t evt_subscribe(enum evt_topic topic, evt_cb cb, uint32_t user_data);
+int32_t evt_publish(struct evt* evt);
+
+#endif // _EVT_H_
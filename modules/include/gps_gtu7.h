@@ -29,19 +29,71 @@
  * SOFTWARE.
  */
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #include "ttys.h"
 
+// NMEA messages, for selecting the messages the receiver outputs. The bit
+// numbers are the UBX message IDs (class 0xF0).
+#define GPS_NMEA_GGA (1 << 0x00)
+#define GPS_NMEA_GLL (1 << 0x01)
+#define GPS_NMEA_GSA (1 << 0x02)
+#define GPS_NMEA_GSV (1 << 0x03)
+#define GPS_NMEA_RMC (1 << 0x04)
+#define GPS_NMEA_VTG (1 << 0x05)
+#define GPS_NMEA_ZDA (1 << 0x08)
+#define GPS_NMEA_ALL (GPS_NMEA_GGA | GPS_NMEA_GLL | GPS_NMEA_GSA | \
+                      GPS_NMEA_GSV | GPS_NMEA_RMC | GPS_NMEA_VTG | \
+                      GPS_NMEA_ZDA)
+
+// Each instance handles one receiver, on its own ttys instance.
+enum gps_instance_id {
+    GPS_INSTANCE_1,
+    GPS_INSTANCE_2,
+
+    GPS_NUM_INSTANCES
+};
+
+// Receiver output protocol.
+enum gps_protocol {
+    GPS_PROTOCOL_NMEA,
+    GPS_PROTOCOL_UBX,
+
+    GPS_NUM_PROTOCOLS
+};
+
 struct gps_cfg
 {
     enum ttys_instance_id ttys_instance_id;
+    bool pps_enable; // Use PPS input to discipline the tmr timebase. Only one
+                     // instance can use it.
+    int32_t pps_din_idx; // dio input for PPS, with rising edge events.
+    enum gps_protocol protocol;
+
+    // Receiver configuration, sent at start if rcvr_cfg_enable is true.
+    bool rcvr_cfg_enable;
+    uint32_t nmea_msgs;    // NMEA messages to output (GPS_NMEA_xxx), if
+                           // protocol is NMEA.
+    uint16_t meas_rate_ms; // Update period (100-1000 ms).
+    uint32_t baud;         // Receiver baud rate (0 to keep current).
+
+    uint16_t snr_decimation; // Keep every Nth SNR update in the history.
+
+    // Receive filter, which drops unwanted NMEA messages as they arrive.
+    bool nmea_filter_enable;
+    uint32_t nmea_filter_msgs; // NMEA messages passed (GPS_NMEA_xxx).
+
+    // Health measurements.
+    uint8_t ttns_num_sats;          // N for time-to-N-satellites.
+    uint32_t latency_bin_us;        // Latency histogram bin width.
+    uint32_t epoch_interval_bin_ms; // Epoch interval histogram bin width.
 };
 
 // Core module interface functions.
-int32_t gps_get_def_cfg(struct gps_cfg* cfg);
-int32_t gps_init(struct gps_cfg* cfg);
-int32_t gps_start(void);
+int32_t gps_get_def_cfg(enum gps_instance_id instance_id, struct gps_cfg* cfg);
+int32_t gps_init(enum gps_instance_id instance_id, struct gps_cfg* cfg);
+int32_t gps_start(enum gps_instance_id instance_id);
 int32_t gps_run(void);
 
 // Other APIs.
@@ -29,11 +29,23 @@
  * SOFTWARE.
  */
 
+#include <stdbool.h>
 #include <stdint.h>
 
+// Completion callback for mem_copy_async(), called from mem_run(). The result
+// is 0 for success, else a "MOD_ERR" value.
+typedef void (*mem_cb_func)(int32_t result, uint32_t user_data);
+
 // Core module interface functions.
 int32_t mem_start(void);
+int32_t mem_run(void);
 
 // Other APIs.
+int32_t mem_hexdump(const void* addr, uint32_t count, uint32_t unit_size,
+                    bool ascii);
+int32_t mem_copy(void* dst, const void* src, uint32_t len, bool use_dma);
+int32_t mem_fill(void* dst, uint8_t value, uint32_t len, bool use_dma);
+int32_t mem_copy_async(void* dst, const void* src, uint32_t len,
+                       mem_cb_func cb_func, uint32_t cb_user_data);
 
 #endif // _MEM_H_
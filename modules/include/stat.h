@@ -41,10 +41,24 @@ struct stat_dur {
     bool started;
 };
 
+// Histogram with fixed width bins. The last bin also counts all larger values.
+#define STAT_HIST_NUM_BINS 10
+
+struct stat_hist {
+    uint32_t bins[STAT_HIST_NUM_BINS];
+    uint32_t bin_width;
+    uint32_t samples;
+    uint32_t max;
+};
+
 void stat_dur_init(struct stat_dur* stat);
 void stat_dur_start(struct stat_dur* stat);
 void stat_dur_restart(struct stat_dur* stat);
 void stat_dur_end(struct stat_dur* stat);
 uint32_t stat_dur_avg_us(struct stat_dur* stat);
 
+void stat_hist_init(struct stat_hist* hist, uint32_t bin_width);
+void stat_hist_add(struct stat_hist* hist, uint32_t value);
+void stat_hist_print(struct stat_hist* hist, const char* units);
+
 #endif // _STAT_H_
@@ -56,6 +56,12 @@ int32_t tmr_run(void);
 
 // Other module-level APIs:
 uint32_t tmr_get_ms(void);
+uint32_t tmr_get_cycles(void);
+
+// PPS discipline and UTC APIs.
+void tmr_pps_edge(uint32_t edge_cycles);
+int32_t tmr_pps_set_utc(uint32_t utc_sec);
+int32_t tmr_get_utc_us(uint64_t* utc_us);
 
 // Timer instance-level APIs.
 int32_t tmr_inst_get(uint32_t ms);
@@ -33,11 +33,13 @@
 #include <stdint.h>
 #include <stdio.h>
 
-// UART numbering is based on the MCU hardware definition.
+// UART numbering is based on the MCU hardware definition. The software UART
+// uses two dio pins and TIM3.
 enum ttys_instance_id {
     TTYS_INSTANCE_UART1,
     TTYS_INSTANCE_UART2, // File discriptor 1 (stdin/stdout).
     TTYS_INSTANCE_UART6,
+    TTYS_INSTANCE_SWUART,
 
     TTYS_NUM_INSTANCES
 };
@@ -45,9 +47,24 @@ enum ttys_instance_id {
 #define TTYS_RX_BUF_SIZE 80
 #define TTYS_TX_BUF_SIZE 1024
 
+// Receive filter, called from the UART interrupt for each received character.
+// It puts zero or more characters (up to TTYS_RX_FILTER_MAX_OUT) in "out",
+// which are added to the receive buffer, and returns the number of them.
+#define TTYS_RX_FILTER_MAX_OUT 8
+typedef uint32_t (*ttys_rx_filter_cb)(char c, char* out, uint32_t user_data);
+
+#define TTYS_SWUART_MIN_BAUD 1200
+#define TTYS_SWUART_MAX_BAUD 115200
+
 struct ttys_cfg {
     bool create_stream;
     bool send_cr_after_nl;
+
+    // Software UART only (8N1). Each pin is optional (-1 for none), and must
+    // be one of the first DIO_MAX_MASK_BITS dio inputs/outputs.
+    int32_t swuart_tx_dout_idx;
+    int32_t swuart_rx_din_idx;
+    uint32_t swuart_baud;
 };
 
 // Core module interface functions.
@@ -58,6 +75,12 @@ int32_t ttys_start(enum ttys_instance_id instance_id);
 // Other APIs.
 int32_t ttys_putc(enum ttys_instance_id instance_id, char c);
 int32_t ttys_getc(enum ttys_instance_id instance_id, char* c);
+int32_t ttys_set_baud(enum ttys_instance_id instance_id, uint32_t baud);
+uint32_t ttys_get_baud(enum ttys_instance_id instance_id);
+bool ttys_is_tx_idle(enum ttys_instance_id instance_id);
+uint32_t ttys_get_tx_free(enum ttys_instance_id instance_id);
+int32_t ttys_set_rx_filter(enum ttys_instance_id instance_id,
+                           ttys_rx_filter_cb cb, uint32_t user_data);
 int ttys_get_fd(enum ttys_instance_id instance_id);
 FILE* ttys_get_stream(enum ttys_instance_id instance_id);
 
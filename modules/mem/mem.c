@@ -1,12 +1,28 @@
 /*
  * @brief Implementation of mem module.
  *
- * This module simply provides console commands to read and write memory, for
- * debugging.
+ * This module provides console commands to read and write memory, for
+ * debugging, and functions to fill and copy memory.
+ *
+ * Memory is displayed by a hex dump formatter (mem_hexdump()) that builds each
+ * line in a buffer, converting nibbles to hex digits with a lookup table, and
+ * outputs the line with a single write. This is much faster than calling
+ * printf() per item (see host_test/hexdump_bench.c), so large regions can be
+ * dumped quickly. Optionally, the bytes of each line are also shown as ASCII.
+ *
+ * Fill and copy can use DMA2 stream 0 in memory-to-memory mode (only DMA2
+ * supports it). The transfer uses the widest data size allowed by the
+ * alignment, with any odd bytes at the end done by the CPU, and is split into
+ * chunks of up to 65535 items. The CPU (memset()/memmove()) is used instead if
+ * the DMA is busy, or for overlapping copies. mem_copy_async() starts a copy
+ * and returns, and the completion callback is called from mem_run().
  *
  * The following console commands are provided:
  * > mem r
+ * > mem d
  * > mem w
+ * > mem fill
+ * > mem copy
  * See code for details.
  *
  * MIT License
@@ -33,28 +49,76 @@
  */
 
 #include <ctype.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
+#include "stm32f4xx_ll_bus.h"
+#include "stm32f4xx_ll_dma.h"
+
 #include "cmd.h"
 #include "log.h"
 #include "module.h"
+#include "tmr.h"
+
+#include "mem.h"
 
 ////////////////////////////////////////////////////////////////////////////////
 // Common macros
 ////////////////////////////////////////////////////////////////////////////////
 
+#define HEXDUMP_BYTES_PER_LINE 16
+
+// Address, items (up to 16 of " xx"), ASCII sidebar, newline, and NUL.
+#define HEXDUMP_LINE_SIZE (8 + 1 + HEXDUMP_BYTES_PER_LINE * 3 + 2 + \
+                           HEXDUMP_BYTES_PER_LINE + 1 + 1)
+
+// Memory-to-memory DMA hardware.
+#define MEM_DMA DMA2
+#define MEM_DMA_STREAM LL_DMA_STREAM_0
+#define MEM_DMA_CHANNEL LL_DMA_CHANNEL_0
+#define MEM_DMA_IRQ DMA2_Stream0_IRQn
+#define MEM_DMA_MAX_ITEMS 65535
+#define MEM_DMA_TIMEOUT_MS 1000 // For blocking transfers.
+
 ////////////////////////////////////////////////////////////////////////////////
 // Type definitions
 ////////////////////////////////////////////////////////////////////////////////
 
+struct dma_xfer
+{
+    volatile bool busy;      // Cleared by the ISR when done.
+    volatile int32_t result; // Set by the ISR.
+    uint32_t src;
+    uint32_t dst;
+    bool src_inc;            // False for fill.
+    uint32_t width;          // Data size in bytes.
+    uint32_t remaining;      // Bytes not yet transferred, including chunk.
+    uint32_t chunk_len;      // Bytes in current chunk.
+
+    // Asynchronous copy, waiting for completion to be reported.
+    mem_cb_func cb_func;
+    uint32_t cb_user_data;
+    bool cb_pending;
+    bool cb_dma; // The copy was done by DMA, so use its result.
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 // Private (static) function declarations
 ////////////////////////////////////////////////////////////////////////////////
 
 static int32_t cmd_mem_read(int32_t argc, const char** argv);
 static int32_t cmd_mem_write(int32_t argc, const char** argv);
+static int32_t cmd_mem_fill_copy(int32_t argc, const char** argv);
+static char* fmt_hex(char* p, uint32_t val, uint32_t num_digits);
+static bool overlaps(const void* dst, const void* src, uint32_t len);
+static int32_t dma_start(void* dst, const void* src, uint32_t len,
+                         bool src_inc);
+static int32_t dma_wait(void);
+static void dma_chunk_start(void);
+static void dma_stop(void);
+static void print_rate(const char* method, uint32_t len, uint32_t cycles);
 
 ////////////////////////////////////////////////////////////////////////////////
 // Private (static) variables
@@ -66,15 +130,37 @@ static struct cmd_cmd_info cmds[] = {
         .func = cmd_mem_read,
         .help = "Read memory, usage: mem r addr [count [data-unit-size]]",
     },
+    {
+        .name = "d",
+        .func = cmd_mem_read,
+        .help = "Dump memory with ASCII, usage: mem d addr [count [data-unit-size]]",
+    },
     {
         .name = "w",
         .func = cmd_mem_write,
         .help = "Write memory, usage: mem w addr <data-unit-size> value ...",
     },
+    {
+        .name = "fill",
+        .func = cmd_mem_fill_copy,
+        .help = "Fill memory, usage: mem fill addr len byte-value [dma|cpu]",
+    },
+    {
+        .name = "copy",
+        .func = cmd_mem_fill_copy,
+        .help = "Copy memory, usage: mem copy dst-addr src-addr len [dma|cpu]",
+    },
 };
 
 static int32_t log_level = LOG_DEFAULT;
 
+static const char hex_digits[16] = "0123456789abcdef";
+
+static struct dma_xfer dma;
+
+// DMA source for fill, with the byte value in all four bytes.
+static uint32_t fill_word;
+
 static struct cmd_client_info cmd_info = {
     .name = "mem",
     .num_cmds = ARRAY_SIZE(cmds),
@@ -107,6 +193,184 @@ int32_t mem_start(void)
         log_error("mem_start: cmd error %d\n", result);
         return MOD_ERR_RESOURCE;
     }
+
+    LL_AHB1_GRP1_EnableClock(LL_AHB1_GRP1_PERIPH_DMA2);
+    NVIC_SetPriority(MEM_DMA_IRQ,
+                     NVIC_EncodePriority(NVIC_GetPriorityGrouping(), 0, 0));
+    NVIC_EnableIRQ(MEM_DMA_IRQ);
+    return 0;
+}
+
+/*
+ * @brief Run mem instance.
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * Reports completion of an asynchronous copy.
+ *
+ * @note This function should not block.
+ */
+int32_t mem_run(void)
+{
+    if (!dma.cb_pending || dma.busy)
+        return 0;
+
+    // The callback could start another copy, so clear the state first.
+    dma.cb_pending = false;
+    dma.cb_func(dma.cb_dma ? dma.result : 0, dma.cb_user_data);
+    return 0;
+}
+
+/*
+ * @brief Copy memory.
+ *
+ * @param[in] dst Destination address.
+ * @param[in] src Source address.
+ * @param[in] len Number of bytes.
+ * @param[in] use_dma Use DMA, if available.
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * The copy is done when this function returns. The CPU is used if the DMA is
+ * busy or fails, or the regions overlap.
+ */
+int32_t mem_copy(void* dst, const void* src, uint32_t len, bool use_dma)
+{
+    if (use_dma && !overlaps(dst, src, len) &&
+        dma_start(dst, src, len, true) == 0 && dma_wait() == 0)
+        return 0;
+    memmove(dst, src, len);
+    return 0;
+}
+
+/*
+ * @brief Fill memory with a byte value.
+ *
+ * @param[in] dst Destination address.
+ * @param[in] value The byte value.
+ * @param[in] len Number of bytes.
+ * @param[in] use_dma Use DMA, if available.
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * The fill is done when this function returns. The CPU is used if the DMA is
+ * busy or fails.
+ */
+int32_t mem_fill(void* dst, uint8_t value, uint32_t len, bool use_dma)
+{
+    if (use_dma && !dma.busy) {
+        fill_word = (uint32_t)value * 0x01010101u;
+        if (dma_start(dst, &fill_word, len, false) == 0 && dma_wait() == 0)
+            return 0;
+    }
+    memset(dst, value, len);
+    return 0;
+}
+
+/*
+ * @brief Start an asynchronous memory copy.
+ *
+ * @param[in] dst Destination address.
+ * @param[in] src Source address.
+ * @param[in] len Number of bytes.
+ * @param[in] cb_func Completion callback.
+ * @param[in] cb_user_data User data passed to the callback.
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * The regions must not be accessed until the callback is called, from
+ * mem_run(). Only one asynchronous copy can be outstanding. If the DMA can't
+ * be used (it is busy with a blocking transfer, or the regions overlap), the
+ * copy is done by the CPU before returning, and the callback is still called
+ * from mem_run().
+ */
+int32_t mem_copy_async(void* dst, const void* src, uint32_t len,
+                       mem_cb_func cb_func, uint32_t cb_user_data)
+{
+    if (cb_func == NULL)
+        return MOD_ERR_ARG;
+    if (dma.cb_pending)
+        return MOD_ERR_STATE;
+
+    dma.cb_dma = !overlaps(dst, src, len) &&
+        dma_start(dst, src, len, true) == 0;
+    if (!dma.cb_dma)
+        memmove(dst, src, len);
+    dma.cb_func = cb_func;
+    dma.cb_user_data = cb_user_data;
+    dma.cb_pending = true;
+    return 0;
+}
+
+/*
+ * @brief Display memory as a hex dump.
+ *
+ * @param[in] addr Start address, aligned to unit_size.
+ * @param[in] count Number of data units to display.
+ * @param[in] unit_size Data unit size (1, 2, or 4).
+ * @param[in] ascii Also display the bytes of each line as ASCII.
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * Each line shows 16 bytes. Memory is accessed once per data unit, using the
+ * data unit size, so this can be used on peripheral registers. The ASCII
+ * sidebar is built from the values read, rather than reading memory again.
+ */
+int32_t mem_hexdump(const void* addr, uint32_t count, uint32_t unit_size,
+                    bool ascii)
+{
+    char line[HEXDUMP_LINE_SIZE];
+    char text[HEXDUMP_BYTES_PER_LINE];
+    const uint8_t* p8 = addr;
+    uint32_t items_per_line;
+    uint32_t line_items;
+    uint32_t item;
+    uint32_t val;
+    uint32_t idx;
+    char* p;
+
+    if (unit_size != 1 && unit_size != 2 && unit_size != 4)
+        return MOD_ERR_ARG;
+    items_per_line = HEXDUMP_BYTES_PER_LINE / unit_size;
+
+    while (count > 0) {
+        line_items = count < items_per_line ? count : items_per_line;
+        count -= line_items;
+
+        p = fmt_hex(line, (uint32_t)p8, 8);
+        *p++ = ':';
+        for (item = 0; item < line_items; item++) {
+            switch (unit_size) {
+                case 1:
+                    val = *(const volatile uint8_t*)p8;
+                    break;
+                case 2:
+                    val = *(const volatile uint16_t*)p8;
+                    break;
+                default:
+                    val = *(const volatile uint32_t*)p8;
+                    break;
+            }
+            p8 += unit_size;
+            *p++ = ' ';
+            p = fmt_hex(p, val, unit_size * 2);
+            for (idx = 0; idx < unit_size; idx++, val >>= 8)
+                text[item * unit_size + idx] = val;
+        }
+        if (ascii) {
+            // Pad a short last line so the sidebar lines up.
+            for (idx = line_items; idx < items_per_line; idx++) {
+                memset(p, ' ', unit_size * 2 + 1);
+                p += unit_size * 2 + 1;
+            }
+            *p++ = ' ';
+            *p++ = ' ';
+            for (idx = 0; idx < line_items * unit_size; idx++)
+                *p++ = isprint((unsigned char)text[idx]) ? text[idx] : '.';
+        }
+        *p++ = '\n';
+        fwrite(line, 1, p - line, stdout);
+    }
     return 0;
 }
 
@@ -115,14 +379,16 @@ int32_t mem_start(void)
 ////////////////////////////////////////////////////////////////////////////////
 
 /*
- * @brief Console command function for "mem r".
+ * @brief Console command function for "mem r" and "mem d".
  *
  * @param[in] argc Number of arguments, including "mem"
  * @param[in] argv Argument values, including "mem"
  *
  * @return 0 for success, else a "MOD_ERR" value. See code for details.
  *
- * Command usage: mem r addr [count [data-unit-size]]
+ * Command usage:
+ *    mem r addr [count [data-unit-size]]
+ *    mem d addr [count [data-unit-size]]
  */
 static int32_t cmd_mem_read(int32_t argc, const char** argv)
 {
@@ -130,9 +396,11 @@ static int32_t cmd_mem_read(int32_t argc, const char** argv)
     struct cmd_arg_val arg_vals[3];
     uint32_t count = 1;
     uint32_t unit_size = 4;
-    int32_t items_per_line;
-    int32_t line_item_ctr;
-    
+    bool ascii = strcasecmp(argv[1], "d") == 0;
+
+    if (ascii)
+        count = HEXDUMP_BYTES_PER_LINE / unit_size;
+
     num_args = cmd_parse_args(argc-2, argv+2, "p[u[u]]", arg_vals);
     if (num_args >= 2) {
         count = arg_vals[1].val.u;
@@ -142,51 +410,16 @@ static int32_t cmd_mem_read(int32_t argc, const char** argv)
     }
     if (num_args < 1 || num_args > 3)
         return num_args;
-            
-    switch (unit_size) {
-        case 1:
-            items_per_line = 16;
-            break;
-        case 2:
-            items_per_line = 8;
-            break;
-        case 4:
-            items_per_line = 4;
-            break;
-        default:
-            printf("Invalid data unit size %lu\n", unit_size);
-            return MOD_ERR_ARG;
-    }
-    line_item_ctr = 0;
-    while (count-- > 0) {
-        if (line_item_ctr == 0)
-            printf("%08x:", (unsigned)arg_vals[0].val.p);
-        switch (unit_size) {
-            case 1:
-                printf(" %02x", *arg_vals[0].val.p8);
-                break;
-            case 2:
-                printf(" %04x", *arg_vals[0].val.p16);
-                break;
-            case 4:
-                printf(" %08lx", *arg_vals[0].val.p32);
-                break;
-        }
-        arg_vals[0].val.p8 += unit_size;
-        if (++line_item_ctr == items_per_line)
-        {
-            printf("\n");
-            line_item_ctr = 0;
-        }
+
+    if (mem_hexdump(arg_vals[0].val.p, count, unit_size, ascii) < 0) {
+        printf("Invalid data unit size %lu\n", unit_size);
+        return MOD_ERR_ARG;
     }
-    if (line_item_ctr != 0)
-        printf("\n");
     return 0;
 }
 
-
 /*
- * @brief Console command function for "mem r".
+ * @brief Console command function for "mem w".
  *
  * @param[in] argc Number of arguments, including "mem"
  * @param[in] argv Argument values, including "mem"
@@ -227,3 +460,300 @@ static int32_t cmd_mem_write(int32_t argc, const char** argv)
     }
     return 0;
 }
+
+/*
+ * @brief Console command function for "mem fill" and "mem copy".
+ *
+ * @param[in] argc Number of arguments, including "mem"
+ * @param[in] argv Argument values, including "mem"
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * Command usage:
+ *    mem fill addr len byte-value [dma|cpu]
+ *    mem copy dst-addr src-addr len [dma|cpu]
+ *
+ * By default both methods are run, one after the other, and the rate of each
+ * is displayed.
+ */
+static int32_t cmd_mem_fill_copy(int32_t argc, const char** argv)
+{
+    int32_t num_args;
+    struct cmd_arg_val arg_vals[4];
+    bool fill = strcasecmp(argv[1], "fill") == 0;
+    bool do_cpu = true;
+    bool do_dma = true;
+    void* dst;
+    const void* src;
+    uint32_t len;
+    uint32_t start;
+    int32_t rc;
+
+    num_args = cmd_parse_args(argc-2, argv+2, fill ? "puu[s]" : "ppu[s]",
+                              arg_vals);
+    if (num_args < 3)
+        return num_args;
+    if (num_args == 4) {
+        if (strcasecmp(arg_vals[3].val.s, "dma") == 0) {
+            do_cpu = false;
+        } else if (strcasecmp(arg_vals[3].val.s, "cpu") == 0) {
+            do_dma = false;
+        } else {
+            printf("Invalid method '%s'\n", arg_vals[3].val.s);
+            return MOD_ERR_ARG;
+        }
+    }
+    dst = arg_vals[0].val.p;
+    src = arg_vals[1].val.p;
+    len = arg_vals[2].val.u;
+    if (fill) {
+        len = arg_vals[1].val.u;
+        fill_word = (uint32_t)(uint8_t)arg_vals[2].val.u * 0x01010101u;
+        src = &fill_word;
+    }
+
+    if (do_cpu) {
+        start = tmr_get_cycles();
+        if (fill)
+            memset(dst, (uint8_t)fill_word, len);
+        else
+            memmove(dst, src, len);
+        print_rate("cpu", len, tmr_get_cycles() - start);
+    }
+    if (do_dma) {
+        if (!fill && overlaps(dst, src, len)) {
+            printf("dma: regions overlap\n");
+            return MOD_ERR_ARG;
+        }
+        start = tmr_get_cycles();
+        rc = dma_start(dst, src, len, !fill);
+        if (rc == 0)
+            rc = dma_wait();
+        if (rc < 0) {
+            printf("dma: error %ld\n", rc);
+            return rc;
+        }
+        print_rate("dma", len, tmr_get_cycles() - start);
+    }
+    return 0;
+}
+
+/*
+ * @brief Format a value as fixed width hex.
+ *
+ * @param[out] p Location to place the digits.
+ * @param[in] val The value.
+ * @param[in] num_digits Number of digits (low order nibbles of val).
+ *
+ * @return Location following the digits.
+ */
+static char* fmt_hex(char* p, uint32_t val, uint32_t num_digits)
+{
+    char* end = p + num_digits;
+
+    while (p < end) {
+        *--end = hex_digits[val & 0xf];
+        val >>= 4;
+    }
+    return p + num_digits;
+}
+
+/*
+ * @brief Check if copy regions overlap.
+ *
+ * @param[in] dst Destination address.
+ * @param[in] src Source address.
+ * @param[in] len Number of bytes.
+ *
+ * @return true if the regions overlap.
+ */
+static bool overlaps(const void* dst, const void* src, uint32_t len)
+{
+    return (uint32_t)dst - (uint32_t)src < len ||
+        (uint32_t)src - (uint32_t)dst < len;
+}
+
+/*
+ * @brief Start a DMA transfer.
+ *
+ * @param[in] dst Destination address.
+ * @param[in] src Source address.
+ * @param[in] len Number of bytes.
+ * @param[in] src_inc Increment the source address (false for fill).
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * Bytes at the end that don't make up a full item are done by the CPU now,
+ * so on return they are already done.
+ */
+static int32_t dma_start(void* dst, const void* src, uint32_t len,
+                         bool src_inc)
+{
+    uint32_t align = (uint32_t)dst | (src_inc ? (uint32_t)src : 0);
+    uint32_t tail;
+
+    if (dma.busy)
+        return MOD_ERR_STATE;
+
+    if ((align & 3) == 0)
+        dma.width = 4;
+    else if ((align & 1) == 0)
+        dma.width = 2;
+    else
+        dma.width = 1;
+    tail = len & (dma.width - 1);
+    len -= tail;
+    if (src_inc)
+        memmove((uint8_t*)dst + len, (const uint8_t*)src + len, tail);
+    else
+        memset((uint8_t*)dst + len, (uint8_t)fill_word, tail);
+
+    dma.src = (uint32_t)src;
+    dma.dst = (uint32_t)dst;
+    dma.src_inc = src_inc;
+    dma.remaining = len;
+    dma.result = 0;
+    if (len == 0)
+        return 0;
+
+    LL_DMA_DisableStream(MEM_DMA, MEM_DMA_STREAM);
+    while (LL_DMA_IsEnabledStream(MEM_DMA, MEM_DMA_STREAM))
+        ;
+    LL_DMA_ClearFlag_TC0(MEM_DMA);
+    LL_DMA_ClearFlag_HT0(MEM_DMA);
+    LL_DMA_ClearFlag_TE0(MEM_DMA);
+    LL_DMA_ClearFlag_DME0(MEM_DMA);
+    LL_DMA_ClearFlag_FE0(MEM_DMA);
+    LL_DMA_SetChannelSelection(MEM_DMA, MEM_DMA_STREAM, MEM_DMA_CHANNEL);
+    // In memory-to-memory mode the "peripheral" is the source.
+    LL_DMA_SetDataTransferDirection(MEM_DMA, MEM_DMA_STREAM,
+                                    LL_DMA_DIRECTION_MEMORY_TO_MEMORY);
+    LL_DMA_SetMode(MEM_DMA, MEM_DMA_STREAM, LL_DMA_MODE_NORMAL);
+    LL_DMA_SetPeriphIncMode(MEM_DMA, MEM_DMA_STREAM,
+                            src_inc ? LL_DMA_PERIPH_INCREMENT :
+                            LL_DMA_PERIPH_NOINCREMENT);
+    LL_DMA_SetMemoryIncMode(MEM_DMA, MEM_DMA_STREAM,
+                            LL_DMA_MEMORY_INCREMENT);
+    LL_DMA_SetPeriphSize(MEM_DMA, MEM_DMA_STREAM,
+                         dma.width == 4 ? LL_DMA_PDATAALIGN_WORD :
+                         dma.width == 2 ? LL_DMA_PDATAALIGN_HALFWORD :
+                         LL_DMA_PDATAALIGN_BYTE);
+    LL_DMA_SetMemorySize(MEM_DMA, MEM_DMA_STREAM,
+                         dma.width == 4 ? LL_DMA_MDATAALIGN_WORD :
+                         dma.width == 2 ? LL_DMA_MDATAALIGN_HALFWORD :
+                         LL_DMA_MDATAALIGN_BYTE);
+    // Memory-to-memory requires the FIFO (no direct mode).
+    LL_DMA_EnableFifoMode(MEM_DMA, MEM_DMA_STREAM);
+    LL_DMA_SetFIFOThreshold(MEM_DMA, MEM_DMA_STREAM,
+                            LL_DMA_FIFOTHRESHOLD_FULL);
+    LL_DMA_SetStreamPriorityLevel(MEM_DMA, MEM_DMA_STREAM,
+                                  LL_DMA_PRIORITY_LOW);
+    LL_DMA_EnableIT_TC(MEM_DMA, MEM_DMA_STREAM);
+    LL_DMA_EnableIT_TE(MEM_DMA, MEM_DMA_STREAM);
+    dma.busy = true;
+    dma_chunk_start();
+    return 0;
+}
+
+/*
+ * @brief Wait for a DMA transfer to finish.
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * On a timeout, the DMA interrupt is disabled while the transfer is stopped,
+ * so the ISR can't start another chunk or change the state at the same time.
+ * A completion flagged during the teardown is discarded.
+ */
+static int32_t dma_wait(void)
+{
+    uint32_t start_ms = tmr_get_ms();
+
+    while (dma.busy) {
+        if (tmr_get_ms() - start_ms > MEM_DMA_TIMEOUT_MS) {
+            NVIC_DisableIRQ(MEM_DMA_IRQ);
+            if (dma.busy) {
+                dma_stop();
+                LL_DMA_ClearFlag_TC0(MEM_DMA);
+                LL_DMA_ClearFlag_TE0(MEM_DMA);
+                NVIC_ClearPendingIRQ(MEM_DMA_IRQ);
+            }
+            NVIC_EnableIRQ(MEM_DMA_IRQ);
+            return dma.result;
+        }
+    }
+    return dma.result;
+}
+
+/*
+ * @brief Start the next chunk of a DMA transfer.
+ *
+ * This is called from dma_start(), and from the ISR for later chunks.
+ */
+static void dma_chunk_start(void)
+{
+    uint32_t items = dma.remaining / dma.width;
+
+    if (items > MEM_DMA_MAX_ITEMS)
+        items = MEM_DMA_MAX_ITEMS;
+    dma.chunk_len = items * dma.width;
+    LL_DMA_SetPeriphAddress(MEM_DMA, MEM_DMA_STREAM, dma.src);
+    LL_DMA_SetMemoryAddress(MEM_DMA, MEM_DMA_STREAM, dma.dst);
+    LL_DMA_SetDataLength(MEM_DMA, MEM_DMA_STREAM, items);
+    LL_DMA_EnableStream(MEM_DMA, MEM_DMA_STREAM);
+}
+
+/*
+ * @brief Stop a DMA transfer.
+ */
+static void dma_stop(void)
+{
+    LL_DMA_DisableIT_TC(MEM_DMA, MEM_DMA_STREAM);
+    LL_DMA_DisableIT_TE(MEM_DMA, MEM_DMA_STREAM);
+    LL_DMA_DisableStream(MEM_DMA, MEM_DMA_STREAM);
+    while (LL_DMA_IsEnabledStream(MEM_DMA, MEM_DMA_STREAM))
+        ;
+    dma.result = MOD_ERR_RESOURCE;
+    dma.busy = false;
+}
+
+/*
+ * @brief Print transfer size, time and rate.
+ *
+ * @param[in] method Name of the method.
+ * @param[in] len Number of bytes.
+ * @param[in] cycles Duration in CPU cycles.
+ */
+static void print_rate(const char* method, uint32_t len, uint32_t cycles)
+{
+    if (cycles == 0)
+        cycles = 1;
+    printf("%s: %lu bytes in %lu us, %lu bytes/s\n", method, len,
+           (uint32_t)((uint64_t)cycles * 1000000 / SystemCoreClock),
+           (uint32_t)((uint64_t)len * SystemCoreClock / cycles));
+}
+
+/*
+ * @brief DMA interrupt handler for memory-to-memory transfers.
+ */
+void DMA2_Stream0_IRQHandler(void)
+{
+    if (LL_DMA_IsActiveFlag_TE0(MEM_DMA)) {
+        LL_DMA_ClearFlag_TE0(MEM_DMA);
+        dma_stop();
+        return;
+    }
+    if (LL_DMA_IsActiveFlag_TC0(MEM_DMA)) {
+        LL_DMA_ClearFlag_TC0(MEM_DMA);
+        dma.remaining -= dma.chunk_len;
+        dma.dst += dma.chunk_len;
+        if (dma.src_inc)
+            dma.src += dma.chunk_len;
+        if (dma.remaining > 0) {
+            dma_chunk_start();
+        } else {
+            LL_DMA_DisableIT_TC(MEM_DMA, MEM_DMA_STREAM);
+            LL_DMA_DisableIT_TE(MEM_DMA, MEM_DMA_STREAM);
+            dma.busy = false;
+        }
+    }
+}
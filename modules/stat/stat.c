@@ -2,7 +2,7 @@
  * @brief Implementation of stat utility.
  *
  * This utility collects data and performs statistical calculations. Currently it
- * supports time duration measurements.
+ * supports time duration measurements, and histograms.
  *
  * MIT License
  * 
@@ -29,6 +29,7 @@
 
 #include <limits.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <string.h>
 
 #include "tmr.h"
@@ -152,6 +153,59 @@ uint32_t stat_dur_avg_us(struct stat_dur* stat)
     return (stat->accum_ms * 1000) / stat->samples;
 }
 
+/*
+ * @brief Initialize histogram.
+ *
+ * @param[in] hist Histogram.
+ * @param[in] bin_width Width of each bin (must be > 0).
+ */
+void stat_hist_init(struct stat_hist* hist, uint32_t bin_width)
+{
+    memset(hist, 0, sizeof(*hist));
+    hist->bin_width = bin_width > 0 ? bin_width : 1;
+}
+
+/*
+ * @brief Add a value to a histogram.
+ *
+ * @param[in] hist Histogram.
+ * @param[in] value The value.
+ */
+void stat_hist_add(struct stat_hist* hist, uint32_t value)
+{
+    uint32_t bin = value / hist->bin_width;
+
+    if (hist->samples == UINT32_MAX)
+        return;
+    if (bin >= STAT_HIST_NUM_BINS)
+        bin = STAT_HIST_NUM_BINS - 1;
+    hist->bins[bin]++;
+    hist->samples++;
+    if (value > hist->max)
+        hist->max = value;
+}
+
+/*
+ * @brief Print a histogram.
+ *
+ * @param[in] hist Histogram.
+ * @param[in] units Units of the values, for display.
+ */
+void stat_hist_print(struct stat_hist* hist, const char* units)
+{
+    uint32_t bin;
+
+    for (bin = 0; bin < STAT_HIST_NUM_BINS; bin++) {
+        if (bin < STAT_HIST_NUM_BINS - 1)
+            printf("  %7lu-%-7lu %s: %lu\n", bin * hist->bin_width,
+                   (bin + 1) * hist->bin_width - 1, units, hist->bins[bin]);
+        else
+            printf("  %7lu+        %s: %lu\n", bin * hist->bin_width, units,
+                   hist->bins[bin]);
+    }
+    printf("  samples=%lu max=%lu %s\n", hist->samples, hist->max, units);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Private (static) functions
 ////////////////////////////////////////////////////////////////////////////////
@@ -11,6 +11,14 @@
  * - A function to get the current ms time value, an unsigned value which
  *   periodically rolls over. With the current 32 bit variable, it rolls over
  *   every 49.7 days.
+ * - A function to get the core clock cycle counter (DWT CYCCNT), for
+ *   sub-microsecond time stamps and measurements.
+ * - A PPS (pulse-per-second) disciplined timebase. A client (e.g. the gps
+ *   module) reports the core cycle count at each PPS edge, and this module
+ *   measures the crystal's frequency error against the PPS, and trims the
+ *   SysTick reload value so the ms tick tracks the PPS. When the client also
+ *   reports the UTC second of each PPS edge, tmr_get_utc_us() provides UTC
+ *   time with microsecond resolution.
  *
  * The number of software timers is fixed at compile time (see TMR_NUM_INST).
  * Each software timer has one of the following states:
@@ -22,6 +30,7 @@
  * The following console commands are provided:
  * > tmr status
  * > tmr test
+ * > tmr pps
  * See code for details.
  *
  * MIT License
@@ -63,6 +72,15 @@
 // Common macros
 ////////////////////////////////////////////////////////////////////////////////
 
+// PPS discipline parameters. PPS intervals are measured in core clock cycles,
+// which also clock SysTick.
+#define PPS_MAX_ERR_PPM 200     // Reject intervals with a larger error.
+#define PPS_ACQ_FILTER_SHIFT 1  // Averaging shift while acquiring lock.
+#define PPS_FILTER_SHIFT 3      // Averaging shift while locked.
+#define PPS_LOCK_RESID_CYC 200  // Max residual for a "good" interval.
+#define PPS_LOCK_COUNT 8        // Good intervals needed to declare lock.
+#define PPS_TIMEOUT_MS 2500     // Lose PPS if no edge for this long.
+
 ////////////////////////////////////////////////////////////////////////////////
 // Type definitions
 ////////////////////////////////////////////////////////////////////////////////
@@ -74,6 +92,22 @@ enum tmr_state {
     TMR_EXPIRED,
 };
 
+// PPS discipline state. Fields marked (I) are updated in interrupt context.
+struct pps_state {
+    uint64_t cyc_per_sec_q8;  // Filtered cycles per second (Q8).
+    uint32_t nominal_cyc;     // Nominal cycles per second.
+    uint32_t last_edge_cyc;   // (I) Cycle count at last edge.
+    uint32_t last_edge_ms;    // (I) ms tick at last edge.
+    uint32_t utc_sec;         // (I) UTC seconds (since 1970) of last edge.
+    uint32_t good_cnt;        // (I) Consecutive good intervals.
+    int32_t last_resid_cyc;   // (I) Last interval minus filtered value.
+    int32_t max_resid_cyc;    // (I) Max |residual| while locked.
+    uint32_t edges;           // (I) Number of edges.
+    bool have_edge;           // (I) last_edge_* is valid.
+    bool utc_valid;           // (I) utc_sec is valid.
+    bool locked;              // (I) Discipline is locked.
+};
+
 // State information for a timer instance.
 struct tmr_inst_info {
     uint32_t period_ms;
@@ -89,7 +123,9 @@ struct tmr_inst_info {
 
 static int32_t cmd_tmr_status(int32_t argc, const char** argv);
 static int32_t cmd_tmr_test(int32_t argc, const char** argv);
+static int32_t cmd_tmr_pps(int32_t argc, const char** argv);
 static enum tmr_cb_action test_cb_func(int32_t tmr_id, uint32_t user_data);
+static void pps_apply_correction(void);
 
 ////////////////////////////////////////////////////////////////////////////////
 // Private (static) variables
@@ -97,6 +133,14 @@ static enum tmr_cb_action test_cb_func(int32_t tmr_id, uint32_t user_data);
 
 static uint32_t tick_ms_ctr;
 
+// SysTick reload trimming. Each tick is tick_load cycles plus a fraction
+// (tick_frac_q16/65536) that is accumulated and carried into the reload.
+static volatile uint32_t tick_load;
+static volatile uint32_t tick_frac_q16;
+static uint32_t tick_frac_acc;
+
+static struct pps_state pps;
+
 static struct tmr_inst_info tmrs[TMR_NUM_INST];
 
 static struct cmd_cmd_info cmds[] = {
@@ -110,15 +154,43 @@ static struct cmd_cmd_info cmds[] = {
         .func = cmd_tmr_test,
         .help = "Run test, usage: tmr test [<op> [<arg1> [<arg2>]]] (enter no op/args for help)",
     },
+    {
+        .name = "pps",
+        .func = cmd_tmr_pps,
+        .help = "Get PPS discipline status, usage: tmr pps",
+    },
 };
 
 static int32_t log_level = LOG_DEFAULT;
 
+enum tmr_u16_pms {
+    CNT_PPS_REJECT,
+    CNT_PPS_TIMEOUT,
+    CNT_PPS_LOCK_LOSS,
+    CNT_PPS_UTC_RESYNC,
+    CNT_PPS_UTC_NO_EDGE,
+
+    NUM_U16_PMS
+};
+
+static uint16_t cnts_u16[NUM_U16_PMS];
+
+static const char* cnts_u16_names[NUM_U16_PMS] = {
+    "pps interval reject",
+    "pps timeout",
+    "pps lock loss",
+    "pps utc resync",
+    "pps utc no edge",
+};
+
 static struct cmd_client_info cmd_info = {
     .name = "tmr",
     .num_cmds = ARRAY_SIZE(cmds),
     .cmds = cmds,
     .log_level_ptr = &log_level,
+    .num_u16_pms = NUM_U16_PMS,
+    .u16_pms = cnts_u16,
+    .u16_pm_names = cnts_u16_names,
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -144,6 +216,21 @@ int32_t tmr_init(struct tmr_cfg* cfg)
 {
     log_debug("In tmr_init()\n");
     memset(&tmrs, 0, sizeof(tmrs));
+    memset(&pps, 0, sizeof(pps));
+
+    // SysTick runs from the core clock, so the current reload value gives the
+    // nominal cycles per ms.
+    tick_load = (SysTick->LOAD & SysTick_LOAD_RELOAD_Msk) + 1;
+    tick_frac_q16 = 0;
+    tick_frac_acc = 0;
+    pps.nominal_cyc = tick_load * 1000;
+    pps.cyc_per_sec_q8 = (uint64_t)pps.nominal_cyc << 8;
+
+    // Enable the DWT cycle counter.
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
     LL_SYSTICK_EnableIT();
     return 0;
 }
@@ -183,12 +270,35 @@ int32_t tmr_run(void)
     static uint32_t last_ms = 0;
     int32_t idx;
     uint32_t now_ms = tmr_get_ms();
+    bool pps_lost = false;
 
     // Fast exit if time has not changed.
     if (now_ms == last_ms)
         return 0;
 
     last_ms = now_ms;
+
+    // Check for loss of PPS. The test is repeated with interrupts disabled,
+    // so an edge that arrives just after the first test isn't discarded.
+    if (pps.have_edge && now_ms - pps.last_edge_ms > PPS_TIMEOUT_MS) {
+        __disable_irq();
+        if (pps.have_edge &&
+            tmr_get_ms() - pps.last_edge_ms > PPS_TIMEOUT_MS) {
+            if (pps.locked)
+                INC_SAT_U16(cnts_u16[CNT_PPS_LOCK_LOSS]);
+            pps.have_edge = false;
+            pps.utc_valid = false;
+            pps.locked = false;
+            pps.good_cnt = 0;
+            pps_lost = true;
+        }
+        __enable_irq();
+        if (pps_lost) {
+            INC_SAT_U16(cnts_u16[CNT_PPS_TIMEOUT]);
+            log_info("PPS lost\n");
+        }
+    }
+
     for (idx = 0; idx < TMR_NUM_INST; idx++) {
         struct tmr_inst_info* ti = &tmrs[idx];
         if (ti->state == TMR_RUNNING) {
@@ -224,6 +334,165 @@ uint32_t tmr_get_ms(void)
     return tick_ms_ctr;
 }
 
+/*
+ * @brief Get core clock cycle counter.
+ *
+ * @return Cycle counter value.
+ *
+ * The counter runs at the core clock rate, and rolls over (e.g. every 51
+ * seconds at 84 MHz). Differences of two values give elapsed cycles.
+ */
+uint32_t tmr_get_cycles(void)
+{
+    return DWT->CYCCNT;
+}
+
+/*
+ * @brief Report a PPS edge.
+ *
+ * @param[in] edge_cycles Cycle counter value (tmr_get_cycles()) at the edge.
+ *
+ * @note This function can be called from interrupt context, and should be
+ *       called as soon as possible after the edge, with the cycle count
+ *       captured at the start of the interrupt handler.
+ *
+ * The interval since the previous edge is the number of core clock cycles in
+ * one (GPS) second. Intervals too far from nominal are rejected as glitches or
+ * missed pulses. Good intervals are averaged to estimate the real core clock
+ * frequency. After a run of intervals that agree with the estimate, the
+ * discipline is declared locked, and the SysTick reload is trimmed to match.
+ */
+void tmr_pps_edge(uint32_t edge_cycles)
+{
+    uint32_t interval;
+    uint32_t max_err_cyc;
+    int32_t resid;
+    uint32_t est_cyc;
+    uint32_t shift;
+
+    pps.edges++;
+    if (!pps.have_edge) {
+        pps.have_edge = true;
+        pps.last_edge_cyc = edge_cycles;
+        pps.last_edge_ms = tick_ms_ctr;
+        return;
+    }
+
+    interval = edge_cycles - pps.last_edge_cyc;
+    pps.last_edge_cyc = edge_cycles;
+    pps.last_edge_ms = tick_ms_ctr;
+    if (pps.utc_valid)
+        pps.utc_sec++;
+
+    max_err_cyc = pps.nominal_cyc / (1000000 / PPS_MAX_ERR_PPM);
+    if (interval > pps.nominal_cyc + max_err_cyc ||
+        interval < pps.nominal_cyc - max_err_cyc) {
+        INC_SAT_U16(cnts_u16[CNT_PPS_REJECT]);
+        pps.good_cnt = 0;
+        pps.utc_valid = false;
+        if (pps.locked)
+            INC_SAT_U16(cnts_u16[CNT_PPS_LOCK_LOSS]);
+        pps.locked = false;
+        return;
+    }
+
+    est_cyc = (uint32_t)((pps.cyc_per_sec_q8 + 128) >> 8);
+    resid = (int32_t)(interval - est_cyc);
+    pps.last_resid_cyc = resid;
+    shift = pps.locked ? PPS_FILTER_SHIFT : PPS_ACQ_FILTER_SHIFT;
+    pps.cyc_per_sec_q8 += ((int64_t)resid << 8) >> shift;
+
+    if (resid < 0)
+        resid = -resid;
+    if (resid <= PPS_LOCK_RESID_CYC) {
+        if (!pps.locked && ++pps.good_cnt >= PPS_LOCK_COUNT) {
+            pps.locked = true;
+            pps.max_resid_cyc = 0;
+        }
+    } else {
+        pps.good_cnt = 0;
+        if (pps.locked)
+            INC_SAT_U16(cnts_u16[CNT_PPS_LOCK_LOSS]);
+        pps.locked = false;
+    }
+    if (pps.locked) {
+        if (resid > pps.max_resid_cyc)
+            pps.max_resid_cyc = resid;
+        pps_apply_correction();
+    }
+}
+
+/*
+ * @brief Set the UTC time of the most recent PPS edge.
+ *
+ * @param[in] utc_sec UTC time, in seconds since 1970-01-01, of the most recent
+ *                    PPS edge.
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * GPS receivers report the time of a PPS edge (e.g. in the RMC sentence)
+ * shortly after the edge. Once set, the UTC time is advanced on each PPS edge,
+ * so this function normally just confirms the current value. A time one
+ * second behind is treated as a late report of the previous edge.
+ */
+int32_t tmr_pps_set_utc(uint32_t utc_sec)
+{
+    int32_t rc = 0;
+
+    __disable_irq();
+    if (!pps.have_edge || tick_ms_ctr - pps.last_edge_ms >= 1000) {
+        rc = MOD_ERR_STATE;
+    } else if (!pps.utc_valid || (utc_sec != pps.utc_sec &&
+                                  utc_sec != pps.utc_sec - 1)) {
+        if (pps.utc_valid)
+            INC_SAT_U16(cnts_u16[CNT_PPS_UTC_RESYNC]);
+        pps.utc_sec = utc_sec;
+        pps.utc_valid = true;
+    }
+    __enable_irq();
+    if (rc == MOD_ERR_STATE)
+        INC_SAT_U16(cnts_u16[CNT_PPS_UTC_NO_EDGE]);
+    return rc;
+}
+
+/*
+ * @brief Get UTC time in microseconds.
+ *
+ * @param[out] utc_us UTC time, in microseconds since 1970-01-01.
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * The time is the UTC time of the last PPS edge, plus the cycles since that
+ * edge scaled by the measured core clock frequency. If the UTC time is not
+ * known, MOD_ERR_STATE is returned.
+ */
+int32_t tmr_get_utc_us(uint64_t* utc_us)
+{
+    uint32_t edge_cyc;
+    uint32_t utc_sec;
+    uint64_t cyc_per_sec_q8;
+    uint32_t now_cyc;
+    bool valid;
+
+    if (utc_us == NULL)
+        return MOD_ERR_ARG;
+
+    __disable_irq();
+    now_cyc = DWT->CYCCNT;
+    valid = pps.utc_valid;
+    edge_cyc = pps.last_edge_cyc;
+    utc_sec = pps.utc_sec;
+    cyc_per_sec_q8 = pps.cyc_per_sec_q8;
+    __enable_irq();
+
+    if (!valid)
+        return MOD_ERR_STATE;
+
+    *utc_us = (uint64_t)utc_sec * 1000000 +
+        ((uint64_t)(now_cyc - edge_cyc) * 1000000 << 8) / cyc_per_sec_q8;
+    return 0;
+}
+
 /*
  * @brief Get a timer instance without a callback function.
  *
@@ -365,6 +634,12 @@ int32_t tmr_inst_is_expired(int32_t tmr_id)
 void tmr_SysTick_Handler(void)
 {
     tick_ms_ctr++;
+
+    // The new reload value is used at the next counter reload, i.e. for the
+    // tick after the current one.
+    tick_frac_acc += tick_frac_q16;
+    SysTick->LOAD = tick_load - 1 + (tick_frac_acc >> 16);
+    tick_frac_acc &= 0xffff;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -505,6 +780,57 @@ static int32_t cmd_tmr_test(int32_t argc, const char** argv)
     return 0;
 }
 
+/*
+ * @brief Console command function for "tmr pps".
+ *
+ * @param[in] argc Number of arguments, including "tmr"
+ * @param[in] argv Argument values, including "tmr"
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * Command usage: tmr pps
+ */
+static int32_t cmd_tmr_pps(int32_t argc, const char** argv)
+{
+    struct pps_state p;
+    int64_t err_ppb;
+    uint64_t utc_us;
+
+    __disable_irq();
+    p = pps;
+    __enable_irq();
+
+    err_ppb = ((int64_t)p.cyc_per_sec_q8 - ((int64_t)p.nominal_cyc << 8)) *
+        1000000000 / ((int64_t)p.nominal_cyc << 8);
+    printf("PPS edges=%lu have-edge=%d locked=%d good-cnt=%lu\n",
+           p.edges, p.have_edge, p.locked, p.good_cnt);
+    printf("Clock nominal=%lu measured=%lu Hz error=%ld ppb\n",
+           p.nominal_cyc, (uint32_t)((p.cyc_per_sec_q8 + 128) >> 8),
+           (int32_t)err_ppb);
+    printf("Residual last=%ld max-since-lock=%ld cycles\n",
+           p.last_resid_cyc, p.max_resid_cyc);
+    printf("SysTick load=%lu frac=%lu/65536\n", tick_load, tick_frac_q16);
+    if (tmr_get_utc_us(&utc_us) == 0)
+        printf("UTC=%lu.%06lu\n", (uint32_t)(utc_us / 1000000),
+               (uint32_t)(utc_us % 1000000));
+    else
+        printf("UTC not available\n");
+    return 0;
+}
+
+/*
+ * @brief Trim the SysTick reload per the measured clock frequency.
+ *
+ * @note Called in the same context as tmr_pps_edge().
+ */
+static void pps_apply_correction(void)
+{
+    uint64_t cyc_per_ms_q16 = (pps.cyc_per_sec_q8 << 8) / 1000;
+
+    tick_load = (uint32_t)(cyc_per_ms_q16 >> 16);
+    tick_frac_q16 = (uint32_t)(cyc_per_ms_q16 & 0xffff);
+}
+
 /*
  * @brief Timer callback function for "tmr test" command.
  *
@@ -7,6 +7,9 @@
  * - Buffering on input to avoid loss of input characters (overrun is possible)
  * - Integrate into the C standard library streams I/O (to support printf and
      friends)
+ * - Optional receive filter, called from the interrupt handler, so a client
+ *   can drop unwanted input before it uses buffer space.
+ * - A software UART on any two dio pins, for when the USARTs are all in use.
  * - Performance measurements.
  * - Console commands
  *
@@ -33,6 +36,16 @@
  * A future feature is to perform full hardware initialization in this library,
  * and allowing at least some UART parameters to be set (e.g. buad).
  *
+ * The software UART (TTYS_INSTANCE_SWUART) is driven by the TIM3 update
+ * interrupt, at SWUART_OVERSAMPLE times the baud rate. TX writes one bit every
+ * SWUART_OVERSAMPLE ticks. RX polls for the start bit every tick, and decides
+ * each bit by majority vote of the last three samples in the bit. This
+ * tolerates a sender baud rate error of -5% to +2.5% (see
+ * host_test/swuart_sim.c). It uses the same buffers, receive filter and stdio
+ * integration as the USARTs, and its interrupt cost is measured and shown by
+ * "ttys status". TIM3 is reserved with dio_reserve_tmr(), so dio PWM can't use
+ * it while the software UART runs.
+ *
  * MIT License
  * 
  * Copyright (c) 2021 Eugene R Schroeder
@@ -63,9 +76,13 @@
 #include <unistd.h>
 #include <errno.h>
 
+#include "stm32f4xx_ll_bus.h"
+#include "stm32f4xx_ll_rcc.h"
+#include "stm32f4xx_ll_tim.h"
 #include "stm32f4xx_ll_usart.h"
 
 #include "cmd.h"
+#include "dio.h"
 #include "log.h"
 #include "module.h"
 #include "tmr.h"
@@ -85,6 +102,11 @@
 #define UART1_FD 4
 #define UART2_FD 1
 #define UART6_FD 3
+#define SWUART_FD 5
+
+#define SWUART_TMR TIM3
+#define SWUART_OVERSAMPLE 4
+#define SWUART_FRAME_BITS 10 // Start, 8 data, stop.
 
 ////////////////////////////////////////////////////////////////////////////////
 // Type definitions
@@ -96,6 +118,8 @@ struct ttys_state {
     FILE* stream;
     int fd;
     USART_TypeDef* uart_reg_base;
+    ttys_rx_filter_cb rx_filter;
+    uint32_t rx_filter_user_data;
     uint16_t rx_buf_get_idx;
     uint16_t rx_buf_put_idx;
     uint16_t tx_buf_get_idx;
@@ -104,6 +128,26 @@ struct ttys_state {
     char rx_buf[TTYS_RX_BUF_SIZE];
 };
 
+// Software UART state. The tick counters count interrupts within a bit.
+struct swuart_state {
+    bool started;
+    bool tx_active;     // Sending a character, including its stop bit.
+    uint8_t tx_tick;
+    uint8_t tx_bits;    // Bits left to send in the character.
+    uint16_t tx_shift;  // Bits to send, LSB first.
+    uint8_t rx_tick;
+    uint8_t rx_bits;    // Bits left to receive, 0 when hunting for start.
+    uint8_t rx_sum;     // Samples of 1 in the current bit.
+    uint8_t rx_shift;
+
+    // Measurements.
+    uint32_t ticks;
+    uint64_t isr_cycles;
+    uint32_t max_isr_cycles;
+    uint32_t tx_bytes;
+    uint32_t rx_bytes;
+};
+
 // Performance measurements for ttys. Currently these are common to all
 // instances.  A future enhancement would be to make them per-instance.
 
@@ -124,6 +168,10 @@ enum ttys_u16_pms {
 
 static void ttys_interrupt(enum ttys_instance_id instance_id,
                            IRQn_Type irq_type);
+static void rx_put(struct ttys_state* st, char c);
+static int32_t swuart_start(struct ttys_state* st);
+static int32_t swuart_set_baud(uint32_t baud);
+static void swuart_print_stats(struct ttys_state* st);
 static int32_t cmd_ttys_status(int32_t argc, const char** argv);
 static int32_t cmd_ttys_test(int32_t argc, const char** argv);
 
@@ -133,6 +181,8 @@ static int32_t cmd_ttys_test(int32_t argc, const char** argv);
 
 static struct ttys_state ttys_states[TTYS_NUM_INSTANCES];
 
+static struct swuart_state swuart;
+
 static int32_t log_level = LOG_DEFAULT;
 
 // Storage for performance measurements.
@@ -196,6 +246,9 @@ int32_t ttys_get_def_cfg(enum ttys_instance_id instance_id, struct ttys_cfg* cfg
     memset(cfg, 0, sizeof(*cfg));
     cfg->create_stream = true;
     cfg->send_cr_after_nl = true;
+    cfg->swuart_tx_dout_idx = -1;
+    cfg->swuart_rx_din_idx = -1;
+    cfg->swuart_baud = 9600;
     return 0;
 }
 
@@ -247,6 +300,15 @@ int32_t ttys_init(enum ttys_instance_id instance_id, struct ttys_cfg* cfg)
             st->uart_reg_base = USART6;
             st->fd = UART6_FD;
             break;
+        case TTYS_INSTANCE_SWUART:
+            if (cfg->swuart_baud < TTYS_SWUART_MIN_BAUD ||
+                cfg->swuart_baud > TTYS_SWUART_MAX_BAUD ||
+                cfg->swuart_tx_dout_idx >= DIO_MAX_MASK_BITS ||
+                cfg->swuart_rx_din_idx >= DIO_MAX_MASK_BITS)
+                return MOD_ERR_ARG;
+            st->uart_reg_base = NULL;
+            st->fd = SWUART_FD;
+            break;
         default:
             return MOD_ERR_BAD_INSTANCE;
     }
@@ -277,7 +339,8 @@ int32_t ttys_start(enum ttys_instance_id instance_id)
     int32_t result;
 
     if (instance_id >= TTYS_NUM_INSTANCES ||
-        ttys_states[instance_id].uart_reg_base == NULL)
+        (ttys_states[instance_id].uart_reg_base == NULL &&
+         ttys_states[instance_id].fd != SWUART_FD))
         return MOD_ERR_BAD_INSTANCE;
 
     result = cmd_register(&cmd_info);
@@ -287,6 +350,8 @@ int32_t ttys_start(enum ttys_instance_id instance_id)
     }
 
     st = &ttys_states[instance_id];
+    if (instance_id == TTYS_INSTANCE_SWUART)
+        return swuart_start(st);
     LL_USART_EnableIT_RXNE(st->uart_reg_base);
     LL_USART_EnableIT_TXE(st->uart_reg_base);
 
@@ -346,7 +411,8 @@ int32_t ttys_putc(enum ttys_instance_id instance_id, char c)
     st->tx_buf[st->tx_buf_put_idx] = c;
     st->tx_buf_put_idx = next_put_idx;
 
-    // Ensure the TX interrupt is enabled.
+    // Ensure the TX interrupt is enabled. The software UART checks the buffer
+    // every bit time, so it needs nothing.
     if (ttys_states[instance_id].uart_reg_base != NULL) {
         __disable_irq();
         LL_USART_EnableIT_TXE(st->uart_reg_base);
@@ -386,6 +452,146 @@ int32_t ttys_getc(enum ttys_instance_id instance_id, char* c)
     return 1;
 }
 
+/*
+ * @brief Set the UART baud rate.
+ *
+ * @param[in] instance_id Identifies the ttys instance.
+ * @param[in] baud New baud rate.
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * @note The UART is briefly disabled, so a character being transmitted or
+ *       received is lost. Use ttys_is_tx_idle() to wait for the end of
+ *       transmission first.
+ */
+int32_t ttys_set_baud(enum ttys_instance_id instance_id, uint32_t baud)
+{
+    struct ttys_state* st;
+    LL_RCC_ClocksTypeDef clocks;
+    uint32_t periph_clk;
+
+    if (instance_id == TTYS_INSTANCE_SWUART)
+        return swuart.started ? swuart_set_baud(baud) : MOD_ERR_BAD_INSTANCE;
+    if (instance_id >= TTYS_NUM_INSTANCES ||
+        ttys_states[instance_id].uart_reg_base == NULL)
+        return MOD_ERR_BAD_INSTANCE;
+    if (baud == 0)
+        return MOD_ERR_ARG;
+
+    st = &ttys_states[instance_id];
+
+    // USART2 is on APB1, the others are on APB2.
+    LL_RCC_GetSystemClocksFreq(&clocks);
+    periph_clk = st->uart_reg_base == USART2 ? clocks.PCLK1_Frequency :
+        clocks.PCLK2_Frequency;
+
+    LL_USART_Disable(st->uart_reg_base);
+    LL_USART_SetBaudRate(st->uart_reg_base, periph_clk,
+                         LL_USART_OVERSAMPLING_16, baud);
+    LL_USART_Enable(st->uart_reg_base);
+    return 0;
+}
+
+/*
+ * @brief Get the UART baud rate.
+ *
+ * @param[in] instance_id Identifies the ttys instance.
+ *
+ * @return The baud rate in use (as programmed in the UART, so it includes
+ *         divider rounding), or 0 if the instance is not initialized.
+ */
+uint32_t ttys_get_baud(enum ttys_instance_id instance_id)
+{
+    struct ttys_state* st;
+    LL_RCC_ClocksTypeDef clocks;
+    uint32_t periph_clk;
+
+    if (instance_id == TTYS_INSTANCE_SWUART)
+        return swuart.started ?
+            ttys_states[TTYS_INSTANCE_SWUART].cfg.swuart_baud : 0;
+    if (instance_id >= TTYS_NUM_INSTANCES ||
+        ttys_states[instance_id].uart_reg_base == NULL)
+        return 0;
+
+    st = &ttys_states[instance_id];
+    LL_RCC_GetSystemClocksFreq(&clocks);
+    periph_clk = st->uart_reg_base == USART2 ? clocks.PCLK1_Frequency :
+        clocks.PCLK2_Frequency;
+    return LL_USART_GetBaudRate(st->uart_reg_base, periph_clk,
+                                LL_USART_OVERSAMPLING_16);
+}
+
+/*
+ * @brief Check if transmission is complete.
+ *
+ * @param[in] instance_id Identifies the ttys instance.
+ *
+ * @return true if the TX buffer is empty and the UART has finished sending
+ *         the last character.
+ */
+bool ttys_is_tx_idle(enum ttys_instance_id instance_id)
+{
+    struct ttys_state* st;
+
+    if (instance_id >= TTYS_NUM_INSTANCES)
+        return true;
+    st = &ttys_states[instance_id];
+    if (st->tx_buf_get_idx != st->tx_buf_put_idx)
+        return false;
+    if (instance_id == TTYS_INSTANCE_SWUART)
+        return !swuart.tx_active;
+    return st->uart_reg_base == NULL ||
+        LL_USART_IsActiveFlag_TC(st->uart_reg_base);
+}
+
+/*
+ * @brief Get the free space in the TX buffer.
+ *
+ * @param[in] instance_id Identifies the ttys instance.
+ *
+ * @return Number of characters that can be put without an overrun.
+ */
+uint32_t ttys_get_tx_free(enum ttys_instance_id instance_id)
+{
+    struct ttys_state* st;
+
+    if (instance_id >= TTYS_NUM_INSTANCES)
+        return 0;
+    st = &ttys_states[instance_id];
+
+    // One slot is always left empty, to tell a full buffer from an empty one.
+    return (st->tx_buf_get_idx + TTYS_TX_BUF_SIZE - st->tx_buf_put_idx - 1) %
+        TTYS_TX_BUF_SIZE;
+}
+
+/*
+ * @brief Set the receive filter.
+ *
+ * @param[in] instance_id Identifies the ttys instance.
+ * @param[in] cb The filter function (NULL for none).
+ * @param[in] user_data User data passed to the filter function.
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * @note The filter is called from the UART interrupt handler.
+ */
+int32_t ttys_set_rx_filter(enum ttys_instance_id instance_id,
+                           ttys_rx_filter_cb cb, uint32_t user_data)
+{
+    struct ttys_state* st;
+
+    if (instance_id >= TTYS_NUM_INSTANCES)
+        return MOD_ERR_BAD_INSTANCE;
+    st = &ttys_states[instance_id];
+
+    // Remove the old filter before changing the user data, as the interrupt
+    // handler could run at any time.
+    st->rx_filter = NULL;
+    st->rx_filter_user_data = user_data;
+    st->rx_filter = cb;
+    return 0;
+}
+
 /*
  * @brief Get file descriptor for a ttys instance.
  *
@@ -436,6 +642,88 @@ void USART6_IRQHandler(void)
     ttys_interrupt(TTYS_INSTANCE_UART6, USART6_IRQn);
 }
 
+/*
+ * @brief Software UART timer interrupt handler.
+ *
+ * The dio fast path functions are used for the pins, to keep the cost per
+ * tick low.
+ */
+void TIM3_IRQHandler(void)
+{
+    uint32_t start_cycles = tmr_get_cycles();
+    struct ttys_state* st = &ttys_states[TTYS_INSTANCE_SWUART];
+    uint32_t bit;
+
+    SWUART_TMR->SR = ~TIM_SR_UIF;
+
+    if (st->cfg.swuart_tx_dout_idx >= 0 &&
+        ++swuart.tx_tick >= SWUART_OVERSAMPLE) {
+        swuart.tx_tick = 0;
+        if (swuart.tx_bits == 0) {
+            if (st->tx_buf_get_idx != st->tx_buf_put_idx) {
+                // Start bit (0), 8 data bits, stop bit (1).
+                swuart.tx_shift =
+                    ((uint16_t)(uint8_t)st->tx_buf[st->tx_buf_get_idx] |
+                     0x100) << 1;
+                swuart.tx_bits = SWUART_FRAME_BITS;
+                swuart.tx_active = true;
+                if (st->tx_buf_get_idx < TTYS_TX_BUF_SIZE-1)
+                    st->tx_buf_get_idx++;
+                else
+                    st->tx_buf_get_idx = 0;
+            } else {
+                swuart.tx_active = false;
+            }
+        }
+        if (swuart.tx_bits != 0) {
+            dio_set_fast(st->cfg.swuart_tx_dout_idx, swuart.tx_shift & 1);
+            swuart.tx_shift >>= 1;
+            if (--swuart.tx_bits == 0)
+                swuart.tx_bytes++;
+        }
+    }
+
+    if (st->cfg.swuart_rx_din_idx >= 0) {
+        bit = dio_get_fast(st->cfg.swuart_rx_din_idx);
+        if (swuart.rx_bits == 0) {
+            // Hunting for the start bit. This sample is tick 0 of the bit.
+            if (bit == 0) {
+                swuart.rx_bits = SWUART_FRAME_BITS;
+                swuart.rx_tick = 0;
+                swuart.rx_sum = 0;
+            }
+        } else if (++swuart.rx_tick < SWUART_OVERSAMPLE) {
+            swuart.rx_sum += bit;
+            if (swuart.rx_tick == SWUART_OVERSAMPLE - 1) {
+                // Majority of the samples in ticks 1 to 3.
+                bit = swuart.rx_sum >= 2;
+                swuart.rx_sum = 0;
+                if (swuart.rx_bits == SWUART_FRAME_BITS) {
+                    if (bit)
+                        swuart.rx_bits = 0; // False start, hunt again.
+                    else
+                        swuart.rx_bits--;
+                } else if (--swuart.rx_bits != 0) {
+                    swuart.rx_shift = (swuart.rx_shift >> 1) | (bit << 7);
+                } else if (bit) {
+                    swuart.rx_bytes++;
+                    rx_put(st, swuart.rx_shift);
+                } else {
+                    INC_SAT_U16(cnts_u16[CNT_RX_UART_FE]);
+                }
+            }
+        } else {
+            swuart.rx_tick = 0;
+        }
+    }
+
+    bit = tmr_get_cycles() - start_cycles;
+    swuart.isr_cycles += bit;
+    if (bit > swuart.max_isr_cycles)
+        swuart.max_isr_cycles = bit;
+    swuart.ticks++;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Private (static) functions
 ////////////////////////////////////////////////////////////////////////////////
@@ -470,17 +758,9 @@ static void ttys_interrupt(enum ttys_instance_id instance_id,
     sr = st->uart_reg_base->SR;
 
     if (sr & LL_USART_SR_RXNE) {
-        // Got an incoming character.
-        uint16_t next_rx_put_idx = st->rx_buf_put_idx + 1;
-        char rx_data = st->uart_reg_base->DR;
-        if (next_rx_put_idx >= TTYS_RX_BUF_SIZE)
-            next_rx_put_idx = 0;
-        if (next_rx_put_idx == st->rx_buf_get_idx) {
-            INC_SAT_U16(cnts_u16[CNT_RX_BUF_OVERRUN]);
-        } else {
-            st->rx_buf[st->rx_buf_put_idx] = rx_data;
-            st->rx_buf_put_idx = next_rx_put_idx;
-        }
+        // Got an incoming character. The filter, if any, decides what goes
+        // into the buffer.
+        rx_put(st, st->uart_reg_base->DR);
     }
     if (sr & LL_USART_SR_TXE) {
         // Can send a character.
@@ -513,6 +793,139 @@ static void ttys_interrupt(enum ttys_instance_id instance_id,
     }
 }
 
+/*
+ * @brief Put a received character in the RX buffer, from an interrupt handler.
+ *
+ * @param[in] st The ttys instance state.
+ * @param[in] c The received character.
+ *
+ * The receive filter, if any, decides what goes into the buffer.
+ */
+static void rx_put(struct ttys_state* st, char c)
+{
+    char rx_data[TTYS_RX_FILTER_MAX_OUT];
+    uint32_t num_rx = 1;
+    uint32_t idx;
+
+    rx_data[0] = c;
+    if (st->rx_filter != NULL)
+        num_rx = st->rx_filter(rx_data[0], rx_data, st->rx_filter_user_data);
+    for (idx = 0; idx < num_rx; idx++) {
+        uint16_t next_rx_put_idx = st->rx_buf_put_idx + 1;
+        if (next_rx_put_idx >= TTYS_RX_BUF_SIZE)
+            next_rx_put_idx = 0;
+        if (next_rx_put_idx == st->rx_buf_get_idx) {
+            INC_SAT_U16(cnts_u16[CNT_RX_BUF_OVERRUN]);
+            break;
+        }
+        st->rx_buf[st->rx_buf_put_idx] = rx_data[idx];
+        st->rx_buf_put_idx = next_rx_put_idx;
+    }
+}
+
+/*
+ * @brief Start the software UART.
+ *
+ * @param[in] st The software UART ttys instance state.
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * The dio module must have been initialized, with the pins configured. TIM3
+ * is reserved in the dio module, so it must not be in use for PWM.
+ */
+static int32_t swuart_start(struct ttys_state* st)
+{
+    int32_t result;
+
+    if ((st->cfg.swuart_tx_dout_idx >= 0 &&
+         st->cfg.swuart_tx_dout_idx >= dio_get_num_out()) ||
+        (st->cfg.swuart_rx_din_idx >= 0 &&
+         st->cfg.swuart_rx_din_idx >= dio_get_num_in()))
+        return MOD_ERR_ARG;
+
+    result = dio_reserve_tmr(SWUART_TMR);
+    if (result < 0)
+        return result;
+
+    memset(&swuart, 0, sizeof(swuart));
+    if (st->cfg.swuart_tx_dout_idx >= 0)
+        dio_set(st->cfg.swuart_tx_dout_idx, 1); // Idle.
+
+    LL_APB1_GRP1_EnableClock(LL_APB1_GRP1_PERIPH_TIM3);
+    LL_TIM_SetPrescaler(SWUART_TMR, 0);
+    result = swuart_set_baud(st->cfg.swuart_baud);
+    if (result < 0)
+        return result;
+    LL_TIM_GenerateEvent_UPDATE(SWUART_TMR);
+    SWUART_TMR->SR = 0;
+    LL_TIM_EnableIT_UPDATE(SWUART_TMR);
+
+    // Bit timing needs low latency, so use the highest priority.
+    NVIC_SetPriority(TIM3_IRQn,
+                     NVIC_EncodePriority(NVIC_GetPriorityGrouping(), 0, 0));
+    NVIC_EnableIRQ(TIM3_IRQn);
+    LL_TIM_EnableCounter(SWUART_TMR);
+    swuart.started = true;
+    return 0;
+}
+
+/*
+ * @brief Set the software UART baud rate.
+ *
+ * @param[in] baud New baud rate.
+ *
+ * @return 0 for success, else a "MOD_ERR" value. See code for details.
+ *
+ * The timer is assumed to run at the core clock. The new rate takes effect at
+ * the next tick.
+ */
+static int32_t swuart_set_baud(uint32_t baud)
+{
+    uint32_t tick_hz = baud * SWUART_OVERSAMPLE;
+
+    if (baud < TTYS_SWUART_MIN_BAUD || baud > TTYS_SWUART_MAX_BAUD)
+        return MOD_ERR_ARG;
+    ttys_states[TTYS_INSTANCE_SWUART].cfg.swuart_baud = baud;
+    LL_TIM_SetAutoReload(SWUART_TMR,
+                         (SystemCoreClock + tick_hz / 2) / tick_hz - 1);
+    return 0;
+}
+
+/*
+ * @brief Print the software UART interrupt cost.
+ *
+ * @param[in] st The software UART ttys instance state.
+ *
+ * The interrupt runs every tick, whether or not there is traffic, so the cost
+ * is given per tick, as a CPU load, and per byte transferred.
+ */
+static void swuart_print_stats(struct ttys_state* st)
+{
+    uint32_t ticks;
+    uint64_t isr_cycles;
+    uint32_t bytes;
+    uint32_t avg;
+
+    __disable_irq();
+    ticks = swuart.ticks;
+    isr_cycles = swuart.isr_cycles;
+    bytes = swuart.tx_bytes + swuart.rx_bytes;
+    __enable_irq();
+    avg = ticks == 0 ? 0 : (uint32_t)(isr_cycles / ticks);
+
+    printf("  SWUART: baud=%lu ticks=%lu tx_bytes=%lu rx_bytes=%lu\n",
+           st->cfg.swuart_baud, ticks, swuart.tx_bytes, swuart.rx_bytes);
+    printf("  ISR cycles: avg/tick=%lu max/tick=%lu load=%lu.%02lu%%",
+           avg, swuart.max_isr_cycles,
+           (uint32_t)((uint64_t)avg * st->cfg.swuart_baud * SWUART_OVERSAMPLE *
+                      100 / SystemCoreClock),
+           (uint32_t)((uint64_t)avg * st->cfg.swuart_baud * SWUART_OVERSAMPLE *
+                      10000 / SystemCoreClock) % 100);
+    if (bytes != 0)
+        printf(" total/byte=%lu", (uint32_t)(isr_cycles / bytes));
+    printf("\n");
+}
+
 /*
  * @brief Console command function for "ttys status".
  *
@@ -530,7 +943,13 @@ static int32_t cmd_ttys_status(int32_t argc, const char** argv)
     for (instance_id = 0; instance_id < TTYS_NUM_INSTANCES; instance_id++) {
         struct ttys_state* st = &ttys_states[instance_id];
         printf("Instance %d:\n", instance_id);
-        if (st->uart_reg_base == NULL) {
+        if (instance_id == TTYS_INSTANCE_SWUART && swuart.started) {
+            printf("  TX buffer: get_idx=%u put_idx=%u\n",
+                   st->tx_buf_get_idx, st->tx_buf_put_idx);
+            printf("  RX buffer: get_idx=%u put_idx=%d\n",
+                   st->rx_buf_get_idx, st->rx_buf_put_idx);
+            swuart_print_stats(st);
+        } else if (st->uart_reg_base == NULL) {
             printf("  NULL\n");
         } else {
             printf("  TX buffer: get_idx=%u put_idx=%u\n",
@@ -668,6 +1087,9 @@ static enum ttys_instance_id fd_to_instance(int fd)
         case UART2_FD:
             instance_id = TTYS_INSTANCE_UART2;
             break;
+        case SWUART_FD:
+            instance_id = TTYS_INSTANCE_SWUART;
+            break;
     }
     return instance_id;
 }